@@ -76,12 +76,12 @@ void Auth::Save()
 	if (!auth) {
 		if (config_has_user_value(main->Config(), "Auth", "Type")) {
 			config_remove_value(main->Config(), "Auth", "Type");
-			config_save_safe(main->Config(), "tmp", nullptr);
+			config_save_safe_async(main->Config(), "tmp", nullptr);
 		}
 		return;
 	}
 
 	config_set_string(main->Config(), "Auth", "Type", auth->service());
 	auth->SaveInternal();
-	config_save_safe(main->Config(), "tmp", nullptr);
+	config_save_safe_async(main->Config(), "tmp", nullptr);
 }
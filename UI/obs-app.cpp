@@ -27,6 +27,7 @@
 #include <util/dstr.hpp>
 #include <util/platform.h>
 #include <util/profiler.hpp>
+#include <util/metrics.h>
 #include <util/cf-parser.h>
 #include <obs-config.h>
 #include <obs.hpp>
@@ -94,6 +95,7 @@ bool opt_disable_missing_files_check = false;
 string opt_starting_collection;
 string opt_starting_profile;
 string opt_starting_scene;
+string opt_metrics_endpoint;
 
 bool restart = false;
 
@@ -834,6 +836,14 @@ bool OBSApp::InitLocale()
 		return false;
 	}
 
+	// compiled locale tables are cached and mapped on later launches,
+	// for both the UI and the modules loaded after this
+	char cachePath[512];
+	if (GetConfigPath(cachePath, sizeof(cachePath),
+			  "obs-studio/cache/locale") > 0 &&
+	    os_mkdirs(cachePath) != MKDIR_ERROR)
+		text_lookup_set_cache_dir(cachePath);
+
 	textLookup = text_lookup_create(englishPath.c_str());
 	if (!textLookup) {
 		OBSErrorBox(NULL, "Failed to create locale from file '%s'",
@@ -2206,8 +2216,13 @@ static int run_program(fstream &logFile, int argc, char *argv[])
 
 		prof.Stop();
 
+		if (!opt_metrics_endpoint.empty())
+			metrics_exporter_start(opt_metrics_endpoint.c_str());
+
 		ret = program.exec();
 
+		metrics_exporter_stop();
+
 	} catch (const char *error) {
 		blog(LOG_ERROR, "%s", error);
 		OBSErrorBox(nullptr, "%s", error);
@@ -2815,6 +2830,10 @@ int main(int argc, char *argv[])
 			if (++i < argc)
 				opt_starting_scene = argv[i];
 
+		} else if (arg_is(argv[i], "--metrics-endpoint", nullptr)) {
+			if (++i < argc)
+				opt_metrics_endpoint = argv[i];
+
 		} else if (arg_is(argv[i], "--minimize-to-tray", nullptr)) {
 			opt_minimize_tray = true;
 
@@ -2855,7 +2874,8 @@ int main(int argc, char *argv[])
 				"--unfiltered_log: Make log unfiltered.\n\n"
 				"--disable-updater: Disable built-in updater (Windows/Mac only)\n\n"
 				"--disable-missing-files-check: Disable the missing files dialog which can appear on startup.\n\n"
-				"--disable-high-dpi-scaling: Disable automatic high-DPI scaling\n\n";
+				"--disable-high-dpi-scaling: Disable automatic high-DPI scaling\n\n"
+				"--metrics-endpoint <string>: Serve runtime metrics in Prometheus format on a local port or unix:<path>.\n\n";
 
 #ifdef _WIN32
 			MessageBoxA(NULL, help.c_str(), "Help",
@@ -2914,6 +2934,8 @@ int main(int argc, char *argv[])
 	}
 #endif
 
+	text_lookup_set_cache_dir(nullptr);
+
 	blog(LOG_INFO, "Number of memory leaks: %ld", bnum_allocs());
 	base_set_log_handler(nullptr, nullptr);
 	return ret;
@@ -126,6 +126,9 @@ bool QTToGSWindow(QWindow *window, gs_window &gswindow)
 		gswindow.id = window->winId();
 		gswindow.display = obs_get_nix_platform_display();
 		break;
+	case OBS_NIX_PLATFORM_SURFACELESS_EGL:
+		success = false;
+		break;
 #ifdef ENABLE_WAYLAND
 	case OBS_NIX_PLATFORM_WAYLAND:
 		QPlatformNativeInterface *native =
@@ -294,8 +294,13 @@ bool OBSBasic::CreateProfile(const std::string &newName, bool create_new,
 		return false;
 	}
 
-	if (!create_new)
+	if (!create_new) {
+		// settings are saved in the background, so make sure the
+		// copied files are up to date
+		config_flush(basicConfig);
+		config_flush(App()->GlobalConfig());
 		CopyProfile(curDir.c_str(), newPath.c_str());
+	}
 
 	newPath += "/basic.ini";
 
@@ -724,6 +729,8 @@ void OBSBasic::on_actionExportProfile_triggered()
 					      "/recordEncoder.json");
 		}
 
+		config_flush(basicConfig);
+
 		QFile::copy(inputPath + currentProfile + "/basic.ini",
 			    outputDir + "/basic.ini");
 		QFile::copy(inputPath + currentProfile + "/service.json",
@@ -1484,6 +1484,9 @@ bool OBSBasic::InitBasicConfigDefaults()
 		Str("Basic.Settings.Advanced.Audio.MonitoringDevice"
 		    ".Default"));
 	config_set_default_uint(basicConfig, "Audio", "SampleRate", 48000);
+	config_set_default_uint(basicConfig, "Audio", "FramesPerTick", 1024);
+	config_set_default_bool(basicConfig, "Audio", "MonitoringPremix",
+				false);
 	config_set_default_string(basicConfig, "Audio", "ChannelSetup",
 				  "Stereo");
 	config_set_default_double(basicConfig, "Audio", "MeterDecayRate",
@@ -1746,6 +1749,9 @@ void OBSBasic::OBSInit()
 
 	/* load audio monitoring */
 	if (obs_audio_monitoring_available()) {
+		obs_set_audio_monitoring_premix(config_get_bool(
+			basicConfig, "Audio", "MonitoringPremix"));
+
 		const char *device_name = config_get_string(
 			basicConfig, "Audio", "MonitoringDeviceName");
 		const char *device_id = config_get_string(basicConfig, "Audio",
@@ -4353,6 +4359,11 @@ int OBSBasic::ResetVideo()
 				ovi.base_height);
 	}
 
+	char shaderCachePath[512];
+	if (GetConfigPath(shaderCachePath, sizeof(shaderCachePath),
+			  "obs-studio/shader-cache") > 0)
+		gs_set_shader_cache_path(shaderCachePath);
+
 	ret = AttemptToResetVideo(&ovi);
 	if (IS_WIN32 && ret != OBS_VIDEO_SUCCESS) {
 		if (ret == OBS_VIDEO_CURRENTLY_ACTIVE) {
@@ -4389,9 +4400,13 @@ bool OBSBasic::ResetAudio()
 {
 	ProfileScope("OBSBasic::ResetAudio");
 
-	struct obs_audio_info ai;
+	struct obs_audio_info2 ai = {};
 	ai.samples_per_sec =
 		config_get_uint(basicConfig, "Audio", "SampleRate");
+	ai.frames_per_tick = (uint32_t)config_get_uint(basicConfig, "Audio",
+						       "FramesPerTick");
+	if (ai.frames_per_tick != 256 && ai.frames_per_tick != 512)
+		ai.frames_per_tick = 1024;
 
 	const char *channelSetupStr =
 		config_get_string(basicConfig, "Audio", "ChannelSetup");
@@ -4411,7 +4426,7 @@ bool OBSBasic::ResetAudio()
 	else
 		ai.speakers = SPEAKERS_STEREO;
 
-	return obs_reset_audio(&ai);
+	return obs_reset_audio2(&ai);
 }
 
 extern char *get_new_source_name(const char *name, const char *format);
@@ -6363,7 +6378,8 @@ void OBSBasic::ShowYouTubeAutoStartWarning()
 		if (cb->isChecked()) {
 			config_set_bool(App()->GlobalConfig(), "General",
 					"WarnedAboutYouTubeAutoStart", true);
-			config_save_safe(App()->GlobalConfig(), "tmp", nullptr);
+			config_save_safe_async(App()->GlobalConfig(), "tmp",
+					       nullptr);
 		}
 	};
 
@@ -7193,7 +7209,8 @@ void OBSBasic::ShowReplayBufferPauseWarning()
 		if (cb->isChecked()) {
 			config_set_bool(App()->GlobalConfig(), "General",
 					"WarnedAboutReplayBufferPausing", true);
-			config_save_safe(App()->GlobalConfig(), "tmp", nullptr);
+			config_save_safe_async(App()->GlobalConfig(), "tmp",
+					       nullptr);
 		}
 	};
 
@@ -9546,7 +9563,7 @@ void OBSBasic::ResizeOutputSizeOfSource()
 
 	ResetVideo();
 	ResetOutputs();
-	config_save_safe(basicConfig, "tmp", nullptr);
+	config_save_safe_async(basicConfig, "tmp", nullptr);
 	on_actionFitToScreen_triggered();
 }
 
@@ -3730,8 +3730,8 @@ void OBSBasicSettings::SaveSettings()
 	if (videoChanged || advancedChanged)
 		main->ResetVideo();
 
-	config_save_safe(main->Config(), "tmp", nullptr);
-	config_save_safe(GetGlobalConfig(), "tmp", nullptr);
+	config_save_safe_async(main->Config(), "tmp", nullptr);
+	config_save_safe_async(GetGlobalConfig(), "tmp", nullptr);
 	main->SaveProject();
 
 	if (Changed()) {
@@ -4244,7 +4244,7 @@ void OBSBasicSettings::HideOBSWindowWarning(int state)
 
 	config_set_bool(GetGlobalConfig(), "General",
 			"WarnedAboutHideOBSFromCapture", true);
-	config_save_safe(GetGlobalConfig(), "tmp", nullptr);
+	config_save_safe_async(GetGlobalConfig(), "tmp", nullptr);
 }
 
 /*
@@ -19,6 +19,7 @@
 #include <sys/stat.h>
 
 #include <assert.h>
+#include <inttypes.h>
 
 #include "media.h"
 #include "closest-format.h"
@@ -28,6 +29,114 @@
 
 static int64_t base_sys_ts = 0;
 
+#define MAX_SEEK_DECODE_FRAMES 300
+
+/* ------------------------------------------------------------------------- */
+/* Loop caches of all media share one memory budget.  When it is exceeded the
+ * least recently used caches are dropped and their media go back to decoding
+ * from the file. */
+
+#define DEFAULT_CACHE_BUDGET (512ULL * 1024ULL * 1024ULL)
+
+static pthread_mutex_t cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+static DARRAY(mp_media_t *) cache_users;
+static uint64_t cache_total = 0;
+static uint64_t cache_budget = DEFAULT_CACHE_BUDGET;
+
+static void cache_evict_lru(void)
+{
+	while (cache_total > cache_budget) {
+		mp_media_t *victim = NULL;
+
+		for (size_t i = 0; i < cache_users.num; i++) {
+			mp_media_t *m = cache_users.array[i];
+			if (!m->cache_bytes ||
+			    os_atomic_load_bool(&m->cache_evict))
+				continue;
+			if (!victim ||
+			    m->cache_last_used < victim->cache_last_used)
+				victim = m;
+		}
+
+		if (!victim)
+			break;
+
+		blog(LOG_INFO,
+		     "MP: Dropping loop cache of '%s' (%" PRIu64 " MB) to stay "
+		     "within the cache budget",
+		     victim->path, victim->cache_bytes / (1024 * 1024));
+
+		/* the owning media thread frees the memory the next time it
+		 * checks the flag, count it as released already */
+		cache_total -= victim->cache_bytes;
+		victim->cache_bytes = 0;
+		os_atomic_set_bool(&victim->cache_evict, true);
+	}
+}
+
+static void cache_register(mp_media_t *m)
+{
+	pthread_mutex_lock(&cache_mutex);
+	da_push_back(cache_users, &m);
+	pthread_mutex_unlock(&cache_mutex);
+}
+
+static void cache_unregister(mp_media_t *m)
+{
+	pthread_mutex_lock(&cache_mutex);
+	da_erase_item(cache_users, &m);
+	if (!cache_users.num)
+		da_free(cache_users);
+	pthread_mutex_unlock(&cache_mutex);
+}
+
+static void cache_add(mp_media_t *m, size_t size)
+{
+	pthread_mutex_lock(&cache_mutex);
+	if (!os_atomic_load_bool(&m->cache_evict)) {
+		m->cache_bytes += size;
+		m->cache_last_used = os_gettime_ns();
+		cache_total += size;
+		cache_evict_lru();
+	}
+	pthread_mutex_unlock(&cache_mutex);
+}
+
+static void cache_touch(mp_media_t *m)
+{
+	pthread_mutex_lock(&cache_mutex);
+	m->cache_last_used = os_gettime_ns();
+	pthread_mutex_unlock(&cache_mutex);
+}
+
+static void cache_release(mp_media_t *m)
+{
+	pthread_mutex_lock(&cache_mutex);
+	cache_total -= m->cache_bytes;
+	m->cache_bytes = 0;
+	pthread_mutex_unlock(&cache_mutex);
+}
+
+void mp_media_set_cache_budget(uint64_t bytes)
+{
+	pthread_mutex_lock(&cache_mutex);
+	cache_budget = bytes;
+	cache_evict_lru();
+	pthread_mutex_unlock(&cache_mutex);
+}
+
+static inline size_t cached_video_size(const struct obs_source_frame *frame)
+{
+	size_t size = 0;
+
+	for (size_t i = 0; i < MAX_AV_PLANES; i++) {
+		if (frame->data[i])
+			size += (size_t)frame->linesize[i] * frame->height;
+	}
+
+	return size;
+}
+
 static inline enum video_format convert_pixel_format(int f)
 {
 	switch (f) {
@@ -298,6 +407,48 @@ static bool mp_media_has_video_frame_cached(mp_media_t *m)
 	return true;
 }
 
+/* ------------------------------------------------------------------------- */
+/* While the media is idle the first few video frames can be decoded ahead of
+ * time.  They are played back before the decoder is touched again, so the
+ * video decoder is always that many frames ahead until they run out. */
+
+static inline bool mp_media_preroll_pending(mp_media_t *m)
+{
+	return m->preroll_pos < m->preroll.num;
+}
+
+static void mp_media_clear_preroll(mp_media_t *m)
+{
+	for (size_t i = 0; i < m->preroll.num; i++)
+		obs_source_frame_destroy(m->preroll.array[i].frame);
+	da_free(m->preroll);
+	m->preroll_pos = 0;
+}
+
+static inline bool mp_media_video_ready(mp_media_t *m)
+{
+	return mp_media_preroll_pending(m) || m->v.frame_ready;
+}
+
+static inline int64_t mp_media_video_pts(mp_media_t *m)
+{
+	return mp_media_preroll_pending(m)
+		       ? m->preroll.array[m->preroll_pos].pts
+		       : m->v.frame_pts;
+}
+
+static inline int64_t mp_media_video_next_pts(mp_media_t *m)
+{
+	if (mp_media_preroll_pending(m)) {
+		struct mp_preroll_frame *pf = &m->preroll.array[m->preroll_pos];
+		return pf->pts + pf->duration;
+	}
+
+	return m->v.next_pts;
+}
+
+/* ------------------------------------------------------------------------- */
+
 static inline int64_t mp_media_get_next_min_pts(mp_media_t *m)
 {
 	int64_t min_next_ns = 0x7FFFFFFFFFFFFFFFLL;
@@ -325,9 +476,10 @@ static inline int64_t mp_media_get_next_min_pts(mp_media_t *m)
 		}
 	}
 	if (!use_cached) {
-		if (m->has_video && m->v.frame_ready) {
-			if (m->v.frame_pts < min_next_ns ) 
-				min_next_ns = m->v.frame_pts;
+		if (m->has_video && mp_media_video_ready(m)) {
+			int64_t pts = mp_media_video_pts(m);
+			if (pts < min_next_ns)
+				min_next_ns = pts;
 		}
 		if (m->has_audio && m->a.frame_ready) {
 			if (m->a.frame_pts < min_next_ns ) 
@@ -341,8 +493,8 @@ static inline int64_t mp_media_get_base_pts(mp_media_t *m)
 {
 	int64_t base_ts = 0;
 
-	if (m->has_video && m->v.next_pts > base_ts)
-		base_ts = m->v.next_pts;
+	if (m->has_video && mp_media_video_next_pts(m) > base_ts)
+		base_ts = mp_media_video_next_pts(m);
 	if (m->has_audio && m->a.next_pts > base_ts)
 		base_ts = m->a.next_pts;
 
@@ -421,6 +573,13 @@ static void mp_media_next_audio(mp_media_t *m)
 					audio->timestamp - previous_frame->timestamp;
 			}
 			da_push_back(m->audio.data, &audio);
+
+			size_t size = sizeof(*audio);
+			for (size_t i = 0; i < MAX_AV_PLANES; i++) {
+				if (audio->data[i])
+					size += f->linesize[0];
+			}
+			cache_add(m, size);
 		}
 	}
 	if (m->enable_caching) {
@@ -444,6 +603,111 @@ static void mp_media_next_audio(mp_media_t *m)
 	}
 }
 
+/* converts the frame held by the video decoder into m->obsframe, everything
+ * except the timing */
+static bool mp_media_convert_video(mp_media_t *m)
+{
+	AVFrame *f = m->v.frame;
+	struct obs_source_frame *current_frame = &m->obsframe;
+	enum video_format new_format;
+	enum video_colorspace new_space;
+	enum video_range_type new_range;
+	bool flip = false;
+
+	if (m->swscale) {
+		int ret = sws_scale(m->swscale,
+			(const uint8_t *const *)f->data, f->linesize,
+			0, f->height,
+			m->scale_pic, m->scale_linesizes);
+		if (ret < 0)
+			return false;
+
+		flip = m->scale_linesizes[0] < 0 && m->scale_linesizes[1] == 0;
+		for (size_t i = 0; i < 4; i++) {
+			current_frame->data[i] = m->scale_pic[i];
+			current_frame->linesize[i] = abs(m->scale_linesizes[i]);
+		}
+
+	}
+	else {
+		flip = f->linesize[0] < 0 && f->linesize[1] == 0;
+
+		for (size_t i = 0; i < MAX_AV_PLANES; i++) {
+			current_frame->data[i] = f->data[i];
+			current_frame->linesize[i] = abs(f->linesize[i]);
+		}
+	}
+
+	if (flip)
+		current_frame->data[0] -= current_frame->linesize[0] * (f->height - 1);
+
+	new_format = convert_pixel_format(m->scale_format);
+	new_space = convert_color_space(f->colorspace, f->color_trc);
+	new_range = m->force_range == VIDEO_RANGE_DEFAULT
+		? convert_color_range(f->color_range)
+		: m->force_range;
+
+	if (new_format != current_frame->format ||
+		new_space != m->cur_space ||
+		new_range != m->cur_range) {
+		bool success;
+
+		current_frame->format = new_format;
+		current_frame->full_range = new_range == VIDEO_RANGE_FULL;
+
+		success = video_format_get_parameters(
+			new_space,
+			new_range,
+			current_frame->color_matrix,
+			current_frame->color_range_min,
+			current_frame->color_range_max);
+
+		current_frame->format = new_format;
+		m->cur_space = new_space;
+		m->cur_range = new_range;
+
+		if (!success) {
+			current_frame->format = VIDEO_FORMAT_NONE;
+			return false;
+		}
+	}
+
+	current_frame->width = f->width;
+	current_frame->height = f->height;
+	current_frame->flip = flip;
+	current_frame->flags |= m->is_linear_alpha ? OBS_SOURCE_FRAME_LINEAR_ALPHA : 0;
+	return true;
+}
+
+static inline int64_t mp_media_frame_ts(mp_media_t *m, int64_t pts)
+{
+	return m->base_ts + pts - m->start_ts + m->play_sys_ts - base_sys_ts;
+}
+
+static void mp_media_next_preroll_video(mp_media_t *m, bool preload)
+{
+	struct mp_preroll_frame *pf = &m->preroll.array[m->preroll_pos];
+	struct obs_source_frame *frame = pf->frame;
+
+	if (!preload) {
+		if (pf->pts > m->next_pts_ns &&
+		    pf->pts - m->next_pts_ns <= MAX_TS_VAR)
+			return;
+		if (!m->v_cb)
+			return;
+
+		m->preroll_pos++;
+	}
+
+	frame->timestamp = mp_media_frame_ts(m, pf->pts);
+	frame->duration = pf->duration;
+
+	if (preload)
+		m->v_preload_cb(m->opaque, frame);
+	else
+		m->v_cb(m->opaque, frame);
+}
+
 static void mp_media_next_video(mp_media_t *m, bool preload)
 {
 	if (!m->process_video) {
@@ -451,10 +715,12 @@ static void mp_media_next_video(mp_media_t *m, bool preload)
 		return;
 	}
 
+	if (mp_media_preroll_pending(m)) {
+		mp_media_next_preroll_video(m, preload);
+		return;
+	}
+
 	struct mp_decode *d = &m->v;
-	enum video_format new_format;
-	enum video_colorspace new_space;
-	enum video_range_type new_range;
 	AVFrame *f = d->frame;
 	struct obs_source_frame *frame;
 
@@ -475,73 +741,12 @@ static void mp_media_next_video(mp_media_t *m, bool preload)
 		}
 
 		struct obs_source_frame *current_frame = &m->obsframe;
-		bool flip = false;
-		if (m->swscale) {
-			int ret = sws_scale(m->swscale,
-				(const uint8_t *const *)f->data, f->linesize,
-				0, f->height,
-				m->scale_pic, m->scale_linesizes);
-			if (ret < 0)
-				return;
-
-			flip = m->scale_linesizes[0] < 0 && m->scale_linesizes[1] == 0;
-			for (size_t i = 0; i < 4; i++) {
-				current_frame->data[i] = m->scale_pic[i];
-				current_frame->linesize[i] = abs(m->scale_linesizes[i]);
-			}
-
-		}
-		else {
-			flip = f->linesize[0] < 0 && f->linesize[1] == 0;
-
-			for (size_t i = 0; i < MAX_AV_PLANES; i++) {
-				current_frame->data[i] = f->data[i];
-				current_frame->linesize[i] = abs(f->linesize[i]);
-			}
-		}
-
-		if (flip)
-			current_frame->data[0] -= current_frame->linesize[0] * (f->height - 1);
-
-		new_format = convert_pixel_format(m->scale_format);
-		new_space = convert_color_space(f->colorspace, f->color_trc);
-		new_range = m->force_range == VIDEO_RANGE_DEFAULT
-			? convert_color_range(f->color_range)
-			: m->force_range;
-
-		if (new_format != current_frame->format ||
-			new_space != m->cur_space ||
-			new_range != m->cur_range) {
-			bool success;
-
-			current_frame->format = new_format;
-			current_frame->full_range = new_range == VIDEO_RANGE_FULL;
-
-			success = video_format_get_parameters(
-				new_space,
-				new_range,
-				current_frame->color_matrix,
-				current_frame->color_range_min,
-				current_frame->color_range_max);
-
-			current_frame->format = new_format;
-			m->cur_space = new_space;
-			m->cur_range = new_range;
+		if (!mp_media_convert_video(m))
+			return;
 
-			if (!success) {
-				current_frame->format = VIDEO_FORMAT_NONE;
-				return;
-			}
-		}
-		current_frame->timestamp = m->base_ts + d->frame_pts - m->start_ts +
-			m->play_sys_ts - base_sys_ts;
+		current_frame->timestamp = mp_media_frame_ts(m, d->frame_pts);
 		current_frame->duration = d->last_duration;
 
-		current_frame->width = f->width;
-		current_frame->height = f->height;
-		current_frame->flip = flip;
-		current_frame->flags |= m->is_linear_alpha ? OBS_SOURCE_FRAME_LINEAR_ALPHA : 0;
-
 		if (!m->is_local_file && !d->got_first_keyframe) {
 			if (!f->key_frame)
 				return;
@@ -564,6 +769,7 @@ static void mp_media_next_video(mp_media_t *m, bool preload)
 			}
 
 			da_push_back(m->video.data, &new_frame);
+			cache_add(m, cached_video_size(new_frame));
 			frame = new_frame;
 		}
 		else {
@@ -588,6 +794,54 @@ static void mp_media_next_video(mp_media_t *m, bool preload)
 	}
 }
 
+/* decodes the next frame of the stream, reading packets as needed.  packets
+ * of the other stream are queued in its decoder */
+static bool mp_media_decode_next(mp_media_t *m, struct mp_decode *d)
+{
+	d->frame_ready = false;
+
+	while (!d->frame_ready && !d->eof) {
+		if (!m->eof) {
+			int ret = mp_media_next_packet(m);
+			if (ret == AVERROR_EOF || ret == AVERROR_EXIT)
+				m->eof = true;
+			else if (ret < 0)
+				return false;
+		}
+
+		if (!mp_decode_next(d))
+			return false;
+	}
+
+	return d->frame_ready;
+}
+
+static void mp_media_preroll(mp_media_t *m)
+{
+	struct mp_decode *d = &m->v;
+
+	mp_media_clear_preroll(m);
+
+	if (!m->has_video || m->enable_caching || m->preroll_frames <= 0)
+		return;
+
+	while (d->frame_ready && m->preroll.num < (size_t)m->preroll_frames) {
+		if (!mp_media_convert_video(m))
+			break;
+
+		struct obs_source_frame *cur = &m->obsframe;
+		struct mp_preroll_frame *pf = da_push_back_new(m->preroll);
+		pf->frame = obs_source_frame_create(cur->format, cur->width,
+						    cur->height);
+		pf->pts = d->frame_pts;
+		pf->duration = d->last_duration;
+		obs_source_frame_copy(pf->frame, cur);
+
+		if (!mp_media_decode_next(m, d))
+			break;
+	}
+}
+
 static void mp_media_calc_next_ns(mp_media_t *m)
 {
 	int64_t min_next_ns = mp_media_get_next_min_pts(m);
@@ -611,6 +865,8 @@ static void mp_media_calc_next_ns(mp_media_t *m)
 	m->next_pts_ns = min_next_ns;
 }
 
+static bool mp_media_reset(mp_media_t *m);
+
 static inline void clear_cache(mp_media_t *m)
 {
 	if (m->video.data.num > 0) {
@@ -623,15 +879,43 @@ static inline void clear_cache(mp_media_t *m)
 			for (size_t j = 0; j < MAX_AV_PLANES; j++) {
 				free((void*)((struct obs_source_audio*)m->audio.data.array[i])->data[j]);
 			}
+			free(m->audio.data.array[i]);
 		}
 	}
 	da_free(m->video.data);
 	da_free(m->audio.data);
+	cache_release(m);
 }
 
-static void seek_to(mp_media_t *m, int64_t pos)
+static inline bool mp_media_replaying_cache(mp_media_t *m)
 {
-	AVStream *stream = m->fmt->streams[0];
+	return m->video.index_eof >= 0 || m->audio.index_eof >= 0;
+}
+
+/* frees the loop cache after it was evicted and goes back to decoding.  if
+ * frames were being replayed from the cache, playback restarts from the
+ * beginning of the file */
+static void mp_media_drop_cache(mp_media_t *m)
+{
+	bool replaying = mp_media_replaying_cache(m);
+
+	clear_cache(m);
+	m->enable_caching = false;
+	m->video.index = 0;
+	m->video.index_eof = -1;
+	m->audio.index = 0;
+	m->audio.index_eof = -1;
+	m->process_audio = true;
+	m->process_video = true;
+	os_atomic_set_bool(&m->cache_evict, false);
+
+	if (replaying)
+		mp_media_reset(m);
+}
+
+static void seek_file(mp_media_t *m, int64_t pos)
+{
+	AVStream *stream = m->has_video ? m->v.stream : m->a.stream;
 	int64_t seek_pos = pos;
 	int seek_flags;
 
@@ -646,21 +930,118 @@ static void seek_to(mp_media_t *m, int64_t pos)
 				      : seek_pos;
 
 	if (m->is_local_file) {
-		int ret = av_seek_frame(m->fmt, 0, seek_target, seek_flags);
+		int ret = av_seek_frame(m->fmt, stream->index, seek_target,
+					seek_flags);
 		if (ret < 0) {
 			blog(LOG_WARNING, "MP: Failed to seek: %s",
 			     av_err2str(ret));
 		}
 	}
+}
 
-	if (m->has_video && m->is_local_file) {
-		mp_decode_flush(&m->v);
-		if (m->seek_next_ts && m->pause && m->v_preload_cb &&
-		    mp_media_prepare_frames(m))
-			mp_media_next_video(m, true);
+static inline int get_index_entries_count(AVStream *stream)
+{
+#if LIBAVFORMAT_VERSION_INT >= AV_VERSION_INT(58, 78, 100)
+	return avformat_index_get_entries_count(stream);
+#else
+	return stream->nb_index_entries;
+#endif
+}
+
+/* seeks straight to the keyframe found in the seek index.  demuxers without
+ * an index of their own would otherwise search the file for it, so for those
+ * the byte position of the keyframe is used if the format allows it */
+static bool seek_keyframe(mp_media_t *m, const struct mp_seek_entry *entry)
+{
+	AVStream *stream = m->v.stream;
+	int ret;
+
+	if (!get_index_entries_count(stream) && entry->pos >= 0 &&
+	    (m->fmt->iformat->flags & AVFMT_NO_BYTE_SEEK) == 0)
+		ret = av_seek_frame(m->fmt, stream->index, entry->pos,
+				    AVSEEK_FLAG_BYTE);
+	else
+		ret = av_seek_frame(m->fmt, stream->index, entry->pts,
+				    AVSEEK_FLAG_BACKWARD);
+
+	if (ret < 0) {
+		blog(LOG_WARNING, "MP: Failed to seek to keyframe: %s",
+		     av_err2str(ret));
+		return false;
+	}
+
+	return true;
+}
+
+/* decodes until the frame that covers the target time, dropping the frames
+ * before it.  bounded so a file with a bad index cannot stall the thread */
+static void mp_media_decode_to(mp_media_t *m, struct mp_decode *d,
+			       int64_t target)
+{
+	int frames = 0;
+
+	if (!d->frame_ready && !mp_media_decode_next(m, d))
+		return;
+
+	while (d->next_pts <= target && frames++ < MAX_SEEK_DECODE_FRAMES) {
+		if (!mp_media_decode_next(m, d))
+			break;
 	}
-	if (m->has_audio && m->is_local_file)
+}
+
+static void seek_flush(mp_media_t *m, int64_t target_ns)
+{
+	if (!m->is_local_file)
+		return;
+
+	mp_media_clear_preroll(m);
+
+	if (m->has_video)
+		mp_decode_flush(&m->v);
+	if (m->has_audio)
 		mp_decode_flush(&m->a);
+
+	if (target_ns >= 0) {
+		/* decoded timestamps are scaled by the playback speed */
+		int64_t target = target_ns * 100 / m->speed;
+
+		if (m->has_video)
+			mp_media_decode_to(m, &m->v, target);
+		if (m->has_audio)
+			mp_media_decode_to(m, &m->a, target);
+	}
+
+	if (m->has_video && m->seek_next_ts && m->pause && m->v_preload_cb &&
+	    mp_media_prepare_frames(m))
+		mp_media_next_video(m, true);
+}
+
+static void seek_to(mp_media_t *m, int64_t pos)
+{
+	seek_file(m, pos);
+	seek_flush(m, -1);
+}
+
+/* seeks to the exact frame at the position rather than to the keyframe
+ * before it.  with a seek index the keyframe is looked up instead of being
+ * searched for by the demuxer */
+static void seek_exact(mp_media_t *m, int64_t pos)
+{
+	struct mp_seek_entry entry;
+	int64_t target_ns;
+
+	/* the position is relative to the start of the media, timestamps of
+	 * the file and of the index are not */
+	if (m->fmt->start_time != AV_NOPTS_VALUE)
+		pos += m->fmt->start_time;
+	target_ns = pos * 1000;
+
+	if (!m->has_video ||
+	    !mp_seek_index_find(m->seek_index, target_ns, &entry) ||
+	    !seek_keyframe(m, &entry))
+		seek_file(m, pos);
+
+	seek_flush(m, target_ns);
 }
 
 static bool mp_media_reset(mp_media_t *m)
@@ -702,8 +1083,11 @@ static bool mp_media_reset(mp_media_t *m)
 
 	m->pause = false;
 
-	if (!active && m->is_local_file && m->v_preload_cb)
-		mp_media_next_video(m, true);
+	if (!active && m->is_local_file) {
+		mp_media_preroll(m);
+		if (m->v_preload_cb)
+			mp_media_next_video(m, true);
+	}
 	if (stopping && m->stop_cb)
 		m->stop_cb(m->opaque);
 	return true;
@@ -733,7 +1117,7 @@ static inline bool mp_media_sleep(mp_media_t *m)
 
 static inline bool mp_media_eof(mp_media_t *m)
 {
-	bool v_ended = !m->has_video || !m->v.frame_ready;
+	bool v_ended = !m->has_video || !mp_media_video_ready(m);
 	bool a_ended = !m->has_audio || !m->a.frame_ready;
 	bool eof = v_ended && a_ended;
 
@@ -867,6 +1251,9 @@ static inline bool mp_media_thread(mp_media_t *m)
 	if (!init_avformat(m)) {
 		return false;
 	}
+	if (m->build_seek_index && m->has_video && !m->seek_index)
+		m->seek_index = mp_seek_index_create(m->path, m->format_name,
+						     m->seek_index_dir);
 	if (!mp_media_reset(m)) {
 		return false;
 	}
@@ -919,7 +1306,7 @@ static inline bool mp_media_thread(mp_media_t *m)
 
 		if (seek) {
 			m->seek_next_ts = true;
-			seek_to(m, seek_pos);
+			seek_exact(m, seek_pos);
 			continue;
 		}
 
@@ -931,6 +1318,12 @@ static inline bool mp_media_thread(mp_media_t *m)
 		if (pause)
 			continue;
 
+		/* a cache that is still being filled can be dropped right
+		 * away, a replaying one only at the end of a loop */
+		if (m->enable_caching && !mp_media_replaying_cache(m) &&
+		    os_atomic_load_bool(&m->cache_evict))
+			mp_media_drop_cache(m);
+
 		/* frames are ready */
 		if (is_active && !timeout) {
 			if (m->has_video)
@@ -988,6 +1381,12 @@ static inline bool mp_media_thread(mp_media_t *m)
 					         m->video.index == m->video.index_eof;
 				if ((audio_eof || !m->has_audio) &&
 				    (video_eof || !m->has_video)) {
+					if (os_atomic_load_bool(
+						    &m->cache_evict)) {
+						mp_media_drop_cache(m);
+						continue;
+					}
+					cache_touch(m);
 					m->audio.index = 0;
 					m->video.index = 0;
 					m->video.last_processed_ns = 0;
@@ -1076,6 +1475,11 @@ bool mp_media_init(mp_media_t *media, const struct mp_media_info *info)
 	media->enable_caching = info->enable_caching;
 	media->playing = false;
 	media->volume = info->volume;
+	media->preroll_frames = info->preroll_frames;
+	media->build_seek_index = info->seek_index && info->is_local_file;
+	media->seek_index_dir = info->seek_index_dir
+					? bstrdup(info->seek_index_dir)
+					: NULL;
 
 	if (!info->is_local_file || media->speed < 1 || media->speed > 200)
 		media->speed = 100;
@@ -1094,6 +1498,9 @@ bool mp_media_init(mp_media_t *media, const struct mp_media_info *info)
 	if (!base_sys_ts)
 		base_sys_ts = (int64_t)os_gettime_ns();
 
+	if (media->enable_caching)
+		cache_register(media);
+
 	if (!mp_media_init_internal(media, info)) {
 		mp_media_free(media);
 		return false;
@@ -1121,6 +1528,10 @@ void mp_media_free(mp_media_t *media)
 
 	mp_media_stop(media);
 	mp_kill_thread(media);
+	clear_cache(media);
+	cache_unregister(media);
+	mp_media_clear_preroll(media);
+	mp_seek_index_destroy(media->seek_index);
 	mp_decode_free(&media->v);
 	mp_decode_free(&media->a);
 	avformat_close_input(&media->fmt);
@@ -1130,6 +1541,7 @@ void mp_media_free(mp_media_t *media)
 	av_freep(&media->scale_pic[0]);
 	bfree(media->path);
 	bfree(media->format_name);
+	bfree(media->seek_index_dir);
 	memset(media, 0, sizeof(*media));
 	pthread_mutex_init_value(&media->mutex);
 }
@@ -1196,3 +1608,8 @@ void mp_media_seek_to(mp_media_t *m, int64_t pos)
 
 	os_sem_post(m->sem);
 }
+
+bool mp_media_seek_index_ready(mp_media_t *m)
+{
+	return mp_seek_index_ready(m->seek_index);
+}
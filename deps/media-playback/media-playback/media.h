@@ -18,6 +18,7 @@
 
 #include <obs.h>
 #include "decode.h"
+#include "seek-index.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -52,6 +53,12 @@ struct cached_data {
 	uint64_t last_processed_ns;
 };
 
+struct mp_preroll_frame {
+	struct obs_source_frame *frame;
+	int64_t pts;
+	int64_t duration;
+};
+
 struct mp_media {
 	AVFormatContext *fmt;
 
@@ -112,6 +119,9 @@ struct mp_media {
 	bool enable_caching;
 	struct cached_data video;
 	struct cached_data audio;
+	uint64_t cache_bytes;
+	uint64_t cache_last_used;
+	volatile bool cache_evict;
 	bool process_audio;
 	bool process_video;
 	int32_t pix_format;
@@ -121,6 +131,14 @@ struct mp_media {
 	bool seek_next_ts;
 	int64_t seek_pos;
 	int volume;
+
+	int preroll_frames;
+	DARRAY(struct mp_preroll_frame) preroll;
+	size_t preroll_pos;
+
+	bool build_seek_index;
+	char *seek_index_dir;
+	struct mp_seek_index *seek_index;
 };
 
 typedef struct mp_media mp_media_t;
@@ -146,6 +164,15 @@ struct mp_media_info {
 	bool enable_caching;
 	bool reconnecting;
 	int volume;
+
+	/* number of video frames to decode ahead while the media is idle so
+	 * playback can start without waiting on the decoder */
+	int preroll_frames;
+
+	/* build a keyframe index of local files in the background so seeks
+	 * land on the exact frame.  the index is stored in seek_index_dir */
+	bool seek_index;
+	const char *seek_index_dir;
 };
 
 extern bool mp_media_init(mp_media_t *media, const struct mp_media_info *info);
@@ -156,6 +183,10 @@ extern void mp_media_stop(mp_media_t *media);
 extern void mp_media_play_pause(mp_media_t *media, bool pause);
 extern int64_t mp_get_current_time(mp_media_t *m);
 extern void mp_media_seek_to(mp_media_t *m, int64_t pos);
+extern bool mp_media_seek_index_ready(mp_media_t *m);
+
+/* sets the memory shared by the loop caches of all media, in bytes */
+extern void mp_media_set_cache_budget(uint64_t bytes);
 
 /* #define DETAILED_DEBUG_INFO */
 
@@ -0,0 +1,417 @@
+#include <util/platform.h>
+#include <util/threading.h>
+#include <util/darray.h>
+#include <util/dstr.h>
+#include <util/bmem.h>
+#include <util/base.h>
+#include <sys/stat.h>
+
+#ifdef _MSC_VER
+#pragma warning(push)
+#pragma warning(disable : 4244)
+#pragma warning(disable : 4204)
+#endif
+
+#include <libavformat/avformat.h>
+
+#ifdef _MSC_VER
+#pragma warning(pop)
+#endif
+
+#include "seek-index.h"
+
+#define INDEX_MAGIC 0x4953504D /* "MPSI" */
+#define INDEX_VERSION 1
+
+/* index files of the oldest files beyond this are deleted */
+#define MAX_INDEX_FILES 256
+
+struct index_header {
+	uint32_t magic;
+	uint32_t version;
+	int32_t stream_index;
+	int32_t time_base_num;
+	int32_t time_base_den;
+	uint32_t count;
+};
+
+struct mp_seek_index {
+	char *path;
+	char *format_name;
+	char *cache_file;
+
+	pthread_t thread;
+	bool thread_valid;
+	volatile bool stop;
+	volatile bool ready;
+
+	DARRAY(struct mp_seek_entry) entries;
+};
+
+static uint64_t hash_data(uint64_t hash, const void *data, size_t size)
+{
+	const uint8_t *bytes = data;
+	for (size_t i = 0; i < size; i++) {
+		hash ^= bytes[i];
+		hash *= 0x100000001B3ULL;
+	}
+	return hash;
+}
+
+/* the cache file name is derived from the path, size and modification time of
+ * the file, so a modified file gets a new index */
+static char *get_cache_file(const char *path, const char *cache_dir)
+{
+	struct stat stats;
+	struct dstr file = {0};
+	uint64_t hash = 0xCBF29CE484222325ULL;
+	int64_t size, mtime;
+
+	if (!cache_dir || !*cache_dir || os_stat(path, &stats) != 0)
+		return NULL;
+
+	size = (int64_t)stats.st_size;
+	mtime = (int64_t)stats.st_mtime;
+	hash = hash_data(hash, path, strlen(path));
+	hash = hash_data(hash, &size, sizeof(size));
+	hash = hash_data(hash, &mtime, sizeof(mtime));
+
+	dstr_copy(&file, cache_dir);
+	dstr_replace(&file, "\\", "/");
+	if (dstr_end(&file) != '/')
+		dstr_cat_ch(&file, '/');
+	dstr_catf(&file, "%016llx.idx", (unsigned long long)hash);
+	return file.array;
+}
+
+static bool load_index(struct mp_seek_index *index, int stream_index,
+		       AVRational time_base)
+{
+	struct index_header header;
+	bool success = false;
+	FILE *f;
+
+	if (!index->cache_file)
+		return false;
+
+	f = os_fopen(index->cache_file, "rb");
+	if (!f)
+		return false;
+
+	if (fread(&header, sizeof(header), 1, f) != 1)
+		goto fail;
+	if (header.magic != INDEX_MAGIC || header.version != INDEX_VERSION ||
+	    header.stream_index != stream_index ||
+	    header.time_base_num != time_base.num ||
+	    header.time_base_den != time_base.den || !header.count)
+		goto fail;
+
+	da_resize(index->entries, header.count);
+	if (fread(index->entries.array, sizeof(struct mp_seek_entry),
+		  header.count, f) != header.count) {
+		da_free(index->entries);
+		goto fail;
+	}
+
+	success = true;
+
+fail:
+	fclose(f);
+	return success;
+}
+
+struct index_file {
+	char *path;
+	time_t mtime;
+};
+
+static int compare_index_files(const void *a, const void *b)
+{
+	const struct index_file *file_a = a;
+	const struct index_file *file_b = b;
+
+	if (file_a->mtime < file_b->mtime)
+		return -1;
+	return file_a->mtime > file_b->mtime ? 1 : 0;
+}
+
+static void prune_index_files(const char *cache_dir)
+{
+	DARRAY(struct index_file) files = {0};
+	struct dstr pattern = {0};
+	os_glob_t *glob;
+
+	dstr_printf(&pattern, "%s/*.idx", cache_dir);
+	if (os_glob(pattern.array, 0, &glob) != 0) {
+		dstr_free(&pattern);
+		return;
+	}
+	dstr_free(&pattern);
+
+	if (glob->gl_pathc > MAX_INDEX_FILES) {
+		for (size_t i = 0; i < glob->gl_pathc; i++) {
+			struct stat stats;
+			struct index_file *file;
+
+			if (os_stat(glob->gl_pathv[i].path, &stats) != 0)
+				continue;
+
+			file = da_push_back_new(files);
+			file->path = glob->gl_pathv[i].path;
+			file->mtime = stats.st_mtime;
+		}
+
+		qsort(files.array, files.num, sizeof(struct index_file),
+		      compare_index_files);
+
+		for (size_t i = 0; i + MAX_INDEX_FILES < files.num; i++)
+			os_unlink(files.array[i].path);
+	}
+
+	da_free(files);
+	os_globfree(glob);
+}
+
+static void save_index(struct mp_seek_index *index, const char *cache_dir,
+		       int stream_index, AVRational time_base)
+{
+	struct index_header header = {0};
+	struct dstr temp = {0};
+	bool success = false;
+	FILE *f;
+
+	if (!index->cache_file || !index->entries.num)
+		return;
+
+	header.magic = INDEX_MAGIC;
+	header.version = INDEX_VERSION;
+	header.stream_index = stream_index;
+	header.time_base_num = time_base.num;
+	header.time_base_den = time_base.den;
+	header.count = (uint32_t)index->entries.num;
+
+	os_mkdirs(cache_dir);
+
+	dstr_copy(&temp, index->cache_file);
+	dstr_cat(&temp, ".tmp");
+
+	f = os_fopen(temp.array, "wb");
+	if (!f) {
+		blog(LOG_WARNING, "MP: Failed to write seek index '%s'",
+		     temp.array);
+		dstr_free(&temp);
+		return;
+	}
+
+	success = fwrite(&header, sizeof(header), 1, f) == 1 &&
+		  fwrite(index->entries.array, sizeof(struct mp_seek_entry),
+			 index->entries.num, f) == index->entries.num;
+	fclose(f);
+
+	if (success)
+		success = os_safe_replace(index->cache_file, temp.array,
+					  NULL) == 0;
+	if (!success)
+		os_unlink(temp.array);
+	dstr_free(&temp);
+
+	if (success)
+		prune_index_files(cache_dir);
+}
+
+static int compare_entries(const void *a, const void *b)
+{
+	const struct mp_seek_entry *entry_a = a;
+	const struct mp_seek_entry *entry_b = b;
+
+	if (entry_a->pts_ns < entry_b->pts_ns)
+		return -1;
+	return entry_a->pts_ns > entry_b->pts_ns ? 1 : 0;
+}
+
+static bool scan_file(struct mp_seek_index *index, AVFormatContext *fmt,
+		      AVStream *stream)
+{
+	AVRational ns = {1, 1000000000};
+	AVPacket pkt;
+	int ret = 0;
+
+	av_init_packet(&pkt);
+
+	while (!os_atomic_load_bool(&index->stop)) {
+		ret = av_read_frame(fmt, &pkt);
+		if (ret < 0)
+			break;
+
+		if (pkt.stream_index == stream->index &&
+		    (pkt.flags & AV_PKT_FLAG_KEY) != 0) {
+			int64_t pts = pkt.pts != AV_NOPTS_VALUE ? pkt.pts
+								: pkt.dts;
+			if (pts != AV_NOPTS_VALUE) {
+				struct mp_seek_entry *entry =
+					da_push_back_new(index->entries);
+				entry->pts = pts;
+				entry->pts_ns = av_rescale_q(
+					pts, stream->time_base, ns);
+				entry->pos = pkt.pos;
+			}
+		}
+
+		av_packet_unref(&pkt);
+	}
+
+	if (os_atomic_load_bool(&index->stop) || ret != AVERROR_EOF)
+		return false;
+
+	qsort(index->entries.array, index->entries.num,
+	      sizeof(struct mp_seek_entry), compare_entries);
+	return index->entries.num > 0;
+}
+
+struct build_info {
+	struct mp_seek_index *index;
+	char *cache_dir;
+};
+
+static void *build_thread(void *data)
+{
+	struct build_info *info = data;
+	struct mp_seek_index *index = info->index;
+#if LIBAVFORMAT_VERSION_INT < AV_VERSION_INT(59, 0, 100)
+	AVInputFormat *format = NULL;
+#else
+	const AVInputFormat *format = NULL;
+#endif
+	AVFormatContext *fmt = NULL;
+	AVStream *stream;
+	uint64_t start = os_gettime_ns();
+	int stream_index;
+
+	os_set_thread_name("mp_seek_index");
+
+	if (index->format_name && *index->format_name)
+		format = av_find_input_format(index->format_name);
+
+	if (avformat_open_input(&fmt, index->path, format, NULL) < 0)
+		goto exit;
+	if (avformat_find_stream_info(fmt, NULL) < 0)
+		goto exit;
+
+	stream_index = av_find_best_stream(fmt, AVMEDIA_TYPE_VIDEO, -1, -1,
+					   NULL, 0);
+	if (stream_index < 0)
+		goto exit;
+
+	stream = fmt->streams[stream_index];
+
+	if (load_index(index, stream_index, stream->time_base)) {
+		os_atomic_set_bool(&index->ready, true);
+		goto exit;
+	}
+
+	for (unsigned int i = 0; i < fmt->nb_streams; i++) {
+		if (i != (unsigned int)stream_index)
+			fmt->streams[i]->discard = AVDISCARD_ALL;
+	}
+
+	if (!scan_file(index, fmt, stream)) {
+		da_free(index->entries);
+		goto exit;
+	}
+
+	save_index(index, info->cache_dir, stream_index, stream->time_base);
+	os_atomic_set_bool(&index->ready, true);
+
+	blog(LOG_DEBUG, "MP: Indexed %zu keyframes of '%s' in %.1f ms",
+	     index->entries.num, index->path,
+	     (double)(os_gettime_ns() - start) / 1000000.0);
+
+exit:
+	avformat_close_input(&fmt);
+	bfree(info->cache_dir);
+	bfree(info);
+	return NULL;
+}
+
+struct mp_seek_index *mp_seek_index_create(const char *path,
+					   const char *format_name,
+					   const char *cache_dir)
+{
+	struct mp_seek_index *index;
+	struct build_info *info;
+
+	if (!path || !*path)
+		return NULL;
+
+	index = bzalloc(sizeof(*index));
+	index->path = bstrdup(path);
+	index->format_name = format_name ? bstrdup(format_name) : NULL;
+	index->cache_file = get_cache_file(path, cache_dir);
+
+	info = bzalloc(sizeof(*info));
+	info->index = index;
+	info->cache_dir = cache_dir ? bstrdup(cache_dir) : NULL;
+
+	if (pthread_create(&index->thread, NULL, build_thread, info) != 0) {
+		blog(LOG_WARNING, "MP: Could not create seek index thread");
+		bfree(info->cache_dir);
+		bfree(info);
+		mp_seek_index_destroy(index);
+		return NULL;
+	}
+
+	index->thread_valid = true;
+	return index;
+}
+
+void mp_seek_index_destroy(struct mp_seek_index *index)
+{
+	if (!index)
+		return;
+
+	if (index->thread_valid) {
+		os_atomic_set_bool(&index->stop, true);
+		pthread_join(index->thread, NULL);
+	}
+
+	da_free(index->entries);
+	bfree(index->path);
+	bfree(index->format_name);
+	bfree(index->cache_file);
+	bfree(index);
+}
+
+bool mp_seek_index_ready(struct mp_seek_index *index)
+{
+	return index && os_atomic_load_bool(&index->ready);
+}
+
+size_t mp_seek_index_count(struct mp_seek_index *index)
+{
+	return mp_seek_index_ready(index) ? index->entries.num : 0;
+}
+
+bool mp_seek_index_find(struct mp_seek_index *index, int64_t pts_ns,
+			struct mp_seek_entry *entry)
+{
+	size_t lo = 0;
+	size_t hi;
+
+	if (!mp_seek_index_ready(index))
+		return false;
+
+	hi = index->entries.num;
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+		if (index->entries.array[mid].pts_ns <= pts_ns)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	if (lo == 0)
+		return false;
+
+	*entry = index->entries.array[lo - 1];
+	return true;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Keyframe index of the video stream of a local file.  The index is built on
+ * a background thread by reading (not decoding) every packet of the file, and
+ * is stored in the cache directory so the file only has to be scanned once
+ * for as long as its size and modification time stay the same.  Only the
+ * most recent indexes are kept in the cache directory.
+ */
+
+struct mp_seek_entry {
+	int64_t pts;    /* in the time base of the video stream */
+	int64_t pts_ns; /* in nanoseconds */
+	int64_t pos;    /* byte position in the file, -1 if unknown */
+};
+
+struct mp_seek_index;
+
+extern struct mp_seek_index *mp_seek_index_create(const char *path,
+						  const char *format_name,
+						  const char *cache_dir);
+extern void mp_seek_index_destroy(struct mp_seek_index *index);
+
+/* returns true once the index is complete.  the index does not change after
+ * that, so it can be used without locking */
+extern bool mp_seek_index_ready(struct mp_seek_index *index);
+extern size_t mp_seek_index_count(struct mp_seek_index *index);
+
+/* finds the last keyframe at or before the time, returns false if the index
+ * is not ready or the time is before the first keyframe */
+extern bool mp_seek_index_find(struct mp_seek_index *index, int64_t pts_ns,
+			       struct mp_seek_entry *entry);
+
+#ifdef __cplusplus
+}
+#endif
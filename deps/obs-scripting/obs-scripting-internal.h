@@ -18,6 +18,7 @@
 #pragma once
 
 #include <util/dstr.h>
+#include <util/metrics.h>
 #include <callback/calldata.h>
 #include "obs-scripting.h"
 
@@ -30,6 +31,8 @@ struct obs_script {
 	struct dstr path;
 	struct dstr file;
 	struct dstr desc;
+
+	metric_t *tick_metric;
 };
 
 struct script_callback;
@@ -37,6 +40,25 @@ typedef void (*defer_call_cb)(void *param);
 
 extern void defer_call_post(defer_call_cb call, void *cb);
 
+/* Runs the script ticks, timers and tick callbacks of one language runtime on
+ * a thread of its own.  The executor is woken once per frame from an obs tick
+ * callback, so a slow script can no longer stall the graphics thread, and if
+ * the scripts fall behind, frames are coalesced into a single larger delta. */
+struct script_executor;
+typedef void (*script_tick_cb)(void *param, float seconds);
+
+extern struct script_executor *script_executor_create(const char *name);
+extern void script_executor_destroy(struct script_executor *exec);
+extern void script_executor_add_tick(struct script_executor *exec,
+				     script_tick_cb tick, void *param);
+extern void script_executor_remove_tick(struct script_executor *exec,
+					script_tick_cb tick, void *param);
+
+/* records the time spent in a script tick, timer or tick callback.  must be
+ * called with the script locked (or the GIL held) and only if the callback
+ * has not been removed, as the metric is destroyed after unload */
+extern void script_tick_record(obs_script_t *script, uint64_t start_ns);
+
 extern void script_log(obs_script_t *script, int level, const char *format,
 		       ...);
 extern void script_log_va(obs_script_t *script, int level, const char *format,
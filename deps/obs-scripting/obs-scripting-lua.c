@@ -57,6 +57,7 @@ static char *startup_script = NULL;
 
 static pthread_mutex_t tick_mutex;
 static struct obs_lua_script *first_tick_script = NULL;
+static struct script_executor *lua_executor = NULL;
 
 pthread_mutex_t lua_source_def_mutex;
 
@@ -291,8 +292,12 @@ static void timer_call(struct script_callback *p_cb)
 	if (script_callback_removed(p_cb))
 		return;
 
+	uint64_t start = os_gettime_ns();
+
 	lock_callback();
 	call_func_(cb->script, cb->reg_idx, 0, 0, "timer_cb", __FUNCTION__);
+	if (!script_callback_removed(p_cb))
+		script_tick_record(p_cb->script, start);
 	unlock_callback();
 }
 
@@ -378,15 +383,21 @@ static void obs_lua_tick_callback(void *priv, float seconds)
 	lua_State *script = cb->script;
 
 	if (script_callback_removed(&cb->base)) {
-		obs_remove_tick_callback(obs_lua_tick_callback, cb);
+		script_executor_remove_tick(lua_executor, obs_lua_tick_callback,
+					    cb);
 		return;
 	}
 
+	uint64_t start = os_gettime_ns();
+
 	lock_callback();
 
 	lua_pushnumber(script, (lua_Number)seconds);
 	call_func(obs_lua_tick_callback, 1, 0);
 
+	if (!script_callback_removed(&cb->base))
+		script_tick_record(cb->base.script, start);
+
 	unlock_callback();
 }
 
@@ -403,7 +414,7 @@ static int obs_lua_remove_tick_callback(lua_State *script)
 
 static void defer_add_tick(void *cb)
 {
-	obs_add_tick_callback(obs_lua_tick_callback, cb);
+	script_executor_add_tick(lua_executor, obs_lua_tick_callback, cb);
 }
 
 static int obs_lua_add_tick_callback(lua_State *script)
@@ -1055,6 +1066,7 @@ static void lua_tick(void *param, float seconds)
 	data = first_tick_script;
 	while (data) {
 		lua_State *script = data->script;
+		uint64_t start = os_gettime_ns();
 		current_lua_script = data;
 
 		pthread_mutex_lock(&data->mutex);
@@ -1064,6 +1076,8 @@ static void lua_tick(void *param, float seconds)
 
 		pthread_mutex_unlock(&data->mutex);
 
+		script_tick_record(&data->base, start);
+
 		data = data->next_tick;
 	}
 	current_lua_script = NULL;
@@ -1351,12 +1365,14 @@ void obs_lua_load(void)
 
 	dstr_free(&dep_paths);
 
-	obs_add_tick_callback(lua_tick, NULL);
+	lua_executor = script_executor_create("lua");
+	script_executor_add_tick(lua_executor, lua_tick, NULL);
 }
 
 void obs_lua_unload(void)
 {
-	obs_remove_tick_callback(lua_tick, NULL);
+	script_executor_destroy(lua_executor);
+	lua_executor = NULL;
 
 	bfree(startup_script);
 	pthread_mutex_destroy(&tick_mutex);
@@ -57,6 +57,7 @@ static bool mutexes_loaded = false;
 
 static pthread_mutex_t tick_mutex;
 static struct obs_python_script *first_tick_script = NULL;
+static struct script_executor *python_executor = NULL;
 
 static PyObject *py_obspython = NULL;
 struct obs_python_script *cur_python_script = NULL;
@@ -434,10 +435,14 @@ static void timer_call(struct script_callback *p_cb)
 	if (script_callback_removed(p_cb))
 		return;
 
+	uint64_t start = os_gettime_ns();
+
 	lock_callback(cb);
 	PyObject *py_ret = PyObject_CallObject(cb->func, NULL);
 	py_error();
 	Py_XDECREF(py_ret);
+	if (!script_callback_removed(p_cb))
+		script_tick_record(p_cb->script, start);
 	unlock_callback();
 }
 
@@ -477,10 +482,13 @@ static void obs_python_tick_callback(void *priv, float seconds)
 	struct python_obs_callback *cb = priv;
 
 	if (script_callback_removed(&cb->base)) {
-		obs_remove_tick_callback(obs_python_tick_callback, cb);
+		script_executor_remove_tick(python_executor,
+					    obs_python_tick_callback, cb);
 		return;
 	}
 
+	uint64_t start = os_gettime_ns();
+
 	lock_callback(cb);
 
 	PyObject *args = Py_BuildValue("(f)", seconds);
@@ -489,9 +497,17 @@ static void obs_python_tick_callback(void *priv, float seconds)
 	Py_XDECREF(py_ret);
 	Py_XDECREF(args);
 
+	if (!script_callback_removed(&cb->base))
+		script_tick_record(cb->base.script, start);
+
 	unlock_callback();
 }
 
+static void defer_add_tick(void *cb)
+{
+	script_executor_add_tick(python_executor, obs_python_tick_callback, cb);
+}
+
 static PyObject *obs_python_remove_tick_callback(PyObject *self, PyObject *args)
 {
 	struct obs_python_script *script = cur_python_script;
@@ -536,7 +552,7 @@ static PyObject *obs_python_add_tick_callback(PyObject *self, PyObject *args)
 		return python_none();
 
 	struct python_obs_callback *cb = add_python_obs_callback(script, py_cb);
-	obs_add_tick_callback(obs_python_tick_callback, cb);
+	defer_call_post(defer_add_tick, cb);
 	return python_none();
 }
 
@@ -1523,12 +1539,15 @@ static void python_tick(void *param, float seconds)
 		data = first_tick_script;
 		while (data) {
 			cur_python_script = data;
+			uint64_t start = os_gettime_ns();
 
 			PyObject *py_ret =
 				PyObject_CallObject(data->tick, args);
 			Py_XDECREF(py_ret);
 			py_error();
 
+			script_tick_record(&data->base, start);
+
 			data = data->next_tick;
 		}
 
@@ -1725,14 +1744,19 @@ out:
 
 	python_loaded_at_all = success;
 
-	if (python_loaded)
-		obs_add_tick_callback(python_tick, NULL);
+	if (python_loaded) {
+		python_executor = script_executor_create("python");
+		script_executor_add_tick(python_executor, python_tick, NULL);
+	}
 
 	return python_loaded;
 }
 
 void obs_python_unload(void)
 {
+	script_executor_destroy(python_executor);
+	python_executor = NULL;
+
 	if (mutexes_loaded) {
 		pthread_mutex_destroy(&tick_mutex);
 		pthread_mutex_destroy(&timer_mutex);
@@ -1750,8 +1774,6 @@ void obs_python_unload(void)
 
 	/* ---------------------- */
 
-	obs_remove_tick_callback(python_tick, NULL);
-
 	for (size_t i = 0; i < python_paths.num; i++)
 		bfree(python_paths.array[i]);
 	da_free(python_paths);
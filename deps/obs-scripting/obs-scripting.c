@@ -15,7 +15,9 @@
     along with this program.  If not, see <http://www.gnu.org/licenses/>.
 ******************************************************************************/
 
+#include <inttypes.h>
 #include <obs.h>
+#include <util/darray.h>
 #include <util/dstr.h>
 #include <util/platform.h>
 #include <util/threading.h>
@@ -120,6 +122,192 @@ void defer_call_post(defer_call_cb call, void *cb)
 
 /* -------------------------------------------- */
 
+struct script_tick_callback {
+	script_tick_cb tick;
+	void *param;
+};
+
+struct script_executor {
+	char *name;
+	pthread_t thread;
+	os_sem_t *semaphore;
+
+	/* recursive, so callbacks can be removed from within a tick */
+	pthread_mutex_t mutex;
+	DARRAY(struct script_tick_callback) callbacks;
+
+	uint64_t last_ts;
+	volatile bool pending;
+	volatile bool exit;
+};
+
+static void executor_frame_tick(void *param, float seconds)
+{
+	struct script_executor *exec = param;
+
+	/* only wake the executor once if the scripts are still busy with
+	 * a previous frame */
+	if (!os_atomic_set_bool(&exec->pending, true))
+		os_sem_post(exec->semaphore);
+
+	UNUSED_PARAMETER(seconds);
+}
+
+static void *executor_thread(void *param)
+{
+	struct script_executor *exec = param;
+	struct dstr name = {0};
+
+	dstr_printf(&name, "scripting: %s ticks", exec->name);
+	os_set_thread_name(name.array);
+	dstr_free(&name);
+
+	while (os_sem_wait(exec->semaphore) == 0) {
+		if (os_atomic_load_bool(&exec->exit))
+			break;
+
+		os_atomic_set_bool(&exec->pending, false);
+
+		uint64_t ts = obs_get_video_frame_time();
+		float seconds =
+			(float)((double)(ts - exec->last_ts) / 1000000000.0);
+		exec->last_ts = ts;
+
+		pthread_mutex_lock(&exec->mutex);
+		for (size_t i = exec->callbacks.num; i > 0; i--) {
+			struct script_tick_callback *cb =
+				exec->callbacks.array + (i - 1);
+			cb->tick(cb->param, seconds);
+		}
+		pthread_mutex_unlock(&exec->mutex);
+	}
+
+	return NULL;
+}
+
+struct script_executor *script_executor_create(const char *name)
+{
+	struct script_executor *exec = bzalloc(sizeof(*exec));
+	exec->name = bstrdup(name);
+	exec->last_ts = obs_get_video_frame_time();
+
+	if (pthread_mutex_init_recursive(&exec->mutex) != 0)
+		goto fail_mutex;
+	if (os_sem_init(&exec->semaphore, 0) != 0)
+		goto fail_sem;
+	if (pthread_create(&exec->thread, NULL, executor_thread, exec) != 0)
+		goto fail_thread;
+
+	obs_add_tick_callback(executor_frame_tick, exec);
+	return exec;
+
+fail_thread:
+	os_sem_destroy(exec->semaphore);
+fail_sem:
+	pthread_mutex_destroy(&exec->mutex);
+fail_mutex:
+	blog(LOG_WARNING, "[Scripting] Failed to create %s executor", name);
+	bfree(exec->name);
+	bfree(exec);
+	return NULL;
+}
+
+void script_executor_destroy(struct script_executor *exec)
+{
+	if (!exec)
+		return;
+
+	obs_remove_tick_callback(executor_frame_tick, exec);
+
+	os_atomic_set_bool(&exec->exit, true);
+	os_sem_post(exec->semaphore);
+	pthread_join(exec->thread, NULL);
+
+	os_sem_destroy(exec->semaphore);
+	pthread_mutex_destroy(&exec->mutex);
+	da_free(exec->callbacks);
+	bfree(exec->name);
+	bfree(exec);
+}
+
+void script_executor_add_tick(struct script_executor *exec,
+			      script_tick_cb tick, void *param)
+{
+	struct script_tick_callback data = {tick, param};
+
+	if (!exec)
+		return;
+
+	pthread_mutex_lock(&exec->mutex);
+	da_push_back(exec->callbacks, &data);
+	pthread_mutex_unlock(&exec->mutex);
+}
+
+void script_executor_remove_tick(struct script_executor *exec,
+				 script_tick_cb tick, void *param)
+{
+	struct script_tick_callback data = {tick, param};
+
+	if (!exec)
+		return;
+
+	pthread_mutex_lock(&exec->mutex);
+	da_erase_item(exec->callbacks, &data);
+	pthread_mutex_unlock(&exec->mutex);
+}
+
+/* -------------------------------------------- */
+
+static const double tick_bounds[] = {
+	0.0001, 0.00025, 0.0005, 0.001, 0.0025, 0.005,
+	0.01,   0.025,   0.05,   0.1,   0.25};
+
+#define NUM_TICK_BOUNDS (sizeof(tick_bounds) / sizeof(tick_bounds[0]))
+
+static void create_tick_metric(obs_script_t *script)
+{
+	struct dstr labels = {0};
+	const char *file = script->file.array ? script->file.array : "";
+	const char *lang = script->type == OBS_SCRIPT_LANG_LUA ? "lua"
+							       : "python";
+
+	metrics_append_label(&labels, "script", file);
+	metrics_append_label(&labels, "lang", lang);
+
+	script->tick_metric = metrics_histogram_create(
+		"obs_script_tick_seconds",
+		"Time spent in script ticks, timers and tick callbacks",
+		labels.array, tick_bounds, NUM_TICK_BOUNDS);
+
+	dstr_free(&labels);
+}
+
+static void free_tick_metric(obs_script_t *script)
+{
+	double sum;
+	uint64_t count =
+		metrics_histogram_read(script->tick_metric, NULL, 0, &sum);
+
+	if (count)
+		blog(LOG_INFO,
+		     "[Scripting] %s: %" PRIu64 " ticks, "
+		     "%.3f ms per tick on average",
+		     script->file.array, count,
+		     sum * 1000.0 / (double)count);
+
+	metrics_destroy(script->tick_metric);
+	script->tick_metric = NULL;
+}
+
+void script_tick_record(obs_script_t *script, uint64_t start_ns)
+{
+	uint64_t elapsed = os_gettime_ns() - start_ns;
+	metrics_histogram_observe(script->tick_metric,
+				  (double)elapsed / 1000000000.0);
+}
+
+/* -------------------------------------------- */
+
 bool obs_scripting_load(void)
 {
 	circlebuf_init(&defer_call_queue);
@@ -263,6 +451,8 @@ obs_script_t *obs_script_create(const char *path, obs_data_t *settings)
 		blog(LOG_WARNING, "Unsupported/unknown script type: %s", path);
 	}
 
+	if (script)
+		create_tick_metric(script);
 	return script;
 }
 
@@ -426,6 +616,7 @@ void obs_script_destroy(obs_script_t *script)
 #if COMPILE_LUA
 	if (script->type == OBS_SCRIPT_LANG_LUA) {
 		obs_lua_script_unload(script);
+		free_tick_metric(script);
 		obs_lua_script_destroy(script);
 		return;
 	}
@@ -433,6 +624,7 @@ void obs_script_destroy(obs_script_t *script)
 #if COMPILE_PYTHON
 	if (script->type == OBS_SCRIPT_LANG_PYTHON) {
 		obs_python_script_unload(script);
+		free_tick_metric(script);
 		obs_python_script_destroy(script);
 		return;
 	}
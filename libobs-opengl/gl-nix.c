@@ -18,6 +18,7 @@
 #include "gl-nix.h"
 #include "gl-x11-glx.h"
 #include "gl-x11-egl.h"
+#include "gl-surfaceless-egl.h"
 
 #ifdef ENABLE_WAYLAND
 #include "gl-wayland-egl.h"
@@ -42,6 +43,10 @@ static void init_winsys(void)
 		blog(LOG_INFO, "Using EGL/Wayland");
 		break;
 #endif
+	case OBS_NIX_PLATFORM_SURFACELESS_EGL:
+		gl_vtable = gl_surfaceless_egl_get_winsys_vtable();
+		blog(LOG_INFO, "Using surfaceless EGL");
+		break;
 	}
 
 	assert(gl_vtable != NULL);
@@ -17,6 +17,8 @@
 
 #include <assert.h>
 
+#include <util/platform.h>
+#include <util/dstr.h>
 #include <graphics/vec2.h>
 #include <graphics/vec3.h>
 #include <graphics/vec4.h>
@@ -25,6 +27,20 @@
 #include "gl-subsystem.h"
 #include "gl-shaderparser.h"
 
+static inline uint64_t hash_str(uint64_t hash, const char *str)
+{
+	/* FNV-1a */
+	if (str) {
+		while (*str) {
+			hash ^= (uint8_t)*(str++);
+			hash *= 0x100000001b3ULL;
+		}
+	}
+	return hash;
+}
+
+#define HASH_INIT 0xcbf29ce484222325ULL
+
 static inline void shader_param_init(struct gs_shader_param *param)
 {
 	memset(param, 0, sizeof(struct gs_shader_param));
@@ -243,6 +259,8 @@ static bool gl_shader_init(struct gs_shader *shader,
 
 	gl_get_shader_info(shader->obj, file, error_string);
 
+	shader->hash = hash_str(HASH_INIT, glsp->gl_string.array);
+
 	if (success)
 		success = gl_add_params(shader, glsp);
 	/* Only vertex shaders actually require input attributes */
@@ -637,27 +655,215 @@ static inline bool assign_program_params(struct gs_program *program)
 	return true;
 }
 
-struct gs_program *gs_program_create(struct gs_device *device)
+/* ------------------------------------------------------------------------- */
+/* program binary cache                                                      */
+
+#define PROGRAM_CACHE_MAGIC 0x5047424F /* "OBGP" */
+#define PROGRAM_CACHE_VERSION 1
+
+struct program_cache_header {
+	uint32_t magic;
+	uint32_t version;
+	uint64_t driver_hash;
+	uint64_t vs_hash;
+	uint64_t ps_hash;
+	uint32_t format;
+	uint32_t size;
+};
+
+void gl_program_cache_init(struct gs_device *device)
 {
-	struct gs_program *program = bzalloc(sizeof(*program));
-	int linked = false;
+	const char *path = gs_get_shader_cache_path();
+	GLint num_formats = 0;
+	uint64_t hash = HASH_INIT;
 
-	program->device = device;
-	program->vertex_shader = device->cur_vertex_shader;
-	program->pixel_shader = device->cur_pixel_shader;
+	if (!path)
+		return;
+	if (!GLAD_GL_VERSION_4_1 && !GLAD_GL_ARB_get_program_binary)
+		return;
 
-	program->obj = glCreateProgram();
-	if (!gl_success("glCreateProgram"))
-		goto error_detach_neither;
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &num_formats);
+	if (!gl_success("glGetIntegerv") || !num_formats) {
+		blog(LOG_INFO, "Shader program cache: driver does not "
+			       "support program binaries, disabled");
+		return;
+	}
+
+	if (os_mkdirs(path) == MKDIR_ERROR) {
+		blog(LOG_WARNING, "Shader program cache: failed to create "
+				  "'%s', disabled",
+		     path);
+		return;
+	}
+
+	/* any driver/renderer change invalidates every cached program */
+	hash = hash_str(hash, (const char *)glGetString(GL_VENDOR));
+	hash = hash_str(hash, (const char *)glGetString(GL_RENDERER));
+	hash = hash_str(hash, (const char *)glGetString(GL_VERSION));
+	hash = hash_str(hash, (const char *)glGetString(
+				      GL_SHADING_LANGUAGE_VERSION));
+
+	device->program_cache_dir = bstrdup(path);
+	device->program_cache_driver_hash = hash;
+
+	blog(LOG_INFO, "Shader program cache: %s", path);
+}
+
+void gl_program_cache_free(struct gs_device *device)
+{
+	if (device->program_cache_hits || device->program_cache_misses)
+		blog(LOG_INFO,
+		     "Shader program cache: %" PRIu32 " hits, %" PRIu32
+		     " misses, %.2f ms spent linking",
+		     device->program_cache_hits, device->program_cache_misses,
+		     (double)device->program_link_time_ns / 1000000.0);
+
+	bfree(device->program_cache_dir);
+	device->program_cache_dir = NULL;
+}
+
+static void get_program_cache_file(struct gs_program *program,
+				   struct dstr *path)
+{
+	dstr_printf(path, "%s/%016" PRIx64 "%016" PRIx64 ".bin",
+		    program->device->program_cache_dir,
+		    program->vertex_shader->hash, program->pixel_shader->hash);
+}
+
+static bool program_cache_load(struct gs_program *program)
+{
+	struct gs_device *device = program->device;
+	struct program_cache_header header;
+	struct dstr path = {0};
+	uint8_t *data = NULL;
+	GLint linked = GL_FALSE;
+	int64_t file_size;
+	FILE *file;
+
+	if (!device->program_cache_dir)
+		return false;
+
+	get_program_cache_file(program, &path);
+	file = os_fopen(path.array, "rb");
+	dstr_free(&path);
+
+	if (!file)
+		return false;
+
+	file_size = os_fgetsize(file);
+	if (fread(&header, 1, sizeof(header), file) != sizeof(header))
+		goto fail;
+	if (header.magic != PROGRAM_CACHE_MAGIC ||
+	    header.version != PROGRAM_CACHE_VERSION ||
+	    header.driver_hash != device->program_cache_driver_hash ||
+	    header.vs_hash != program->vertex_shader->hash ||
+	    header.ps_hash != program->pixel_shader->hash || !header.size)
+		goto fail;
+
+	/* don't trust the size of a corrupt or truncated file */
+	if (file_size < 0 ||
+	    (uint64_t)header.size > (uint64_t)file_size - sizeof(header))
+		goto fail;
+
+	data = bmalloc(header.size);
+	if (fread(data, 1, header.size, file) != header.size)
+		goto fail;
+
+	glProgramBinary(program->obj, header.format, data, header.size);
+	if (!gl_success("glProgramBinary"))
+		goto fail;
+
+	glGetProgramiv(program->obj, GL_LINK_STATUS, &linked);
+	if (!gl_success("glGetProgramiv") || linked == GL_FALSE)
+		goto fail;
+
+	bfree(data);
+	fclose(file);
+	return true;
+
+fail:
+	bfree(data);
+	fclose(file);
+	return false;
+}
+
+static void program_cache_save(struct gs_program *program)
+{
+	struct gs_device *device = program->device;
+	struct program_cache_header header = {0};
+	struct dstr path = {0};
+	struct dstr tmp_path = {0};
+	uint8_t *data = NULL;
+	GLint length = 0;
+	GLenum format = 0;
+	bool success = false;
+	FILE *file;
+
+	if (!device->program_cache_dir)
+		return;
+
+	glGetProgramiv(program->obj, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (!gl_success("glGetProgramiv") || length <= 0)
+		return;
+
+	data = bmalloc(length);
+	glGetProgramBinary(program->obj, length, &length, &format, data);
+	if (!gl_success("glGetProgramBinary") || length <= 0)
+		goto exit;
+
+	header.magic = PROGRAM_CACHE_MAGIC;
+	header.version = PROGRAM_CACHE_VERSION;
+	header.driver_hash = device->program_cache_driver_hash;
+	header.vs_hash = program->vertex_shader->hash;
+	header.ps_hash = program->pixel_shader->hash;
+	header.format = format;
+	header.size = (uint32_t)length;
+
+	get_program_cache_file(program, &path);
+	dstr_copy_dstr(&tmp_path, &path);
+	dstr_cat(&tmp_path, ".tmp");
+
+	file = os_fopen(tmp_path.array, "wb");
+	if (!file)
+		goto exit;
+
+	success = fwrite(&header, 1, sizeof(header), file) == sizeof(header) &&
+		  fwrite(data, 1, length, file) == (size_t)length;
+	fclose(file);
+
+	if (!success || os_rename(tmp_path.array, path.array) != 0) {
+		blog(LOG_DEBUG, "Shader program cache: failed to write '%s'",
+		     path.array);
+		os_unlink(tmp_path.array);
+	}
+
+exit:
+	dstr_free(&tmp_path);
+	dstr_free(&path);
+	bfree(data);
+}
+
+/* ------------------------------------------------------------------------- */
+
+static bool gs_program_link(struct gs_program *program)
+{
+	int linked = false;
 
 	glAttachShader(program->obj, program->vertex_shader->obj);
 	if (!gl_success("glAttachShader (vertex)"))
-		goto error_detach_neither;
+		return false;
 
 	glAttachShader(program->obj, program->pixel_shader->obj);
 	if (!gl_success("glAttachShader (pixel)"))
 		goto error_detach_vertex;
 
+	if (program->device->program_cache_dir) {
+		glProgramParameteri(program->obj,
+				    GL_PROGRAM_BINARY_RETRIEVABLE_HINT,
+				    GL_TRUE);
+		gl_success("glProgramParameteri");
+	}
+
 	glLinkProgram(program->obj);
 	if (!gl_success("glLinkProgram"))
 		goto error;
@@ -671,24 +877,13 @@ struct gs_program *gs_program_create(struct gs_device *device)
 		goto error;
 	}
 
-	if (!assign_program_attribs(program))
-		goto error;
-	if (!assign_program_params(program))
-		goto error;
-
 	glDetachShader(program->obj, program->vertex_shader->obj);
 	gl_success("glDetachShader (vertex)");
 
 	glDetachShader(program->obj, program->pixel_shader->obj);
 	gl_success("glDetachShader (pixel)");
 
-	program->next = device->first_program;
-	program->prev_next = &device->first_program;
-	device->first_program = program;
-	if (program->next)
-		program->next->prev_next = &program->next;
-
-	return program;
+	return true;
 
 error:
 	glDetachShader(program->obj, program->pixel_shader->obj);
@@ -697,8 +892,50 @@ error:
 error_detach_vertex:
 	glDetachShader(program->obj, program->vertex_shader->obj);
 	gl_success("glDetachShader (vertex)");
+	return false;
+}
 
-error_detach_neither:
+struct gs_program *gs_program_create(struct gs_device *device)
+{
+	struct gs_program *program = bzalloc(sizeof(*program));
+	uint64_t start_time;
+
+	program->device = device;
+	program->vertex_shader = device->cur_vertex_shader;
+	program->pixel_shader = device->cur_pixel_shader;
+
+	program->obj = glCreateProgram();
+	if (!gl_success("glCreateProgram"))
+		goto error;
+
+	start_time = os_gettime_ns();
+
+	if (program_cache_load(program)) {
+		device->program_cache_hits++;
+	} else {
+		if (!gs_program_link(program))
+			goto error;
+
+		program_cache_save(program);
+		device->program_cache_misses++;
+	}
+
+	device->program_link_time_ns += os_gettime_ns() - start_time;
+
+	if (!assign_program_attribs(program))
+		goto error;
+	if (!assign_program_params(program))
+		goto error;
+
+	program->next = device->first_program;
+	program->prev_next = &device->first_program;
+	device->first_program = program;
+	if (program->next)
+		program->next->prev_next = &program->next;
+
+	return program;
+
+error:
 	gs_program_destroy(program);
 	return NULL;
 }
@@ -480,6 +480,7 @@ struct gs_shader {
 	gs_device_t *device;
 	enum gs_shader_type type;
 	GLuint obj;
+	uint64_t hash;
 
 	struct gs_shader_param *viewproj;
 	struct gs_shader_param *world;
@@ -507,6 +508,9 @@ struct gs_program {
 	struct gs_program *next;
 };
 
+extern void gl_program_cache_init(struct gs_device *device);
+extern void gl_program_cache_free(struct gs_device *device);
+
 extern struct gs_program *gs_program_create(struct gs_device *device);
 extern void gs_program_destroy(struct gs_program *program);
 extern void program_update_params(struct gs_program *shader);
@@ -656,6 +660,12 @@ struct gs_device {
 
 	struct gs_program *first_program;
 
+	char *program_cache_dir;
+	uint64_t program_cache_driver_hash;
+	uint32_t program_cache_hits;
+	uint32_t program_cache_misses;
+	uint64_t program_link_time_ns;
+
 	enum gs_cull_mode cur_cull_mode;
 	struct gs_rect cur_viewport;
 
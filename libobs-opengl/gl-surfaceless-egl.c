@@ -0,0 +1,376 @@
+/******************************************************************************
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+/* Windowless GL context for headless use (benchmarks, render farms, CI).
+ * Rendering only ever targets textures, so there is no default framebuffer
+ * and swap chains cannot be created. */
+
+#include "gl-surfaceless-egl.h"
+
+#include "gl-egl-common.h"
+
+#include <glad/glad_egl.h>
+
+#ifndef EGL_PLATFORM_SURFACELESS_MESA
+#define EGL_PLATFORM_SURFACELESS_MESA 0x31DD
+#endif
+
+typedef EGLDisplay(EGLAPIENTRYP PFNEGLGETPLATFORMDISPLAYEXTPROC)(
+	EGLenum platform, void *native_display, const EGLint *attrib_list);
+
+static const EGLint config_attribs[] = {EGL_SURFACE_TYPE,
+					EGL_PBUFFER_BIT,
+					EGL_RENDERABLE_TYPE,
+					EGL_OPENGL_BIT,
+					EGL_STENCIL_SIZE,
+					0,
+					EGL_DEPTH_SIZE,
+					0,
+					EGL_BUFFER_SIZE,
+					32,
+					EGL_ALPHA_SIZE,
+					8,
+					EGL_NONE};
+
+static const EGLint ctx_attribs[] = {
+#ifdef _DEBUG
+	EGL_CONTEXT_OPENGL_DEBUG,
+	EGL_TRUE,
+#endif
+	EGL_CONTEXT_OPENGL_PROFILE_MASK,
+	EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+	EGL_CONTEXT_MAJOR_VERSION,
+	3,
+	EGL_CONTEXT_MINOR_VERSION,
+	3,
+	EGL_NONE};
+
+static const EGLint khr_ctx_attribs[] = {
+#ifdef _DEBUG
+	EGL_CONTEXT_FLAGS_KHR,
+	EGL_CONTEXT_OPENGL_DEBUG_BIT_KHR,
+#endif
+	EGL_CONTEXT_OPENGL_PROFILE_MASK_KHR,
+	EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT_KHR,
+	EGL_CONTEXT_MAJOR_VERSION_KHR,
+	3,
+	EGL_CONTEXT_MINOR_VERSION_KHR,
+	3,
+	EGL_NONE};
+
+struct gl_windowinfo {
+	int unused;
+};
+
+struct gl_platform {
+	EGLDisplay display;
+	EGLConfig config;
+	EGLContext context;
+};
+
+static bool extension_supported(const char *extensions, const char *search)
+{
+	const char *result = extensions ? strstr(extensions, search) : NULL;
+	unsigned long len = strlen(search);
+	return result != NULL &&
+	       (result == extensions || *(result - 1) == ' ') &&
+	       (result[len] == ' ' || result[len] == '\0');
+}
+
+static struct gl_windowinfo *
+gl_surfaceless_egl_windowinfo_create(const struct gs_init_data *info)
+{
+	UNUSED_PARAMETER(info);
+	blog(LOG_ERROR, "Swap chains are not available on surfaceless EGL");
+	return NULL;
+}
+
+static void gl_surfaceless_egl_windowinfo_destroy(struct gl_windowinfo *info)
+{
+	bfree(info);
+}
+
+static bool egl_make_current(EGLDisplay display, EGLContext context)
+{
+	if (eglBindAPI(EGL_OPENGL_API) == EGL_FALSE) {
+		blog(LOG_ERROR, "eglBindAPI failed");
+	}
+
+	if (!eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)) {
+		blog(LOG_ERROR, "eglMakeCurrent failed");
+		return false;
+	}
+
+	return true;
+}
+
+static EGLDisplay get_egl_display(void)
+{
+	const char *client_extensions =
+		eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+
+	if (!extension_supported(client_extensions, "EGL_EXT_platform_base") ||
+	    !extension_supported(client_extensions,
+				 "EGL_MESA_platform_surfaceless")) {
+		blog(LOG_ERROR,
+		     "EGL_MESA_platform_surfaceless is not supported");
+		return EGL_NO_DISPLAY;
+	}
+
+	PFNEGLGETPLATFORMDISPLAYEXTPROC eglGetPlatformDisplayEXT =
+		(PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress(
+			"eglGetPlatformDisplayEXT");
+	if (!eglGetPlatformDisplayEXT)
+		return EGL_NO_DISPLAY;
+
+	return eglGetPlatformDisplayEXT(EGL_PLATFORM_SURFACELESS_MESA,
+					EGL_DEFAULT_DISPLAY, NULL);
+}
+
+static bool egl_context_create(struct gl_platform *plat, const EGLint *attribs)
+{
+	EGLint num_config;
+
+	if (eglBindAPI(EGL_OPENGL_API) == EGL_FALSE) {
+		blog(LOG_ERROR, "eglBindAPI failed");
+	}
+
+	EGLBoolean result = eglChooseConfig(plat->display, config_attribs,
+					    &plat->config, 1, &num_config);
+	if (result != EGL_TRUE || num_config == 0) {
+		blog(LOG_ERROR, "eglChooseConfig failed");
+		return false;
+	}
+
+	plat->context = eglCreateContext(plat->display, plat->config,
+					 EGL_NO_CONTEXT, attribs);
+	if (plat->context == EGL_NO_CONTEXT) {
+		blog(LOG_ERROR, "eglCreateContext failed");
+		return false;
+	}
+
+	return egl_make_current(plat->display, plat->context);
+}
+
+static void egl_context_destroy(struct gl_platform *plat)
+{
+	egl_make_current(plat->display, EGL_NO_CONTEXT);
+	eglDestroyContext(plat->display, plat->context);
+}
+
+static struct gl_platform *
+gl_surfaceless_egl_platform_create(gs_device_t *device, uint32_t adapter)
+{
+	struct gl_platform *plat = bzalloc(sizeof(struct gl_platform));
+
+	device->plat = plat;
+
+	plat->display = get_egl_display();
+	if (plat->display == EGL_NO_DISPLAY) {
+		blog(LOG_ERROR, "Failed to get surfaceless EGL display");
+		goto fail_display_init;
+	}
+
+	EGLint major;
+	EGLint minor;
+
+	if (eglInitialize(plat->display, &major, &minor) == EGL_FALSE) {
+		blog(LOG_ERROR, "eglInitialize failed");
+		goto fail_display_init;
+	}
+
+	blog(LOG_INFO, "Initialized EGL %d.%d", major, minor);
+
+	const char *extensions = eglQueryString(plat->display, EGL_EXTENSIONS);
+	blog(LOG_DEBUG, "Supported EGL Extensions: %s", extensions);
+
+	if (!extension_supported(extensions, "EGL_KHR_surfaceless_context")) {
+		blog(LOG_ERROR, "EGL_KHR_surfaceless_context is required");
+		goto fail_context_create;
+	}
+
+	const EGLint *attribs = ctx_attribs;
+	if (major == 1 && minor == 4) {
+		if (extension_supported(extensions, "EGL_KHR_create_context")) {
+			attribs = khr_ctx_attribs;
+		} else {
+			blog(LOG_ERROR,
+			     "EGL_KHR_create_context extension is required to use EGL 1.4.");
+			goto fail_context_create;
+		}
+	} else if (major < 1 || (major == 1 && minor < 4)) {
+		blog(LOG_ERROR, "EGL 1.4 or higher is required.");
+		goto fail_context_create;
+	}
+
+	if (!egl_context_create(plat, attribs)) {
+		goto fail_context_create;
+	}
+
+	if (!gladLoadGL()) {
+		blog(LOG_ERROR, "Failed to load OpenGL entry functions.");
+		goto fail_load_gl;
+	}
+
+	if (!gladLoadEGL()) {
+		blog(LOG_ERROR, "Unable to load EGL entry functions.");
+		goto fail_load_egl;
+	}
+
+	goto success;
+
+fail_load_egl:
+fail_load_gl:
+	egl_context_destroy(plat);
+fail_context_create:
+	eglTerminate(plat->display);
+fail_display_init:
+	bfree(plat);
+	plat = NULL;
+success:
+	UNUSED_PARAMETER(adapter);
+	return plat;
+}
+
+static void gl_surfaceless_egl_platform_destroy(struct gl_platform *plat)
+{
+	if (plat) {
+		egl_context_destroy(plat);
+		eglTerminate(plat->display);
+		bfree(plat);
+	}
+}
+
+static bool
+gl_surfaceless_egl_platform_init_swapchain(struct gs_swap_chain *swap)
+{
+	UNUSED_PARAMETER(swap);
+	return false;
+}
+
+static void
+gl_surfaceless_egl_platform_cleanup_swapchain(struct gs_swap_chain *swap)
+{
+	UNUSED_PARAMETER(swap);
+}
+
+static void gl_surfaceless_egl_device_enter_context(gs_device_t *device)
+{
+	struct gl_platform *plat = device->plat;
+	egl_make_current(plat->display, plat->context);
+}
+
+static void gl_surfaceless_egl_device_leave_context(gs_device_t *device)
+{
+	struct gl_platform *plat = device->plat;
+	egl_make_current(plat->display, EGL_NO_CONTEXT);
+}
+
+static void *gl_surfaceless_egl_device_get_device_obj(gs_device_t *device)
+{
+	return device->plat->context;
+}
+
+static void gl_surfaceless_egl_getclientsize(const struct gs_swap_chain *swap,
+					     uint32_t *width, uint32_t *height)
+{
+	UNUSED_PARAMETER(swap);
+	*width = 0;
+	*height = 0;
+}
+
+static void gl_surfaceless_egl_clear_context(gs_device_t *device)
+{
+	struct gl_platform *plat = device->plat;
+	egl_make_current(plat->display, EGL_NO_CONTEXT);
+}
+
+static void gl_surfaceless_egl_update(gs_device_t *device)
+{
+	UNUSED_PARAMETER(device);
+}
+
+static void gl_surfaceless_egl_device_load_swapchain(gs_device_t *device,
+						     gs_swapchain_t *swap)
+{
+	device->cur_swap = swap;
+}
+
+static void gl_surfaceless_egl_device_present(gs_device_t *device)
+{
+	UNUSED_PARAMETER(device);
+}
+
+static struct gs_texture *gl_surfaceless_egl_device_texture_create_from_dmabuf(
+	gs_device_t *device, unsigned int width, unsigned int height,
+	uint32_t drm_format, enum gs_color_format color_format,
+	uint32_t n_planes, const int *fds, const uint32_t *strides,
+	const uint32_t *offsets, const uint64_t *modifiers)
+{
+	struct gl_platform *plat = device->plat;
+
+	return gl_egl_create_dmabuf_image(plat->display, width, height,
+					  drm_format, color_format, n_planes,
+					  fds, strides, offsets, modifiers);
+}
+
+static bool gl_surfaceless_egl_device_query_dmabuf_capabilities(
+	gs_device_t *device, enum gs_dmabuf_flags *dmabuf_flags,
+	uint32_t **drm_formats, size_t *n_formats)
+{
+	struct gl_platform *plat = device->plat;
+
+	return gl_egl_query_dmabuf_capabilities(plat->display, dmabuf_flags,
+						drm_formats, n_formats);
+}
+
+static bool gl_surfaceless_egl_device_query_dmabuf_modifiers_for_format(
+	gs_device_t *device, uint32_t drm_format, uint64_t **modifiers,
+	size_t *n_modifiers)
+{
+	struct gl_platform *plat = device->plat;
+
+	return gl_egl_query_dmabuf_modifiers_for_format(
+		plat->display, drm_format, modifiers, n_modifiers);
+}
+
+static const struct gl_winsys_vtable egl_surfaceless_winsys_vtable = {
+	.windowinfo_create = gl_surfaceless_egl_windowinfo_create,
+	.windowinfo_destroy = gl_surfaceless_egl_windowinfo_destroy,
+	.platform_create = gl_surfaceless_egl_platform_create,
+	.platform_destroy = gl_surfaceless_egl_platform_destroy,
+	.platform_init_swapchain = gl_surfaceless_egl_platform_init_swapchain,
+	.platform_cleanup_swapchain =
+		gl_surfaceless_egl_platform_cleanup_swapchain,
+	.device_enter_context = gl_surfaceless_egl_device_enter_context,
+	.device_leave_context = gl_surfaceless_egl_device_leave_context,
+	.device_get_device_obj = gl_surfaceless_egl_device_get_device_obj,
+	.getclientsize = gl_surfaceless_egl_getclientsize,
+	.clear_context = gl_surfaceless_egl_clear_context,
+	.update = gl_surfaceless_egl_update,
+	.device_load_swapchain = gl_surfaceless_egl_device_load_swapchain,
+	.device_present = gl_surfaceless_egl_device_present,
+	.device_texture_create_from_dmabuf =
+		gl_surfaceless_egl_device_texture_create_from_dmabuf,
+	.device_query_dmabuf_capabilities =
+		gl_surfaceless_egl_device_query_dmabuf_capabilities,
+	.device_query_dmabuf_modifiers_for_format =
+		gl_surfaceless_egl_device_query_dmabuf_modifiers_for_format,
+};
+
+const struct gl_winsys_vtable *gl_surfaceless_egl_get_winsys_vtable(void)
+{
+	return &egl_surfaceless_winsys_vtable;
+}
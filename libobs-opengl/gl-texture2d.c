@@ -258,6 +258,48 @@ failed:
 	blog(LOG_ERROR, "gs_texture_unmap (GL) failed");
 }
 
+bool gs_texture_set_image_region(gs_texture_t *tex, uint32_t x, uint32_t y,
+				 uint32_t cx, uint32_t cy, const uint8_t *data,
+				 uint32_t linesize)
+{
+	struct gs_texture_2d *tex2d = (struct gs_texture_2d *)tex;
+	uint32_t pixel_size;
+	bool success;
+
+	if (!is_texture_2d(tex, "gs_texture_set_image_region"))
+		goto fail;
+
+	pixel_size = gs_get_format_bpp(tex->format) / 8;
+	if (gs_is_compressed_format(tex->format) || !pixel_size ||
+	    linesize % pixel_size != 0)
+		goto fail;
+
+	if (x + cx > tex2d->width || y + cy > tex2d->height) {
+		blog(LOG_ERROR, "Region is outside of the texture");
+		goto fail;
+	}
+
+	if (!gl_bind_texture(GL_TEXTURE_2D, tex2d->base.texture))
+		goto fail;
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, linesize / pixel_size);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, cx, cy, tex->gl_format,
+			tex->gl_type, data);
+	success = gl_success("glTexSubImage2D");
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+	gl_bind_texture(GL_TEXTURE_2D, 0);
+
+	if (success)
+		return true;
+
+fail:
+	blog(LOG_ERROR, "gs_texture_set_image_region (GL) failed");
+	return false;
+}
+
 bool gs_texture_is_rect(const gs_texture_t *tex)
 {
 	if (tex->type == GS_TEXTURE_3D)
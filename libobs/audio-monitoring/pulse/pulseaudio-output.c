@@ -1,12 +1,34 @@
 #include "obs-internal.h"
 #include "pulseaudio-wrapper.h"
 
-#define PULSE_DATA(voidptr) struct audio_monitor *data = voidptr;
+#include <util/spsc-ring.h>
+
+#define PULSE_DATA(voidptr) struct pulse_output *data = voidptr;
 #define blog(level, msg, ...) blog(level, "pulse-am: " msg, ##__VA_ARGS__)
 
-struct audio_monitor {
-	obs_source_t *source;
+/* frames moved between the rings and the stream at a time */
+#define MONITOR_CHUNK_FRAMES 1024
+/* how much audio a monitor can queue before it starts dropping */
+#define MONITOR_RING_MS 250
+/* how often the mainloop checks the rings for data pulse has room for */
+#define MONITOR_PUMP_USEC 5000
+
+/*
+ * Monitoring never touches pulse or a lock on the thread that produces the
+ * audio.  Each monitor interleaves its audio (with the volume applied) into
+ * its own single-producer/single-consumer ring, and everything else --
+ * mixing, resampling to the device format and writing to the stream -- is
+ * done by the pulse mainloop thread.  Normally each monitor has its own
+ * stream, but when monitoring is premixed all monitors on the same device
+ * share one stream and are resampled once.
+ */
+
+struct pulse_output {
+	long refs;
+	bool shared;
+
 	pa_stream *stream;
+	pa_time_event *timer;
 	char *device;
 	pa_buffer_attr attr;
 	enum speaker_layout speakers;
@@ -15,17 +37,37 @@ struct audio_monitor {
 	uint_fast32_t bytes_per_frame;
 	uint_fast8_t channels;
 
+	/* only touched by the mainloop, or with the mainloop locked */
+	DARRAY(struct audio_monitor *) monitors;
+	audio_resampler_t *resampler;
+	struct circlebuf new_data;
+	size_t obs_channels;
+	float *buffer;
+	float *mix;
+};
+
+struct audio_monitor {
+	obs_source_t *source;
+	struct pulse_output *output;
+
+	struct spsc_ring ring;
+	float *buffer;
+	size_t channels;
+
+	/* only touched by the thread producing the audio */
 	uint_fast32_t packets;
 	uint_fast64_t frames;
-
-	struct circlebuf new_data;
-	audio_resampler_t *resampler;
-	size_t bytesRemaining;
+	uint_fast64_t dropped;
+	uint64_t playback_ns;
+	uint64_t max_playback_ns;
 
 	bool ignore;
-	pthread_mutex_t playback_mutex;
 };
 
+static pthread_mutex_t shared_output_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct pulse_output *shared_output = NULL;
+
+static const char *on_audio_playback_name = "audio_monitor_playback";
 static enum speaker_layout
 pulseaudio_channels_to_obs_speakers(uint_fast32_t channels)
 {
@@ -123,151 +165,207 @@ static pa_channel_map pulseaudio_channel_map(enum speaker_layout layout)
 	return ret;
 }
 
-static void process_byte(void *p, size_t frames, size_t channels, float vol)
+static void interleave_audio(float *out, const struct audio_data *audio_data,
+			     size_t offset, size_t frames, size_t channels,
+			     float vol)
 {
-	register uint8_t *cur = (uint8_t *)p;
-	register uint8_t *end = cur + frames * channels;
+	for (size_t ch = 0; ch < channels; ch++) {
+		const float *in = (const float *)audio_data->data[ch];
+		float *cur = out + ch;
+
+		if (!in) {
+			for (size_t i = 0; i < frames; i++)
+				cur[i * channels] = 0.0f;
+			continue;
+		}
 
-	for (; cur < end; cur++)
-		*cur = ((int)*cur - 128) * vol + 128;
+		in += offset;
+		for (size_t i = 0; i < frames; i++)
+			cur[i * channels] = in[i] * vol;
+	}
 }
 
-static void process_s16(void *p, size_t frames, size_t channels, float vol)
+static void on_audio_playback(void *param, obs_source_t *source,
+			      const struct audio_data *audio_data, bool muted)
 {
-	register int16_t *cur = (int16_t *)p;
-	register int16_t *end = cur + frames * channels;
+	struct audio_monitor *monitor = param;
+	float vol = muted ? 0.0f : source->user_volume;
+	size_t frame_size = monitor->channels * sizeof(float);
+	size_t offset = 0;
+	uint64_t start_time;
+	uint64_t elapsed;
 
-	while (cur < end)
-		*(cur++) *= vol;
-}
+	if (os_atomic_load_long(&source->activate_refs) == 0)
+		return;
 
-static void process_s32(void *p, size_t frames, size_t channels, float vol)
-{
-	register int32_t *cur = (int32_t *)p;
-	register int32_t *end = cur + frames * channels;
+	start_time = os_gettime_ns();
+	profile_start(on_audio_playback_name);
 
-	while (cur < end)
-		*(cur++) *= vol;
-}
+	while (offset < audio_data->frames) {
+		size_t frames = audio_data->frames - offset;
+		if (frames > MONITOR_CHUNK_FRAMES)
+			frames = MONITOR_CHUNK_FRAMES;
 
-static void process_float(void *p, size_t frames, size_t channels, float vol)
-{
-	register float *cur = (float *)p;
-	register float *end = cur + frames * channels;
-
-	while (cur < end)
-		*(cur++) *= vol;
-}
+		/* the mainloop isn't keeping up, drop instead of waiting */
+		if (spsc_ring_avail(&monitor->ring) < frames * frame_size) {
+			monitor->dropped += audio_data->frames - offset;
+			break;
+		}
 
-void process_volume(const struct audio_monitor *monitor, float vol,
-		    uint8_t *const *resample_data, uint32_t resample_frames)
-{
-	switch (monitor->format) {
-	case PA_SAMPLE_U8:
-		process_byte(resample_data[0], resample_frames,
-			     monitor->channels, vol);
-		break;
-	case PA_SAMPLE_S16LE:
-		process_s16(resample_data[0], resample_frames,
-			    monitor->channels, vol);
-		break;
-	case PA_SAMPLE_S32LE:
-		process_s32(resample_data[0], resample_frames,
-			    monitor->channels, vol);
-		break;
-	case PA_SAMPLE_FLOAT32LE:
-		process_float(resample_data[0], resample_frames,
-			      monitor->channels, vol);
-		break;
-	default:
-		// just ignore
-		break;
+		interleave_audio(monitor->buffer, audio_data, offset, frames,
+				 monitor->channels, vol);
+		spsc_ring_push(&monitor->ring, monitor->buffer,
+			       frames * frame_size);
+		offset += frames;
 	}
+
+	monitor->packets++;
+	monitor->frames += offset;
+
+	profile_end(on_audio_playback_name);
+
+	elapsed = os_gettime_ns() - start_time;
+	monitor->playback_ns += elapsed;
+	if (elapsed > monitor->max_playback_ns)
+		monitor->max_playback_ns = elapsed;
 }
 
-static void do_stream_write(void *param)
+/* pops up to MONITOR_CHUNK_FRAMES of OBS audio from the monitors feeding the
+ * output into data->buffer, mixing them if there is more than one */
+static size_t pulseaudio_pop_monitors(struct pulse_output *data)
 {
-	PULSE_DATA(param);
-	uint8_t *buffer = NULL;
+	size_t frame_size = data->obs_channels * sizeof(float);
+	size_t frames = MONITOR_CHUNK_FRAMES;
+	bool found = false;
+
+	/* only take as much as every monitor that is currently producing
+	 * audio has queued, so premixed monitors stay in sync */
+	for (size_t i = 0; i < data->monitors.num; i++) {
+		struct audio_monitor *monitor = data->monitors.array[i];
+		size_t queued = spsc_ring_size(&monitor->ring) / frame_size;
+
+		if (queued) {
+			if (queued < frames)
+				frames = queued;
+			found = true;
+		}
+	}
 
-	while (data->new_data.size > 0 && data->bytesRemaining > 0) {
-		size_t bytesToFill = data->new_data.size;
-		if (data->bytesRemaining < bytesToFill)
-			bytesToFill = data->bytesRemaining;
+	if (!found)
+		return 0;
 
-		pulseaudio_lock();
-		if (pa_stream_begin_write(data->stream, (void **)&buffer,
-					  &bytesToFill)) {
-			pulseaudio_unlock();
-			return;
-		}
+	if (data->monitors.num == 1) {
+		spsc_ring_pop(&data->monitors.array[0]->ring, data->buffer,
+			      frames * frame_size);
+		return frames;
+	}
 
-		circlebuf_pop_front(&data->new_data, buffer, bytesToFill);
+	memset(data->buffer, 0, frames * frame_size);
 
-		pa_stream_write(data->stream, buffer, bytesToFill, NULL, 0LL,
-				PA_SEEK_RELATIVE);
-		pulseaudio_unlock();
+	for (size_t i = 0; i < data->monitors.num; i++) {
+		struct audio_monitor *monitor = data->monitors.array[i];
+		size_t count = spsc_ring_pop(&monitor->ring, data->mix,
+					     frames * frame_size) /
+			       sizeof(float);
 
-		data->bytesRemaining -= bytesToFill;
+		for (size_t j = 0; j < count; j++)
+			data->buffer[j] += data->mix[j];
 	}
+
+	return frames;
 }
 
-static void on_audio_playback(void *param, obs_source_t *source,
-			      const struct audio_data *audio_data, bool muted)
+static bool pulseaudio_resample(struct pulse_output *data)
 {
-	struct audio_monitor *monitor = param;
-	float vol = source->user_volume;
-	size_t bytes;
-
+	const uint8_t *input[MAX_AV_PLANES] = {(uint8_t *)data->buffer};
 	uint8_t *resample_data[MAX_AV_PLANES];
 	uint32_t resample_frames;
 	uint64_t ts_offset;
-	bool success;
+	size_t frames;
 
-	if (pthread_mutex_trylock(&monitor->playback_mutex) != 0)
-		return;
+	frames = pulseaudio_pop_monitors(data);
+	if (!frames)
+		return false;
 
-	if (os_atomic_load_long(&source->activate_refs) == 0)
-		goto unlock;
+	if (!audio_resampler_resample(data->resampler, resample_data,
+				      &resample_frames, &ts_offset, input,
+				      (uint32_t)frames))
+		return false;
 
-	success = audio_resampler_resample(
-		monitor->resampler, resample_data, &resample_frames, &ts_offset,
-		(const uint8_t *const *)audio_data->data,
-		(uint32_t)audio_data->frames);
+	circlebuf_push_back(&data->new_data, resample_data[0],
+			    resample_frames * data->bytes_per_frame);
+	return true;
+}
 
-	if (!success)
-		goto unlock;
+/* always called from the mainloop thread */
+static void pulseaudio_fill_stream(struct pulse_output *data)
+{
+	size_t writable;
 
-	bytes = monitor->bytes_per_frame * resample_frames;
+	if (pa_stream_get_state(data->stream) != PA_STREAM_READY)
+		return;
 
-	if (muted) {
-		memset(resample_data[0], 0, bytes);
-	} else {
-		if (!close_float(vol, 1.0f, EPSILON)) {
-			process_volume(monitor, vol, resample_data,
-				       resample_frames);
+	writable = pa_stream_writable_size(data->stream);
+	if (writable == (size_t)-1)
+		return;
+
+	while (writable > 0) {
+		uint8_t *buffer = NULL;
+		size_t bytes;
+
+		if (!data->new_data.size) {
+			if (!pulseaudio_resample(data))
+				break;
+			continue;
 		}
-	}
 
-	circlebuf_push_back(&monitor->new_data, resample_data[0], bytes);
-	monitor->packets++;
-	monitor->frames += resample_frames;
+		bytes = data->new_data.size;
+		if (bytes > writable)
+			bytes = writable;
+
+		if (pa_stream_begin_write(data->stream, (void **)&buffer,
+					  &bytes) < 0)
+			break;
 
-unlock:
-	pthread_mutex_unlock(&monitor->playback_mutex);
-	do_stream_write(param);
+		circlebuf_pop_front(&data->new_data, buffer, bytes);
+
+		pa_stream_write(data->stream, buffer, bytes, NULL, 0LL,
+				PA_SEEK_RELATIVE);
+
+		writable -= bytes;
+	}
 }
 
 static void pulseaudio_stream_write(pa_stream *p, size_t nbytes, void *userdata)
 {
 	UNUSED_PARAMETER(p);
+	UNUSED_PARAMETER(nbytes);
 	PULSE_DATA(userdata);
 
-	pthread_mutex_lock(&data->playback_mutex);
-	data->bytesRemaining += nbytes;
-	pthread_mutex_unlock(&data->playback_mutex);
+	pulseaudio_fill_stream(data);
+}
 
-	pulseaudio_signal(0);
+/* pulse only asks for more data once it has room for a full request, so
+ * also check periodically for audio that arrived in the meantime */
+static void pulseaudio_pump(pa_mainloop_api *api, pa_time_event *e,
+			    const struct timeval *tv, void *userdata)
+{
+	UNUSED_PARAMETER(api);
+	UNUSED_PARAMETER(tv);
+	PULSE_DATA(userdata);
+
+	pulseaudio_fill_stream(data);
+	pulseaudio_timer_restart(e, MONITOR_PUMP_USEC);
+}
+
+static bool pulseaudio_output_active(const struct pulse_output *data)
+{
+	for (size_t i = 0; i < data->monitors.num; i++) {
+		if (obs_source_active(data->monitors.array[i]->source))
+			return true;
+	}
+
+	return false;
 }
 
 static void pulseaudio_underflow(pa_stream *p, void *userdata)
@@ -281,8 +379,7 @@ static void pulseaudio_underflow(pa_stream *p, void *userdata)
 	spec.channels = data->channels;
 	uint64_t latency = pa_bytes_to_usec(data->attr.tlength, &spec);
 
-	pthread_mutex_lock(&data->playback_mutex);
-	if (obs_source_active(data->source) && latency < 1000000) {
+	if (pulseaudio_output_active(data) && latency < 1000000) {
 		data->attr.fragsize = (uint32_t)-1;
 		data->attr.maxlength = (uint32_t)-1;
 		data->attr.prebuf = (uint32_t)-1;
@@ -290,9 +387,7 @@ static void pulseaudio_underflow(pa_stream *p, void *userdata)
 		data->attr.tlength = (data->attr.tlength * 3) / 2;
 		pa_stream_set_buffer_attr(data->stream, &data->attr, NULL,
 					  NULL);
-		data->bytesRemaining = data->attr.maxlength;
 	}
-	pthread_mutex_unlock(&data->playback_mutex);
 
 	if (latency >= 1000000) {
 		blog(LOG_WARNING, "source monitor reached max latency %ldms",
@@ -301,7 +396,6 @@ static void pulseaudio_underflow(pa_stream *p, void *userdata)
 
 	pulseaudio_signal(0);
 }
-
 static void pulseaudio_server_info(pa_context *c, const pa_server_info *i,
 				   void *userdata)
 {
@@ -360,95 +454,83 @@ skip:
 	pulseaudio_signal(0);
 }
 
-static void pulseaudio_stop_playback(struct audio_monitor *monitor)
+static void pulseaudio_stop_playback(struct pulse_output *data)
 {
-	if (monitor->stream) {
+	if (data->timer) {
+		pulseaudio_timer_free(data->timer);
+		data->timer = NULL;
+	}
+
+	if (data->stream) {
 		/* Stop the stream */
 		pulseaudio_lock();
-		pa_stream_disconnect(monitor->stream);
+		pa_stream_disconnect(data->stream);
 		pulseaudio_unlock();
 
 		/* Remove the callbacks, to ensure we no longer try to do anything
 		 * with this stream object */
-		pulseaudio_write_callback(monitor->stream, NULL, NULL);
-		pulseaudio_set_underflow_callback(monitor->stream, NULL, NULL);
+		pulseaudio_write_callback(data->stream, NULL, NULL);
+		pulseaudio_set_underflow_callback(data->stream, NULL, NULL);
 
 		/* Unreference the stream and drop it. PA will free it when it can. */
 		pulseaudio_lock();
-		pa_stream_unref(monitor->stream);
+		pa_stream_unref(data->stream);
 		pulseaudio_unlock();
-		monitor->stream = NULL;
+		data->stream = NULL;
 	}
 
-	blog(LOG_INFO, "Stopped Monitoring in '%s'", monitor->device);
-	blog(LOG_INFO,
-	     "Got %" PRIuFAST32 " packets with %" PRIuFAST64 " frames",
-	     monitor->packets, monitor->frames);
-
-	monitor->packets = 0;
-	monitor->frames = 0;
+	blog(LOG_INFO, "Stopped Monitoring in '%s'", data->device);
 }
 
-static bool audio_monitor_init(struct audio_monitor *monitor,
-			       obs_source_t *source)
+static void pulseaudio_output_free(struct pulse_output *data)
 {
-	pthread_mutex_init_value(&monitor->playback_mutex);
-
-	monitor->source = source;
-
-	const char *id = obs->audio.monitoring_device_id;
-	if (!id)
-		return false;
-
-	if (source->info.output_flags & OBS_SOURCE_DO_NOT_SELF_MONITOR) {
-		obs_data_t *s = obs_source_get_settings(source);
-		const char *s_dev_id = obs_data_get_string(s, "device_id");
-		bool match = devices_match(s_dev_id, id);
-		obs_data_release(s);
-
-		if (match) {
-			monitor->ignore = true;
-			blog(LOG_INFO, "Prevented feedback-loop in '%s'",
-			     s_dev_id);
-			return true;
-		}
-	}
+	if (data->stream)
+		pulseaudio_stop_playback(data);
 
-	pulseaudio_init();
+	audio_resampler_destroy(data->resampler);
+	circlebuf_free(&data->new_data);
+	da_free(data->monitors);
 
-	if (strcmp(id, "default") == 0)
-		get_default_id(&monitor->device);
-	else
-		monitor->device = bstrdup(id);
+	bfree(data->buffer);
+	bfree(data->mix);
+	bfree(data->device);
+	bfree(data);
+}
 
-	if (!monitor->device)
-		return false;
+static struct pulse_output *pulseaudio_output_create(const char *device,
+						     const char *name,
+						     bool shared)
+{
+	struct pulse_output *data = bzalloc(sizeof(struct pulse_output));
+	data->refs = 1;
+	data->shared = shared;
+	data->device = bstrdup(device);
 
-	if (pulseaudio_get_server_info(pulseaudio_server_info,
-				       (void *)monitor) < 0) {
+	if (pulseaudio_get_server_info(pulseaudio_server_info, (void *)data) <
+	    0) {
 		blog(LOG_ERROR, "Unable to get server info !");
-		return false;
+		goto fail;
 	}
 
-	if (pulseaudio_get_source_info(pulseaudio_source_info, monitor->device,
-				       (void *)monitor) < 0) {
+	if (pulseaudio_get_source_info(pulseaudio_source_info, data->device,
+				       (void *)data) < 0) {
 		blog(LOG_ERROR, "Unable to get source info !");
-		return false;
+		goto fail;
 	}
-	if (monitor->format == PA_SAMPLE_INVALID) {
+	if (data->format == PA_SAMPLE_INVALID) {
 		blog(LOG_ERROR,
 		     "An error occurred while getting the source info!");
-		return false;
+		goto fail;
 	}
 
 	pa_sample_spec spec;
-	spec.format = monitor->format;
-	spec.rate = (uint32_t)monitor->samples_per_sec;
-	spec.channels = monitor->channels;
+	spec.format = data->format;
+	spec.rate = (uint32_t)data->samples_per_sec;
+	spec.channels = data->channels;
 
 	if (!pa_sample_spec_valid(&spec)) {
 		blog(LOG_ERROR, "Sample spec is not valid");
-		return false;
+		goto fail;
 	}
 
 	const struct audio_output_info *info =
@@ -456,58 +538,167 @@ static bool audio_monitor_init(struct audio_monitor *monitor,
 
 	struct resample_info from = {.samples_per_sec = info->samples_per_sec,
 				     .speakers = info->speakers,
-				     .format = AUDIO_FORMAT_FLOAT_PLANAR};
+				     .format = AUDIO_FORMAT_FLOAT};
 	struct resample_info to = {
-		.samples_per_sec = (uint32_t)monitor->samples_per_sec,
-		.speakers =
-			pulseaudio_channels_to_obs_speakers(monitor->channels),
-		.format = pulseaudio_to_obs_audio_format(monitor->format)};
+		.samples_per_sec = (uint32_t)data->samples_per_sec,
+		.speakers = pulseaudio_channels_to_obs_speakers(data->channels),
+		.format = pulseaudio_to_obs_audio_format(data->format)};
 
-	monitor->resampler = audio_resampler_create(&to, &from);
-	if (!monitor->resampler) {
+	data->resampler = audio_resampler_create(&to, &from);
+	if (!data->resampler) {
 		blog(LOG_WARNING, "%s: %s", __FUNCTION__,
 		     "Failed to create resampler");
-		return false;
+		goto fail;
 	}
 
-	monitor->speakers = pulseaudio_channels_to_obs_speakers(spec.channels);
-	monitor->bytes_per_frame = pa_frame_size(&spec);
+	data->obs_channels = audio_output_get_channels(obs->audio.audio);
+	data->buffer = bmalloc(MONITOR_CHUNK_FRAMES * data->obs_channels *
+			       sizeof(float));
+	if (shared)
+		data->mix = bmalloc(MONITOR_CHUNK_FRAMES * data->obs_channels *
+				    sizeof(float));
 
-	pa_channel_map channel_map = pulseaudio_channel_map(monitor->speakers);
+	data->speakers = pulseaudio_channels_to_obs_speakers(spec.channels);
+	data->bytes_per_frame = pa_frame_size(&spec);
 
-	monitor->stream = pulseaudio_stream_new(
-		obs_source_get_name(monitor->source), &spec, &channel_map);
-	if (!monitor->stream) {
+	pa_channel_map channel_map = pulseaudio_channel_map(data->speakers);
+
+	data->stream = pulseaudio_stream_new(name, &spec, &channel_map);
+	if (!data->stream) {
 		blog(LOG_ERROR, "Unable to create stream");
-		return false;
+		goto fail;
 	}
 
-	monitor->attr.fragsize = (uint32_t)-1;
-	monitor->attr.maxlength = (uint32_t)-1;
-	monitor->attr.minreq = (uint32_t)-1;
-	monitor->attr.prebuf = (uint32_t)-1;
-	monitor->attr.tlength = pa_usec_to_bytes(25000, &spec);
+	data->attr.fragsize = (uint32_t)-1;
+	data->attr.maxlength = (uint32_t)-1;
+	data->attr.minreq = (uint32_t)-1;
+	data->attr.prebuf = (uint32_t)-1;
+	data->attr.tlength = pa_usec_to_bytes(25000, &spec);
 
 	pa_stream_flags_t flags = PA_STREAM_INTERPOLATE_TIMING |
 				  PA_STREAM_AUTO_TIMING_UPDATE;
 
-	if (pthread_mutex_init(&monitor->playback_mutex, NULL) != 0) {
-		blog(LOG_WARNING, "%s: %s", __FUNCTION__,
-		     "Failed to init mutex");
-		return false;
-	}
-
 	int_fast32_t ret = pulseaudio_connect_playback(
-		monitor->stream, monitor->device, &monitor->attr, flags);
+		data->stream, data->device, &data->attr, flags);
 	if (ret < 0) {
-		pulseaudio_stop_playback(monitor);
 		blog(LOG_ERROR, "Unable to connect to stream");
+		goto fail;
+	}
+
+	pulseaudio_write_callback(data->stream, pulseaudio_stream_write,
+				  (void *)data);
+	pulseaudio_set_underflow_callback(data->stream, pulseaudio_underflow,
+					  (void *)data);
+	data->timer = pulseaudio_timer_new(MONITOR_PUMP_USEC, pulseaudio_pump,
+					   (void *)data);
+
+	blog(LOG_INFO, "Started Monitoring in '%s'%s", data->device,
+	     shared ? " (premixed)" : "");
+	return data;
+
+fail:
+	pulseaudio_output_free(data);
+	return NULL;
+}
+
+static struct pulse_output *pulseaudio_output_get(const char *device,
+						  obs_source_t *source)
+{
+	struct pulse_output *data;
+
+	if (!obs->audio.monitoring_premix)
+		return pulseaudio_output_create(
+			device, obs_source_get_name(source), false);
+
+	/* a device change creates a new shared output, the previous one is
+	 * freed once the last of its monitors has been reset */
+	pthread_mutex_lock(&shared_output_mutex);
+	if (shared_output && strcmp(shared_output->device, device) == 0) {
+		shared_output->refs++;
+		data = shared_output;
+	} else {
+		data = pulseaudio_output_create(device, "Audio Monitoring",
+						true);
+		if (data)
+			shared_output = data;
+	}
+	pthread_mutex_unlock(&shared_output_mutex);
+
+	return data;
+}
+
+static void pulseaudio_output_release(struct pulse_output *data)
+{
+	bool destroy = true;
+
+	if (data->shared) {
+		pthread_mutex_lock(&shared_output_mutex);
+		destroy = --data->refs == 0;
+		if (destroy && shared_output == data)
+			shared_output = NULL;
+		pthread_mutex_unlock(&shared_output_mutex);
+	}
+
+	if (destroy)
+		pulseaudio_output_free(data);
+}
+
+static bool audio_monitor_init(struct audio_monitor *monitor,
+			       obs_source_t *source)
+{
+	monitor->source = source;
+
+	const char *id = obs->audio.monitoring_device_id;
+	if (!id)
 		return false;
+
+	if (source->info.output_flags & OBS_SOURCE_DO_NOT_SELF_MONITOR) {
+		obs_data_t *s = obs_source_get_settings(source);
+		const char *s_dev_id = obs_data_get_string(s, "device_id");
+		bool match = devices_match(s_dev_id, id);
+		obs_data_release(s);
+
+		if (match) {
+			monitor->ignore = true;
+			blog(LOG_INFO, "Prevented feedback-loop in '%s'",
+			     s_dev_id);
+			return true;
+		}
 	}
 
-	monitor->bytesRemaining = monitor->attr.maxlength;
+	pulseaudio_init();
+
+	char *device = NULL;
+	if (strcmp(id, "default") == 0)
+		get_default_id(&device);
+	else
+		device = bstrdup(id);
 
-	blog(LOG_INFO, "Started Monitoring in '%s'", monitor->device);
+	if (!device)
+		return false;
+
+	monitor->output = pulseaudio_output_get(device, source);
+	bfree(device);
+
+	if (!monitor->output)
+		return false;
+
+	const struct audio_output_info *info =
+		audio_output_get_info(obs->audio.audio);
+	size_t frame_size;
+
+	monitor->channels = audio_output_get_channels(obs->audio.audio);
+	frame_size = monitor->channels * sizeof(float);
+
+	if (!spsc_ring_init(&monitor->ring, info->samples_per_sec *
+						    MONITOR_RING_MS / 1000 *
+						    frame_size)) {
+		blog(LOG_WARNING, "%s: %s", __FUNCTION__,
+		     "Failed to create ring buffer");
+		return false;
+	}
+
+	monitor->buffer = bmalloc(MONITOR_CHUNK_FRAMES * frame_size);
 	return true;
 }
 
@@ -516,14 +707,31 @@ static void audio_monitor_init_final(struct audio_monitor *monitor)
 	if (monitor->ignore)
 		return;
 
+	pulseaudio_lock();
+	da_push_back(monitor->output->monitors, &monitor);
+	pulseaudio_unlock();
+
 	obs_source_add_audio_capture_callback(monitor->source,
 					      on_audio_playback, monitor);
+}
 
-	pulseaudio_write_callback(monitor->stream, pulseaudio_stream_write,
-				  (void *)monitor);
+static void audio_monitor_log_stats(struct audio_monitor *monitor)
+{
+	double avg = monitor->packets
+			     ? (double)monitor->playback_ns /
+				       (double)monitor->packets / 1000.0
+			     : 0.0;
 
-	pulseaudio_set_underflow_callback(monitor->stream, pulseaudio_underflow,
-					  (void *)monitor);
+	blog(LOG_INFO,
+	     "Got %" PRIuFAST32 " packets with %" PRIuFAST64
+	     " frames for '%s', %" PRIuFAST64 " frames dropped",
+	     monitor->packets, monitor->frames,
+	     obs_source_get_name(monitor->source), monitor->dropped);
+	blog(LOG_INFO,
+	     "Monitoring took %.3f ms of the audio thread "
+	     "(%.1f us average, %.1f us max)",
+	     (double)monitor->playback_ns / 1000000.0, avg,
+	     (double)monitor->max_playback_ns / 1000.0);
 }
 
 static inline void audio_monitor_free(struct audio_monitor *monitor)
@@ -535,14 +743,19 @@ static inline void audio_monitor_free(struct audio_monitor *monitor)
 		obs_source_remove_audio_capture_callback(
 			monitor->source, on_audio_playback, monitor);
 
-	audio_resampler_destroy(monitor->resampler);
-	circlebuf_free(&monitor->new_data);
+	if (monitor->output) {
+		/* the mainloop holds the lock while it reads the rings */
+		pulseaudio_lock();
+		da_erase_item(monitor->output->monitors, &monitor);
+		pulseaudio_unlock();
 
-	if (monitor->stream)
-		pulseaudio_stop_playback(monitor);
-	pulseaudio_unref();
+		pulseaudio_output_release(monitor->output);
+		audio_monitor_log_stats(monitor);
+	}
 
-	bfree(monitor->device);
+	spsc_ring_free(&monitor->ring);
+	bfree(monitor->buffer);
+	pulseaudio_unref();
 }
 
 struct audio_monitor *audio_monitor_create(obs_source_t *source)
@@ -570,18 +783,20 @@ fail:
 void audio_monitor_reset(struct audio_monitor *monitor)
 {
 	struct audio_monitor new_monitor = {0};
-	bool success;
-	audio_monitor_free(monitor);
+	obs_source_t *source = monitor->source;
 
-	pthread_mutex_lock(&monitor->playback_mutex);
-	success = audio_monitor_init(&new_monitor, monitor->source);
-	pthread_mutex_unlock(&monitor->playback_mutex);
+	audio_monitor_free(monitor);
 
-	if (success) {
+	if (audio_monitor_init(&new_monitor, source)) {
 		*monitor = new_monitor;
 		audio_monitor_init_final(monitor);
 	} else {
 		audio_monitor_free(&new_monitor);
+
+		/* leave nothing for audio_monitor_destroy to free twice */
+		memset(monitor, 0, sizeof(*monitor));
+		monitor->source = source;
+		monitor->ignore = true;
 	}
 }
 
@@ -19,6 +19,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <pthread.h>
 
 #include <pulse/thread-mainloop.h>
+#include <pulse/rtclock.h>
 
 #include <util/base.h>
 #include <obs.h>
@@ -346,3 +347,30 @@ void pulseaudio_set_underflow_callback(pa_stream *p, pa_stream_notify_cb_t cb,
 	pa_stream_set_underflow_callback(p, cb, userdata);
 	pulseaudio_unlock();
 }
+
+pa_time_event *pulseaudio_timer_new(pa_usec_t usec, pa_time_event_cb_t cb,
+				    void *userdata)
+{
+	if (pulseaudio_context_ready() < 0)
+		return NULL;
+
+	pulseaudio_lock();
+	pa_time_event *e = pa_context_rttime_new(
+		pulseaudio_context, pa_rtclock_now() + usec, cb, userdata);
+	pulseaudio_unlock();
+
+	return e;
+}
+
+void pulseaudio_timer_restart(pa_time_event *e, pa_usec_t usec)
+{
+	pa_context_rttime_restart(pulseaudio_context, e,
+				  pa_rtclock_now() + usec);
+}
+
+void pulseaudio_timer_free(pa_time_event *e)
+{
+	pulseaudio_lock();
+	pa_threaded_mainloop_get_api(pulseaudio_mainloop)->time_free(e);
+	pulseaudio_unlock();
+}
@@ -184,3 +184,34 @@ void pulseaudio_write_callback(pa_stream *p, pa_stream_request_cb_t cb,
  */
 void pulseaudio_set_underflow_callback(pa_stream *p, pa_stream_notify_cb_t cb,
 				       void *userdata);
+
+/**
+ * Create a timer event on the mainloop
+ *
+ * @param usec time from now until the callback is called
+ * @param cb pa_time_event_cb_t
+ * @param userdata pointer to userdata the callback will be called with
+ *
+ * @note The function will block until the server context is ready.
+ *
+ * @warning call without active locks
+ */
+pa_time_event *pulseaudio_timer_new(pa_usec_t usec, pa_time_event_cb_t cb,
+				    void *userdata);
+
+/**
+ * Rearm a timer event, usually from within its own callback
+ *
+ * @param e the timer event
+ * @param usec time from now until the callback is called again
+ *
+ * @warning only call from mainloop callbacks or with the mainloop locked
+ */
+void pulseaudio_timer_restart(pa_time_event *e, pa_usec_t usec);
+
+/**
+ * Free a timer event, after this the callback is no longer called
+ *
+ * @warning call without active locks
+ */
+void pulseaudio_timer_free(pa_time_event *e);
@@ -68,10 +68,14 @@ static inline const char *cd_serialize_string(uint8_t **pos)
 static bool cd_getparam(const calldata_t *data, const char *name, uint8_t **pos)
 {
 	size_t name_size;
+	size_t len;
 
 	if (!data->size)
 		return false;
 
+	/* names are stored with their sizes, so only names of the same length
+	 * need to be compared at all */
+	len = strlen(name) + 1;
 	*pos = data->stack;
 
 	name_size = cd_serialize_size(pos);
@@ -80,7 +84,7 @@ static bool cd_getparam(const calldata_t *data, const char *name, uint8_t **pos)
 		size_t param_size;
 
 		*pos += name_size;
-		if (strcmp(param_name, name) == 0)
+		if (name_size == len && memcmp(param_name, name, len) == 0)
 			return true;
 
 		param_size = cd_serialize_size(pos);
@@ -16,35 +16,94 @@
 
 #include "../util/darray.h"
 #include "../util/threading.h"
+#include "../util/platform.h"
 
 #include "decl.h"
 #include "signal.h"
 
+/*
+ *   Callbacks are stored in immutable arrays.  Connecting or disconnecting
+ * builds a new array and swaps it in, while emits that are already in progress
+ * keep iterating over the array they started with.  The signal mutex is only
+ * held to swap arrays or to take/release a reference to one, never while
+ * callbacks run, so emitting never waits on connects, disconnects or other
+ * emits of the same signal.
+ */
+
 struct signal_callback {
 	signal_callback_t callback;
 	void *data;
-	bool remove;
+	long id;
+	volatile bool remove;
 	bool keep_ref;
 };
 
+struct callback_array {
+	struct callback_array *next;
+	long refs;
+	size_t num;
+	struct signal_callback *callbacks;
+};
+
+#define SIGNAL_HASH_SIZE 32
+
 struct signal_info {
 	struct decl_info func;
-	DARRAY(struct signal_callback) callbacks;
+	uint32_t hash;
+
 	pthread_mutex_t mutex;
-	bool signalling;
+	struct callback_array *callbacks;
+	struct callback_array *retired;
+	long next_id;
 
 	struct signal_info *next;
 };
 
+static inline uint32_t signal_name_hash(const char *name)
+{
+	uint32_t hash = 2166136261U;
+
+	while (*name) {
+		hash ^= (uint8_t)*(name++);
+		hash *= 16777619U;
+	}
+
+	return hash;
+}
+
+static struct callback_array *callback_array_create(size_t num)
+{
+	struct callback_array *array =
+		bmalloc(sizeof(struct callback_array) +
+			sizeof(struct signal_callback) * num);
+
+	array->next = NULL;
+	array->refs = 0;
+	array->num = num;
+	array->callbacks = (struct signal_callback *)(array + 1);
+	return array;
+}
+
+static inline size_t callback_array_find(const struct callback_array *array,
+					 long id)
+{
+	if (array) {
+		for (size_t i = 0; i < array->num; i++) {
+			if (array->callbacks[i].id == id)
+				return i;
+		}
+	}
+
+	return DARRAY_INVALID;
+}
+
 static inline struct signal_info *signal_info_create(struct decl_info *info)
 {
-	struct signal_info *si = bmalloc(sizeof(struct signal_info));
+	struct signal_info *si = bzalloc(sizeof(struct signal_info));
 	si->func = *info;
-	si->next = NULL;
-	si->signalling = false;
-	da_init(si->callbacks);
+	si->hash = signal_name_hash(info->name);
 
-	if (pthread_mutex_init_recursive(&si->mutex) != 0) {
+	if (pthread_mutex_init(&si->mutex, NULL) != 0) {
 		blog(LOG_ERROR, "Could not create signal");
 
 		decl_info_free(&si->func);
@@ -58,25 +117,71 @@ static inline struct signal_info *signal_info_create(struct decl_info *info)
 static inline void signal_info_destroy(struct signal_info *si)
 {
 	if (si) {
+		struct callback_array *array = si->retired;
+
+		while (array) {
+			struct callback_array *next = array->next;
+			bfree(array);
+			array = next;
+		}
+
 		pthread_mutex_destroy(&si->mutex);
 		decl_info_free(&si->func);
-		da_free(si->callbacks);
+		bfree(si->callbacks);
 		bfree(si);
 	}
 }
 
-static inline size_t signal_get_callback_idx(struct signal_info *si,
-					     signal_callback_t callback,
-					     void *data)
+/* must be called with the signal mutex locked.  the previous array is freed
+ * right away if no emit is using it, otherwise the last emit to release it
+ * frees it. */
+static void signal_set_callbacks(struct signal_info *si,
+				 struct callback_array *array)
 {
-	for (size_t i = 0; i < si->callbacks.num; i++) {
-		struct signal_callback *sc = si->callbacks.array + i;
+	struct callback_array *prev = si->callbacks;
+
+	si->callbacks = array;
 
-		if (sc->callback == callback && sc->data == data)
-			return i;
+	if (prev && prev->refs) {
+		prev->next = si->retired;
+		si->retired = prev;
+	} else {
+		bfree(prev);
 	}
+}
 
-	return DARRAY_INVALID;
+static struct callback_array *signal_acquire_callbacks(struct signal_info *si)
+{
+	struct callback_array *array;
+
+	pthread_mutex_lock(&si->mutex);
+	array = si->callbacks;
+	if (array)
+		array->refs++;
+	pthread_mutex_unlock(&si->mutex);
+
+	return array;
+}
+
+static void signal_release_callbacks(struct signal_info *si,
+				     struct callback_array *array)
+{
+	if (!array)
+		return;
+
+	pthread_mutex_lock(&si->mutex);
+
+	if (--array->refs == 0 && array != si->callbacks) {
+		struct callback_array **prev = &si->retired;
+
+		while (*prev != array)
+			prev = &(*prev)->next;
+
+		*prev = array->next;
+		bfree(array);
+	}
+
+	pthread_mutex_unlock(&si->mutex);
 }
 
 struct global_callback_info {
@@ -87,7 +192,7 @@ struct global_callback_info {
 };
 
 struct signal_handler {
-	struct signal_info *first;
+	struct signal_info *signals[SIGNAL_HASH_SIZE];
 	pthread_mutex_t mutex;
 	volatile long refs;
 
@@ -96,31 +201,116 @@ struct signal_handler {
 };
 
 static struct signal_info *getsignal(signal_handler_t *handler,
-				     const char *name,
-				     struct signal_info **p_last)
+				     const char *name)
 {
-	struct signal_info *signal, *last = NULL;
+	uint32_t hash = signal_name_hash(name);
+	struct signal_info *signal;
 
-	signal = handler->first;
+	signal = handler->signals[hash % SIGNAL_HASH_SIZE];
 	while (signal != NULL) {
-		if (strcmp(signal->func.name, name) == 0)
+		if (signal->hash == hash &&
+		    strcmp(signal->func.name, name) == 0)
 			break;
 
-		last = signal;
 		signal = signal->next;
 	}
 
-	if (p_last)
-		*p_last = last;
 	return signal;
 }
 
 /* ------------------------------------------------------------------------- */
 
+/* signals currently being emitted on this thread, innermost first */
+struct signal_emit {
+	signal_handler_t *handler;
+	struct signal_info *sig;
+	struct callback_array *callbacks;
+	struct signal_callback *cb;
+	struct signal_emit *prev;
+};
+
+static THREAD_LOCAL struct signal_emit *current_emit = NULL;
+static THREAD_LOCAL struct global_callback_info *current_global_cb = NULL;
+
+static inline bool emitting_on_this_thread(struct signal_info *sig)
+{
+	for (struct signal_emit *emit = current_emit; emit; emit = emit->prev) {
+		if (emit->sig == sig)
+			return true;
+	}
+
+	return false;
+}
+
+static bool signal_in_use(struct signal_info *sig, long id)
+{
+	bool in_use = false;
+
+	pthread_mutex_lock(&sig->mutex);
+
+	if (sig->callbacks && sig->callbacks->refs &&
+	    callback_array_find(sig->callbacks, id) != DARRAY_INVALID)
+		in_use = true;
+
+	for (struct callback_array *array = sig->retired; array && !in_use;
+	     array = array->next) {
+		if (callback_array_find(array, id) != DARRAY_INVALID)
+			in_use = true;
+	}
+
+	pthread_mutex_unlock(&sig->mutex);
+	return in_use;
+}
+
+/* removes a callback by connection id, and returns whether it held a
+ * reference to the handler.  the callback is also flagged in every array that
+ * is still being emitted so that it isn't called again. */
+static bool signal_remove_callback(struct signal_info *sig, long id)
+{
+	struct callback_array *array;
+	bool keep_ref = false;
+	size_t idx;
+
+	pthread_mutex_lock(&sig->mutex);
+
+	idx = callback_array_find(sig->callbacks, id);
+	if (idx == DARRAY_INVALID) {
+		pthread_mutex_unlock(&sig->mutex);
+		return false;
+	}
+
+	keep_ref = sig->callbacks->callbacks[idx].keep_ref;
+
+	for (array = sig->retired; array; array = array->next) {
+		size_t old_idx = callback_array_find(array, id);
+		if (old_idx != DARRAY_INVALID)
+			os_atomic_store_bool(
+				&array->callbacks[old_idx].remove, true);
+	}
+	os_atomic_store_bool(&sig->callbacks->callbacks[idx].remove, true);
+
+	if (sig->callbacks->num == 1) {
+		array = NULL;
+	} else {
+		struct signal_callback *old = sig->callbacks->callbacks;
+
+		array = callback_array_create(sig->callbacks->num - 1);
+		memcpy(array->callbacks, old, sizeof(*old) * idx);
+		memcpy(array->callbacks + idx, old + idx + 1,
+		       sizeof(*old) * (array->num - idx));
+	}
+
+	signal_set_callbacks(sig, array);
+
+	pthread_mutex_unlock(&sig->mutex);
+	return keep_ref;
+}
+
+/* ------------------------------------------------------------------------- */
+
 signal_handler_t *signal_handler_create(void)
 {
 	struct signal_handler *handler = bzalloc(sizeof(struct signal_handler));
-	handler->first = NULL;
 	handler->refs = 1;
 
 	if (pthread_mutex_init(&handler->mutex, NULL) != 0) {
@@ -142,11 +332,13 @@ signal_handler_t *signal_handler_create(void)
 
 static void signal_handler_actually_destroy(signal_handler_t *handler)
 {
-	struct signal_info *sig = handler->first;
-	while (sig != NULL) {
-		struct signal_info *next = sig->next;
-		signal_info_destroy(sig);
-		sig = next;
+	for (size_t i = 0; i < SIGNAL_HASH_SIZE; i++) {
+		struct signal_info *sig = handler->signals[i];
+		while (sig != NULL) {
+			struct signal_info *next = sig->next;
+			signal_info_destroy(sig);
+			sig = next;
+		}
 	}
 
 	da_free(handler->global_callbacks);
@@ -165,7 +357,7 @@ void signal_handler_destroy(signal_handler_t *handler)
 bool signal_handler_add(signal_handler_t *handler, const char *signal_decl)
 {
 	struct decl_info func = {0};
-	struct signal_info *sig, *last;
+	struct signal_info *sig;
 	bool success = true;
 
 	if (!parse_decl_string(&func, signal_decl)) {
@@ -175,17 +367,18 @@ bool signal_handler_add(signal_handler_t *handler, const char *signal_decl)
 
 	pthread_mutex_lock(&handler->mutex);
 
-	sig = getsignal(handler, func.name, &last);
+	sig = getsignal(handler, func.name);
 	if (sig) {
 		blog(LOG_WARNING, "Signal declaration '%s' exists", func.name);
 		decl_info_free(&func);
 		success = false;
 	} else {
 		sig = signal_info_create(&func);
-		if (!last)
-			handler->first = sig;
-		else
-			last->next = sig;
+		if (sig) {
+			size_t bucket = sig->hash % SIGNAL_HASH_SIZE;
+			sig->next = handler->signals[bucket];
+			handler->signals[bucket] = sig;
+		}
 	}
 
 	pthread_mutex_unlock(&handler->mutex);
@@ -193,22 +386,33 @@ bool signal_handler_add(signal_handler_t *handler, const char *signal_decl)
 	return success;
 }
 
+static inline struct signal_info *getsignal_locked(signal_handler_t *handler,
+						   const char *name)
+{
+	struct signal_info *sig;
+
+	if (!handler)
+		return NULL;
+
+	pthread_mutex_lock(&handler->mutex);
+	sig = getsignal(handler, name);
+	pthread_mutex_unlock(&handler->mutex);
+
+	return sig;
+}
+
 static void signal_handler_connect_internal(signal_handler_t *handler,
 					    const char *signal,
 					    signal_callback_t callback,
 					    void *data, bool keep_ref)
 {
-	struct signal_info *sig, *last;
-	struct signal_callback cb_data = {callback, data, false, keep_ref};
-	size_t idx;
+	struct signal_info *sig = getsignal_locked(handler, signal);
+	struct callback_array *array;
+	size_t num;
 
 	if (!handler)
 		return;
 
-	pthread_mutex_lock(&handler->mutex);
-	sig = getsignal(handler, signal, &last);
-	pthread_mutex_unlock(&handler->mutex);
-
 	if (!sig) {
 		blog(LOG_WARNING,
 		     "signal_handler_connect: "
@@ -224,9 +428,32 @@ static void signal_handler_connect_internal(signal_handler_t *handler,
 	if (keep_ref)
 		os_atomic_inc_long(&handler->refs);
 
-	idx = signal_get_callback_idx(sig, callback, data);
-	if (keep_ref || idx == DARRAY_INVALID)
-		da_push_back(sig->callbacks, &cb_data);
+	num = sig->callbacks ? sig->callbacks->num : 0;
+
+	if (!keep_ref) {
+		for (size_t i = 0; i < num; i++) {
+			struct signal_callback *cb =
+				sig->callbacks->callbacks + i;
+
+			if (cb->callback == callback && cb->data == data) {
+				pthread_mutex_unlock(&sig->mutex);
+				return;
+			}
+		}
+	}
+
+	array = callback_array_create(num + 1);
+	if (num)
+		memcpy(array->callbacks, sig->callbacks->callbacks,
+		       sizeof(struct signal_callback) * num);
+
+	array->callbacks[num].callback = callback;
+	array->callbacks[num].data = data;
+	array->callbacks[num].id = ++sig->next_id;
+	array->callbacks[num].remove = false;
+	array->callbacks[num].keep_ref = keep_ref;
+
+	signal_set_callbacks(sig, array);
 
 	pthread_mutex_unlock(&sig->mutex);
 }
@@ -243,94 +470,93 @@ void signal_handler_connect_ref(signal_handler_t *handler, const char *signal,
 	signal_handler_connect_internal(handler, signal, callback, data, true);
 }
 
-static inline struct signal_info *getsignal_locked(signal_handler_t *handler,
-						   const char *name)
-{
-	struct signal_info *sig;
-
-	if (!handler)
-		return NULL;
-
-	pthread_mutex_lock(&handler->mutex);
-	sig = getsignal(handler, name, NULL);
-	pthread_mutex_unlock(&handler->mutex);
-
-	return sig;
-}
-
 void signal_handler_disconnect(signal_handler_t *handler, const char *signal,
 			       signal_callback_t callback, void *data)
 {
 	struct signal_info *sig = getsignal_locked(handler, signal);
-	bool keep_ref = false;
-	size_t idx;
+	bool keep_ref;
+	long id = 0;
 
 	if (!sig)
 		return;
 
 	pthread_mutex_lock(&sig->mutex);
 
-	idx = signal_get_callback_idx(sig, callback, data);
-	if (idx != DARRAY_INVALID) {
-		if (sig->signalling) {
-			sig->callbacks.array[idx].remove = true;
-		} else {
-			keep_ref = sig->callbacks.array[idx].keep_ref;
-			da_erase(sig->callbacks, idx);
+	for (size_t i = 0; sig->callbacks && i < sig->callbacks->num; i++) {
+		struct signal_callback *cb = sig->callbacks->callbacks + i;
+
+		if (cb->callback == callback && cb->data == data) {
+			id = cb->id;
+			break;
 		}
 	}
 
 	pthread_mutex_unlock(&sig->mutex);
 
+	if (!id)
+		return;
+
+	keep_ref = signal_remove_callback(sig, id);
+
+	/* the callback may still be running on another thread, so wait for
+	 * that emit to finish to make it safe to free the callback data.  if
+	 * this thread is inside an emit of the signal itself, waiting could
+	 * deadlock, and the handler must stay alive until the emit returns. */
+	if (emitting_on_this_thread(sig)) {
+		if (keep_ref)
+			os_atomic_dec_long(&handler->refs);
+		return;
+	}
+
+	while (signal_in_use(sig, id))
+		os_sleep_ms(1);
+
 	if (keep_ref && os_atomic_dec_long(&handler->refs) == 0) {
 		signal_handler_actually_destroy(handler);
 	}
 }
 
-static THREAD_LOCAL struct signal_callback *current_signal_cb = NULL;
-static THREAD_LOCAL struct global_callback_info *current_global_cb = NULL;
-
 void signal_handler_remove_current(void)
 {
-	if (current_signal_cb)
-		current_signal_cb->remove = true;
-	else if (current_global_cb)
+	if (current_emit && current_emit->cb) {
+		struct signal_callback *cb = current_emit->cb;
+
+		/* the handler is still referenced by the emit that's calling
+		 * this, so it can't be destroyed here */
+		if (!os_atomic_load_bool(&cb->remove) &&
+		    signal_remove_callback(current_emit->sig, cb->id))
+			os_atomic_dec_long(&current_emit->handler->refs);
+	} else if (current_global_cb) {
 		current_global_cb->remove = true;
+	}
 }
 
 void signal_handler_signal(signal_handler_t *handler, const char *signal,
 			   calldata_t *params)
 {
 	struct signal_info *sig = getsignal_locked(handler, signal);
-	long remove_refs = 0;
+	struct signal_emit emit;
 
 	if (!sig)
 		return;
 
-	pthread_mutex_lock(&sig->mutex);
-	sig->signalling = true;
-
-	for (size_t i = 0; i < sig->callbacks.num; i++) {
-		struct signal_callback *cb = sig->callbacks.array + i;
-		if (!cb->remove) {
-			current_signal_cb = cb;
+	emit.handler = handler;
+	emit.sig = sig;
+	emit.callbacks = signal_acquire_callbacks(sig);
+	emit.cb = NULL;
+	emit.prev = current_emit;
+	current_emit = &emit;
+
+	for (size_t i = 0; emit.callbacks && i < emit.callbacks->num; i++) {
+		struct signal_callback *cb = emit.callbacks->callbacks + i;
+		if (!os_atomic_load_bool(&cb->remove)) {
+			emit.cb = cb;
 			cb->callback(cb->data, params);
-			current_signal_cb = NULL;
+			emit.cb = NULL;
 		}
 	}
 
-	for (size_t i = sig->callbacks.num; i > 0; i--) {
-		struct signal_callback *cb = sig->callbacks.array + i - 1;
-		if (cb->remove) {
-			if (cb->keep_ref)
-				remove_refs++;
-
-			da_erase(sig->callbacks, i - 1);
-		}
-	}
-
-	sig->signalling = false;
-	pthread_mutex_unlock(&sig->mutex);
+	signal_release_callbacks(sig, emit.callbacks);
 
 	pthread_mutex_lock(&handler->global_callbacks_mutex);
 
@@ -359,11 +585,7 @@ void signal_handler_signal(signal_handler_t *handler, const char *signal,
 
 	pthread_mutex_unlock(&handler->global_callbacks_mutex);
 
-	if (remove_refs) {
-		os_atomic_set_long(&handler->refs,
-				   os_atomic_load_long(&handler->refs) -
-					   remove_refs);
-	}
+	current_emit = emit.prev;
 }
 
 void signal_handler_connect_global(signal_handler_t *handler,
@@ -127,7 +127,7 @@ static void *ffmpeg_image_copy_data_straight(struct ffmpeg_image *info,
 {
 	const size_t linesize = (size_t)info->cx * 4;
 	const size_t totalsize = info->cy * linesize;
-	void *data = bmalloc(totalsize);
+	void *data = bmalloc_tagged(totalsize, BMEM_TAG_IMAGES);
 
 	const size_t src_linesize = frame->linesize[0];
 	if (linesize != src_linesize) {
@@ -176,7 +176,7 @@ static void *ffmpeg_image_reformat_frame(struct ffmpeg_image *info,
 		} else {
 			const size_t linesize = (size_t)info->cx * 4;
 			const size_t totalsize = info->cy * linesize;
-			data = bmalloc(totalsize);
+			data = bmalloc_tagged(totalsize, BMEM_TAG_IMAGES);
 			const size_t src_linesize = frame->linesize[0];
 			const size_t min_line = linesize < src_linesize
 							? linesize
@@ -202,7 +202,8 @@ static void *ffmpeg_image_reformat_frame(struct ffmpeg_image *info,
 		}
 	} else if (!downsize && info->format == AV_PIX_FMT_RGBA64BE) {
 		const size_t dst_linesize = (size_t)info->cx * 4;
-		data = bmalloc(info->cy * dst_linesize);
+		data = bmalloc_tagged(info->cy * dst_linesize,
+				      BMEM_TAG_IMAGES);
 		const size_t src_linesize = frame->linesize[0];
 		const size_t src_min_line = (dst_linesize * 2) < src_linesize
 						    ? (dst_linesize * 2)
@@ -316,7 +317,7 @@ static void *ffmpeg_image_reformat_frame(struct ffmpeg_image *info,
 		}
 
 		const size_t linesize = (size_t)info->cx * 4;
-		data = bmalloc(info->cy * linesize);
+		data = bmalloc_tagged(info->cy * linesize, BMEM_TAG_IMAGES);
 		const uint8_t *src = pointers[0];
 		uint8_t *dst = data;
 		for (size_t y = 0; y < (size_t)info->cy; y++) {
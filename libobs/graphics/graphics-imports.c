@@ -125,6 +125,7 @@ bool load_graphics_imports(struct gs_exports *exports, void *module,
 	GRAPHICS_IMPORT(gs_texture_map);
 	GRAPHICS_IMPORT(gs_texture_unmap);
 	GRAPHICS_IMPORT_OPTIONAL(gs_texture_is_rect);
+	GRAPHICS_IMPORT_OPTIONAL(gs_texture_set_image_region);
 	GRAPHICS_IMPORT(gs_texture_get_obj);
 
 	GRAPHICS_IMPORT(gs_cubetexture_destroy);
@@ -184,6 +184,10 @@ struct gs_exports {
 			       uint32_t *linesize);
 	void (*gs_texture_unmap)(gs_texture_t *tex);
 	bool (*gs_texture_is_rect)(const gs_texture_t *tex);
+	bool (*gs_texture_set_image_region)(gs_texture_t *tex, uint32_t x,
+					    uint32_t y, uint32_t cx,
+					    uint32_t cy, const uint8_t *data,
+					    uint32_t linesize);
 	void *(*gs_texture_get_obj)(const gs_texture_t *tex);
 
 	void (*gs_cubetexture_destroy)(gs_texture_t *cubetex);
@@ -392,4 +396,8 @@ struct graphics_subsystem {
 	DARRAY(struct blend_state) blend_state_stack;
 
 	bool linear_srgb;
+
+	struct gs_atlas *atlas;
 };
+
+extern void gs_atlas_free(struct gs_atlas *atlas);
@@ -36,6 +36,7 @@
 #endif
 
 static THREAD_LOCAL graphics_t *thread_graphics = NULL;
+static char shader_cache_path[512] = {0};
 
 static inline bool gs_obj_valid(const void *obj, const char *f,
 				const char *name)
@@ -182,6 +183,28 @@ static bool graphics_init(struct graphics_subsystem *graphics)
 	return true;
 }
 
+void gs_set_shader_cache_path(const char *path)
+{
+	if (!path) {
+		*shader_cache_path = 0;
+		return;
+	}
+
+	if (strlen(path) >= sizeof(shader_cache_path)) {
+		blog(LOG_WARNING, "gs_set_shader_cache_path: path too long, "
+				  "shader cache disabled");
+		*shader_cache_path = 0;
+		return;
+	}
+
+	strcpy(shader_cache_path, path);
+}
+
+const char *gs_get_shader_cache_path(void)
+{
+	return *shader_cache_path ? shader_cache_path : NULL;
+}
+
 int gs_create(graphics_t **pgraphics, const char *module, uint32_t adapter)
 {
 	int errcode = GS_ERROR_FAIL;
@@ -233,6 +256,8 @@ void gs_destroy(graphics_t *graphics)
 		thread_graphics = graphics;
 		graphics->exports.device_enter_context(graphics->device);
 
+		gs_atlas_free(graphics->atlas);
+
 		while (effect) {
 			struct gs_effect *next = effect->next;
 			gs_effect_actually_destroy(effect);
@@ -2410,6 +2435,22 @@ void gs_texture_unmap(gs_texture_t *tex)
 	graphics->exports.gs_texture_unmap(tex);
 }
 
+bool gs_texture_set_image_region(gs_texture_t *tex, uint32_t x, uint32_t y,
+				 uint32_t cx, uint32_t cy, const uint8_t *data,
+				 uint32_t linesize)
+{
+	graphics_t *graphics = thread_graphics;
+
+	if (!gs_valid_p2("gs_texture_set_image_region", tex, data))
+		return false;
+
+	if (!graphics->exports.gs_texture_set_image_region)
+		return false;
+
+	return graphics->exports.gs_texture_set_image_region(tex, x, y, cx, cy,
+							     data, linesize);
+}
+
 bool gs_texture_is_rect(const gs_texture_t *tex)
 {
 	graphics_t *graphics = thread_graphics;
@@ -517,6 +517,14 @@ EXPORT void gs_enum_adapters(bool (*callback)(void *param, const char *name,
 					      uint32_t id),
 			     void *param);
 
+/**
+ * Sets the directory used by the graphics module to cache compiled shader
+ * programs between sessions.  Must be called before gs_create to take effect.
+ * Passing NULL or an empty string disables the cache.
+ */
+EXPORT void gs_set_shader_cache_path(const char *path);
+EXPORT const char *gs_get_shader_cache_path(void);
+
 EXPORT int gs_create(graphics_t **graphics, const char *module,
 		     uint32_t adapter);
 EXPORT void gs_destroy(graphics_t *graphics);
@@ -774,6 +782,15 @@ EXPORT void gs_texture_unmap(gs_texture_t *tex);
  * GL_TEXTURE_RECTANGLE type, which doesn't use normalized texture
  * coordinates, doesn't support mipmapping, and requires address clamping */
 EXPORT bool gs_texture_is_rect(const gs_texture_t *tex);
+/**
+ * Updates a rectangle of a dynamic texture without uploading the rest of it.
+ * data points at the first pixel of the rectangle.  Returns false if the
+ * graphics subsystem cannot update part of a texture, in which case the whole
+ * image has to be set with gs_texture_set_image.
+ */
+EXPORT bool gs_texture_set_image_region(gs_texture_t *tex, uint32_t x,
+					uint32_t y, uint32_t cx, uint32_t cy,
+					const uint8_t *data, uint32_t linesize);
 /**
  * Gets a pointer to the context-specific object associated with the texture.
  * For example, for GL, this is a GLuint*.  For D3D11, ID3D11Texture2D*.
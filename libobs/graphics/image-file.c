@@ -18,6 +18,8 @@
 #include "image-file.h"
 #include "../util/base.h"
 #include "../util/platform.h"
+#include "../util/threading.h"
+#include "../util/task.h"
 #include "vec4.h"
 
 #define blog(level, format, ...) \
@@ -25,7 +27,7 @@
 
 static void *bi_def_bitmap_create(int width, int height)
 {
-	return bmalloc((size_t)4 * width * height);
+	return bmalloc_tagged((size_t)4 * width * height, BMEM_TAG_IMAGES);
 }
 
 static void bi_def_bitmap_set_opaque(void *bitmap, bool opaque)
@@ -55,6 +57,371 @@ static void bi_def_bitmap_modified(void *bitmap)
 	UNUSED_PARAMETER(bitmap);
 }
 
+/* animated gif frames are decoded ahead of playback on a task queue shared
+ * by all gifs and stored as 8-bit palette indices, which is a quarter of the
+ * size of the decoded RGBA frame.  if every frame fits within
+ * GIF_FULL_CACHE_SIZE all frames are kept, otherwise only a window of
+ * GIF_DECODE_WINDOW frames starting at the current frame is kept in
+ * memory. */
+#define GIF_FULL_CACHE_SIZE (64 * 1024 * 1024)
+#define GIF_DECODE_WINDOW 16
+
+struct gif_frame_data {
+	/* palette indices, or RGBA if the frame has more than 256 colors */
+	uint8_t *data;
+	uint32_t palette[256];
+	uint32_t palette_size;
+	bool ready;
+};
+
+struct gs_gif_decoder {
+	gif_animation *gif;
+	enum gs_image_alpha_mode alpha_mode;
+	struct gif_frame_data *frames;
+	unsigned int frame_count;
+	unsigned int window;
+	size_t area;
+	int last_decoded_frame;
+
+	/* held by the owner and by the queued decode task */
+	os_task_queue_t *queue;
+	volatile long refs;
+	volatile bool queued;
+	volatile bool stop;
+	volatile long target_frame;
+
+	/* held while decoding, gif belongs to the image being freed once
+	 * stop is set */
+	pthread_mutex_t decode_mutex;
+	pthread_mutex_t mutex;
+};
+
+static pthread_mutex_t gif_queue_mutex = PTHREAD_MUTEX_INITIALIZER;
+static os_task_queue_t *gif_queue = NULL;
+static long gif_queue_users = 0;
+
+static uint8_t *quantize_frame(const uint32_t *pixels, size_t area,
+			       uint32_t *palette, uint32_t *palette_size)
+{
+	/* open addressed color -> index table, twice the max palette size */
+	uint32_t keys[512];
+	int16_t values[512];
+	uint8_t *indices = bmalloc(area);
+	uint32_t count = 0;
+
+	memset(values, 0xFF, sizeof(values));
+
+	for (size_t i = 0; i < area; i++) {
+		uint32_t color = pixels[i];
+		uint32_t slot = (color * 2654435761U) >> 23;
+
+		while (values[slot] >= 0 && keys[slot] != color)
+			slot = (slot + 1) & 511;
+
+		if (values[slot] < 0) {
+			if (count == 256) {
+				bfree(indices);
+				*palette_size = 0;
+				return NULL;
+			}
+
+			keys[slot] = color;
+			values[slot] = (int16_t)count;
+			palette[count++] = color;
+		}
+
+		indices[i] = (uint8_t)values[slot];
+	}
+
+	*palette_size = count;
+	return indices;
+}
+
+static void expand_frame(uint32_t *dst, const uint8_t *src,
+			 const uint32_t *palette, size_t area)
+{
+	size_t i = 0;
+
+	for (; i + 4 <= area; i += 4) {
+		dst[i] = palette[src[i]];
+		dst[i + 1] = palette[src[i + 1]];
+		dst[i + 2] = palette[src[i + 2]];
+		dst[i + 3] = palette[src[i + 3]];
+	}
+	for (; i < area; i++)
+		dst[i] = palette[src[i]];
+}
+
+/* stores the frame currently decoded into gif->frame_image */
+static void gif_decoder_store_frame(struct gs_gif_decoder *dec,
+				    unsigned int frame)
+{
+	struct gif_frame_data data = {0};
+	uint32_t *pixels = dec->gif->frame_image;
+
+	if (dec->alpha_mode == GS_IMAGE_ALPHA_PREMULTIPLY_SRGB)
+		gs_premultiply_xyza_srgb_loop((uint8_t *)pixels, dec->area);
+	else if (dec->alpha_mode == GS_IMAGE_ALPHA_PREMULTIPLY)
+		gs_premultiply_xyza_loop((uint8_t *)pixels, dec->area);
+
+	data.data = quantize_frame(pixels, dec->area, data.palette,
+				   &data.palette_size);
+	if (!data.data)
+		data.data = bmemdup(pixels, dec->area * 4);
+	data.ready = true;
+
+	pthread_mutex_lock(&dec->mutex);
+	bfree(dec->frames[frame].data);
+	dec->frames[frame] = data;
+	pthread_mutex_unlock(&dec->mutex);
+}
+
+static inline unsigned int frame_distance(struct gs_gif_decoder *dec,
+					  unsigned int frame,
+					  unsigned int target)
+{
+	return (frame + dec->frame_count - target) % dec->frame_count;
+}
+
+static void gif_decoder_evict(struct gs_gif_decoder *dec, unsigned int target)
+{
+	if (dec->window == dec->frame_count)
+		return;
+
+	for (unsigned int i = 0; i < dec->frame_count; i++) {
+		struct gif_frame_data *frame = &dec->frames[i];
+		if (!frame->ready ||
+		    frame_distance(dec, i, target) < dec->window)
+			continue;
+
+		pthread_mutex_lock(&dec->mutex);
+		bfree(frame->data);
+		frame->data = NULL;
+		frame->ready = false;
+		pthread_mutex_unlock(&dec->mutex);
+	}
+}
+
+static void gif_decoder_decode(struct gs_gif_decoder *dec, unsigned int frame,
+			       unsigned int target)
+{
+	/* frames are composited on top of each other, so they have to be
+	 * decoded in order.  if looped, start again from frame 0 */
+	int start = ((int)frame <= dec->last_decoded_frame)
+			    ? 0
+			    : dec->last_decoded_frame + 1;
+
+	for (unsigned int i = (unsigned int)start; i <= frame; i++) {
+		if (gif_decode_frame(dec->gif, i) != GIF_OK) {
+			blog(LOG_WARNING, "Couldn't decode frame %u", i);
+
+			/* skip the frame rather than retrying it forever */
+			pthread_mutex_lock(&dec->mutex);
+			dec->frames[frame].ready = true;
+			pthread_mutex_unlock(&dec->mutex);
+			dec->last_decoded_frame = -1;
+			return;
+		}
+
+		dec->last_decoded_frame = (int)i;
+
+		if (!dec->frames[i].ready &&
+		    frame_distance(dec, i, target) < dec->window)
+			gif_decoder_store_frame(dec, i);
+	}
+}
+
+/* decodes the next missing frame of the window, returns false if the
+ * whole window is decoded */
+static bool gif_decoder_step(struct gs_gif_decoder *dec, unsigned int target)
+{
+	gif_decoder_evict(dec, target);
+
+	for (unsigned int i = 0; i < dec->window; i++) {
+		unsigned int frame = (target + i) % dec->frame_count;
+		if (!dec->frames[frame].ready) {
+			gif_decoder_decode(dec, frame, target);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static void gif_decoder_release(struct gs_gif_decoder *dec)
+{
+	if (os_atomic_dec_long(&dec->refs) != 0)
+		return;
+
+	for (unsigned int i = 0; i < dec->frame_count; i++)
+		bfree(dec->frames[i].data);
+	bfree(dec->frames);
+
+	pthread_mutex_destroy(&dec->decode_mutex);
+	pthread_mutex_destroy(&dec->mutex);
+	bfree(dec);
+}
+
+/* decodes one frame per run so that gifs sharing the queue take turns */
+static void gif_decoder_task(void *param)
+{
+	struct gs_gif_decoder *dec = param;
+	unsigned int target;
+	bool more = false;
+
+	pthread_mutex_lock(&dec->decode_mutex);
+	target = (unsigned int)os_atomic_load_long(&dec->target_frame);
+	if (!os_atomic_load_bool(&dec->stop))
+		more = gif_decoder_step(dec, target);
+	pthread_mutex_unlock(&dec->decode_mutex);
+
+	if (more) {
+		os_task_queue_queue_task(dec->queue, gif_decoder_task, dec);
+		return;
+	}
+
+	os_atomic_set_bool(&dec->queued, false);
+
+	/* a request made during the step saw the task as still queued */
+	if (!os_atomic_load_bool(&dec->stop) &&
+	    (unsigned int)os_atomic_load_long(&dec->target_frame) != target &&
+	    !os_atomic_set_bool(&dec->queued, true)) {
+		os_task_queue_queue_task(dec->queue, gif_decoder_task, dec);
+		return;
+	}
+
+	gif_decoder_release(dec);
+}
+
+static os_task_queue_t *gif_queue_add_user(void)
+{
+	os_task_queue_t *queue;
+
+	pthread_mutex_lock(&gif_queue_mutex);
+	if (!gif_queue)
+		gif_queue = os_task_queue_create();
+	if (gif_queue)
+		gif_queue_users++;
+	queue = gif_queue;
+	pthread_mutex_unlock(&gif_queue_mutex);
+
+	return queue;
+}
+
+static void gif_queue_remove_user(void)
+{
+	os_task_queue_t *queue = NULL;
+
+	pthread_mutex_lock(&gif_queue_mutex);
+	if (--gif_queue_users == 0) {
+		queue = gif_queue;
+		gif_queue = NULL;
+	}
+	pthread_mutex_unlock(&gif_queue_mutex);
+
+	/* runs the remaining tasks before the queue thread exits */
+	os_task_queue_destroy(queue);
+}
+
+static struct gs_gif_decoder *
+gif_decoder_create(gs_image_file_t *image, const char *path,
+		   uint64_t *mem_usage, enum gs_image_alpha_mode alpha_mode)
+{
+	struct gs_gif_decoder *dec = bzalloc(sizeof(struct gs_gif_decoder));
+	size_t area = (size_t)image->gif.width * image->gif.height;
+	uint64_t full_size = (uint64_t)area * image->gif.frame_count;
+
+	dec->gif = &image->gif;
+	dec->alpha_mode = alpha_mode;
+	dec->area = area;
+	dec->frame_count = image->gif.frame_count;
+	dec->window = full_size <= GIF_FULL_CACHE_SIZE ? dec->frame_count
+						       : GIF_DECODE_WINDOW;
+	if (dec->window > dec->frame_count)
+		dec->window = dec->frame_count;
+	dec->frames = bzalloc_tagged(dec->frame_count * sizeof(*dec->frames),
+				     BMEM_TAG_IMAGES);
+	dec->last_decoded_frame = 0;
+	dec->refs = 1;
+
+	if (mem_usage) {
+		*mem_usage += dec->frame_count * sizeof(*dec->frames);
+		*mem_usage += (uint64_t)area * dec->window;
+	}
+
+	pthread_mutex_init_value(&dec->decode_mutex);
+	pthread_mutex_init_value(&dec->mutex);
+	if (pthread_mutex_init(&dec->decode_mutex, NULL) != 0)
+		goto fail;
+	if (pthread_mutex_init(&dec->mutex, NULL) != 0)
+		goto fail;
+	dec->queue = gif_queue_add_user();
+	if (!dec->queue)
+		goto fail;
+
+	/* frame 0 was decoded when the gif was opened */
+	gif_decoder_store_frame(dec, 0);
+	return dec;
+
+fail:
+	blog(LOG_WARNING, "Failed to start decoder for '%s'", path);
+	gif_decoder_release(dec);
+	return NULL;
+}
+
+static void gif_decoder_destroy(struct gs_gif_decoder *dec)
+{
+	if (!dec)
+		return;
+
+	/* once a running step is done the task no longer touches the gif */
+	os_atomic_set_bool(&dec->stop, true);
+	pthread_mutex_lock(&dec->decode_mutex);
+	pthread_mutex_unlock(&dec->decode_mutex);
+
+	gif_decoder_release(dec);
+	gif_queue_remove_user();
+}
+
+static void gif_decoder_request(struct gs_gif_decoder *dec, int frame)
+{
+	if (!dec)
+		return;
+
+	os_atomic_set_long(&dec->target_frame, frame);
+
+	if (!os_atomic_set_bool(&dec->queued, true)) {
+		os_atomic_inc_long(&dec->refs);
+		os_task_queue_queue_task(dec->queue, gif_decoder_task, dec);
+	}
+}
+
+/* expands a decoded frame to RGBA, returns false if it is not ready yet */
+static bool gif_decoder_expand(struct gs_gif_decoder *dec, int frame,
+			       uint8_t *rgba)
+{
+	struct gif_frame_data *data;
+	bool success = false;
+
+	if (!dec)
+		return false;
+
+	pthread_mutex_lock(&dec->mutex);
+
+	data = &dec->frames[frame];
+	if (data->ready && data->data) {
+		if (data->palette_size)
+			expand_frame((uint32_t *)rgba, data->data,
+				     data->palette, dec->area);
+		else
+			memcpy(rgba, data->data, dec->area * 4);
+		success = true;
+	}
+
+	pthread_mutex_unlock(&dec->mutex);
+	return success;
+}
+
 static inline int get_full_decoded_gif_size(gs_image_file_t *image)
 {
 	return image->gif.width * image->gif.height * 4 *
@@ -68,7 +435,7 @@ static inline void *alloc_mem(gs_image_file_t *image, uint64_t *mem_usage,
 
 	if (mem_usage)
 		*mem_usage += size;
-	return bzalloc(size);
+	return bzalloc_tagged(size, BMEM_TAG_IMAGES);
 }
 
 static bool init_animated_gif(gs_image_file_t *image, const char *path,
@@ -100,7 +467,7 @@ static bool init_animated_gif(gs_image_file_t *image, const char *path,
 	size = (size_t)os_ftelli64(file);
 	fseek(file, 0, SEEK_SET);
 
-	image->gif_data = bmalloc(size);
+	image->gif_data = bmalloc_tagged(size, BMEM_TAG_IMAGES);
 	size_read = fread(image->gif_data, 1, size, file);
 	if (size_read != size) {
 		blog(LOG_WARNING, "Failed to fully read gif file '%s'.", path);
@@ -135,41 +502,30 @@ static bool init_animated_gif(gs_image_file_t *image, const char *path,
 
 	image->is_animated_gif = (image->gif.frame_count > 1 && result >= 0);
 	if (image->is_animated_gif) {
-		gif_decode_frame(&image->gif, 0);
-
-		image->animation_frame_cache =
-			alloc_mem(image, mem_usage,
-				  image->gif.frame_count * sizeof(uint8_t *));
-		image->animation_frame_data = alloc_mem(
-			image, mem_usage, get_full_decoded_gif_size(image));
-
-		for (unsigned int i = 0; i < image->gif.frame_count; i++) {
-			if (gif_decode_frame(&image->gif, i) != GIF_OK)
-				blog(LOG_WARNING,
-				     "Couldn't decode frame %u "
-				     "of '%s'",
-				     i, path);
+		if (gif_decode_frame(&image->gif, 0) != GIF_OK) {
+			blog(LOG_WARNING, "Couldn't decode first frame of '%s'",
+			     path);
+			goto fail;
 		}
 
-		gif_decode_frame(&image->gif, 0);
-
 		image->cx = (uint32_t)image->gif.width;
 		image->cy = (uint32_t)image->gif.height;
 		image->format = GS_RGBA;
 
+		image->gif_decoder =
+			gif_decoder_create(image, path, mem_usage, alpha_mode);
+		if (!image->gif_decoder)
+			goto fail;
+
+		image->animation_frame_data = alloc_mem(
+			image, mem_usage, (size_t)4 * image->cx * image->cy);
+		gif_decoder_expand(image->gif_decoder, 0,
+				   image->animation_frame_data);
+
 		if (mem_usage) {
 			*mem_usage += (size_t)4 * image->cx * image->cy;
 			*mem_usage += size;
 		}
-
-		if (alpha_mode == GS_IMAGE_ALPHA_PREMULTIPLY_SRGB) {
-			gs_premultiply_xyza_srgb_loop(image->gif.frame_image,
-						      (size_t)image->cx *
-							      image->cy);
-		} else if (alpha_mode == GS_IMAGE_ALPHA_PREMULTIPLY) {
-			gs_premultiply_xyza_loop(image->gif.frame_image,
-						 (size_t)image->cx * image->cy);
-		}
 	} else {
 		gif_finalise(&image->gif);
 		bfree(image->gif_data);
@@ -239,8 +595,8 @@ void gs_image_file_free(gs_image_file_t *image)
 
 	if (image->loaded) {
 		if (image->is_animated_gif) {
+			gif_decoder_destroy(image->gif_decoder);
 			gif_finalise(&image->gif);
-			bfree(image->animation_frame_cache);
 			bfree(image->animation_frame_data);
 		}
 
@@ -274,7 +630,9 @@ void gs_image_file_init_texture(gs_image_file_t *image)
 	if (image->is_animated_gif) {
 		image->texture = gs_texture_create(
 			image->cx, image->cy, image->format, 1,
-			(const uint8_t **)&image->gif.frame_image, GS_DYNAMIC);
+			(const uint8_t **)&image->animation_frame_data,
+			GS_DYNAMIC);
+		image->uploaded_frame = image->cur_frame;
 
 	} else {
 		image->texture = gs_texture_create(
@@ -318,52 +676,8 @@ static inline int calculate_new_frame(gs_image_file_t *image,
 	return new_frame;
 }
 
-static void decode_new_frame(gs_image_file_t *image, int new_frame,
-			     enum gs_image_alpha_mode alpha_mode)
-{
-	if (!image->animation_frame_cache[new_frame]) {
-		int last_frame;
-
-		/* if looped, decode frame 0 */
-		last_frame = (new_frame < image->last_decoded_frame)
-				     ? 0
-				     : image->last_decoded_frame + 1;
-
-		/* decode missed frames */
-		for (int i = last_frame; i < new_frame; i++) {
-			if (gif_decode_frame(&image->gif, i) != GIF_OK)
-				return;
-		}
-
-		/* decode actual desired frame */
-		if (gif_decode_frame(&image->gif, new_frame) == GIF_OK) {
-			const size_t area =
-				(size_t)image->gif.width * image->gif.height;
-			size_t pos = new_frame * area * 4;
-			image->animation_frame_cache[new_frame] =
-				image->animation_frame_data + pos;
-
-			if (alpha_mode == GS_IMAGE_ALPHA_PREMULTIPLY_SRGB) {
-				gs_premultiply_xyza_srgb_loop(
-					image->gif.frame_image, area);
-			} else if (alpha_mode == GS_IMAGE_ALPHA_PREMULTIPLY) {
-				gs_premultiply_xyza_loop(image->gif.frame_image,
-							 area);
-			}
-
-			memcpy(image->animation_frame_cache[new_frame],
-			       image->gif.frame_image, area * 4);
-
-			image->last_decoded_frame = new_frame;
-		}
-	}
-
-	image->cur_frame = new_frame;
-}
-
 static bool gs_image_file_tick_internal(gs_image_file_t *image,
-					uint64_t elapsed_time_ns,
-					enum gs_image_alpha_mode alpha_mode)
+					uint64_t elapsed_time_ns)
 {
 	int loops;
 
@@ -379,57 +693,60 @@ static bool gs_image_file_tick_internal(gs_image_file_t *image,
 			calculate_new_frame(image, elapsed_time_ns, loops);
 
 		if (new_frame != image->cur_frame) {
-			decode_new_frame(image, new_frame, alpha_mode);
+			image->cur_frame = new_frame;
+			gif_decoder_request(image->gif_decoder, new_frame);
 			return true;
 		}
 	}
 
-	return false;
+	/* keep updating until the decoder has caught up with playback */
+	return image->uploaded_frame != image->cur_frame;
 }
 
 bool gs_image_file_tick(gs_image_file_t *image, uint64_t elapsed_time_ns)
 {
-	return gs_image_file_tick_internal(image, elapsed_time_ns, false);
+	return gs_image_file_tick_internal(image, elapsed_time_ns);
 }
 
 bool gs_image_file2_tick(gs_image_file2_t *if2, uint64_t elapsed_time_ns)
 {
-	return gs_image_file_tick_internal(&if2->image, elapsed_time_ns, false);
+	return gs_image_file_tick_internal(&if2->image, elapsed_time_ns);
 }
 
 bool gs_image_file3_tick(gs_image_file3_t *if3, uint64_t elapsed_time_ns)
 {
-	return gs_image_file_tick_internal(&if3->image2.image, elapsed_time_ns,
-					   if3->alpha_mode);
+	return gs_image_file_tick_internal(&if3->image2.image, elapsed_time_ns);
 }
 
-static void
-gs_image_file_update_texture_internal(gs_image_file_t *image,
-				      enum gs_image_alpha_mode alpha_mode)
+static void gs_image_file_update_texture_internal(gs_image_file_t *image)
 {
 	if (!image->is_animated_gif || !image->loaded)
 		return;
 
-	if (!image->animation_frame_cache[image->cur_frame])
-		decode_new_frame(image, image->cur_frame, alpha_mode);
+	gif_decoder_request(image->gif_decoder, image->cur_frame);
+
+	/* if the frame is not decoded yet the previous frame stays visible,
+	 * decoding never happens on the calling thread */
+	if (!gif_decoder_expand(image->gif_decoder, image->cur_frame,
+				image->animation_frame_data))
+		return;
 
-	gs_texture_set_image(image->texture,
-			     image->animation_frame_cache[image->cur_frame],
+	gs_texture_set_image(image->texture, image->animation_frame_data,
 			     image->gif.width * 4, false);
+	image->uploaded_frame = image->cur_frame;
 }
 
 void gs_image_file_update_texture(gs_image_file_t *image)
 {
-	gs_image_file_update_texture_internal(image, false);
+	gs_image_file_update_texture_internal(image);
 }
 
 void gs_image_file2_update_texture(gs_image_file2_t *if2)
 {
-	gs_image_file_update_texture_internal(&if2->image, false);
+	gs_image_file_update_texture_internal(&if2->image);
 }
 
 void gs_image_file3_update_texture(gs_image_file3_t *if3)
 {
-	gs_image_file_update_texture_internal(&if3->image2.image,
-					      if3->alpha_mode);
+	gs_image_file_update_texture_internal(&if3->image2.image);
 }
@@ -24,6 +24,8 @@
 extern "C" {
 #endif
 
+struct gs_gif_decoder;
+
 struct gs_image_file {
 	gs_texture_t *texture;
 	enum gs_color_format format;
@@ -35,15 +37,18 @@ struct gs_image_file {
 
 	gif_animation gif;
 	uint8_t *gif_data;
-	uint8_t **animation_frame_cache;
+	uint8_t **animation_frame_cache; /* deprecated, always NULL */
 	uint8_t *animation_frame_data;
 	uint64_t cur_time;
 	int cur_frame;
 	int cur_loop;
-	int last_decoded_frame;
+	int last_decoded_frame; /* deprecated, unused */
 
 	uint8_t *texture_data;
 	gif_bitmap_callback_vt bitmap_callbacks;
+
+	struct gs_gif_decoder *gif_decoder;
+	int uploaded_frame;
 };
 
 struct gs_image_file2 {
@@ -0,0 +1,419 @@
+/******************************************************************************
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+/*
+ *   Packs small images into shared atlas pages using a shelf allocator.  Each
+ * page is split into horizontal shelves; images are placed in the shelf that
+ * fits them most tightly and freed space is returned to the shelf so it can
+ * be reused by later images.  Empty shelves at the bottom of a page are
+ * released and empty pages are destroyed, so pages repack incrementally as
+ * images come and go.
+ */
+
+#include "../util/darray.h"
+#include "graphics-internal.h"
+#include "texture-atlas.h"
+
+/* each region is surrounded by a border holding a copy of its edge pixels so
+ * that linear filtering never samples a neighbouring region */
+#define ATLAS_PADDING 1
+
+struct atlas_span {
+	uint32_t x;
+	uint32_t cx;
+};
+
+struct atlas_shelf {
+	uint32_t y;
+	uint32_t cy;
+	uint32_t regions;
+	DARRAY(struct atlas_span) free_spans;
+};
+
+struct atlas_page {
+	gs_texture_t *texture;
+	enum gs_color_format format;
+	uint32_t regions;
+	uint32_t next_y;
+	DARRAY(struct atlas_shelf) shelves;
+};
+
+struct gs_atlas_region {
+	struct atlas_page *page;
+	uint32_t x;
+	uint32_t y;
+	uint32_t cx;
+	uint32_t cy;
+};
+
+struct gs_atlas {
+	DARRAY(struct atlas_page *) pages;
+	uint32_t regions;
+	uint64_t region_bytes;
+};
+
+static inline uint64_t format_bytes(enum gs_color_format format, uint32_t cx,
+				    uint32_t cy)
+{
+	return (uint64_t)cx * cy * gs_get_format_bpp(format) / 8;
+}
+
+static struct gs_atlas *get_atlas(void)
+{
+	graphics_t *graphics = gs_get_context();
+	if (!graphics)
+		return NULL;
+
+	if (!graphics->atlas)
+		graphics->atlas = bzalloc(sizeof(struct gs_atlas));
+	return graphics->atlas;
+}
+
+/* ------------------------------------------------------------------------- */
+
+static bool shelf_find_span(const struct atlas_shelf *shelf, uint32_t cx,
+			    size_t *idx)
+{
+	for (size_t i = 0; i < shelf->free_spans.num; i++) {
+		if (shelf->free_spans.array[i].cx >= cx) {
+			*idx = i;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static uint32_t shelf_alloc(struct atlas_shelf *shelf, size_t idx, uint32_t cx)
+{
+	struct atlas_span *span = shelf->free_spans.array + idx;
+	uint32_t x = span->x;
+
+	span->x += cx;
+	span->cx -= cx;
+	if (!span->cx)
+		da_erase(shelf->free_spans, idx);
+
+	shelf->regions++;
+	return x;
+}
+
+static void shelf_free(struct atlas_shelf *shelf, uint32_t x, uint32_t cx)
+{
+	struct atlas_span span = {x, cx};
+	size_t idx = 0;
+
+	while (idx < shelf->free_spans.num &&
+	       shelf->free_spans.array[idx].x < x)
+		idx++;
+
+	da_insert(shelf->free_spans, idx, &span);
+
+	struct atlas_span *spans = shelf->free_spans.array;
+	if (idx + 1 < shelf->free_spans.num &&
+	    spans[idx].x + spans[idx].cx == spans[idx + 1].x) {
+		spans[idx].cx += spans[idx + 1].cx;
+		da_erase(shelf->free_spans, idx + 1);
+	}
+	if (idx > 0 && spans[idx - 1].x + spans[idx - 1].cx == spans[idx].x) {
+		spans[idx - 1].cx += spans[idx].cx;
+		da_erase(shelf->free_spans, idx);
+	}
+
+	shelf->regions--;
+}
+
+/* a shelf may waste at most a quarter of its height on a shorter image,
+ * unless it is empty and would otherwise go unused */
+static inline bool shelf_fits(const struct atlas_shelf *shelf, uint32_t cy)
+{
+	return cy <= shelf->cy &&
+	       (shelf->regions == 0 || cy * 4 >= shelf->cy * 3);
+}
+
+static struct atlas_shelf *page_add_shelf(struct atlas_page *page,
+					  uint32_t cy)
+{
+	if (page->next_y + cy > GS_ATLAS_PAGE_SIZE)
+		return NULL;
+
+	struct atlas_shelf *shelf = da_push_back_new(page->shelves);
+	struct atlas_span span = {0, GS_ATLAS_PAGE_SIZE};
+
+	shelf->y = page->next_y;
+	shelf->cy = cy;
+	da_push_back(shelf->free_spans, &span);
+
+	page->next_y += cy;
+	return shelf;
+}
+
+static void page_trim_shelves(struct atlas_page *page)
+{
+	while (page->shelves.num) {
+		struct atlas_shelf *shelf = da_end(page->shelves);
+		if (shelf->regions)
+			break;
+
+		page->next_y = shelf->y;
+		da_free(shelf->free_spans);
+		da_pop_back(page->shelves);
+	}
+}
+
+static struct atlas_page *page_create(struct gs_atlas *atlas,
+				      enum gs_color_format format)
+{
+	gs_texture_t *tex = gs_texture_create(GS_ATLAS_PAGE_SIZE,
+					      GS_ATLAS_PAGE_SIZE, format, 1,
+					      NULL, 0);
+	if (!tex)
+		return NULL;
+
+	struct atlas_page *page = bzalloc(sizeof(struct atlas_page));
+	page->texture = tex;
+	page->format = format;
+	da_push_back(atlas->pages, &page);
+	return page;
+}
+
+static void page_destroy(struct atlas_page *page)
+{
+	for (size_t i = 0; i < page->shelves.num; i++)
+		da_free(page->shelves.array[i].free_spans);
+	da_free(page->shelves);
+	gs_texture_destroy(page->texture);
+	bfree(page);
+}
+
+static struct atlas_shelf *find_shelf(struct atlas_page *page, uint32_t y)
+{
+	for (size_t i = 0; i < page->shelves.num; i++) {
+		if (page->shelves.array[i].y == y)
+			return page->shelves.array + i;
+	}
+
+	return NULL;
+}
+
+/* ------------------------------------------------------------------------- */
+
+static bool atlas_alloc(struct gs_atlas *atlas, enum gs_color_format format,
+			uint32_t cx, uint32_t cy, struct atlas_page **out_page,
+			uint32_t *x, uint32_t *y)
+{
+	struct atlas_page *best_page = NULL;
+	struct atlas_shelf *best_shelf = NULL;
+	size_t best_span = 0;
+
+	for (size_t i = 0; i < atlas->pages.num; i++) {
+		struct atlas_page *page = atlas->pages.array[i];
+		if (page->format != format)
+			continue;
+
+		for (size_t j = 0; j < page->shelves.num; j++) {
+			struct atlas_shelf *shelf = page->shelves.array + j;
+			size_t span;
+
+			if (!shelf_fits(shelf, cy))
+				continue;
+			if (best_shelf && best_shelf->cy <= shelf->cy)
+				continue;
+			if (!shelf_find_span(shelf, cx, &span))
+				continue;
+
+			best_page = page;
+			best_shelf = shelf;
+			best_span = span;
+		}
+	}
+
+	if (!best_shelf) {
+		for (size_t i = 0; i < atlas->pages.num; i++) {
+			struct atlas_page *page = atlas->pages.array[i];
+			if (page->format != format)
+				continue;
+
+			best_shelf = page_add_shelf(page, cy);
+			if (best_shelf) {
+				best_page = page;
+				break;
+			}
+		}
+	}
+
+	if (!best_shelf) {
+		best_page = page_create(atlas, format);
+		if (!best_page)
+			return false;
+
+		best_shelf = page_add_shelf(best_page, cy);
+	}
+
+	*out_page = best_page;
+	*x = shelf_alloc(best_shelf, best_span, cx);
+	*y = best_shelf->y;
+	best_page->regions++;
+	return true;
+}
+
+static void upload_region(const struct gs_atlas_region *region,
+			  const uint8_t *data)
+{
+	gs_texture_t *page = region->page->texture;
+	uint32_t x = region->x;
+	uint32_t y = region->y;
+	uint32_t cx = region->cx;
+	uint32_t cy = region->cy;
+
+	gs_texture_t *tex = gs_texture_create(cx, cy, region->page->format, 1,
+					      &data, 0);
+	if (!tex)
+		return;
+
+	gs_copy_texture_region(page, x, y, tex, 0, 0, cx, cy);
+
+	gs_copy_texture_region(page, x, y - 1, tex, 0, 0, cx, 1);
+	gs_copy_texture_region(page, x, y + cy, tex, 0, cy - 1, cx, 1);
+	gs_copy_texture_region(page, x - 1, y, tex, 0, 0, 1, cy);
+	gs_copy_texture_region(page, x + cx, y, tex, cx - 1, 0, 1, cy);
+
+	gs_copy_texture_region(page, x - 1, y - 1, tex, 0, 0, 1, 1);
+	gs_copy_texture_region(page, x + cx, y - 1, tex, cx - 1, 0, 1, 1);
+	gs_copy_texture_region(page, x - 1, y + cy, tex, 0, cy - 1, 1, 1);
+	gs_copy_texture_region(page, x + cx, y + cy, tex, cx - 1, cy - 1, 1,
+			       1);
+
+	gs_texture_destroy(tex);
+}
+
+gs_atlas_region_t *gs_atlas_region_create(uint32_t cx, uint32_t cy,
+					  enum gs_color_format format,
+					  const uint8_t *data)
+{
+	struct gs_atlas *atlas = get_atlas();
+	struct atlas_page *page;
+	uint32_t x, y;
+
+	if (!atlas || !data || !cx || !cy)
+		return NULL;
+	if (cx > GS_ATLAS_MAX_REGION_SIZE || cy > GS_ATLAS_MAX_REGION_SIZE)
+		return NULL;
+	if (format == GS_UNKNOWN || gs_is_compressed_format(format))
+		return NULL;
+
+	if (!atlas_alloc(atlas, format, cx + ATLAS_PADDING * 2,
+			 cy + ATLAS_PADDING * 2, &page, &x, &y))
+		return NULL;
+
+	struct gs_atlas_region *region = bzalloc(sizeof(*region));
+	region->page = page;
+	region->x = x + ATLAS_PADDING;
+	region->y = y + ATLAS_PADDING;
+	region->cx = cx;
+	region->cy = cy;
+
+	upload_region(region, data);
+
+	atlas->regions++;
+	atlas->region_bytes += format_bytes(format, cx, cy);
+	return region;
+}
+
+void gs_atlas_region_destroy(gs_atlas_region_t *region)
+{
+	struct gs_atlas *atlas = get_atlas();
+	if (!region || !atlas)
+		return;
+
+	struct atlas_page *page = region->page;
+	struct atlas_shelf *shelf =
+		find_shelf(page, region->y - ATLAS_PADDING);
+
+	if (shelf) {
+		shelf_free(shelf, region->x - ATLAS_PADDING,
+			   region->cx + ATLAS_PADDING * 2);
+		page_trim_shelves(page);
+	}
+
+	atlas->regions--;
+	atlas->region_bytes -=
+		format_bytes(page->format, region->cx, region->cy);
+
+	if (--page->regions == 0) {
+		da_erase_item(atlas->pages, &page);
+		page_destroy(page);
+	}
+
+	bfree(region);
+}
+
+gs_texture_t *gs_atlas_region_get_texture(const gs_atlas_region_t *region)
+{
+	return region ? region->page->texture : NULL;
+}
+
+uint32_t gs_atlas_region_get_width(const gs_atlas_region_t *region)
+{
+	return region ? region->cx : 0;
+}
+
+uint32_t gs_atlas_region_get_height(const gs_atlas_region_t *region)
+{
+	return region ? region->cy : 0;
+}
+
+void gs_atlas_region_draw(const gs_atlas_region_t *region, uint32_t flip)
+{
+	if (!region)
+		return;
+
+	gs_draw_sprite_subregion(region->page->texture, flip, region->x,
+				 region->y, region->cx, region->cy);
+}
+
+void gs_atlas_get_stats(struct gs_atlas_stats *stats)
+{
+	struct gs_atlas *atlas = get_atlas();
+
+	memset(stats, 0, sizeof(*stats));
+	if (!atlas)
+		return;
+
+	stats->pages = (uint32_t)atlas->pages.num;
+	stats->regions = atlas->regions;
+	stats->region_bytes = atlas->region_bytes;
+
+	for (size_t i = 0; i < atlas->pages.num; i++) {
+		struct atlas_page *page = atlas->pages.array[i];
+		stats->page_bytes += format_bytes(
+			page->format, GS_ATLAS_PAGE_SIZE, GS_ATLAS_PAGE_SIZE);
+	}
+}
+
+void gs_atlas_free(struct gs_atlas *atlas)
+{
+	if (!atlas)
+		return;
+
+	if (atlas->regions)
+		blog(LOG_WARNING, "gs_atlas_free: %u atlas regions leaked",
+		     atlas->regions);
+
+	for (size_t i = 0; i < atlas->pages.num; i++)
+		page_destroy(atlas->pages.array[i]);
+	da_free(atlas->pages);
+	bfree(atlas);
+}
@@ -0,0 +1,73 @@
+/******************************************************************************
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include "graphics.h"
+
+/*
+ *   Shared texture atlas for small static images.
+ *
+ *   Regions are packed into large atlas pages so that scenes with many small
+ * images (emotes, badges, icons) do not need a texture per image.  All
+ * functions must be called from within the graphics context.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Largest width/height an image may have to be placed in the atlas */
+#define GS_ATLAS_MAX_REGION_SIZE 256
+/** Width and height of each atlas page */
+#define GS_ATLAS_PAGE_SIZE 2048
+
+struct gs_atlas_region;
+typedef struct gs_atlas_region gs_atlas_region_t;
+
+struct gs_atlas_stats {
+	uint32_t pages;
+	uint32_t regions;
+	/** Video memory used by all atlas pages */
+	uint64_t page_bytes;
+	/** Video memory the regions would use as individual textures */
+	uint64_t region_bytes;
+};
+
+/**
+ * Packs an image into the atlas.  Returns NULL if the image is too large or
+ * its format cannot be placed in an atlas, in which case the caller should
+ * create a regular texture instead.
+ */
+EXPORT gs_atlas_region_t *gs_atlas_region_create(uint32_t cx, uint32_t cy,
+						 enum gs_color_format format,
+						 const uint8_t *data);
+EXPORT void gs_atlas_region_destroy(gs_atlas_region_t *region);
+
+/** Returns the atlas page texture the region was packed into */
+EXPORT gs_texture_t *
+gs_atlas_region_get_texture(const gs_atlas_region_t *region);
+EXPORT uint32_t gs_atlas_region_get_width(const gs_atlas_region_t *region);
+EXPORT uint32_t gs_atlas_region_get_height(const gs_atlas_region_t *region);
+
+/** Draws the region as a sprite, the atlas page must be bound by the caller */
+EXPORT void gs_atlas_region_draw(const gs_atlas_region_t *region,
+				 uint32_t flip);
+
+EXPORT void gs_atlas_get_stats(struct gs_atlas_stats *stats);
+
+#ifdef __cplusplus
+}
+#endif
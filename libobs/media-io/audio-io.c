@@ -209,7 +209,8 @@ static inline void clamp_audio_output(struct audio_output *audio, size_t bytes)
 static void input_and_output(struct audio_output *audio, uint64_t audio_time,
 			     uint64_t prev_time)
 {
-	size_t bytes = AUDIO_OUTPUT_FRAMES * audio->block_size;
+	uint32_t frames = audio->info.frames_per_tick;
+	size_t bytes = frames * audio->block_size;
 	struct audio_output_data data[NUM_RENDERING_MODES][MAX_AUDIO_MIXES];
 	uint32_t active_mixes = 0;
 	uint64_t new_ts = 0;
@@ -268,7 +269,7 @@ static void input_and_output(struct audio_output *audio, uint64_t audio_time,
 
 	/* output */
 	for (size_t i = 0; i < MAX_AUDIO_MIXES; i++)
-		do_audio_output(audio, i, new_ts, AUDIO_OUTPUT_FRAMES);
+		do_audio_output(audio, i, new_ts, frames);
 }
 
 static void *audio_thread(void *param)
@@ -280,13 +281,13 @@ static void *audio_thread(void *param)
 
 	struct audio_output *audio = param;
 	size_t rate = audio->info.samples_per_sec;
+	uint32_t frames = audio->info.frames_per_tick;
 	uint64_t samples = 0;
 	uint64_t start_time = os_gettime_ns();
 	uint64_t prev_time = start_time;
 	uint64_t audio_time = prev_time;
 	uint32_t audio_wait_time =
-		(uint32_t)(audio_frames_to_ns(rate, AUDIO_OUTPUT_FRAMES) /
-			   1000000);
+		(uint32_t)(audio_frames_to_ns(rate, frames) / 1000000);
 
 	os_set_thread_name("audio-io: audio thread");
 
@@ -304,7 +305,7 @@ static void *audio_thread(void *param)
 		cache_multiple_rendering();
 		cur_time = os_gettime_ns();
 		while (audio_time <= cur_time) {
-			samples += AUDIO_OUTPUT_FRAMES;
+			samples += frames;
 			audio_time =
 				start_time + audio_frames_to_ns(rate, samples);
 
@@ -461,10 +462,18 @@ void audio_output_disconnect(audio_t *audio, size_t mix_idx,
 	pthread_mutex_unlock(&audio->input_mutex);
 }
 
+static inline bool valid_frames_per_tick(uint32_t frames)
+{
+	return frames >= AUDIO_OUTPUT_MIN_FRAMES &&
+	       frames <= AUDIO_OUTPUT_FRAMES && (frames & (frames - 1)) == 0;
+}
+
 static inline bool valid_audio_params(const struct audio_output_info *info)
 {
 	return info->format && info->name && info->samples_per_sec > 0 &&
-	       info->speakers > 0;
+	       info->speakers > 0 &&
+	       (!info->frames_per_tick ||
+		valid_frames_per_tick(info->frames_per_tick));
 }
 
 int audio_output_open(audio_t **audio, struct audio_output_info *info)
@@ -480,6 +489,8 @@ int audio_output_open(audio_t **audio, struct audio_output_info *info)
 		goto fail0;
 
 	memcpy(&out->info, info, sizeof(struct audio_output_info));
+	if (!out->info.frames_per_tick)
+		out->info.frames_per_tick = AUDIO_OUTPUT_FRAMES;
 	out->channels = get_audio_channels(info->speakers);
 	out->planes = planar ? out->channels : 1;
 	out->input_cb = info->input_callback;
@@ -584,3 +595,8 @@ uint32_t audio_output_get_sample_rate(const audio_t *audio)
 {
 	return audio ? audio->info.samples_per_sec : 0;
 }
+
+uint32_t audio_output_get_frames_per_tick(const audio_t *audio)
+{
+	return audio ? audio->info.frames_per_tick : 0;
+}
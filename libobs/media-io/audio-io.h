@@ -28,6 +28,7 @@ extern "C" {
 #define MAX_AUDIO_MIXES 6
 #define MAX_AUDIO_CHANNELS 8
 #define AUDIO_OUTPUT_FRAMES 1024
+#define AUDIO_OUTPUT_MIN_FRAMES 256
 
 #define TOTAL_AUDIO_SIZE                                              \
 	(MAX_AUDIO_MIXES * MAX_AUDIO_CHANNELS * AUDIO_OUTPUT_FRAMES * \
@@ -101,6 +102,10 @@ struct audio_output_info {
 
 	audio_input_callback_t input_callback;
 	void *input_param;
+
+	/* frames mixed per tick: 256, 512 or 1024.  0 uses
+	 * AUDIO_OUTPUT_FRAMES */
+	uint32_t frames_per_tick;
 };
 
 struct audio_convert_info {
@@ -229,6 +234,7 @@ EXPORT size_t audio_output_get_block_size(const audio_t *audio);
 EXPORT size_t audio_output_get_planes(const audio_t *audio);
 EXPORT size_t audio_output_get_channels(const audio_t *audio);
 EXPORT uint32_t audio_output_get_sample_rate(const audio_t *audio);
+EXPORT uint32_t audio_output_get_frames_per_tick(const audio_t *audio);
 EXPORT const struct audio_output_info *
 audio_output_get_info(const audio_t *audio);
 
@@ -17,12 +17,14 @@
 
 #include "../util/bmem.h"
 #include "audio-resampler.h"
+#include "audio-resampler-polyphase.h"
 #include "audio-io.h"
 #include <libavutil/avutil.h>
 #include <libavformat/avformat.h>
 #include <libswresample/swresample.h>
 
 struct audio_resampler {
+	struct polyphase_resampler *polyphase;
 	struct SwrContext *context;
 	bool opened;
 
@@ -97,6 +99,12 @@ audio_resampler_t *audio_resampler_create(const struct resample_info *dst,
 	struct audio_resampler *rs = bzalloc(sizeof(struct audio_resampler));
 	int errcode;
 
+	/* plain rate changes are handled natively, swresample is only used
+	 * when remixing or converting the output format */
+	rs->polyphase = polyphase_resampler_create(dst, src);
+	if (rs->polyphase)
+		return rs;
+
 	rs->opened = false;
 	rs->input_freq = src->samples_per_sec;
 	rs->input_layout = convert_speaker_layout(src->speakers);
@@ -151,6 +159,7 @@ audio_resampler_t *audio_resampler_create(const struct resample_info *dst,
 void audio_resampler_destroy(audio_resampler_t *rs)
 {
 	if (rs) {
+		polyphase_resampler_destroy(rs->polyphase);
 		if (rs->context)
 			swr_free(&rs->context);
 		if (rs->output_buffer[0])
@@ -166,6 +175,10 @@ bool audio_resampler_resample(audio_resampler_t *rs, uint8_t *output[],
 {
 	if (!rs)
 		return false;
+	if (rs->polyphase)
+		return polyphase_resampler_resample(rs->polyphase, output,
+						    out_frames, ts_offset,
+						    input, in_frames);
 
 	struct SwrContext *context = rs->context;
 	int ret;
@@ -0,0 +1,402 @@
+/******************************************************************************
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include <math.h>
+#include "../util/bmem.h"
+#include "../util/darray.h"
+#include "../util/threading.h"
+#include "../util/sse-intrin.h"
+#include "audio-resampler-polyphase.h"
+#include "audio-io.h"
+
+#define MAX_PHASES 1024
+#define MAX_DECIMATION 4
+#define BASE_TAPS 32
+#define KAISER_BETA 9.0
+#define CUTOFF 0.97
+#define PREALLOC_FRAMES 4096
+
+/* ------------------------------------------------------------------------- */
+/* shared filter banks */
+
+struct filter_bank {
+	uint32_t phases; /* L, the interpolation factor */
+	uint32_t step;   /* M, the decimation factor */
+	uint32_t taps;
+	float *coeffs;   /* phases * taps */
+	long refs;
+};
+
+static pthread_mutex_t bank_mutex = PTHREAD_MUTEX_INITIALIZER;
+static DARRAY(struct filter_bank *) banks;
+
+static double bessel_i0(double x)
+{
+	double sum = 1.0;
+	double term = 1.0;
+	double half = x * 0.5;
+
+	for (int k = 1; k < 64; k++) {
+		term *= (half / k) * (half / k);
+		sum += term;
+		if (term < sum * 1e-12)
+			break;
+	}
+
+	return sum;
+}
+
+static void build_filter(struct filter_bank *bank)
+{
+	const uint32_t taps = bank->taps;
+	const double center = (double)(taps / 2 - 1);
+	const double half_width = (double)taps / 2.0;
+	const double ratio = (double)bank->phases / (double)bank->step;
+	const double cutoff = CUTOFF * (ratio < 1.0 ? ratio : 1.0);
+	const double norm = bessel_i0(KAISER_BETA);
+
+	for (uint32_t p = 0; p < bank->phases; p++) {
+		float *row = bank->coeffs + (size_t)p * taps;
+		double frac = (double)p / (double)bank->phases;
+		double sum = 0.0;
+
+		for (uint32_t k = 0; k < taps; k++) {
+			double t = (double)k - center - frac;
+			double x = t / half_width;
+			double sinc = 1.0;
+			double window = 0.0;
+
+			if (fabs(t) > 1e-9)
+				sinc = sin(M_PI * cutoff * t) /
+				       (M_PI * cutoff * t);
+			if (x > -1.0 && x < 1.0)
+				window = bessel_i0(KAISER_BETA *
+						   sqrt(1.0 - x * x)) /
+					 norm;
+
+			row[k] = (float)(cutoff * sinc * window);
+			sum += row[k];
+		}
+
+		/* unity gain at DC for every phase */
+		for (uint32_t k = 0; k < taps; k++)
+			row[k] = (float)(row[k] / sum);
+	}
+}
+
+static struct filter_bank *get_filter_bank(uint32_t phases, uint32_t step)
+{
+	struct filter_bank *bank = NULL;
+
+	pthread_mutex_lock(&bank_mutex);
+
+	for (size_t i = 0; i < banks.num; i++) {
+		if (banks.array[i]->phases == phases &&
+		    banks.array[i]->step == step) {
+			bank = banks.array[i];
+			break;
+		}
+	}
+
+	if (!bank) {
+		uint32_t decimation = (step + phases - 1) / phases;
+
+		bank = bzalloc(sizeof(*bank));
+		bank->phases = phases;
+		bank->step = step;
+		bank->taps = BASE_TAPS * (decimation > 1 ? decimation : 1);
+		bank->coeffs = bmalloc(sizeof(float) * phases * bank->taps);
+		build_filter(bank);
+
+		da_push_back(banks, &bank);
+	}
+
+	bank->refs++;
+	pthread_mutex_unlock(&bank_mutex);
+	return bank;
+}
+
+static void release_filter_bank(struct filter_bank *bank)
+{
+	pthread_mutex_lock(&bank_mutex);
+	if (--bank->refs == 0) {
+		da_erase_item(banks, &bank);
+		if (!banks.num)
+			da_free(banks);
+
+		bfree(bank->coeffs);
+		bfree(bank);
+	}
+	pthread_mutex_unlock(&bank_mutex);
+}
+
+/* ------------------------------------------------------------------------- */
+
+struct polyphase_resampler {
+	struct filter_bank *bank;
+
+	enum audio_format input_format;
+	uint32_t input_freq;
+	uint32_t channels;
+
+	/* input history, one buffer per channel, starting with the
+	 * taps / 2 - 1 samples before the current position */
+	float *buffer[MAX_AUDIO_CHANNELS];
+	size_t buffer_count;
+	size_t buffer_size;
+
+	/* the next output sample is at pos + phase / phases in the buffer,
+	 * offset by the filter center */
+	size_t pos;
+	uint32_t phase;
+
+	float *output[MAX_AUDIO_CHANNELS];
+	size_t output_size;
+};
+
+static inline uint32_t gcd(uint32_t a, uint32_t b)
+{
+	while (b) {
+		uint32_t t = a % b;
+		a = b;
+		b = t;
+	}
+	return a;
+}
+
+static void resize_buffers(struct polyphase_resampler *rs, size_t in_frames)
+{
+	const struct filter_bank *bank = rs->bank;
+	size_t size = bank->taps + in_frames;
+	size_t out_size = (size * bank->phases) / bank->step + 1;
+
+	if (size > rs->buffer_size) {
+		for (uint32_t c = 0; c < rs->channels; c++)
+			rs->buffer[c] =
+				brealloc(rs->buffer[c], size * sizeof(float));
+		rs->buffer_size = size;
+	}
+
+	if (out_size > rs->output_size) {
+		for (uint32_t c = 0; c < rs->channels; c++) {
+			bfree(rs->output[c]);
+			rs->output[c] = bmalloc(out_size * sizeof(float));
+		}
+		rs->output_size = out_size;
+	}
+}
+
+struct polyphase_resampler *
+polyphase_resampler_create(const struct resample_info *dst,
+			   const struct resample_info *src)
+{
+	struct polyphase_resampler *rs;
+	uint32_t divisor, phases, step;
+	size_t prefill;
+
+	if (dst->format != AUDIO_FORMAT_FLOAT_PLANAR ||
+	    src->format == AUDIO_FORMAT_UNKNOWN ||
+	    src->speakers == SPEAKERS_UNKNOWN ||
+	    src->speakers != dst->speakers || !src->samples_per_sec ||
+	    !dst->samples_per_sec ||
+	    src->samples_per_sec == dst->samples_per_sec)
+		return NULL;
+
+	divisor = gcd(dst->samples_per_sec, src->samples_per_sec);
+	phases = dst->samples_per_sec / divisor;
+	step = src->samples_per_sec / divisor;
+
+	if (phases > MAX_PHASES || step > phases * MAX_DECIMATION)
+		return NULL;
+
+	rs = bzalloc(sizeof(*rs));
+	rs->bank = get_filter_bank(phases, step);
+	rs->input_format = src->format;
+	rs->input_freq = src->samples_per_sec;
+	rs->channels = get_audio_channels(src->speakers);
+
+	resize_buffers(rs, PREALLOC_FRAMES);
+
+	prefill = rs->bank->taps / 2 - 1;
+	for (uint32_t c = 0; c < rs->channels; c++)
+		memset(rs->buffer[c], 0, prefill * sizeof(float));
+	rs->buffer_count = prefill;
+
+	return rs;
+}
+
+void polyphase_resampler_destroy(struct polyphase_resampler *rs)
+{
+	if (!rs)
+		return;
+
+	for (uint32_t c = 0; c < rs->channels; c++) {
+		bfree(rs->buffer[c]);
+		bfree(rs->output[c]);
+	}
+
+	release_filter_bank(rs->bank);
+	bfree(rs);
+}
+
+/* ------------------------------------------------------------------------- */
+
+static inline float convert_sample(enum audio_format format, const uint8_t *in,
+				   size_t idx)
+{
+	switch (format) {
+	case AUDIO_FORMAT_U8BIT:
+	case AUDIO_FORMAT_U8BIT_PLANAR:
+		return ((float)in[idx] - 128.0f) / 128.0f;
+	case AUDIO_FORMAT_16BIT:
+	case AUDIO_FORMAT_16BIT_PLANAR:
+		return (float)((const int16_t *)in)[idx] / 32768.0f;
+	case AUDIO_FORMAT_32BIT:
+	case AUDIO_FORMAT_32BIT_PLANAR:
+		return (float)((const int32_t *)in)[idx] / 2147483648.0f;
+	case AUDIO_FORMAT_FLOAT:
+	case AUDIO_FORMAT_FLOAT_PLANAR:
+		return ((const float *)in)[idx];
+	case AUDIO_FORMAT_UNKNOWN:
+		break;
+	}
+
+	return 0.0f;
+}
+
+static void append_input(struct polyphase_resampler *rs,
+			 const uint8_t *const input[], uint32_t in_frames)
+{
+	const enum audio_format format = rs->input_format;
+
+	for (uint32_t c = 0; c < rs->channels; c++) {
+		float *out = rs->buffer[c] + rs->buffer_count;
+
+		if (format == AUDIO_FORMAT_FLOAT_PLANAR) {
+			memcpy(out, input[c], in_frames * sizeof(float));
+
+		} else if (is_audio_planar(format)) {
+			for (uint32_t i = 0; i < in_frames; i++)
+				out[i] = convert_sample(format, input[c], i);
+
+		} else {
+			for (uint32_t i = 0; i < in_frames; i++)
+				out[i] = convert_sample(
+					format, input[0],
+					(size_t)i * rs->channels + c);
+		}
+	}
+
+	rs->buffer_count += in_frames;
+}
+
+/* taps is always a multiple of 8 and every filter row is aligned */
+static inline float dot_product(const float *in, const float *coeffs,
+				uint32_t taps)
+{
+	__m128 sum0 = _mm_setzero_ps();
+	__m128 sum1 = _mm_setzero_ps();
+	__m128 shuf;
+	float result;
+
+	for (uint32_t k = 0; k < taps; k += 8) {
+		__m128 in0 = _mm_loadu_ps(in + k);
+		__m128 in1 = _mm_loadu_ps(in + k + 4);
+		__m128 c0 = _mm_load_ps(coeffs + k);
+		__m128 c1 = _mm_load_ps(coeffs + k + 4);
+
+		sum0 = _mm_add_ps(sum0, _mm_mul_ps(in0, c0));
+		sum1 = _mm_add_ps(sum1, _mm_mul_ps(in1, c1));
+	}
+
+	sum0 = _mm_add_ps(sum0, sum1);
+	shuf = _mm_shuffle_ps(sum0, sum0, _MM_SHUFFLE(2, 3, 0, 1));
+	sum0 = _mm_add_ps(sum0, shuf);
+	shuf = _mm_movehl_ps(shuf, sum0);
+	sum0 = _mm_add_ss(sum0, shuf);
+	_mm_store_ss(&result, sum0);
+	return result;
+}
+
+bool polyphase_resampler_resample(struct polyphase_resampler *rs,
+				  uint8_t *output[], uint32_t *out_frames,
+				  uint64_t *ts_offset,
+				  const uint8_t *const input[],
+				  uint32_t in_frames)
+{
+	const struct filter_bank *bank;
+	size_t pos, remaining;
+	uint32_t phase, frames = 0;
+	int64_t delay;
+
+	if (!rs)
+		return false;
+
+	bank = rs->bank;
+	pos = rs->pos;
+	phase = rs->phase;
+
+	/* distance between the next output sample and the start of this
+	 * input, in 1 / phases of an input sample */
+	delay = ((int64_t)rs->buffer_count - (int64_t)rs->pos -
+		 (int64_t)(bank->taps / 2 - 1)) *
+			(int64_t)bank->phases -
+		(int64_t)rs->phase;
+	*ts_offset = (uint64_t)(int64_t)((double)delay * 1000000000.0 /
+					 ((double)bank->phases *
+					  (double)rs->input_freq));
+
+	resize_buffers(rs, in_frames);
+	append_input(rs, input, in_frames);
+
+	for (uint32_t c = 0; c < rs->channels; c++) {
+		const float *in = rs->buffer[c];
+		float *out = rs->output[c];
+
+		pos = rs->pos;
+		phase = rs->phase;
+		frames = 0;
+
+		while (pos + bank->taps <= rs->buffer_count) {
+			const float *coeffs =
+				bank->coeffs + (size_t)phase * bank->taps;
+
+			out[frames++] =
+				dot_product(in + pos, coeffs, bank->taps);
+
+			phase += bank->step;
+			pos += phase / bank->phases;
+			phase %= bank->phases;
+		}
+
+		output[c] = (uint8_t *)out;
+	}
+
+	/* drop the input that is no longer needed by the filter */
+	if (pos > rs->buffer_count)
+		pos = rs->buffer_count;
+	remaining = rs->buffer_count - pos;
+
+	for (uint32_t c = 0; c < rs->channels; c++)
+		memmove(rs->buffer[c], rs->buffer[c] + pos,
+			remaining * sizeof(float));
+
+	rs->buffer_count = remaining;
+	rs->pos = 0;
+	rs->phase = phase;
+
+	*out_frames = frames;
+	return true;
+}
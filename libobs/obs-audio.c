@@ -26,7 +26,6 @@ struct ts_info {
 
 #define DEBUG_AUDIO 0
 #define DEBUG_LAGGED_AUDIO 0
-#define MAX_BUFFERING_TICKS 45
 
 // Cached state of multiple rendering so each run of in audio-io thread work with same state
 static bool audio_multiple_rendering = false;
@@ -63,7 +62,8 @@ static inline void mix_audio(struct audio_output_data *main_mixes,
 			     obs_source_t *source, size_t channels,
 			     size_t sample_rate, struct ts_info *ts)
 {
-	size_t total_floats = AUDIO_OUTPUT_FRAMES;
+	size_t frames = obs->audio.frames_per_tick;
+	size_t total_floats = frames;
 	size_t start_point = 0;
 	enum obs_audio_rendering_mode start =
 		get_cached_multiple_rendering() ? OBS_STREAMING_AUDIO_RENDERING
@@ -79,7 +79,7 @@ static inline void mix_audio(struct audio_output_data *main_mixes,
 	if (source->audio_ts != ts->start) {
 		start_point = convert_time_to_frames(
 			sample_rate, source->audio_ts - ts->start);
-		if (start_point >= AUDIO_OUTPUT_FRAMES)
+		if (start_point >= frames)
 			return;
 
 		total_floats -= start_point;
@@ -262,19 +262,16 @@ static bool discard_if_stopped(obs_source_t *source, size_t channels)
 	}
 }
 
-#define MAX_AUDIO_SIZE (AUDIO_OUTPUT_FRAMES * sizeof(float))
-
 static inline void discard_audio(struct obs_core_audio *audio,
 				 obs_source_t *source, size_t channels,
 				 size_t sample_rate, struct ts_info *ts)
 {
-	size_t total_floats = AUDIO_OUTPUT_FRAMES;
+	size_t frames = audio->frames_per_tick;
+	size_t total_floats = frames;
 	size_t size;
 	enum obs_audio_rendering_mode mode =
 		get_cached_multiple_rendering() ? OBS_STREAMING_AUDIO_RENDERING
 					     : OBS_MAIN_AUDIO_RENDERING;
-	/* debug assert only */
-	UNUSED_PARAMETER(audio);
 
 #if DEBUG_AUDIO == 1
 	bool is_audio_source = source->info.output_flags & OBS_SOURCE_AUDIO;
@@ -299,7 +296,7 @@ static inline void discard_audio(struct obs_core_audio *audio,
 	if (source->audio_ts < (ts->start - 1)) {
 		if (source->audio_pending &&
 		    source->audio_input_buf[mode][0].size <
-			    MAX_AUDIO_SIZE &&
+			    frames * sizeof(float) &&
 		    discard_if_stopped(source, channels))
 			return;
 
@@ -314,7 +311,8 @@ static inline void discard_audio(struct obs_core_audio *audio,
 
 		/* ignore_audio should have already run and marked this source
 		 * pending, unless we *just* added buffering */
-		assert(audio->total_buffering_ticks < MAX_BUFFERING_TICKS ||
+		assert(audio->total_buffering_ticks <
+			       audio->max_buffering_ticks ||
 		       source->audio_pending || !source->audio_ts ||
 		       audio->buffering_wait_ticks);
 #endif
@@ -325,7 +323,7 @@ static inline void discard_audio(struct obs_core_audio *audio,
 	    source->audio_ts != (ts->start - 1)) {
 		size_t start_point = convert_time_to_frames(
 			sample_rate, source->audio_ts - ts->start);
-		if (start_point == AUDIO_OUTPUT_FRAMES) {
+		if (start_point == frames) {
 #if DEBUG_AUDIO == 1
 			if (is_audio_source)
 				blog(LOG_DEBUG, "can't discard, start point is "
@@ -381,7 +379,10 @@ static void add_audio_buffering(struct obs_core_audio *audio,
 	size_t ms;
 	int ticks;
 
-	if (audio->total_buffering_ticks == MAX_BUFFERING_TICKS)
+	size_t frames_per_tick = audio->frames_per_tick;
+	int max_ticks = audio->max_buffering_ticks;
+
+	if (audio->total_buffering_ticks == max_ticks)
 		return;
 
 	if (!audio->buffering_wait_ticks)
@@ -389,18 +390,18 @@ static void add_audio_buffering(struct obs_core_audio *audio,
 
 	offset = ts->start - min_ts;
 	frames = ns_to_audio_frames(sample_rate, offset);
-	ticks = (int)((frames + AUDIO_OUTPUT_FRAMES - 1) / AUDIO_OUTPUT_FRAMES);
+	ticks = (int)((frames + frames_per_tick - 1) / frames_per_tick);
 
 	audio->total_buffering_ticks += ticks;
 
-	if (audio->total_buffering_ticks >= MAX_BUFFERING_TICKS) {
-		ticks -= audio->total_buffering_ticks - MAX_BUFFERING_TICKS;
-		audio->total_buffering_ticks = MAX_BUFFERING_TICKS;
+	if (audio->total_buffering_ticks >= max_ticks) {
+		ticks -= audio->total_buffering_ticks - max_ticks;
+		audio->total_buffering_ticks = max_ticks;
 		blog(LOG_WARNING, "Max audio buffering reached!");
 	}
 
-	ms = ticks * AUDIO_OUTPUT_FRAMES * 1000 / sample_rate;
-	total_ms = audio->total_buffering_ticks * AUDIO_OUTPUT_FRAMES * 1000 /
+	ms = ticks * frames_per_tick * 1000 / sample_rate;
+	total_ms = audio->total_buffering_ticks * frames_per_tick * 1000 /
 		   sample_rate;
 
 	blog(LOG_INFO,
@@ -420,7 +421,7 @@ static void add_audio_buffering(struct obs_core_audio *audio,
 	new_ts.start =
 		audio->buffered_ts -
 		audio_frames_to_ns(sample_rate, audio->buffering_wait_ticks *
-							AUDIO_OUTPUT_FRAMES);
+							frames_per_tick);
 
 	while (ticks--) {
 		const uint64_t cur_ticks = ++audio->buffering_wait_ticks;
@@ -429,7 +430,7 @@ static void add_audio_buffering(struct obs_core_audio *audio,
 		new_ts.start =
 			audio->buffered_ts -
 			audio_frames_to_ns(sample_rate,
-					   cur_ticks * AUDIO_OUTPUT_FRAMES);
+					   cur_ticks * frames_per_tick);
 
 #if DEBUG_AUDIO == 1
 		blog(LOG_DEBUG, "add buffered ts: %" PRIu64 "-%" PRIu64,
@@ -446,7 +447,8 @@ static void add_audio_buffering(struct obs_core_audio *audio,
 static bool audio_buffer_insuffient(struct obs_source *source,
 				    size_t sample_rate, uint64_t min_ts)
 {
-	size_t total_floats = AUDIO_OUTPUT_FRAMES;
+	size_t frames = obs->audio.frames_per_tick;
+	size_t total_floats = frames;
 	size_t size;
 	enum obs_audio_rendering_mode mode =
 		get_cached_multiple_rendering() ? OBS_STREAMING_AUDIO_RENDERING
@@ -460,7 +462,7 @@ static bool audio_buffer_insuffient(struct obs_source *source,
 	if (source->audio_ts != min_ts && source->audio_ts != (min_ts - 1)) {
 		size_t start_point = convert_time_to_frames(
 			sample_rate, source->audio_ts - min_ts);
-		if (start_point >= AUDIO_OUTPUT_FRAMES)
+		if (start_point >= frames)
 			return false;
 
 		total_floats -= start_point;
@@ -565,7 +567,7 @@ bool audio_callback(void *param, uint64_t start_ts_in, uint64_t end_ts_in,
 	circlebuf_peek_front(&audio->buffered_timestamps, &ts, sizeof(ts));
 	min_ts = ts.start;
 
-	audio_size = AUDIO_OUTPUT_FRAMES * sizeof(float);
+	audio_size = audio->frames_per_tick * sizeof(float);
 
 #if DEBUG_AUDIO == 1
 	blog(LOG_DEBUG, "ts %llu-%llu", ts.start, ts.end);
@@ -616,7 +618,8 @@ bool audio_callback(void *param, uint64_t start_ts_in, uint64_t end_ts_in,
 
 		/* if a source has gone backward in time and we can no
 		 * longer buffer, drop some or all of its audio */
-		if (audio->total_buffering_ticks == MAX_BUFFERING_TICKS &&
+		if (audio->total_buffering_ticks ==
+			    audio->max_buffering_ticks &&
 		    source->audio_ts < ts.start) {
 			if (source->info.audio_render) {
 				blog(LOG_DEBUG,
@@ -276,7 +276,7 @@ static struct obs_data_item *obs_data_item_create(const char *name,
 	name_size = get_name_align_size(name);
 	total_size = name_size + sizeof(struct obs_data_item) + size;
 
-	item = bzalloc(total_size);
+	item = bzalloc_tagged(total_size, BMEM_TAG_DATA);
 
 	item->capacity = total_size;
 	item->type = type;
@@ -673,7 +673,8 @@ static json_t *obs_data_to_full_json(obs_data_t *data)
 
 obs_data_t *obs_data_create()
 {
-	struct obs_data *data = bzalloc(sizeof(struct obs_data));
+	struct obs_data *data =
+		bzalloc_tagged(sizeof(struct obs_data), BMEM_TAG_DATA);
 	data->ref = 1;
 
 	return data;
@@ -1428,7 +1429,8 @@ obs_data_array_t *obs_data_get_autoselect_array(obs_data_t *data,
 
 obs_data_array_t *obs_data_array_create()
 {
-	struct obs_data_array *array = bzalloc(sizeof(struct obs_data_array));
+	struct obs_data_array *array =
+		bzalloc_tagged(sizeof(struct obs_data_array), BMEM_TAG_DATA);
 	array->ref = 1;
 
 	return array;
@@ -110,7 +110,8 @@ create_encoder(const char *id, enum obs_encoder_type type, const char *name,
 	obs_context_init_control(&encoder->context, encoder,
 				 (obs_destroy_cb)obs_encoder_destroy);
 	obs_context_data_insert(&encoder->context, &obs->data.encoders_mutex,
-				&obs->data.first_encoder);
+				&obs->data.first_encoder,
+				&obs->data.encoder_names);
 
 	blog(LOG_DEBUG, "encoder '%s' (%s) created (0x%I64X)", name, id, encoder);
 	return encoder;
@@ -582,6 +583,7 @@ static inline void obs_encoder_start_internal(
 		pause_reset(&encoder->pause);
 
 		encoder->cur_pts = 0;
+		memset(encoder->frame_trace, 0, sizeof(encoder->frame_trace));
 		add_connection(encoder);
 	}
 }
@@ -940,6 +942,35 @@ void full_stop(struct obs_encoder *encoder)
 	}
 }
 
+static inline size_t frame_trace_idx(const struct obs_encoder *encoder,
+				     int64_t pts)
+{
+	int64_t frame = encoder->timebase_num ? pts / encoder->timebase_num
+					      : pts;
+	return (size_t)frame & (ENCODER_FRAME_TRACE_SIZE - 1);
+}
+
+void obs_encoder_trace_frame(struct obs_encoder *encoder, int64_t pts,
+			     uint64_t frame_ts)
+{
+	struct encoder_frame_trace *trace =
+		&encoder->frame_trace[frame_trace_idx(encoder, pts)];
+
+	trace->pts = pts;
+	trace->frame_ts = frame_ts;
+	obs_frame_trace_mark(OBS_FRAME_STAGE_DEQUEUE, frame_ts);
+}
+
+/* packets can come out of the encoder in a different order than the frames
+ * went in, so they are matched to their frame by pts */
+static inline uint64_t packet_frame_ts(const struct obs_encoder *encoder,
+				       int64_t pts)
+{
+	const struct encoder_frame_trace *trace =
+		&encoder->frame_trace[frame_trace_idx(encoder, pts)];
+	return trace->pts == pts ? trace->frame_ts : 0;
+}
+
 void send_off_encoder_packet(obs_encoder_t *encoder, bool success,
 			     bool received, struct encoder_packet *pkt)
 {
@@ -966,6 +997,12 @@ void send_off_encoder_packet(obs_encoder_t *encoder, bool success,
 		pkt->sys_dts_usec += encoder->pause.ts_offset / 1000;
 		pthread_mutex_unlock(&encoder->pause.mutex);
 
+		if (encoder->info.type == OBS_ENCODER_VIDEO) {
+			pkt->frame_ts = packet_frame_ts(encoder, pkt->pts);
+			obs_frame_trace_mark(OBS_FRAME_STAGE_ENCODE,
+					     pkt->frame_ts);
+		}
+
 		pthread_mutex_lock(&encoder->callbacks_mutex);
 
 		for (size_t i = encoder->callbacks.num; i > 0; i--) {
@@ -1100,6 +1137,8 @@ static void receive_video(void *param, struct video_data *streaming_frame,
 	enc_frame.frames = 1;
 	enc_frame.pts = encoder->cur_pts;
 
+	obs_encoder_trace_frame(encoder, enc_frame.pts, frame->timestamp);
+
 	if (do_encode(encoder, &enc_frame))
 		encoder->cur_pts += encoder->timebase_num;
 
@@ -1396,7 +1435,8 @@ void obs_encoder_packet_create_instance(struct encoder_packet *dst,
 	long *p_refs;
 
 	*dst = *src;
-	p_refs = bmalloc(src->size + sizeof(long));
+	p_refs = bmalloc_tagged(src->size + sizeof(long),
+				BMEM_TAG_ENCODER_PACKETS);
 	dst->data = (void *)(p_refs + 1);
 	*p_refs = 1;
 	memcpy(dst->data, src->data, src->size);
@@ -1443,6 +1483,12 @@ void obs_encoder_packet_release(struct encoder_packet *pkt)
 	memset(pkt, 0, sizeof(struct encoder_packet));
 }
 
+void obs_encoder_packet_trace_sent(const struct encoder_packet *packet)
+{
+	if (packet && packet->type == OBS_ENCODER_VIDEO)
+		obs_frame_trace_mark(OBS_FRAME_STAGE_SEND, packet->frame_ts);
+}
+
 void obs_encoder_set_preferred_video_format(obs_encoder_t *encoder,
 					    enum video_format format)
 {
@@ -85,6 +85,12 @@ struct encoder_packet {
 
 	/** Encoder from which the track originated from */
 	obs_encoder_t *encoder;
+
+	/**
+	 * Video timestamp of the raw frame this packet was encoded from, used
+	 * to trace frame latency through the outputs.  0 if unknown.
+	 */
+	uint64_t frame_ts;
 };
 
 /** Encoder input frame */
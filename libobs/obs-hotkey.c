@@ -635,6 +635,7 @@ static inline void create_binding(obs_hotkey_t *hotkey,
 	binding->key = combo;
 	binding->hotkey_id = hotkey->id;
 	binding->hotkey = hotkey;
+	obs->hotkeys.query.bindings_changed = true;
 	unlock();
 }
 
@@ -979,6 +980,7 @@ static inline void remove_bindings(obs_hotkey_id id)
 			release_pressed_binding(binding);
 
 		da_erase(obs->hotkeys.bindings, idx);
+		obs->hotkeys.query.bindings_changed = true;
 	}
 }
 
@@ -1131,10 +1133,28 @@ void obs_hotkeys_context_release(struct obs_context_data *context)
 	unlock();
 }
 
+static void log_press_latency(void)
+{
+	struct obs_hotkey_query_state *query = &obs->hotkeys.query;
+
+	if (!query->presses)
+		return;
+
+	blog(LOG_INFO,
+	     "Hotkey press latency: %ld key event presses, "
+	     "average %.2f ms, max %.2f ms",
+	     query->presses,
+	     (double)query->press_latency_total / query->presses / 1000000.0,
+	     (double)query->press_latency_max / 1000000.0);
+}
+
 void obs_hotkeys_free(void)
 {
 	if (!lock())
 		return;
+
+	log_press_latency();
+
 	const size_t num = obs->hotkeys.hotkeys.num;
 	obs_hotkey_t *hotkeys = obs->hotkeys.hotkeys.array;
 	for (size_t i = 0; i < num; i++) {
@@ -1147,6 +1167,12 @@ void obs_hotkeys_free(void)
 	da_free(obs->hotkeys.hotkeys);
 	da_free(obs->hotkeys.hotkey_pairs);
 
+	da_free(obs->hotkeys.query.key_bindings);
+	da_free(obs->hotkeys.query.keys);
+	da_free(obs->hotkeys.query.unsettled);
+	da_free(obs->hotkeys.query.handle);
+	obs->hotkeys.query.bindings_changed = true;
+
 	for (size_t i = 0; i < OBS_KEY_LAST_VALUE; i++) {
 		if (obs->hotkeys.translations[i]) {
 			bfree(obs->hotkeys.translations[i]);
@@ -1201,6 +1227,21 @@ static inline bool is_pressed(obs_key_t key)
 					       key);
 }
 
+static inline void record_press_latency(void)
+{
+	struct obs_hotkey_query_state *query = &obs->hotkeys.query;
+	uint64_t latency;
+
+	if (!query->event_time)
+		return;
+
+	latency = os_gettime_ns() - query->event_time;
+	query->press_latency_total += latency;
+	if (latency > query->press_latency_max)
+		query->press_latency_max = latency;
+	query->presses++;
+}
+
 static inline void press_released_binding(obs_hotkey_binding_t *binding)
 {
 	binding->pressed = true;
@@ -1209,6 +1250,8 @@ static inline void press_released_binding(obs_hotkey_binding_t *binding)
 	if (hotkey->pressed++)
 		return;
 
+	record_press_latency();
+
 	if (!obs->hotkeys.reroute_hotkeys)
 		hotkey->func(hotkey->data, hotkey->id, hotkey, true);
 	else if (obs->hotkeys.router_func)
@@ -1303,6 +1346,7 @@ void obs_hotkey_inject_event(obs_key_combination_t hotkey, bool pressed)
 		obs->hotkeys.strict_modifiers,
 	};
 	enum_bindings(inject_hotkey, &event);
+	obs->hotkeys.query.states_changed = true;
 	unlock();
 }
 
@@ -1324,28 +1368,111 @@ void obs_hotkey_enable_strict_modifiers(bool enable)
 	unlock();
 }
 
-struct obs_query_hotkeys_helper {
-	uint32_t modifiers;
-	bool no_press;
-	bool strict_modifiers;
-};
+static int cmp_binding_key(const void *a, const void *b)
+{
+	const obs_hotkey_binding_t *bindings = obs->hotkeys.bindings.array;
+	size_t idx_a = *(const size_t *)a;
+	size_t idx_b = *(const size_t *)b;
+	obs_key_t key_a = bindings[idx_a].key.key;
+	obs_key_t key_b = bindings[idx_b].key.key;
 
-static inline bool query_hotkey(void *data, size_t idx,
-				obs_hotkey_binding_t *binding)
+	if (key_a != key_b)
+		return key_a < key_b ? -1 : 1;
+	return idx_a < idx_b ? -1 : (idx_a > idx_b ? 1 : 0);
+}
+
+static int cmp_size(const void *a, const void *b)
 {
-	UNUSED_PARAMETER(idx);
+	size_t val_a = *(const size_t *)a;
+	size_t val_b = *(const size_t *)b;
+	return val_a < val_b ? -1 : (val_a > val_b ? 1 : 0);
+}
 
-	struct obs_query_hotkeys_helper *param =
-		(struct obs_query_hotkeys_helper *)data;
-	handle_binding(binding, param->modifiers, param->no_press,
-		       param->strict_modifiers, NULL);
+static void rebuild_key_index(void)
+{
+	struct obs_hotkey_query_state *query = &obs->hotkeys.query;
+	const obs_hotkey_binding_t *bindings = obs->hotkeys.bindings.array;
+	size_t num = obs->hotkeys.bindings.num;
 
-	return true;
+	da_resize(query->key_bindings, num);
+	for (size_t i = 0; i < num; i++)
+		query->key_bindings.array[i] = i;
+
+	qsort(query->key_bindings.array, num, sizeof(size_t), cmp_binding_key);
+
+	da_resize(query->keys, 0);
+	for (size_t i = 0; i < num; i++) {
+		obs_key_t key = bindings[query->key_bindings.array[i]].key.key;
+		struct obs_hotkey_key_state *state;
+
+		/* modifier only bindings only depend on the modifiers */
+		if (key == OBS_KEY_NONE)
+			continue;
+
+		state = query->keys.num ? da_end(query->keys) : NULL;
+		if (!state || state->key != key) {
+			state = da_push_back_new(query->keys);
+			state->key = key;
+			state->first = i;
+		}
+
+		state->num++;
+	}
+
+	da_resize(query->unsettled, 0);
+	query->bindings_changed = false;
 }
 
+static bool *binding_key_state(obs_key_t key)
+{
+	struct obs_hotkey_query_state *query = &obs->hotkeys.query;
+	size_t lo = 0;
+	size_t hi = query->keys.num;
+
+	while (lo < hi) {
+		size_t mid = (lo + hi) / 2;
+		struct obs_hotkey_key_state *state = query->keys.array + mid;
+
+		if (state->key == key)
+			return &state->pressed;
+		if (state->key < key)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return NULL;
+}
+
+static inline void query_binding(size_t idx, uint32_t modifiers, bool no_press,
+				 bool strict_modifiers)
+{
+	struct obs_hotkey_query_state *query = &obs->hotkeys.query;
+	obs_hotkey_binding_t *binding = obs->hotkeys.bindings.array + idx;
+	bool was_pressed = binding->pressed;
+	bool modifiers_matched = binding->modifiers_match;
+	bool *pressed = binding_key_state(binding->key.key);
+
+	/* the key was already queried, so there's no need to query it again
+	 * for every binding */
+	handle_binding(binding, modifiers, no_press, strict_modifiers,
+		       pressed);
+
+	if (binding->pressed != was_pressed ||
+	    binding->modifiers_match != modifiers_matched)
+		da_push_back(query->unsettled, &idx);
+}
+
+/* only handles the bindings of keys that changed since the last query, unless
+ * the modifiers or the bindings themselves changed */
 static inline void query_hotkeys()
 {
+	struct obs_hotkey_query_state *query = &obs->hotkeys.query;
+	bool no_press = obs->hotkeys.thread_disable_press;
+	bool strict_modifiers = obs->hotkeys.strict_modifiers;
 	uint32_t modifiers = 0;
+	bool full;
+
 	if (is_pressed(OBS_KEY_SHIFT))
 		modifiers |= INTERACT_SHIFT_KEY;
 	if (is_pressed(OBS_KEY_CONTROL))
@@ -1355,12 +1482,69 @@ static inline void query_hotkeys()
 	if (is_pressed(OBS_KEY_META))
 		modifiers |= INTERACT_COMMAND_KEY;
 
-	struct obs_query_hotkeys_helper param = {
-		modifiers,
-		obs->hotkeys.thread_disable_press,
-		obs->hotkeys.strict_modifiers,
-	};
-	enum_bindings(query_hotkey, &param);
+	full = query->bindings_changed || query->states_changed ||
+	       modifiers != query->modifiers || no_press != query->no_press ||
+	       strict_modifiers != query->strict_modifiers;
+
+	if (query->bindings_changed)
+		rebuild_key_index();
+
+	query->states_changed = false;
+	query->modifiers = modifiers;
+	query->no_press = no_press;
+	query->strict_modifiers = strict_modifiers;
+
+	da_resize(query->handle, 0);
+
+	for (size_t i = 0; i < query->keys.num; i++) {
+		struct obs_hotkey_key_state *state = query->keys.array + i;
+		bool pressed = is_pressed(state->key);
+
+		if (pressed == state->pressed)
+			continue;
+
+		state->pressed = pressed;
+		if (!full)
+			da_push_back_array(
+				query->handle,
+				query->key_bindings.array + state->first,
+				state->num);
+	}
+
+	if (full) {
+		da_resize(query->handle, obs->hotkeys.bindings.num);
+		for (size_t i = 0; i < query->handle.num; i++)
+			query->handle.array[i] = i;
+	} else {
+		da_push_back_da(query->handle, query->unsettled);
+		qsort(query->handle.array, query->handle.num, sizeof(size_t),
+		      cmp_size);
+	}
+
+	da_resize(query->unsettled, 0);
+
+	for (size_t i = 0; i < query->handle.num; i++) {
+		size_t idx = query->handle.array[i];
+
+		if (i && idx == query->handle.array[i - 1])
+			continue;
+
+		query_binding(idx, modifiers, no_press, strict_modifiers);
+
+		/* a callback changed the bindings */
+		if (query->bindings_changed)
+			break;
+	}
+}
+
+void obs_hotkey_thread_wake(uint64_t event_time)
+{
+	pthread_mutex_lock(&obs->hotkeys.wake_mutex);
+	if (!obs->hotkeys.wake_time)
+		obs->hotkeys.wake_time = event_time;
+	pthread_mutex_unlock(&obs->hotkeys.wake_mutex);
+
+	os_event_signal(obs->hotkeys.wake_event);
 }
 
 #define NBSP "\xC2\xA0"
@@ -1376,12 +1560,27 @@ void *obs_hotkey_thread(void *arg)
 				   "obs_hotkey_thread(%g" NBSP "ms)", 25.);
 	profile_register_root(hotkey_thread_name, (uint64_t)25000000);
 
-	while (os_event_timedwait(obs->hotkeys.stop_event, 25) == ETIMEDOUT) {
+	/* keys are still polled every 25 ms, but event driven backends wake
+	 * the thread as soon as a key changes */
+	for (;;) {
+		uint64_t event_time;
+
+		os_event_timedwait(obs->hotkeys.wake_event, 25);
+		if (os_event_try(obs->hotkeys.stop_event) != EAGAIN)
+			break;
+
+		pthread_mutex_lock(&obs->hotkeys.wake_mutex);
+		event_time = obs->hotkeys.wake_time;
+		obs->hotkeys.wake_time = 0;
+		pthread_mutex_unlock(&obs->hotkeys.wake_mutex);
+
 		if (!lock())
 			continue;
 
 		profile_start(hotkey_thread_name);
+		obs->hotkeys.query.event_time = event_time;
 		query_hotkeys();
+		obs->hotkeys.query.event_time = 0;
 		profile_end(hotkey_thread_name);
 
 		unlock();
@@ -24,6 +24,7 @@
 #include "util/threading.h"
 #include "util/platform.h"
 #include "util/profiler.h"
+#include "util/metrics.h"
 #include "util/task.h"
 #include "callback/signal.h"
 #include "callback/proc.h"
@@ -164,6 +165,7 @@ typedef struct obs_hotkey_pair obs_hotkey_pair_t;
 typedef struct obs_hotkeys_platform obs_hotkeys_platform_t;
 
 void *obs_hotkey_thread(void *param);
+void obs_hotkey_thread_wake(uint64_t event_time);
 
 struct obs_core_hotkeys;
 bool obs_hotkeys_platform_init(struct obs_core_hotkeys *hotkeys);
@@ -262,6 +264,7 @@ struct obs_gpu_queues {
 
 struct obs_core_video {
 	graphics_t *graphics;
+	uint64_t graphics_init_time;
 	struct obs_textures textures[NUM_RENDERING_MODES];
 	bool using_nv12_tex;
 	struct circlebuf vframe_info_buffer;
@@ -301,6 +304,17 @@ struct obs_core_video {
 	uint32_t lagged_frames;
 	bool thread_initialized;
 
+	/* observed by the graphics thread, lock-free */
+	metric_t *render_time_metric;
+
+	/* age of frames at each stage, see obs_frame_trace_mark */
+	metric_t *frame_latency_metrics[OBS_FRAME_STAGE_COUNT];
+
+	uint32_t render_cache_hits;
+	uint32_t render_cache_misses;
+	uint32_t last_render_cache_hits;
+	uint32_t last_render_cache_misses;
+
 	bool gpu_conversion;
 	const char *conversion_techs[NUM_CHANNELS];
 	bool conversion_needed;
@@ -332,6 +346,9 @@ struct obs_core_video {
 
 struct audio_monitor;
 
+/* maximum audio buffering, in ticks of AUDIO_OUTPUT_FRAMES */
+#define MAX_BUFFERING_TICKS 45
+
 struct obs_core_audio {
 	audio_t *audio;
 
@@ -342,6 +359,8 @@ struct obs_core_audio {
 	struct circlebuf buffered_timestamps;
 	uint64_t buffering_wait_ticks;
 	int total_buffering_ticks;
+	int max_buffering_ticks;
+	uint32_t frames_per_tick;
 
 	float user_volume;
 
@@ -349,11 +368,22 @@ struct obs_core_audio {
 	DARRAY(struct audio_monitor *) monitors;
 	char *monitoring_device_name;
 	char *monitoring_device_id;
+	bool monitoring_premix;
 
 	pthread_mutex_t task_mutex;
 	struct circlebuf tasks;
 };
 
+/* hashed index of the contexts of one type by name, so name lookups don't
+ * have to walk (or lock) the context list itself.  private contexts are
+ * indexed too, only obs_get_transition_by_name() returns them */
+struct obs_context_name_index {
+	pthread_mutex_t mutex;
+	struct obs_context_data **buckets;
+	size_t num_buckets;
+	size_t num;
+};
+
 /* user sources, output channels, and displays */
 struct obs_core_data {
 	struct obs_source *first_source;
@@ -371,6 +401,11 @@ struct obs_core_data {
 	pthread_mutex_t audio_sources_mutex;
 	pthread_mutex_t draw_callbacks_mutex;
 	DARRAY(struct draw_callback) draw_callbacks;
+
+	struct obs_context_name_index source_names;
+	struct obs_context_name_index output_names;
+	struct obs_context_name_index encoder_names;
+	struct obs_context_name_index service_names;
 	DARRAY(struct tick_callback) tick_callbacks;
 
 	struct obs_view main_view;
@@ -382,6 +417,38 @@ struct obs_core_data {
 	volatile bool valid;
 };
 
+/* bindings grouped by key, so the hotkey thread only has to query each key
+ * once and only has to handle the bindings of keys that changed */
+struct obs_hotkey_key_state {
+	obs_key_t key;
+	bool pressed;
+	size_t first;
+	size_t num;
+};
+
+struct obs_hotkey_query_state {
+	bool bindings_changed;
+	bool states_changed; /* bindings handled outside of the thread */
+	DARRAY(size_t) key_bindings;
+	DARRAY(struct obs_hotkey_key_state) keys;
+
+	/* bindings whose state changed during the last query, they have to be
+	 * handled again even if nothing else changed */
+	DARRAY(size_t) unsettled;
+	DARRAY(size_t) handle;
+
+	uint32_t modifiers;
+	bool no_press;
+	bool strict_modifiers;
+
+	/* time of the key event that woke the hotkey thread, if any */
+	uint64_t event_time;
+
+	long presses;
+	uint64_t press_latency_total;
+	uint64_t press_latency_max;
+};
+
 /* user hotkeys */
 struct obs_core_hotkeys {
 	pthread_mutex_t mutex;
@@ -397,6 +464,12 @@ struct obs_core_hotkeys {
 	bool strict_modifiers;
 	bool reroute_hotkeys;
 	DARRAY(obs_hotkey_binding_t) bindings;
+	struct obs_hotkey_query_state query;
+
+	/* signalled by event driven platform backends when a key changes */
+	os_event_t *wake_event;
+	pthread_mutex_t wake_mutex;
+	uint64_t wake_time;
 
 	obs_hotkey_callback_router_func router_func;
 	void *router_func_data;
@@ -454,11 +527,16 @@ struct obs_core {
 	os_task_queue_t *destruction_task_thread;
 
 	obs_task_handler_t ui_task_handler;
+
+	DARRAY(metric_t *) metrics;
 };
 
 extern struct obs_core *obs;
 
+struct obs_tick_pool;
+
 struct obs_graphics_context {
+	struct obs_tick_pool *tick_pool;
 	uint64_t last_time;
 	uint64_t interval;
 	uint64_t frame_time_total_ns;
@@ -469,6 +547,7 @@ struct obs_graphics_context {
 #endif
 	bool raw_was_active;
 	bool was_active;
+	bool first_frame_rendered;
 	const char *video_thread_name;
 };
 
@@ -536,6 +615,10 @@ struct obs_context_data {
 	struct obs_context_data         *next;
 	struct obs_context_data         **prev_next;
 
+	struct obs_context_name_index   *name_index;
+	struct obs_context_data         *name_next;
+	uint32_t                        name_hash;
+
 	bool                            private;
 
 	DARRAY(char*)                   rename_cache;
@@ -551,7 +634,8 @@ extern void obs_context_init_control(struct obs_context_data *context,
 extern void obs_context_data_free(struct obs_context_data *context);
 
 extern void obs_context_data_insert(struct obs_context_data *context,
-				    pthread_mutex_t *mutex, void *first);
+				    pthread_mutex_t *mutex, void *first,
+				    struct obs_context_name_index *index);
 extern void obs_context_data_remove(struct obs_context_data *context);
 extern void obs_context_wait(struct obs_context_data *context);
 
@@ -742,6 +826,7 @@ struct obs_source {
 	bool async_unbuffered;
 	bool async_decoupled;
 	struct obs_source_frame *async_preload_frame;
+	bool async_preload_uploaded;
 	DARRAY(struct async_frame) async_cache;
 	DARRAY(struct obs_source_frame *) async_frames;
 	pthread_mutex_t async_mutex;
@@ -776,6 +861,21 @@ struct obs_source {
 	enum obs_allow_direct_render allow_direct;
 	bool rendering_filter;
 
+	/* parallel video tick */
+	const char *tick_profile_name;
+
+	/* filter chain render cache.  chain_gen changes when filters are
+	 * added, removed or reordered, cached_gens holds chain_gen, the
+	 * source's content_gen and that of each filter at the last render */
+	volatile long content_gen;
+	volatile long chain_gen;
+	DARRAY(long) cached_gens;
+	gs_texrender_t *cache_texrender;
+	uint32_t cached_cx;
+	uint32_t cached_cy;
+	bool cached_srgb;
+	bool cache_valid;
+
 	/* sources specific hotkeys */
 	obs_hotkey_pair_id mute_unmute_key;
 	obs_hotkey_id push_to_mute_key;
@@ -900,6 +1000,9 @@ convert_video_format(enum video_format format)
 
 extern void obs_source_set_texcoords_centered(obs_source_t *source,
 					      bool centered);
+extern void obs_source_video_tick_internal(obs_source_t *source,
+					   float seconds, bool call_tick);
+
 extern void obs_source_activate(obs_source_t *source, enum view_type type);
 extern void obs_source_deactivate(obs_source_t *source, enum view_type type);
 extern void obs_source_video_tick(obs_source_t *source, float seconds);
@@ -1060,6 +1163,8 @@ struct obs_output {
 
 	char *last_error_message;
 
+	DARRAY(metric_t *) metrics;
+
 	float audio_data[MAX_AUDIO_CHANNELS][AUDIO_OUTPUT_FRAMES];
 };
 
@@ -1104,6 +1209,13 @@ struct encoder_callback {
 	void *param;
 };
 
+#define ENCODER_FRAME_TRACE_SIZE 256
+
+struct encoder_frame_trace {
+	int64_t pts;
+	uint64_t frame_ts;
+};
+
 struct obs_encoder {
 	struct obs_context_data context;
 	struct obs_encoder_info info;
@@ -1137,6 +1249,10 @@ struct obs_encoder {
 
 	int64_t cur_pts;
 
+	/* video timestamps of the frames in flight, indexed by pts, so that
+	 * packets can be traced back to the frame they were encoded from */
+	struct encoder_frame_trace frame_trace[ENCODER_FRAME_TRACE_SIZE];
+
 	struct circlebuf audio_input_buffer[MAX_AV_PLANES];
 	uint8_t *audio_output_buffer[MAX_AV_PLANES];
 
@@ -1196,6 +1312,8 @@ extern void stop_gpu_encode(obs_encoder_t *encoder);
 extern bool do_encode(struct obs_encoder *encoder, struct encoder_frame *frame);
 extern void send_off_encoder_packet(obs_encoder_t *encoder, bool success,
 				    bool received, struct encoder_packet *pkt);
+extern void obs_encoder_trace_frame(struct obs_encoder *encoder, int64_t pts,
+				    uint64_t frame_ts);
 
 void obs_encoder_destroy(obs_encoder_t *encoder);
 
@@ -15,6 +15,8 @@
     along with this program.  If not, see <http://www.gnu.org/licenses/>.
 ******************************************************************************/
 
+#include <inttypes.h>
+
 #include "util/platform.h"
 #include "util/dstr.h"
 
@@ -319,8 +321,29 @@ static const char *obs_load_all_modules_name = "obs_load_all_modules";
 static const char *reset_win32_symbol_paths_name = "reset_win32_symbol_paths";
 #endif
 
+static void log_locale_stats(const struct text_lookup_stats *start)
+{
+	struct text_lookup_stats end;
+	text_lookup_get_stats(&end);
+
+	if (end.files == start->files)
+		return;
+
+	blog(LOG_INFO,
+	     "Loaded %" PRIu64 " module locale files (%" PRIu64
+	     " from cache) in %.2f ms, %" PRIu64 " KB mapped, %" PRIu64
+	     " KB on the heap",
+	     end.files - start->files, end.cached_files - start->cached_files,
+	     (double)(end.load_time_ns - start->load_time_ns) / 1000000.0,
+	     (end.mapped_bytes - start->mapped_bytes) / 1024,
+	     (end.heap_bytes - start->heap_bytes) / 1024);
+}
+
 void obs_load_all_modules(void)
 {
+	struct text_lookup_stats locale_stats;
+	text_lookup_get_stats(&locale_stats);
+
 	profile_start(obs_load_all_modules_name);
 	obs_find_modules(load_all_callback, NULL);
 #ifdef _WIN32
@@ -329,6 +352,8 @@ void obs_load_all_modules(void)
 	profile_end(reset_win32_symbol_paths_name);
 #endif
 	profile_end(obs_load_all_modules_name);
+
+	log_locale_stats(&locale_stats);
 }
 
 void obs_post_load_modules(void)
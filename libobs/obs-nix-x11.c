@@ -24,6 +24,9 @@
 #include <xcb/xcb.h>
 #if USE_XINPUT
 #include <xcb/xinput.h>
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
 #endif
 #include <X11/Xlib.h>
 #include <X11/Xutil.h>
@@ -98,6 +101,15 @@ struct obs_hotkeys_platform {
 	bool pressed[XINPUT_MOUSE_LEN];
 	bool update[XINPUT_MOUSE_LEN];
 	bool button_pressed[XINPUT_MOUSE_LEN];
+
+	/* keymap kept up to date from XInput2 raw key events on a separate
+	 * connection, so key states don't need a round trip to the server */
+	volatile bool key_thread_active;
+	pthread_t key_thread;
+	xcb_connection_t *key_connection;
+	int key_thread_pipe[2];
+	pthread_mutex_t keymap_mutex;
+	uint8_t keymap[32];
 #endif
 };
 
@@ -826,6 +838,179 @@ static inline void registerMouseEvents(struct obs_core_hotkeys *hotkeys)
 }
 #endif
 
+#if USE_XINPUT
+static inline void set_keymap_key(obs_hotkeys_platform_t *context,
+				  uint32_t code, bool pressed)
+{
+	if (code >= 256)
+		return;
+
+	if (pressed)
+		context->keymap[code / 8] |= (uint8_t)(1 << (code % 8));
+	else
+		context->keymap[code / 8] &= (uint8_t) ~(1 << (code % 8));
+}
+
+static bool handle_key_events(obs_hotkeys_platform_t *context)
+{
+	xcb_generic_event_t *ev;
+	bool changed = false;
+
+	while ((ev = xcb_poll_for_event(context->key_connection))) {
+		if ((ev->response_type & ~0x80) == XCB_GE_GENERIC) {
+			xcb_input_raw_key_press_event_t *key =
+				(xcb_input_raw_key_press_event_t *)ev;
+
+			switch (key->event_type) {
+			case XCB_INPUT_RAW_KEY_PRESS:
+			case XCB_INPUT_RAW_KEY_RELEASE:
+				pthread_mutex_lock(&context->keymap_mutex);
+				set_keymap_key(context, key->detail,
+					       key->event_type ==
+						       XCB_INPUT_RAW_KEY_PRESS);
+				pthread_mutex_unlock(&context->keymap_mutex);
+				changed = true;
+				break;
+			default:
+				break;
+			}
+		}
+		free(ev);
+	}
+
+	return changed;
+}
+
+static void *key_event_thread(void *data)
+{
+	obs_hotkeys_platform_t *context = data;
+	struct pollfd fds[2] = {
+		{xcb_get_file_descriptor(context->key_connection), POLLIN, 0},
+		{context->key_thread_pipe[0], POLLIN, 0},
+	};
+
+	os_set_thread_name("libobs: hotkey key events");
+
+	for (;;) {
+		uint64_t event_time = os_gettime_ns();
+
+		if (handle_key_events(context))
+			obs_hotkey_thread_wake(event_time);
+
+		if (xcb_connection_has_error(context->key_connection)) {
+			blog(LOG_WARNING, "Lost the connection for hotkey key "
+					  "events, falling back to polling");
+			break;
+		}
+
+		if (poll(fds, 2, -1) < 0 && errno != EINTR)
+			break;
+		if (fds[1].revents)
+			break;
+	}
+
+	/* key states are queried from the server again from now on */
+	os_atomic_set_bool(&context->key_thread_active, false);
+	return NULL;
+}
+
+static void stop_key_thread(obs_hotkeys_platform_t *context)
+{
+	if (context->key_thread_pipe[1] != -1) {
+		if (write(context->key_thread_pipe[1], "", 1) < 0)
+			blog(LOG_WARNING, "Could not stop hotkey key thread");
+		pthread_join(context->key_thread, NULL);
+
+		close(context->key_thread_pipe[0]);
+		close(context->key_thread_pipe[1]);
+		context->key_thread_pipe[0] = -1;
+		context->key_thread_pipe[1] = -1;
+		pthread_mutex_destroy(&context->keymap_mutex);
+	}
+
+	if (context->key_connection)
+		xcb_disconnect(context->key_connection);
+	context->key_connection = NULL;
+	context->key_thread_active = false;
+}
+
+/* key states are queried for every key used by a binding on every hotkey
+ * poll.  with XInput2 they're tracked from raw key events instead, which also
+ * lets the hotkey thread react as soon as a key is pressed. */
+static void start_key_thread(obs_hotkeys_platform_t *context)
+{
+	xcb_input_xi_query_version_reply_t *version;
+	xcb_query_keymap_reply_t *keymap;
+	xcb_connection_t *connection;
+	xcb_window_t window;
+
+	struct {
+		xcb_input_event_mask_t head;
+		xcb_input_xi_event_mask_t mask;
+	} mask;
+
+	context->key_thread_pipe[0] = -1;
+	context->key_thread_pipe[1] = -1;
+
+	connection = xcb_connect(DisplayString(context->display), NULL);
+	context->key_connection = connection;
+	if (xcb_connection_has_error(connection))
+		goto fail;
+
+	version = xcb_input_xi_query_version_reply(
+		connection, xcb_input_xi_query_version(connection, 2, 0), NULL);
+	if (!version || version->major_version < 2) {
+		free(version);
+		goto fail;
+	}
+	free(version);
+
+	window = root_window(context, connection);
+	mask.head.deviceid = XCB_INPUT_DEVICE_ALL_MASTER;
+	mask.head.mask_len = sizeof(mask.mask) / sizeof(uint32_t);
+	mask.mask = XCB_INPUT_XI_EVENT_MASK_RAW_KEY_PRESS |
+		    XCB_INPUT_XI_EVENT_MASK_RAW_KEY_RELEASE;
+	xcb_input_xi_select_events(connection, window, 1, &mask.head);
+
+	/* events are selected before the initial keymap is queried, so no
+	 * change can be missed in between */
+	keymap = xcb_query_keymap_reply(connection,
+					xcb_query_keymap(connection), NULL);
+	if (!keymap)
+		goto fail;
+	memcpy(context->keymap, keymap->keys, sizeof(context->keymap));
+	free(keymap);
+
+	if (pthread_mutex_init(&context->keymap_mutex, NULL) != 0)
+		goto fail;
+	if (pipe(context->key_thread_pipe) != 0) {
+		context->key_thread_pipe[0] = -1;
+		context->key_thread_pipe[1] = -1;
+		pthread_mutex_destroy(&context->keymap_mutex);
+		goto fail;
+	}
+
+	context->key_thread_active = true;
+	if (pthread_create(&context->key_thread, NULL, key_event_thread,
+			   context) != 0) {
+		close(context->key_thread_pipe[0]);
+		close(context->key_thread_pipe[1]);
+		context->key_thread_pipe[0] = -1;
+		context->key_thread_pipe[1] = -1;
+		pthread_mutex_destroy(&context->keymap_mutex);
+		goto fail;
+	}
+
+	blog(LOG_INFO, "Using XInput2 raw key events for hotkeys");
+	return;
+
+fail:
+	blog(LOG_INFO, "XInput2 raw key events unavailable, polling the "
+		       "keyboard for hotkeys");
+	stop_key_thread(context);
+}
+#endif
+
 static bool obs_nix_x11_hotkeys_platform_init(struct obs_core_hotkeys *hotkeys)
 {
 	// Open a new X11 connection here, this avoids Qt masking events we care about.
@@ -841,6 +1026,9 @@ static bool obs_nix_x11_hotkeys_platform_init(struct obs_core_hotkeys *hotkeys)
 #endif
 	fill_base_keysyms(hotkeys);
 	fill_keycodes(hotkeys);
+#if USE_XINPUT
+	start_key_thread(hotkeys->platform_context);
+#endif
 	return true;
 }
 
@@ -850,6 +1038,10 @@ static void obs_nix_x11_hotkeys_platform_free(struct obs_core_hotkeys *hotkeys)
 	if (!context)
 		return;
 
+#if USE_XINPUT
+	stop_key_thread(context);
+#endif
+
 	for (size_t i = 0; i < OBS_KEY_LAST_VALUE; i++)
 		da_free(context->keycodes[i].list);
 
@@ -1030,36 +1222,50 @@ static bool mouse_button_pressed(xcb_connection_t *connection,
 	return ret;
 }
 
-static inline bool keycode_pressed(xcb_query_keymap_reply_t *reply,
-				   xcb_keycode_t code)
+static inline bool keymap_pressed(const uint8_t *keys, xcb_keycode_t code)
+{
+	return (keys[code / 8] & (1 << (code % 8))) != 0;
+}
+
+static bool keycodes_pressed(obs_hotkeys_platform_t *context,
+			     const uint8_t *keys, obs_key_t key)
 {
-	return (reply->keys[code / 8] & (1 << (code % 8))) != 0;
+	struct keycode_list *codes = &context->keycodes[key];
+
+	if (key == OBS_KEY_META)
+		return keymap_pressed(keys, context->super_l_code) ||
+		       keymap_pressed(keys, context->super_r_code);
+
+	for (size_t i = 0; i < codes->list.num; i++) {
+		if (keymap_pressed(keys, codes->list.array[i]))
+			return true;
+	}
+
+	return false;
 }
 
 static bool key_pressed(xcb_connection_t *connection,
 			obs_hotkeys_platform_t *context, obs_key_t key)
 {
-	struct keycode_list *codes = &context->keycodes[key];
 	xcb_generic_error_t *error = NULL;
 	xcb_query_keymap_reply_t *reply;
 	bool pressed = false;
 
+#if USE_XINPUT
+	if (os_atomic_load_bool(&context->key_thread_active)) {
+		pthread_mutex_lock(&context->keymap_mutex);
+		pressed = keycodes_pressed(context, context->keymap, key);
+		pthread_mutex_unlock(&context->keymap_mutex);
+		return pressed;
+	}
+#endif
+
 	reply = xcb_query_keymap_reply(connection, xcb_query_keymap(connection),
 				       &error);
 	if (error) {
 		blog(LOG_WARNING, "xcb_query_keymap failed");
-
-	} else if (key == OBS_KEY_META) {
-		pressed = keycode_pressed(reply, context->super_l_code) ||
-			  keycode_pressed(reply, context->super_r_code);
-
 	} else {
-		for (size_t i = 0; i < codes->list.num; i++) {
-			if (keycode_pressed(reply, codes->list.array[i])) {
-				pressed = true;
-				break;
-			}
-		}
+		pressed = keycodes_pressed(context, reply->keys, key);
 	}
 
 	free(reply);
@@ -100,6 +100,76 @@ static bool init_output_handlers(struct obs_output *output, const char *name,
 	return true;
 }
 
+static double collect_output_active(void *output)
+{
+	return obs_output_active(output) ? 1.0 : 0.0;
+}
+
+static double collect_output_frames(void *output)
+{
+	return (double)obs_output_get_total_frames(output);
+}
+
+static double collect_output_dropped(void *output)
+{
+	return (double)obs_output_get_frames_dropped(output);
+}
+
+static double collect_output_bytes(void *output)
+{
+	return (double)obs_output_get_total_bytes(output);
+}
+
+static double collect_output_congestion(void *output)
+{
+	return (double)obs_output_get_congestion(output);
+}
+
+static void add_output_metric(struct obs_output *output, const char *name,
+			      const char *help, const char *labels,
+			      enum metric_type type,
+			      metric_collect_func collect)
+{
+	metric_t *metric = metrics_collector_create(name, help, labels, type,
+						    collect, output);
+	if (metric)
+		da_push_back(output->metrics, &metric);
+}
+
+static void init_output_metrics(struct obs_output *output)
+{
+	struct dstr labels = {0};
+
+	metrics_append_label(&labels, "output", output->context.name);
+	metrics_append_label(&labels, "id", output->info.id);
+
+	add_output_metric(output, "obs_output_active",
+			  "Whether the output is active", labels.array,
+			  METRIC_GAUGE, collect_output_active);
+	add_output_metric(output, "obs_output_frames_total",
+			  "Video frames received by the output", labels.array,
+			  METRIC_COUNTER, collect_output_frames);
+	add_output_metric(output, "obs_output_frames_dropped_total",
+			  "Video frames dropped by the output", labels.array,
+			  METRIC_COUNTER, collect_output_dropped);
+	add_output_metric(output, "obs_output_bytes_total",
+			  "Bytes written by the output", labels.array,
+			  METRIC_COUNTER, collect_output_bytes);
+	add_output_metric(output, "obs_output_congestion",
+			  "Network congestion of the output, from 0 to 1",
+			  labels.array, METRIC_GAUGE,
+			  collect_output_congestion);
+
+	dstr_free(&labels);
+}
+
+static void free_output_metrics(struct obs_output *output)
+{
+	for (size_t i = 0; i < output->metrics.num; i++)
+		metrics_destroy(output->metrics.array[i]);
+	da_free(output->metrics);
+}
+
 obs_output_t *obs_output_create(const char *id, const char *name,
 				obs_data_t *settings, obs_data_t *hotkey_data)
 {
@@ -153,12 +223,15 @@ obs_output_t *obs_output_create(const char *id, const char *name,
 	obs_context_init_control(&output->context, output,
 				 (obs_destroy_cb)obs_output_destroy);
 	obs_context_data_insert(&output->context, &obs->data.outputs_mutex,
-				&obs->data.first_output);
+				&obs->data.first_output,
+				&obs->data.output_names);
 
 	if (info)
 		output->context.data =
 			info->create(output->context.settings, output);
-	if (!output->context.data)
+	if (output->context.data)
+		init_output_metrics(output);
+	else
 		blog(LOG_ERROR, "Failed to create output '%s'!", name);
 
 	blog(LOG_DEBUG, "output '%s' (%s) created", name, id);
@@ -189,6 +262,7 @@ static inline void clear_audio_buffers(obs_output_t *output)
 void obs_output_destroy(obs_output_t *output)
 {
 	if (output) {
+		free_output_metrics(output);
 		obs_context_data_remove(&output->context);
 		os_atomic_set_long(&output->context.control->ref.refs, -0xFF);
 
@@ -1371,6 +1445,8 @@ static inline void send_interleaved(struct obs_output *output)
 		}
 
 		pthread_mutex_unlock(&output->caption_mutex);
+
+		obs_frame_trace_mark(OBS_FRAME_STAGE_INTERLEAVE, out.frame_ts);
 	}
 
 	output->info.encoded_packet(output->context.data, &out);
@@ -1774,6 +1850,9 @@ static void default_encoded_callback(void *param, struct encoder_packet *packet)
 	if (data_active(output)) {
 		if (packet->type == OBS_ENCODER_AUDIO)
 			packet->track_idx = get_track_index(output, packet);
+		else
+			obs_frame_trace_mark(OBS_FRAME_STAGE_INTERLEAVE,
+					     packet->frame_ts);
 
 		output->info.encoded_packet(output->context.data, packet);
 
@@ -1232,6 +1232,7 @@ static void apply_scene_item_audio_actions(struct obs_scene_item *item,
 		cur_visible = item->visible;
 	}
 
+	uint64_t frames = obs->audio.frames_per_tick;
 	uint64_t frame_num = 0;
 	size_t deref_count = 0;
 
@@ -1248,7 +1249,7 @@ static void apply_scene_item_audio_actions(struct obs_scene_item *item,
 		new_frame_num = util_mul_div64(timestamp - ts, sample_rate,
 					       1000000000ULL);
 
-		if (ts && new_frame_num >= AUDIO_OUTPUT_FRAMES)
+		if (ts && new_frame_num >= frames)
 			break;
 
 		da_erase(item->audio_actions, i--);
@@ -1285,7 +1286,7 @@ static void apply_scene_item_audio_actions(struct obs_scene_item *item,
 	}
 
 	if (buf) {
-		for (; frame_num < AUDIO_OUTPUT_FRAMES; frame_num++)
+		for (; frame_num < frames; frame_num++)
 			buf[frame_num] = cur_visible ? 1.0f : 0.0f;
 	}
 
@@ -1314,7 +1315,7 @@ static bool apply_scene_item_volume(struct obs_scene_item *item, float *buf,
 	pthread_mutex_unlock(&item->actions_mutex);
 
 	if (actions_pending) {
-		uint64_t duration = util_mul_div64(AUDIO_OUTPUT_FRAMES,
+		uint64_t duration = util_mul_div64(obs->audio.frames_per_tick,
 						   1000000000ULL, sample_rate);
 
 		if (!ts || action.timestamp < (ts + duration)) {
@@ -1373,6 +1374,7 @@ static bool scene_audio_render(void *data, uint64_t *ts_out,
 {
 	uint64_t timestamp = 0;
 	float buf[AUDIO_OUTPUT_FRAMES];
+	size_t frames = obs->audio.frames_per_tick;
 	struct obs_source_audio_mix child_audio;
 	struct obs_scene *scene = data;
 	struct obs_scene_item *item;
@@ -1476,7 +1478,7 @@ static bool scene_audio_render(void *data, uint64_t *ts_out,
 
 		pos = (size_t)ns_to_audio_frames(sample_rate,
 						 source_ts - timestamp);
-		count = AUDIO_OUTPUT_FRAMES - pos;
+		count = frames - pos;
 
 		if (obs_get_multiple_rendering()) {
 			if (!apply_buf &&
@@ -296,6 +296,8 @@ void deinterlace_update_async_video(obs_source_t *source)
 		obs_source_release_frame(source, frame);
 
 	} else if (updated) { /* swap cur/prev if no previous texture */
+		source->async_preload_uploaded = false;
+
 		for (size_t c = 0; c < MAX_AV_PLANES; c++) {
 			gs_texture_t *prev_tex = source->async_prev_textures[c];
 			source->async_prev_textures[c] =
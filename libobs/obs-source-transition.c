@@ -891,6 +891,7 @@ static void process_audio(obs_source_t *transition, obs_source_t *child,
 {
 	bool valid = child && !child->audio_pending && child->audio_ts;
 	struct obs_source_audio_mix child_audio;
+	size_t frames = obs->audio.frames_per_tick;
 	uint64_t ts;
 	size_t pos;
 
@@ -901,7 +902,7 @@ static void process_audio(obs_source_t *transition, obs_source_t *child,
 	obs_source_get_audio_mix(child, &child_audio);
 	pos = (size_t)ns_to_audio_frames(sample_rate, ts - min_ts);
 
-	if (pos > AUDIO_OUTPUT_FRAMES)
+	if (pos > frames)
 		return;
 
 	for (size_t mix_idx = 0; mix_idx < MAX_AUDIO_MIXES; mix_idx++) {
@@ -915,9 +916,8 @@ static void process_audio(obs_source_t *transition, obs_source_t *child,
 			float *out = output->data[ch];
 			float *in = input->data[ch];
 
-			mix_child(transition, out + pos, in,
-				  AUDIO_OUTPUT_FRAMES - pos, sample_rate, ts,
-				  mix);
+			mix_child(transition, out + pos, in, frames - pos,
+				  sample_rate, ts, mix);
 		}
 	}
 }
@@ -141,7 +141,7 @@ static void allocate_audio_output_buffer(struct obs_source *source)
 		      MAX_AUDIO_MIXES;
 	for (enum obs_audio_rendering_mode mode = OBS_MAIN_AUDIO_RENDERING;
 	     mode <= OBS_RECORDING_AUDIO_RENDERING; mode++) {
-		float *ptr = bzalloc(size);
+		float *ptr = bzalloc_tagged(size, BMEM_TAG_AUDIO);
 
 		for (size_t mix = 0; mix < MAX_AUDIO_MIXES; mix++) {
 			size_t mix_pos =
@@ -158,7 +158,7 @@ static void allocate_audio_output_buffer(struct obs_source *source)
 static void allocate_audio_mix_buffer(struct obs_source *source)
 {
 	size_t size = sizeof(float) * AUDIO_OUTPUT_FRAMES * MAX_AUDIO_CHANNELS;
-	float *ptr = bzalloc(size);
+	float *ptr = bzalloc_tagged(size, BMEM_TAG_AUDIO);
 
 	for (size_t i = 0; i < MAX_AUDIO_CHANNELS; i++) {
 		source->audio_mix_buf[i] = ptr + AUDIO_OUTPUT_FRAMES * i;
@@ -249,7 +249,8 @@ static void obs_source_init_finalize(struct obs_source *source)
 	}
 
 	obs_context_data_insert(&source->context, &obs->data.sources_mutex,
-				&obs->data.first_source);
+				&obs->data.first_source,
+				&obs->data.source_names);
 }
 
 static bool obs_source_hotkey_mute(void *data, obs_hotkey_pair_id id,
@@ -598,11 +599,14 @@ void obs_source_frame_init(struct obs_source_frame *frame,
 			   uint32_t height)
 {
 	struct video_frame vid_frame;
+	enum bmem_tag prev_tag;
 
 	if (!obs_ptr_valid(frame, "obs_source_frame_init"))
 		return;
 
+	prev_tag = bmem_set_thread_tag(BMEM_TAG_ASYNC_FRAMES);
 	video_frame_init(&vid_frame, format, width, height);
+	bmem_set_thread_tag(prev_tag);
 	frame->format = format;
 	frame->width = width;
 	frame->height = height;
@@ -717,8 +721,12 @@ static void obs_source_destroy_defer(struct obs_source *source)
 	}
 	if (source->filter_texrender)
 		gs_texrender_destroy(source->filter_texrender);
+	if (source->cache_texrender)
+		gs_texrender_destroy(source->cache_texrender);
 	gs_leave_context();
 
+	da_free(source->cached_gens);
+
 	for (i = 0; i < MAX_AV_PLANES; i++)
 		bfree(source->audio_data.data[i]);
 
@@ -986,6 +994,7 @@ static void obs_source_deferred_update(obs_source_t *source)
 				    source->context.settings);
 		os_atomic_compare_swap_long(&source->defer_update_count, count,
 					    0);
+		os_atomic_inc_long(&source->content_gen);
 	}
 }
 
@@ -1003,6 +1012,7 @@ void obs_source_update(obs_source_t *source, obs_data_t *settings)
 	} else if (source->context.data && source->info.update) {
 		source->info.update(source->context.data,
 				    source->context.settings);
+		os_atomic_inc_long(&source->content_gen);
 	}
 }
 
@@ -1230,13 +1240,11 @@ static void async_tick(obs_source_t *source)
 			set_async_texture_size(source, source->cur_async_frame);
 }
 
-void obs_source_video_tick(obs_source_t *source, float seconds)
+void obs_source_video_tick_internal(obs_source_t *source, float seconds,
+				    bool call_tick)
 {
 	bool now_showing, now_active;
 
-	if (!obs_source_valid(source, "obs_source_video_tick"))
-		return;
-
 	if (source->info.type == OBS_SOURCE_TYPE_TRANSITION)
 		obs_transition_tick(source, seconds);
 
@@ -1298,13 +1306,21 @@ void obs_source_video_tick(obs_source_t *source, float seconds)
 		source->active = now_active;
 	}
 
-	if (source->context.data && source->info.video_tick)
+	if (call_tick && source->context.data && source->info.video_tick)
 		source->info.video_tick(source->context.data, seconds);
 
 	source->async_rendered = false;
 	source->deinterlace_rendered = false;
 }
 
+void obs_source_video_tick(obs_source_t *source, float seconds)
+{
+	if (!obs_source_valid(source, "obs_source_video_tick"))
+		return;
+
+	obs_source_video_tick_internal(source, seconds, true);
+}
+
 /* unless the value is 3+ hours worth of frames, this won't overflow */
 static inline uint64_t conv_frames_to_time(const size_t sample_rate,
 					   const size_t frames)
@@ -1553,10 +1569,14 @@ static void source_output_audio_data(obs_source_t *source,
 	}
 
 	if (source->monitoring_type != OBS_MONITORING_TYPE_MONITOR_ONLY) {
+		enum bmem_tag prev_tag = bmem_set_thread_tag(BMEM_TAG_AUDIO);
+
 		if (push_back && source->audio_ts)
 			source_output_audio_push_back(source, &in);
 		else
 			source_output_audio_place(source, &in);
+
+		bmem_set_thread_tag(prev_tag);
 	}
 
 	pthread_mutex_unlock(&source->audio_buf_mutex);
@@ -1882,6 +1902,7 @@ bool set_async_texture_size(struct obs_source *source,
 	source->async_height = frame->height;
 	source->async_format = frame->format;
 	source->async_full_range = frame->full_range;
+	source->async_preload_uploaded = false;
 
 	gs_enter_context(obs->video.graphics);
 
@@ -2251,6 +2272,7 @@ static void obs_source_update_async_video(obs_source_t *source)
 						      source->async_textures,
 						      source->async_texrender);
 				source->async_update_texture = false;
+				source->async_preload_uploaded = false;
 			}
 
 			obs_source_release_frame(source, frame);
@@ -2310,6 +2332,143 @@ static inline void obs_source_render_filters(obs_source_t *source)
 	obs_source_release(first_filter);
 }
 
+static inline void render_filter_tex(gs_texture_t *tex, gs_effect_t *effect,
+				     uint32_t width, uint32_t height,
+				     const char *tech_name);
+
+void obs_source_mark_dirty(obs_source_t *source)
+{
+	if (!obs_source_valid(source, "obs_source_mark_dirty"))
+		return;
+
+	os_atomic_inc_long(&source->content_gen);
+}
+
+static inline void update_chain_gen(obs_source_t *source, size_t idx,
+				    long gen, bool *changed)
+{
+	if (idx == source->cached_gens.num) {
+		da_push_back(source->cached_gens, &gen);
+		*changed = true;
+	} else if (source->cached_gens.array[idx] != gen) {
+		source->cached_gens.array[idx] = gen;
+		*changed = true;
+	}
+}
+
+/* stores the generation of every part of the chain and sets changed if any of
+ * them differ from the last render.  each counter only ever increases, and
+ * chain_gen covers filters being replaced or reordered, so the cache can't be
+ * matched by a different chain.  returns false if any part of the chain can't
+ * be cached */
+static bool update_filter_chain_gens(obs_source_t *source, bool *changed)
+{
+	uint32_t flags = source->info.output_flags;
+	bool cacheable = (flags & OBS_SOURCE_CACHEABLE) != 0 &&
+			 (flags & OBS_SOURCE_ASYNC) == 0;
+	size_t num;
+
+	if (!cacheable)
+		return false;
+
+	*changed = false;
+
+	pthread_mutex_lock(&source->filter_mutex);
+
+	update_chain_gen(source, 0, os_atomic_load_long(&source->chain_gen),
+			 changed);
+	update_chain_gen(source, 1, os_atomic_load_long(&source->content_gen),
+			 changed);
+
+	for (size_t i = 0; i < source->filters.num; i++) {
+		obs_source_t *filter = source->filters.array[i];
+
+		if ((filter->info.output_flags & OBS_SOURCE_CACHEABLE) == 0) {
+			cacheable = false;
+			break;
+		}
+
+		update_chain_gen(source, i + 2,
+				 os_atomic_load_long(&filter->content_gen),
+				 changed);
+	}
+
+	num = source->filters.num + 2;
+	pthread_mutex_unlock(&source->filter_mutex);
+
+	if (source->cached_gens.num != num) {
+		da_resize(source->cached_gens, num);
+		*changed = true;
+	}
+
+	return cacheable;
+}
+
+static bool obs_source_render_filters_cached(obs_source_t *source)
+{
+	const bool linear_srgb = gs_get_linear_srgb();
+	uint32_t cx, cy;
+	bool changed;
+
+	if (!update_filter_chain_gens(source, &changed)) {
+		source->cache_valid = false;
+		return false;
+	}
+
+	cx = obs_source_get_width(source);
+	cy = obs_source_get_height(source);
+	if (!cx || !cy) {
+		source->cache_valid = false;
+		return false;
+	}
+
+	if (!source->cache_texrender)
+		source->cache_texrender =
+			gs_texrender_create(GS_RGBA, GS_ZS_NONE);
+
+	if (!source->cache_valid || changed ||
+	    source->cached_cx != cx || source->cached_cy != cy ||
+	    source->cached_srgb != linear_srgb) {
+		gs_texrender_reset(source->cache_texrender);
+		source->cache_valid = false;
+
+		if (gs_texrender_begin(source->cache_texrender, cx, cy)) {
+			struct vec4 clear_color;
+
+			/* store the final filter output as-is, blending is
+			 * applied when the cached texture is drawn */
+			gs_blend_state_push();
+			gs_blend_function(GS_BLEND_ONE, GS_BLEND_ZERO);
+
+			vec4_zero(&clear_color);
+			gs_clear(GS_CLEAR_COLOR, &clear_color, 0.0f, 0);
+			gs_ortho(0.0f, (float)cx, 0.0f, (float)cy, -100.0f,
+				 100.0f);
+
+			obs_source_render_filters(source);
+
+			gs_blend_state_pop();
+			gs_texrender_end(source->cache_texrender);
+
+			source->cached_cx = cx;
+			source->cached_cy = cy;
+			source->cached_srgb = linear_srgb;
+			source->cache_valid = true;
+		}
+
+		obs->video.render_cache_misses++;
+	} else {
+		obs->video.render_cache_hits++;
+	}
+
+	gs_texture_t *tex = gs_texrender_get_texture(source->cache_texrender);
+	if (!source->cache_valid || !tex)
+		return false;
+
+	render_filter_tex(tex, obs->video.default_effect, cx, cy, "Draw");
+	return true;
+}
+
 void obs_source_default_render(obs_source_t *source)
 {
 	gs_effect_t *effect = obs->video.default_effect;
@@ -2397,8 +2556,10 @@ static inline void render_video(obs_source_t *source)
 				     get_type_format(source->info.type),
 				     obs_source_get_name(source));
 
-	if (source->filters.num && !source->rendering_filter)
-		obs_source_render_filters(source);
+	if (source->filters.num && !source->rendering_filter) {
+		if (!obs_source_render_filters_cached(source))
+			obs_source_render_filters(source);
+	}
 
 	else if (source->info.video_render)
 		obs_source_main_render(source);
@@ -2601,6 +2762,7 @@ void obs_source_filter_add(obs_source_t *source, obs_source_t *filter)
 						     : source->filters.array[0];
 
 	da_insert(source->filters, 0, &filter);
+	os_atomic_inc_long(&source->chain_gen);
 
 	pthread_mutex_unlock(&source->filter_mutex);
 
@@ -2635,6 +2797,7 @@ static bool obs_source_filter_remove_refless(obs_source_t *source,
 	}
 
 	da_erase(source->filters, idx);
+	os_atomic_inc_long(&source->chain_gen);
 
 	pthread_mutex_unlock(&source->filter_mutex);
 
@@ -2763,6 +2926,8 @@ void obs_source_filter_set_order(obs_source_t *source, obs_source_t *filter,
 
 	pthread_mutex_lock(&source->filter_mutex);
 	success = move_filter_dir(source, filter, movement);
+	if (success)
+		os_atomic_inc_long(&source->chain_gen);
 	pthread_mutex_unlock(&source->filter_mutex);
 
 	if (success)
@@ -3208,6 +3373,7 @@ obs_source_preload_video_internal(obs_source_t *source,
 	}
 
 	copy_frame_data(source->async_preload_frame, frame);
+	source->async_preload_uploaded = false;
 
 	source->last_frame_ts = frame->timestamp;
 }
@@ -3279,9 +3445,13 @@ void obs_source_show_preloaded_video(obs_source_t *source)
 
 	obs_enter_graphics();
 
-	set_async_texture_size(source, source->async_preload_frame);
-	update_async_textures(source, source->async_preload_frame,
-			      source->async_textures, source->async_texrender);
+	/* obs_source_set_video_frame may have uploaded it already */
+	if (!source->async_preload_uploaded) {
+		set_async_texture_size(source, source->async_preload_frame);
+		update_async_textures(source, source->async_preload_frame,
+				      source->async_textures,
+				      source->async_texrender);
+	}
 	source->async_active = true;
 
 	obs_leave_graphics();
@@ -3316,6 +3486,7 @@ obs_source_set_video_frame_internal(obs_source_t *source,
 	set_async_texture_size(source, source->async_preload_frame);
 	update_async_textures(source, source->async_preload_frame,
 			      source->async_textures, source->async_texrender);
+	source->async_preload_uploaded = true;
 
 	source->last_frame_ts = frame->timestamp;
 
@@ -3447,7 +3618,8 @@ static void copy_audio_data(obs_source_t *source, const uint8_t *const data[],
 		/* ensure audio storage capacity */
 		if (resize) {
 			bfree(source->audio_data.data[i]);
-			source->audio_data.data[i] = bmalloc(size);
+			source->audio_data.data[i] =
+				bmalloc_tagged(size, BMEM_TAG_AUDIO);
 		}
 
 		if (data[i] != NULL)
@@ -4594,6 +4766,7 @@ void obs_source_set_enabled(obs_source_t *source, bool enabled)
 		return;
 
 	source->enabled = enabled;
+	os_atomic_inc_long(&source->content_gen);
 
 	calldata_init_fixed(&data, stack, sizeof(stack));
 	calldata_set_ptr(&data, "source", source);
@@ -4820,14 +4993,15 @@ static inline void multiply_output_audio(obs_source_t *source, size_t mix,
 }
 
 static inline void multiply_vol_data(obs_source_t *source, size_t mix,
-				     size_t channels, float *vol_data)
+				     size_t channels, float *vol_data,
+				     size_t frames)
 {
 	for (enum obs_audio_rendering_mode mode = OBS_MAIN_AUDIO_RENDERING;
 	     mode <= OBS_RECORDING_AUDIO_RENDERING; mode++) {
 		for (size_t ch = 0; ch < channels; ch++) {
 			register float *out =
 				source->audio_output_buf[mode][mix][ch];
-			register float *end = out + AUDIO_OUTPUT_FRAMES;
+			register float *end = out + frames;
 			register float *vol = vol_data;
 
 			while (out < end)
@@ -4860,6 +5034,7 @@ static void apply_audio_actions(obs_source_t *source, size_t channels,
 {
 	float vol_data[AUDIO_OUTPUT_FRAMES];
 	float cur_vol = get_source_volume(source, source->audio_ts);
+	size_t frames = obs->audio.frames_per_tick;
 	size_t frame_num = 0;
 
 	pthread_mutex_lock(&source->audio_actions_mutex);
@@ -4875,7 +5050,7 @@ static void apply_audio_actions(obs_source_t *source, size_t channels,
 		new_frame_num = conv_time_to_frames(
 			sample_rate, timestamp - source->audio_ts);
 
-		if (new_frame_num >= AUDIO_OUTPUT_FRAMES)
+		if (new_frame_num >= frames)
 			break;
 
 		da_erase(source->audio_actions, i--);
@@ -4890,14 +5065,15 @@ static void apply_audio_actions(obs_source_t *source, size_t channels,
 		cur_vol = get_source_volume(source, timestamp);
 	}
 
-	for (; frame_num < AUDIO_OUTPUT_FRAMES; frame_num++)
+	for (; frame_num < frames; frame_num++)
 		vol_data[frame_num] = cur_vol;
 
 	pthread_mutex_unlock(&source->audio_actions_mutex);
 
 	for (size_t mix = 0; mix < MAX_AUDIO_MIXES; mix++) {
 		if ((source->audio_mixers & (1 << mix)) != 0)
-			multiply_vol_data(source, mix, channels, vol_data);
+			multiply_vol_data(source, mix, channels, vol_data,
+					  frames);
 	}
 }
 
@@ -4917,8 +5093,8 @@ static void apply_audio_volume(obs_source_t *source, uint32_t mixers,
 	pthread_mutex_unlock(&source->audio_actions_mutex);
 
 	if (actions_pending) {
-		uint64_t duration =
-			conv_frames_to_time(sample_rate, AUDIO_OUTPUT_FRAMES);
+		uint64_t duration = conv_frames_to_time(
+			sample_rate, obs->audio.frames_per_tick);
 
 		if (action.timestamp < (source->audio_ts + duration)) {
 			apply_audio_actions(source, channels, sample_rate);
@@ -5060,7 +5236,7 @@ static void audio_submix(obs_source_t *source, size_t channels,
 		audio.data[i] = (const uint8_t *)audio_data.data[i];
 
 	audio.samples_per_sec = (uint32_t)sample_rate;
-	audio.frames = AUDIO_OUTPUT_FRAMES;
+	audio.frames = obs->audio.frames_per_tick;
 	audio.format = AUDIO_FORMAT_FLOAT_PLANAR;
 	audio.speakers = (enum speaker_layout)channels;
 	audio.timestamp = ts;
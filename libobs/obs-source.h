@@ -202,6 +202,23 @@ enum obs_media_state {
  */
 #define OBS_SOURCE_CAP_DONT_SHOW_PROPERTIES (1 << 16)
 
+/**
+ * Source's video only changes when it is updated or when it calls
+ * obs_source_mark_dirty.  When a source and all of its filters have this
+ * flag, the output of the filter chain is cached in a texture and only
+ * re-rendered when something changes.  Do not use this flag for sources or
+ * filters whose output varies over time.
+ */
+#define OBS_SOURCE_CACHEABLE (1 << 17)
+
+/**
+ * Source's video_tick callback is thread-safe and may be called from a
+ * worker thread in parallel with the ticks of other sources.  The tick must
+ * not depend on other sources having been ticked first, and must enter the
+ * graphics context before making any graphics calls.
+ */
+#define OBS_SOURCE_THREADSAFE_TICK (1 << 18)
+
 /** @} */
 
 typedef void (*obs_source_enum_proc_t)(obs_source_t *parent,
@@ -161,6 +161,10 @@ static void *gpu_encode_thread(void *unused)
 					else
 						next_key++;
 
+					obs_encoder_trace_frame(
+						encoder, encoder->cur_pts,
+						timestamp);
+
 					success = encoder->info.encode_texture(
 						encoder->context.data, tf.handle,
 						encoder->cur_pts, lock_key, &next_key, &pkt,
@@ -29,7 +29,169 @@
 #include <windows.h>
 #endif
 
-static uint64_t tick_sources(uint64_t cur_time, uint64_t last_time)
+/* ------------------------------------------------------------------------- */
+/* parallel video tick                                                       */
+
+#define MAX_TICK_THREADS 4
+
+struct obs_tick_pool {
+	pthread_t threads[MAX_TICK_THREADS];
+	size_t num_threads;
+	os_sem_t *start_sem;
+	os_sem_t *done_sem;
+	volatile bool stop;
+
+	DARRAY(obs_source_t *) jobs;
+	volatile long next_job;
+	float seconds;
+};
+
+static const char *parallel_tick_name = "parallel_video_tick";
+
+static void run_tick_jobs(struct obs_tick_pool *pool)
+{
+	long idx;
+
+	while ((idx = os_atomic_inc_long(&pool->next_job) - 1) <
+	       (long)pool->jobs.num) {
+		obs_source_t *source = pool->jobs.array[idx];
+
+		profile_start(source->tick_profile_name);
+		source->info.video_tick(source->context.data, pool->seconds);
+		profile_end(source->tick_profile_name);
+	}
+}
+
+static void *tick_thread(void *param)
+{
+	struct obs_tick_pool *pool = param;
+
+	os_set_thread_name("libobs: video tick worker");
+	profile_register_root(parallel_tick_name, 0);
+
+	while (os_sem_wait(pool->start_sem) == 0) {
+		if (pool->stop)
+			break;
+
+		profile_start(parallel_tick_name);
+		run_tick_jobs(pool);
+		profile_end(parallel_tick_name);
+
+		profile_reenable_thread();
+		os_sem_post(pool->done_sem);
+	}
+
+	return NULL;
+}
+
+static struct obs_tick_pool *tick_pool_create(void)
+{
+	struct obs_tick_pool *pool;
+	int cores = os_get_logical_cores();
+	size_t num_threads;
+
+	/* the graphics thread works through the queue as well */
+	if (cores <= 1)
+		return NULL;
+
+	num_threads = (size_t)cores - 1;
+	if (num_threads > MAX_TICK_THREADS)
+		num_threads = MAX_TICK_THREADS;
+
+	pool = bzalloc(sizeof(*pool));
+
+	if (os_sem_init(&pool->start_sem, 0) != 0)
+		goto fail;
+	if (os_sem_init(&pool->done_sem, 0) != 0)
+		goto fail;
+
+	for (size_t i = 0; i < num_threads; i++) {
+		if (pthread_create(&pool->threads[i], NULL, tick_thread,
+				   pool) != 0)
+			break;
+		pool->num_threads++;
+	}
+
+	if (!pool->num_threads)
+		goto fail;
+
+	return pool;
+
+fail:
+	os_sem_destroy(pool->done_sem);
+	os_sem_destroy(pool->start_sem);
+	bfree(pool);
+	return NULL;
+}
+
+static void tick_pool_destroy(struct obs_tick_pool *pool)
+{
+	if (!pool)
+		return;
+
+	pool->stop = true;
+	for (size_t i = 0; i < pool->num_threads; i++)
+		os_sem_post(pool->start_sem);
+	for (size_t i = 0; i < pool->num_threads; i++)
+		pthread_join(pool->threads[i], NULL);
+
+	os_sem_destroy(pool->done_sem);
+	os_sem_destroy(pool->start_sem);
+	da_free(pool->jobs);
+	bfree(pool);
+}
+
+static inline bool can_tick_in_parallel(struct obs_tick_pool *pool,
+					obs_source_t *source)
+{
+	return pool &&
+	       (source->info.output_flags & OBS_SOURCE_THREADSAFE_TICK) != 0 &&
+	       source->context.data && source->info.video_tick;
+}
+
+static void queue_tick_job(struct obs_tick_pool *pool, obs_source_t *source)
+{
+	if (!source->tick_profile_name)
+		source->tick_profile_name = profile_store_name(
+			obs_get_profiler_name_store(), "video_tick(%s)",
+			source->context.name);
+
+	da_push_back(pool->jobs, &source);
+}
+
+/* runs the queued ticks on the worker threads and waits for all of them to
+ * finish before rendering */
+static void run_parallel_ticks(struct obs_tick_pool *pool, float seconds)
+{
+	size_t num_threads;
+
+	if (!pool || !pool->jobs.num)
+		return;
+
+	num_threads = pool->jobs.num - 1;
+	if (num_threads > pool->num_threads)
+		num_threads = pool->num_threads;
+
+	pool->seconds = seconds;
+	os_atomic_set_long(&pool->next_job, 0);
+
+	for (size_t i = 0; i < num_threads; i++)
+		os_sem_post(pool->start_sem);
+
+	run_tick_jobs(pool);
+
+	for (size_t i = 0; i < num_threads; i++)
+		os_sem_wait(pool->done_sem);
+
+	for (size_t i = 0; i < pool->jobs.num; i++)
+		obs_source_release(pool->jobs.array[i]);
+	da_resize(pool->jobs, 0);
+}
+
+/* ------------------------------------------------------------------------- */
+
+static uint64_t tick_sources(struct obs_tick_pool *pool, uint64_t cur_time,
+			     uint64_t last_time)
 {
 	struct obs_core_data *data = &obs->data;
 	uint64_t delta_time;
@@ -65,14 +227,22 @@ static uint64_t tick_sources(uint64_t cur_time, uint64_t last_time)
 	while (source) {
 		struct obs_source *next_source = obs_source_get_ref((struct obs_source *)source->context.next);
 
-		obs_source_video_tick(source, seconds);
-		obs_source_release(source);
+		if (can_tick_in_parallel(pool, source)) {
+			obs_source_video_tick_internal(source, seconds, false);
+			queue_tick_job(pool, source);
+		} else {
+			obs_source_video_tick(source, seconds);
+			obs_source_release(source);
+		}
 
 		source = next_source;
 	}
 
 	pthread_mutex_unlock(&data->sources_mutex);
 
+	/* run outside of sources_mutex so ticks can look up sources */
+	run_parallel_ticks(pool, seconds);
+
 	return cur_time;
 }
 
@@ -909,6 +1079,9 @@ static inline void output_frame(bool raw_active, const bool gpu_active)
 		output_video_data(video, &main_frame, &streaming_frame,
 				  &recording_frame, vframe_info.count);
 		profile_end(output_frame_output_video_data_name);
+
+		obs_frame_trace_mark(OBS_FRAME_STAGE_OUTPUT,
+				     vframe_info.timestamp);
 	}
 
 	if (++video->cur_texture == NUM_TEXTURES)
@@ -1080,13 +1253,18 @@ bool obs_graphics_thread_loop(struct obs_graphics_context *context)
 
 	profile_start(context->video_thread_name);
 
+	obs->video.last_render_cache_hits = obs->video.render_cache_hits;
+	obs->video.last_render_cache_misses = obs->video.render_cache_misses;
+	obs->video.render_cache_hits = 0;
+	obs->video.render_cache_misses = 0;
+
 	gs_enter_context(obs->video.graphics);
 	gs_begin_frame();
 	gs_leave_context();
 
 	profile_start(tick_sources_name);
-	context->last_time =
-		tick_sources(obs->video.video_time, context->last_time);
+	context->last_time = tick_sources(
+		context->tick_pool, obs->video.video_time, context->last_time);
 	profile_end(tick_sources_name);
 
 #ifdef _WIN32
@@ -1101,6 +1279,10 @@ bool obs_graphics_thread_loop(struct obs_graphics_context *context)
 	output_frame(raw_active, gpu_active);
 	profile_end(output_frame_name);
 
+	if (raw_active || gpu_active)
+		obs_frame_trace_mark(OBS_FRAME_STAGE_RENDER,
+				     obs->video.video_time);
+
 	profile_start(render_displays_name);
 	render_displays();
 	profile_end(render_displays_name);
@@ -1108,9 +1290,20 @@ bool obs_graphics_thread_loop(struct obs_graphics_context *context)
 	execute_graphics_tasks();
 
 	frame_time_ns = os_gettime_ns() - frame_start;
+	metrics_histogram_observe(obs->video.render_time_metric,
+				  (double)frame_time_ns / 1000000000.0);
 
 	profile_end(context->video_thread_name);
 
+	if (!context->first_frame_rendered) {
+		uint64_t startup_ns =
+			os_gettime_ns() - obs->video.graphics_init_time;
+		blog(LOG_INFO, "First frame rendered %.2f ms after graphics "
+			       "initialization",
+		     (double)startup_ns / 1000000.0);
+		context->first_frame_rendered = true;
+	}
+
 	profile_reenable_thread();
 
 	video_sleep(&obs->video, raw_active, gpu_active, &obs->video.video_time,
@@ -1160,6 +1353,7 @@ void *obs_graphics_thread(void *param)
 	srand((unsigned int)time(NULL));
 
 	struct obs_graphics_context context;
+	context.tick_pool = tick_pool_create();
 	context.interval = video_output_get_frame_time(obs->video.video);
 	context.frame_time_total_ns = 0;
 	context.fps_total_ns = 0;
@@ -1170,6 +1364,7 @@ void *obs_graphics_thread(void *param)
 #endif
 	context.raw_was_active = false;
 	context.was_active = false;
+	context.first_frame_rendered = false;
 	context.video_thread_name = video_thread_name;
 
 #ifdef __APPLE__
@@ -1179,6 +1374,8 @@ void *obs_graphics_thread(void *param)
 #endif
 		;
 
+	tick_pool_destroy(context.tick_pool);
+
 #ifdef _WIN32
 	uninit_winrt_state(&winrt);
 #endif
@@ -285,6 +285,8 @@ static int obs_init_graphics(struct obs_video_info *ovi)
 	bool success = true;
 	int errorcode;
 
+	video->graphics_init_time = os_gettime_ns();
+
 	errorcode =
 		gs_create(&video->graphics, ovi->graphics_module, ovi->adapter);
 	if (errorcode != GS_SUCCESS) {
@@ -666,6 +668,10 @@ static bool obs_init_data(void)
 
 	pthread_mutex_init_value(&obs->data.displays_mutex);
 	pthread_mutex_init_value(&obs->data.draw_callbacks_mutex);
+	pthread_mutex_init_value(&obs->data.source_names.mutex);
+	pthread_mutex_init_value(&obs->data.output_names.mutex);
+	pthread_mutex_init_value(&obs->data.encoder_names.mutex);
+	pthread_mutex_init_value(&obs->data.service_names.mutex);
 
 	if (pthread_mutex_init_recursive(&data->sources_mutex) != 0)
 		goto fail;
@@ -681,6 +687,14 @@ static bool obs_init_data(void)
 		goto fail;
 	if (pthread_mutex_init_recursive(&obs->data.draw_callbacks_mutex) != 0)
 		goto fail;
+	if (pthread_mutex_init(&data->source_names.mutex, NULL) != 0)
+		goto fail;
+	if (pthread_mutex_init(&data->output_names.mutex, NULL) != 0)
+		goto fail;
+	if (pthread_mutex_init(&data->encoder_names.mutex, NULL) != 0)
+		goto fail;
+	if (pthread_mutex_init(&data->service_names.mutex, NULL) != 0)
+		goto fail;
 
 	if (!obs_view_init(&data->main_view))
 		goto fail;
@@ -716,6 +730,14 @@ void obs_main_view_free(struct obs_view *view)
 			     unfreed);                                     \
 	} while (false)
 
+static inline void
+obs_context_name_index_free(struct obs_context_name_index *index)
+{
+	pthread_mutex_destroy(&index->mutex);
+	bfree(index->buckets);
+	memset(index, 0, sizeof(*index));
+}
+
 static void obs_free_data(void)
 {
 	struct obs_core_data *data = &obs->data;
@@ -741,6 +763,10 @@ static void obs_free_data(void)
 	pthread_mutex_destroy(&data->encoders_mutex);
 	pthread_mutex_destroy(&data->services_mutex);
 	pthread_mutex_destroy(&data->draw_callbacks_mutex);
+	obs_context_name_index_free(&data->source_names);
+	obs_context_name_index_free(&data->output_names);
+	obs_context_name_index_free(&data->encoder_names);
+	obs_context_name_index_free(&data->service_names);
 	da_free(data->draw_callbacks);
 	da_free(data->tick_callbacks);
 	obs_data_release(data->private_data);
@@ -807,6 +833,13 @@ static inline bool obs_init_hotkeys(void)
 	hotkeys->push_to_talk = bstrdup("Push-to-talk");
 	hotkeys->sceneitem_show = bstrdup("Show '%1'");
 	hotkeys->sceneitem_hide = bstrdup("Hide '%1'");
+	hotkeys->query.bindings_changed = true;
+
+	/* platform backends may start waking the hotkey thread right away */
+	if (pthread_mutex_init(&hotkeys->wake_mutex, NULL) != 0)
+		return false;
+	if (os_event_init(&hotkeys->wake_event, OS_EVENT_TYPE_AUTO) != 0)
+		return false;
 
 	if (key_processing_enabled)
 		if (!obs_hotkeys_platform_init(hotkeys))
@@ -838,6 +871,7 @@ static inline void stop_hotkeys(void)
 
 	if (hotkeys->hotkey_thread_initialized) {
 		os_event_signal(hotkeys->stop_event);
+		os_event_signal(hotkeys->wake_event);
 		pthread_join(hotkeys->hotkey_thread, &thread_ret);
 		hotkeys->hotkey_thread_initialized = false;
 	}
@@ -862,6 +896,8 @@ static inline void obs_free_hotkeys(void)
 	if (key_processing_enabled)
 		obs_hotkeys_platform_free(hotkeys);
 
+	os_event_destroy(hotkeys->wake_event);
+	pthread_mutex_destroy(&hotkeys->wake_mutex);
 	pthread_mutex_destroy(&hotkeys->mutex);
 }
 
@@ -882,6 +918,177 @@ const struct obs_source_info audio_line_info = {
 	.get_name = submix_name,
 };
 
+static double collect_total_frames(void *unused)
+{
+	UNUSED_PARAMETER(unused);
+	return (double)obs->video.total_frames;
+}
+
+static double collect_lagged_frames(void *unused)
+{
+	UNUSED_PARAMETER(unused);
+	return (double)obs->video.lagged_frames;
+}
+
+static double collect_skipped_frames(void *unused)
+{
+	video_t *video = obs->video.video;
+
+	UNUSED_PARAMETER(unused);
+	return video ? (double)video_output_get_skipped_frames(video) : 0.0;
+}
+
+static double collect_active_fps(void *unused)
+{
+	UNUSED_PARAMETER(unused);
+	return obs->video.video_fps;
+}
+
+static double collect_audio_buffering(void *unused)
+{
+	UNUSED_PARAMETER(unused);
+	return (double)obs_get_audio_buffering_ms() / 1000.0;
+}
+
+static const double frame_latency_bounds[] = {
+	0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.075, 0.1,
+	0.15,  0.2,    0.3,   0.5,  0.75,  1.0,  2.0,   5.0};
+
+#define FRAME_LATENCY_BOUNDS \
+	(sizeof(frame_latency_bounds) / sizeof(frame_latency_bounds[0]))
+
+static const char *frame_stage_names[OBS_FRAME_STAGE_COUNT] = {
+	"render", "output", "dequeue", "encode", "interleave", "send"};
+
+static inline void add_core_metric(metric_t *metric)
+{
+	if (metric)
+		da_push_back(obs->metrics, &metric);
+}
+
+static void obs_init_metrics(void)
+{
+	static const double render_bounds[] = {0.001, 0.002, 0.004, 0.008,
+					       0.0167, 0.0333, 0.05, 0.1};
+
+	add_core_metric(metrics_collector_create(
+		"obs_video_frames_total",
+		"Video frames output, including lagged frames", NULL,
+		METRIC_COUNTER, collect_total_frames, NULL));
+	add_core_metric(metrics_collector_create(
+		"obs_video_frames_lagged_total",
+		"Video frames missed because rendering took too long", NULL,
+		METRIC_COUNTER, collect_lagged_frames, NULL));
+	add_core_metric(metrics_collector_create(
+		"obs_video_frames_skipped_total",
+		"Video frames skipped because encoding took too long", NULL,
+		METRIC_COUNTER, collect_skipped_frames, NULL));
+	add_core_metric(metrics_collector_create(
+		"obs_video_fps", "Frames rendered per second", NULL,
+		METRIC_GAUGE, collect_active_fps, NULL));
+	add_core_metric(metrics_collector_create(
+		"obs_audio_buffering_seconds",
+		"Audio buffering added to compensate for late sources", NULL,
+		METRIC_GAUGE, collect_audio_buffering, NULL));
+
+	obs->video.render_time_metric = metrics_histogram_create(
+		"obs_video_render_seconds",
+		"Time taken by the graphics thread to render a frame", NULL,
+		render_bounds,
+		sizeof(render_bounds) / sizeof(render_bounds[0]));
+	add_core_metric(obs->video.render_time_metric);
+
+	for (size_t i = 0; i < OBS_FRAME_STAGE_COUNT; i++) {
+		struct dstr labels = {0};
+
+		metrics_append_label(&labels, "stage", frame_stage_names[i]);
+		obs->video.frame_latency_metrics[i] = metrics_histogram_create(
+			"obs_frame_latency_seconds",
+			"Age of video frames at each stage of the pipeline",
+			labels.array, frame_latency_bounds,
+			FRAME_LATENCY_BOUNDS);
+		add_core_metric(obs->video.frame_latency_metrics[i]);
+
+		dstr_free(&labels);
+	}
+}
+
+static void obs_free_metrics(void)
+{
+	for (size_t i = 0; i < obs->metrics.num; i++)
+		metrics_destroy(obs->metrics.array[i]);
+	da_free(obs->metrics);
+
+	obs->video.render_time_metric = NULL;
+	memset(obs->video.frame_latency_metrics, 0,
+	       sizeof(obs->video.frame_latency_metrics));
+}
+
+void obs_frame_trace_mark(enum obs_frame_stage stage, uint64_t frame_ts)
+{
+	uint64_t now;
+	double age;
+
+	if (!obs || !frame_ts || stage < 0 || stage >= OBS_FRAME_STAGE_COUNT)
+		return;
+
+	/* rendering can start slightly before the video timestamp */
+	now = os_gettime_ns();
+	age = now > frame_ts ? (double)(now - frame_ts) / 1000000000.0 : 0.0;
+	metrics_histogram_observe(obs->video.frame_latency_metrics[stage], age);
+}
+
+/* linear interpolation within the bucket the percentile falls into */
+static double latency_percentile(const uint64_t *buckets, uint64_t frames,
+				 double percentile)
+{
+	double rank = percentile * (double)frames;
+	uint64_t prev = 0;
+
+	for (size_t i = 0; i < FRAME_LATENCY_BOUNDS; i++) {
+		if ((double)buckets[i] >= rank) {
+			double lower = i ? frame_latency_bounds[i - 1] : 0.0;
+			double upper = frame_latency_bounds[i];
+			uint64_t count = buckets[i] - prev;
+			double pos = count ? (rank - (double)prev) / count
+					   : 0.0;
+
+			return (lower + (upper - lower) * pos) * 1000.0;
+		}
+
+		prev = buckets[i];
+	}
+
+	return frame_latency_bounds[FRAME_LATENCY_BOUNDS - 1] * 1000.0;
+}
+
+bool obs_get_frame_latency(enum obs_frame_stage stage,
+			   struct obs_frame_latency *latency)
+{
+	uint64_t buckets[FRAME_LATENCY_BOUNDS + 1];
+	double sum;
+
+	if (!obs || !latency || stage < 0 || stage >= OBS_FRAME_STAGE_COUNT)
+		return false;
+
+	memset(latency, 0, sizeof(*latency));
+	latency->frames = metrics_histogram_read(
+		obs->video.frame_latency_metrics[stage], buckets,
+		FRAME_LATENCY_BOUNDS + 1, &sum);
+
+	if (latency->frames) {
+		latency->avg_ms = sum * 1000.0 / (double)latency->frames;
+		latency->p50_ms = latency_percentile(buckets, latency->frames,
+						     0.50);
+		latency->p95_ms = latency_percentile(buckets, latency->frames,
+						     0.95);
+		latency->p99_ms = latency_percentile(buckets, latency->frames,
+						     0.99);
+	}
+
+	return true;
+}
+
 extern void log_system_info(void);
 
 static bool obs_init(const char *locale, const char *module_config_path,
@@ -910,6 +1117,8 @@ static bool obs_init(const char *locale, const char *module_config_path,
 	if (!obs_init_hotkeys())
 		return false;
 
+	obs_init_metrics();
+
 	obs->destruction_task_thread = os_task_queue_create();
 	if (!obs->destruction_task_thread)
 		return false;
@@ -1035,11 +1244,49 @@ struct obs_cmdline_args obs_get_cmdline_args(void)
 	return cmdline_args;
 }
 
+static void log_memory_tags(void)
+{
+	blog(LOG_INFO, "Memory usage by tag (current / peak):");
+
+	for (int i = 0; i < BMEM_TAG_COUNT; i++) {
+		struct bmem_tag_stats stats;
+		bmem_get_tag_stats(i, &stats);
+
+		blog(LOG_INFO, "\t%s: %.1f MB / %.1f MB, %ld allocations",
+		     bmem_tag_name(i), (double)stats.bytes / 1048576.0,
+		     (double)stats.peak_bytes / 1048576.0, stats.allocs);
+	}
+}
+
+static void log_frame_latency(void)
+{
+	struct obs_frame_latency latency;
+
+	obs_get_frame_latency(OBS_FRAME_STAGE_RENDER, &latency);
+	if (!latency.frames)
+		return;
+
+	blog(LOG_INFO, "Video frame latency by stage (avg / p95 / p99):");
+
+	for (int i = 0; i < OBS_FRAME_STAGE_COUNT; i++) {
+		obs_get_frame_latency(i, &latency);
+		if (!latency.frames)
+			continue;
+
+		blog(LOG_INFO, "\t%s: %.2f ms / %.2f ms / %.2f ms, %" PRIu64
+			       " frames",
+		     frame_stage_names[i], latency.avg_ms, latency.p95_ms,
+		     latency.p99_ms, latency.frames);
+	}
+}
+
 void obs_shutdown(void)
 {
 	struct obs_module *module;
 
 	obs_wait_for_destroy_queue();
+	log_memory_tags();
+	log_frame_latency();
 
 	for (size_t i = 0; i < obs->source_types.num; i++) {
 		struct obs_source_info *item = &obs->source_types.array[i];
@@ -1089,6 +1336,7 @@ void obs_shutdown(void)
 	obs_free_video();
 	obs_free_hotkeys();
 	obs_free_graphics();
+	obs_free_metrics();
 	proc_handler_destroy(obs->procs);
 	signal_handler_destroy(obs->signals);
 	obs->procs = NULL;
@@ -1235,9 +1483,9 @@ int obs_reset_video(struct obs_video_info *ovi)
 	return obs_init_video(ovi);
 }
 
-bool obs_reset_audio(const struct obs_audio_info *oai)
+bool obs_reset_audio2(const struct obs_audio_info2 *oai)
 {
-	struct audio_output_info ai;
+	struct audio_output_info ai = {0};
 
 	/* don't allow changing of audio settings if active. */
 	if (obs->audio.audio && audio_output_active(obs->audio.audio))
@@ -1252,17 +1500,41 @@ bool obs_reset_audio(const struct obs_audio_info *oai)
 	ai.format = AUDIO_FORMAT_FLOAT_PLANAR;
 	ai.speakers = oai->speakers;
 	ai.input_callback = audio_callback;
+	ai.frames_per_tick = oai->frames_per_tick ? oai->frames_per_tick
+						  : AUDIO_OUTPUT_FRAMES;
+
+	/* keep the maximum amount of buffering the same in time */
+	obs->audio.frames_per_tick = ai.frames_per_tick;
+	obs->audio.max_buffering_ticks =
+		MAX_BUFFERING_TICKS * AUDIO_OUTPUT_FRAMES / ai.frames_per_tick;
+	obs->audio.total_buffering_ticks = 0;
+	obs->audio.buffering_wait_ticks = 0;
 
 	blog(LOG_INFO, "---------------------------------");
 	blog(LOG_INFO,
 	     "audio settings reset:\n"
 	     "\tsamples per sec: %d\n"
-	     "\tspeakers:        %d",
-	     (int)ai.samples_per_sec, (int)ai.speakers);
+	     "\tspeakers:        %d\n"
+	     "\tframes per tick: %d",
+	     (int)ai.samples_per_sec, (int)ai.speakers,
+	     (int)ai.frames_per_tick);
 
 	return obs_init_audio(&ai);
 }
 
+bool obs_reset_audio(const struct obs_audio_info *oai)
+{
+	struct obs_audio_info2 oai2 = {0};
+
+	if (!oai)
+		return obs_reset_audio2(NULL);
+
+	oai2.samples_per_sec = oai->samples_per_sec;
+	oai2.speakers = oai->speakers;
+	oai2.frames_per_tick = AUDIO_OUTPUT_FRAMES;
+	return obs_reset_audio2(&oai2);
+}
+
 bool obs_get_video_info(struct obs_video_info *ovi)
 {
 	struct obs_core_video *video = &obs->video;
@@ -1649,25 +1921,71 @@ void obs_enum_services(bool (*enum_proc)(void *, obs_service_t *), void *param)
 		 param);
 }
 
-static inline void *get_context_by_name(void *vfirst, const char *name,
-					pthread_mutex_t *mutex,
-					void *(*addref)(void *))
+static inline uint32_t context_name_hash(const char *name)
+{
+	uint32_t hash = 2166136261U;
+
+	if (!name)
+		return hash;
+
+	while (*name) {
+		hash ^= (uint8_t)*(name++);
+		hash *= 16777619U;
+	}
+
+	return hash;
+}
+
+/* must be called with the index mutex locked.  returns the first context in
+ * the index with the name, or the one after prev if prev is not NULL. */
+static struct obs_context_data *
+context_name_index_find(struct obs_context_name_index *index, const char *name,
+			uint32_t hash, struct obs_context_data *prev)
 {
-	struct obs_context_data **first = vfirst;
 	struct obs_context_data *context;
 
-	pthread_mutex_lock(mutex);
+	if (prev)
+		context = prev->name_next;
+	else if (index->num_buckets)
+		context = index->buckets[hash & (index->num_buckets - 1)];
+	else
+		context = NULL;
 
-	context = *first;
 	while (context) {
-		if (!context->private && strcmp(context->name, name) == 0) {
+		if (context->name_hash == hash && context->name &&
+		    strcmp(context->name, name) == 0)
+			break;
+		context = context->name_next;
+	}
+
+	return context;
+}
+
+/* private contexts are indexed for obs_get_transition_by_name(), but can't be
+ * looked up here */
+static inline void *get_context_by_name(struct obs_context_name_index *index,
+					const char *name,
+					void *(*addref)(void *))
+{
+	struct obs_context_data *context = NULL;
+	uint32_t hash;
+
+	if (!name)
+		return NULL;
+
+	hash = context_name_hash(name);
+
+	pthread_mutex_lock(&index->mutex);
+
+	while ((context = context_name_index_find(index, name, hash,
+						  context)) != NULL) {
+		if (!context->private) {
 			context = addref(context);
 			break;
 		}
-		context = context->next;
 	}
 
-	pthread_mutex_unlock(mutex);
+	pthread_mutex_unlock(&index->mutex);
 	return context;
 }
 
@@ -1698,50 +2016,53 @@ static inline void *obs_id_(void *data)
 
 obs_source_t *obs_get_source_by_name(const char *name)
 {
-	return get_context_by_name(&obs->data.first_source, name,
-				   &obs->data.sources_mutex,
+	return get_context_by_name(&obs->data.source_names, name,
 				   obs_source_addref_safe_);
 }
 
 obs_source_t *obs_get_transition_by_name(const char *name)
 {
-	struct obs_source **first = &obs->data.first_source;
-	struct obs_source *source;
+	struct obs_context_name_index *index = &obs->data.source_names;
+	struct obs_context_data *context = NULL;
+	struct obs_source *source = NULL;
+	uint32_t hash;
 
-	pthread_mutex_lock(&obs->data.sources_mutex);
+	if (!name)
+		return NULL;
 
-	source = *first;
-	while (source) {
-		if (source->info.type == OBS_SOURCE_TYPE_TRANSITION &&
-		    strcmp(source->context.name, name) == 0) {
-			source = obs_source_addref_safe_(source);
+	hash = context_name_hash(name);
+
+	pthread_mutex_lock(&index->mutex);
+
+	while ((context = context_name_index_find(index, name, hash,
+						  context)) != NULL) {
+		struct obs_source *cur = (struct obs_source *)context;
+
+		if (cur->info.type == OBS_SOURCE_TYPE_TRANSITION) {
+			source = obs_source_addref_safe_(cur);
 			break;
 		}
-		source = (void *)source->context.next;
 	}
 
-	pthread_mutex_unlock(&obs->data.sources_mutex);
+	pthread_mutex_unlock(&index->mutex);
 	return source;
 }
 
 obs_output_t *obs_get_output_by_name(const char *name)
 {
-	return get_context_by_name(&obs->data.first_output, name,
-				   &obs->data.outputs_mutex,
+	return get_context_by_name(&obs->data.output_names, name,
 				   obs_output_addref_safe_);
 }
 
 obs_encoder_t *obs_get_encoder_by_name(const char *name)
 {
-	return get_context_by_name(&obs->data.first_encoder, name,
-				   &obs->data.encoders_mutex,
+	return get_context_by_name(&obs->data.encoder_names, name,
 				   obs_encoder_addref_safe_);
 }
 
 obs_service_t *obs_get_service_by_name(const char *name)
 {
-	return get_context_by_name(&obs->data.first_service, name,
-				   &obs->data.services_mutex,
+	return get_context_by_name(&obs->data.service_names, name,
 				   obs_service_addref_safe_);
 }
 
@@ -2339,8 +2660,66 @@ void obs_context_init_control(struct obs_context_data *context, void *object,
 	context->destroy = destroy;
 }
 
+static void context_name_index_grow(struct obs_context_name_index *index)
+{
+	size_t num_buckets = index->num_buckets ? index->num_buckets * 2 : 64;
+	struct obs_context_data **buckets =
+		bzalloc(sizeof(struct obs_context_data *) * num_buckets);
+
+	for (size_t i = 0; i < index->num_buckets; i++) {
+		struct obs_context_data *context = index->buckets[i];
+
+		while (context) {
+			struct obs_context_data *next = context->name_next;
+			size_t bucket = context->name_hash & (num_buckets - 1);
+
+			context->name_next = buckets[bucket];
+			buckets[bucket] = context;
+			context = next;
+		}
+	}
+
+	bfree(index->buckets);
+	index->buckets = buckets;
+	index->num_buckets = num_buckets;
+}
+
+/* these must be called with the index mutex locked */
+static void context_name_index_add(struct obs_context_name_index *index,
+				   struct obs_context_data *context)
+{
+	size_t bucket;
+
+	if (index->num >= index->num_buckets)
+		context_name_index_grow(index);
+
+	context->name_hash = context_name_hash(context->name);
+	bucket = context->name_hash & (index->num_buckets - 1);
+
+	context->name_next = index->buckets[bucket];
+	index->buckets[bucket] = context;
+	index->num++;
+}
+
+static void context_name_index_remove(struct obs_context_name_index *index,
+				      struct obs_context_data *context)
+{
+	size_t bucket = context->name_hash & (index->num_buckets - 1);
+	struct obs_context_data **prev_next = &index->buckets[bucket];
+
+	while (*prev_next && *prev_next != context)
+		prev_next = &(*prev_next)->name_next;
+
+	if (*prev_next) {
+		*prev_next = context->name_next;
+		context->name_next = NULL;
+		index->num--;
+	}
+}
+
 void obs_context_data_insert(struct obs_context_data *context,
-			     pthread_mutex_t *mutex, void *pfirst)
+			     pthread_mutex_t *mutex, void *pfirst,
+			     struct obs_context_name_index *index)
 {
 	struct obs_context_data **first = pfirst;
 
@@ -2357,10 +2736,28 @@ void obs_context_data_insert(struct obs_context_data *context,
 	if (context->next)
 		context->next->prev_next = &context->next;
 	pthread_mutex_unlock(mutex);
+
+	if (index) {
+		pthread_mutex_lock(&context->rename_cache_mutex);
+		pthread_mutex_lock(&index->mutex);
+		context_name_index_add(index, context);
+		context->name_index = index;
+		pthread_mutex_unlock(&index->mutex);
+		pthread_mutex_unlock(&context->rename_cache_mutex);
+	}
 }
 
 void obs_context_data_remove(struct obs_context_data *context)
 {
+	if (context && context->name_index) {
+		struct obs_context_name_index *index = context->name_index;
+
+		pthread_mutex_lock(&index->mutex);
+		context_name_index_remove(index, context);
+		context->name_index = NULL;
+		pthread_mutex_unlock(&index->mutex);
+	}
+
 	if (context && context->prev_next) {
 		pthread_mutex_lock(context->mutex);
 		*context->prev_next = context->next;
@@ -2380,11 +2777,25 @@ void obs_context_wait(struct obs_context_data *context)
 void obs_context_data_setname(struct obs_context_data *context,
 			      const char *name)
 {
+	struct obs_context_name_index *index;
+	char *new_name;
+
 	pthread_mutex_lock(&context->rename_cache_mutex);
 
 	if (context->name)
 		da_push_back(context->rename_cache, &context->name);
-	context->name = dup_name(name, context->private);
+	new_name = dup_name(name, context->private);
+
+	index = context->name_index;
+	if (index) {
+		pthread_mutex_lock(&index->mutex);
+		context_name_index_remove(index, context);
+		context->name = new_name;
+		context_name_index_add(index, context);
+		pthread_mutex_unlock(&index->mutex);
+	} else {
+		context->name = new_name;
+	}
 
 	pthread_mutex_unlock(&context->rename_cache_mutex);
 }
@@ -2506,6 +2917,31 @@ void obs_get_audio_monitoring_device(const char **name, const char **id)
 		*id = obs->audio.monitoring_device_id;
 }
 
+void obs_set_audio_monitoring_premix(bool premix)
+{
+	if (!obs)
+		return;
+
+	pthread_mutex_lock(&obs->audio.monitoring_mutex);
+
+	if (obs->audio.monitoring_premix != premix) {
+		obs->audio.monitoring_premix = premix;
+
+		for (size_t i = 0; i < obs->audio.monitors.num; i++) {
+			struct audio_monitor *monitor =
+				obs->audio.monitors.array[i];
+			audio_monitor_reset(monitor);
+		}
+	}
+
+	pthread_mutex_unlock(&obs->audio.monitoring_mutex);
+}
+
+bool obs_get_audio_monitoring_premix(void)
+{
+	return obs ? obs->audio.monitoring_premix : false;
+}
+
 void obs_add_tick_callback(void (*tick)(void *param, float seconds),
 			   void *param)
 {
@@ -2558,6 +2994,33 @@ uint32_t obs_get_lagged_frames(void)
 	return obs->video.lagged_frames;
 }
 
+void obs_get_render_cache_stats(uint32_t *hits, uint32_t *misses)
+{
+	if (hits)
+		*hits = obs->video.last_render_cache_hits;
+	if (misses)
+		*misses = obs->video.last_render_cache_misses;
+}
+
+uint32_t obs_get_audio_buffering_ms(void)
+{
+	const struct audio_output_info *info;
+	audio_t *audio = obs->audio.audio;
+
+	if (!audio)
+		return 0;
+
+	info = audio_output_get_info(audio);
+	return (uint32_t)((uint64_t)obs->audio.total_buffering_ticks *
+			  info->frames_per_tick * 1000 /
+			  info->samples_per_sec);
+}
+
+uint32_t obs_get_audio_frames_per_tick(void)
+{
+	return audio_output_get_frames_per_tick(obs->audio.audio);
+}
+
 void start_raw_video(video_t *v, const struct video_scale_info *conversion,
 		     void (*callback)(void *param,
 				      struct video_data *streaming_frame,
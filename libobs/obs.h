@@ -218,6 +218,15 @@ struct obs_audio_info {
 	enum speaker_layout speakers;
 };
 
+struct obs_audio_info2 {
+	uint32_t samples_per_sec;
+	enum speaker_layout speakers;
+
+	/** Frames mixed per tick: 256, 512 or 1024 (0 for 1024).  Smaller
+	 * ticks lower the latency of the mix at the cost of more wakeups */
+	uint32_t frames_per_tick;
+};
+
 /**
  * Sent to source filters via the filter_audio callback to allow filtering of
  * audio data
@@ -427,6 +436,9 @@ EXPORT int obs_reset_video(struct obs_video_info *ovi);
  */
 EXPORT bool obs_reset_audio(const struct obs_audio_info *oai);
 
+/** Same as obs_reset_audio, but also sets the mixer tick size */
+EXPORT bool obs_reset_audio2(const struct obs_audio_info2 *oai);
+
 /** Gets the current video settings, returns false if no video */
 EXPORT bool obs_get_video_info(struct obs_video_info *ovi);
 
@@ -819,6 +831,8 @@ EXPORT void obs_enum_audio_monitoring_devices(obs_enum_audio_device_cb cb,
 
 EXPORT bool obs_set_audio_monitoring_device(const char *name, const char *id);
 EXPORT void obs_get_audio_monitoring_device(const char **name, const char **id);
+EXPORT void obs_set_audio_monitoring_premix(bool premix);
+EXPORT bool obs_get_audio_monitoring_premix(void);
 
 EXPORT void obs_add_tick_callback(void (*tick)(void *param, float seconds),
 				  void *param);
@@ -858,6 +872,50 @@ EXPORT uint64_t obs_get_frame_interval_ns(void);
 EXPORT uint32_t obs_get_total_frames(void);
 EXPORT uint32_t obs_get_lagged_frames(void);
 
+/** Gets the number of filter chain render cache hits and misses that occurred
+ * during the last rendered frame */
+EXPORT void obs_get_render_cache_stats(uint32_t *hits, uint32_t *misses);
+
+/** Gets the amount of audio buffering currently applied, in milliseconds */
+EXPORT uint32_t obs_get_audio_buffering_ms(void);
+
+/** Gets the number of frames mixed per audio tick */
+EXPORT uint32_t obs_get_audio_frames_per_tick(void);
+
+/** Points in the video pipeline at which the age of a frame is measured */
+enum obs_frame_stage {
+	OBS_FRAME_STAGE_RENDER,     /**< Rendered by the graphics thread */
+	OBS_FRAME_STAGE_OUTPUT,     /**< Handed to the video output */
+	OBS_FRAME_STAGE_DEQUEUE,    /**< Received by an encoder */
+	OBS_FRAME_STAGE_ENCODE,     /**< Encoded packet returned */
+	OBS_FRAME_STAGE_INTERLEAVE, /**< Packet interleaved by an output */
+	OBS_FRAME_STAGE_SEND,       /**< Packet sent or written by an output */
+	OBS_FRAME_STAGE_COUNT,
+};
+
+struct obs_frame_latency {
+	uint64_t frames;
+	double avg_ms;
+	double p50_ms;
+	double p95_ms;
+	double p99_ms;
+};
+
+/**
+ * Gets the age of video frames when they reached a stage of the pipeline,
+ * relative to their video timestamp, since libobs was initialized.
+ * Percentiles are estimated from a histogram.
+ */
+EXPORT bool obs_get_frame_latency(enum obs_frame_stage stage,
+				  struct obs_frame_latency *latency);
+
+/**
+ * Records the age of a frame with the video timestamp frame_ts at a stage of
+ * the pipeline.  Lock-free, a frame_ts of 0 is ignored.
+ */
+EXPORT void obs_frame_trace_mark(enum obs_frame_stage stage,
+				 uint64_t frame_ts);
+
 EXPORT bool obs_nv12_tex_active(void);
 
 EXPORT void obs_apply_private_data(obs_data_t *settings);
@@ -1063,6 +1121,13 @@ EXPORT void obs_source_reset_settings(obs_source_t *source,
 /** Renders a video source. */
 EXPORT void obs_source_video_render(obs_source_t *source);
 
+/**
+ * Signals that the video output of a source has changed.  Sources flagged
+ * with OBS_SOURCE_CACHEABLE must call this whenever their output changes
+ * outside of an update (e.g. from video_tick).
+ */
+EXPORT void obs_source_mark_dirty(obs_source_t *source);
+
 /** Updates a source. */
 EXPORT void obs_source_video_tick(obs_source_t *source, float seconds);
 
@@ -2388,6 +2453,10 @@ EXPORT void obs_encoder_packet_ref(struct encoder_packet *dst,
 				   struct encoder_packet *src);
 EXPORT void obs_encoder_packet_release(struct encoder_packet *packet);
 
+/** Called by outputs once a video packet has been sent or written, to record
+ * the latency of the frame it was encoded from */
+EXPORT void obs_encoder_packet_trace_sent(const struct encoder_packet *packet);
+
 EXPORT void *obs_encoder_create_rerouted(obs_encoder_t *encoder,
 					 const char *reroute_id);
 
@@ -91,6 +91,106 @@ static struct base_allocator alloc = {a_malloc, a_realloc, a_free};
 static long num_allocs = 0;
 static bool alloc_has_failed = false;
 
+/* ------------------------------------------------------------------------- */
+/* Tagged allocation accounting */
+
+/* every allocation is prefixed by its size and tag.  the header takes up a
+ * full alignment unit so the returned memory stays aligned. */
+struct bmem_header {
+	size_t size;
+	enum bmem_tag tag;
+};
+
+#define HEADER_SIZE ALIGNMENT
+
+/* per-thread counters are merged into the totals after this many
+ * operations, or once a tag has changed by this many bytes */
+#define FLUSH_OPS 64
+#define FLUSH_BYTES (1024 * 1024)
+
+struct bmem_thread_stats {
+	int64_t bytes[BMEM_TAG_COUNT];
+	long allocs[BMEM_TAG_COUNT];
+	long ops;
+};
+
+static const char *tag_names[BMEM_TAG_COUNT] = {
+	"untagged", "async frames", "audio buffers",
+	"encoder packets", "obs_data", "images",
+};
+
+static pthread_mutex_t stats_mutex = PTHREAD_MUTEX_INITIALIZER;
+static int64_t tag_bytes[BMEM_TAG_COUNT];
+static int64_t tag_peak_bytes[BMEM_TAG_COUNT];
+static long tag_allocs[BMEM_TAG_COUNT];
+
+static THREAD_LOCAL struct bmem_thread_stats thread_stats;
+static THREAD_LOCAL enum bmem_tag thread_tag = BMEM_TAG_UNTAGGED;
+
+static void flush_thread_stats(struct bmem_thread_stats *stats)
+{
+	pthread_mutex_lock(&stats_mutex);
+	for (size_t i = 0; i < BMEM_TAG_COUNT; i++) {
+		tag_bytes[i] += stats->bytes[i];
+		tag_allocs[i] += stats->allocs[i];
+		if (tag_bytes[i] > tag_peak_bytes[i])
+			tag_peak_bytes[i] = tag_bytes[i];
+	}
+	pthread_mutex_unlock(&stats_mutex);
+
+	memset(stats, 0, sizeof(*stats));
+}
+
+static inline void account(enum bmem_tag tag, int64_t bytes, long allocs)
+{
+	struct bmem_thread_stats *stats = &thread_stats;
+
+	stats->bytes[tag] += bytes;
+	stats->allocs[tag] += allocs;
+
+	if (++stats->ops >= FLUSH_OPS || stats->bytes[tag] >= FLUSH_BYTES ||
+	    stats->bytes[tag] <= -FLUSH_BYTES)
+		flush_thread_stats(stats);
+}
+
+static inline struct bmem_header *get_header(void *ptr)
+{
+	return (struct bmem_header *)((uint8_t *)ptr - HEADER_SIZE);
+}
+
+enum bmem_tag bmem_set_thread_tag(enum bmem_tag tag)
+{
+	enum bmem_tag prev = thread_tag;
+	if ((int)tag >= 0 && tag < BMEM_TAG_COUNT)
+		thread_tag = tag;
+	return prev;
+}
+
+const char *bmem_tag_name(enum bmem_tag tag)
+{
+	return ((int)tag >= 0 && tag < BMEM_TAG_COUNT) ? tag_names[tag] : NULL;
+}
+
+void bmem_get_tag_stats(enum bmem_tag tag, struct bmem_tag_stats *stats)
+{
+	if (!stats)
+		return;
+
+	memset(stats, 0, sizeof(*stats));
+	if ((int)tag < 0 || tag >= BMEM_TAG_COUNT)
+		return;
+
+	flush_thread_stats(&thread_stats);
+
+	pthread_mutex_lock(&stats_mutex);
+	stats->bytes = tag_bytes[tag];
+	stats->peak_bytes = tag_peak_bytes[tag];
+	stats->allocs = tag_allocs[tag];
+	pthread_mutex_unlock(&stats_mutex);
+}
+
+/* ------------------------------------------------------------------------- */
+
 void base_set_allocator(struct base_allocator *defs)
 {
 	memcpy(&alloc, defs, sizeof(struct base_allocator));
@@ -101,12 +201,10 @@ bool is_allocator_failed(void)
 	return alloc_has_failed;
 }
 
-void *bmalloc(size_t size)
+void *bmalloc_tagged(size_t size, enum bmem_tag tag)
 {
-	void *ptr = alloc.malloc(size);
-	if (!ptr && !size)
-		ptr = alloc.malloc(1);
-	if (!ptr) {
+	struct bmem_header *header = alloc.malloc(size + HEADER_SIZE);
+	if (!header) {
 #ifdef ALIGNED_MALLOC
 		blog(LOG_ERROR, "Failed while trying to allocate %lu bytes, errno %u", (unsigned long)size, errno);
 #else
@@ -118,19 +216,35 @@ void *bmalloc(size_t size)
 		       (unsigned long)size);
 	}
 
+	if ((int)tag < 0 || tag >= BMEM_TAG_COUNT)
+		tag = BMEM_TAG_UNTAGGED;
+
+	header->size = size;
+	header->tag = tag;
+	account(tag, (int64_t)size, 1);
+
 	os_atomic_inc_long(&num_allocs);
-	return ptr;
+	return (uint8_t *)header + HEADER_SIZE;
+}
+
+void *bmalloc(size_t size)
+{
+	return bmalloc_tagged(size, thread_tag);
 }
 
 void *brealloc(void *ptr, size_t size)
 {
+	struct bmem_header *header;
+	size_t old_size;
+
 	if (!ptr)
-		os_atomic_inc_long(&num_allocs);
+		return bmalloc(size);
+
+	header = get_header(ptr);
+	old_size = header->size;
 
-	ptr = alloc.realloc(ptr, size);
-	if (!ptr && !size)
-		ptr = alloc.realloc(ptr, 1);
-	if (!ptr) {
+	header = alloc.realloc(header, size + HEADER_SIZE);
+	if (!header) {
 #ifdef ALIGNED_MALLOC
 		blog(LOG_ERROR, "Failed while trying to reallocate %lu bytes, errno %u", (unsigned long)size, errno);
 #else
@@ -142,14 +256,21 @@ void *brealloc(void *ptr, size_t size)
 		       (unsigned long)size);
 	}
 
-	return ptr;
+	/* keeps the tag it was allocated with */
+	header->size = size;
+	account(header->tag, (int64_t)size - (int64_t)old_size, 0);
+
+	return (uint8_t *)header + HEADER_SIZE;
 }
 
 void bfree(void *ptr)
 {
 	if (ptr) {
+		struct bmem_header *header = get_header(ptr);
+
+		account(header->tag, -(int64_t)header->size, -1);
 		os_atomic_dec_long(&num_allocs);
-		alloc.free(ptr);
+		alloc.free(header);
 	}
 }
 
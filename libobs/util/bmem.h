@@ -33,10 +33,41 @@ struct base_allocator {
 
 EXPORT void base_set_allocator(struct base_allocator *defs);
 
+/*
+ * Allocations are accounted per tag, to be able to tell what memory is used
+ * for.  bmalloc uses the tag set for the calling thread (untagged by
+ * default), and brealloc keeps the tag of the original allocation.  Counters
+ * are kept per thread and merged periodically, so the totals are
+ * approximate.
+ */
+enum bmem_tag {
+	BMEM_TAG_UNTAGGED,
+	BMEM_TAG_ASYNC_FRAMES,
+	BMEM_TAG_AUDIO,
+	BMEM_TAG_ENCODER_PACKETS,
+	BMEM_TAG_DATA,
+	BMEM_TAG_IMAGES,
+	BMEM_TAG_COUNT,
+};
+
+struct bmem_tag_stats {
+	int64_t bytes;
+	int64_t peak_bytes;
+	long allocs;
+};
+
 EXPORT void *bmalloc(size_t size);
+EXPORT void *bmalloc_tagged(size_t size, enum bmem_tag tag);
 EXPORT void *brealloc(void *ptr, size_t size);
 EXPORT void bfree(void *ptr);
 
+/* returns the previous tag of the calling thread */
+EXPORT enum bmem_tag bmem_set_thread_tag(enum bmem_tag tag);
+
+EXPORT const char *bmem_tag_name(enum bmem_tag tag);
+EXPORT void bmem_get_tag_stats(enum bmem_tag tag,
+			       struct bmem_tag_stats *stats);
+
 EXPORT int base_get_alignment(void);
 EXPORT bool is_allocator_failed(void);
 
@@ -52,6 +83,14 @@ static inline void *bzalloc(size_t size)
 	return mem;
 }
 
+static inline void *bzalloc_tagged(size_t size, enum bmem_tag tag)
+{
+	void *mem = bmalloc_tagged(size, tag);
+	if (mem)
+		memset(mem, 0, size);
+	return mem;
+}
+
 static inline char *bstrdup_n(const char *str, size_t n)
 {
 	char *dup;
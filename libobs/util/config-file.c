@@ -17,6 +17,7 @@
 #include <inttypes.h>
 #include <stdio.h>
 #include <wchar.h>
+#include <ctype.h>
 #include "config-file.h"
 #include "threading.h"
 #include "platform.h"
@@ -25,6 +26,115 @@
 #include "darray.h"
 #include "lexer.h"
 #include "dstr.h"
+#include "task.h"
+
+/*
+ * Sections and items are kept in arrays in file order, with a hash index on
+ * the side for lookups.  The index only stores array positions, so it does
+ * not have to be touched when an array is reallocated, and entries are
+ * looked up by the name pointer that both sections and items start with.
+ */
+struct config_index {
+	size_t *buckets; /* index + 1 of the first entry, 0 if empty */
+	size_t num_buckets;
+	DARRAY(size_t) next; /* index + 1 of the next entry in the bucket */
+};
+
+static inline uint32_t config_hash(const char *name)
+{
+	uint32_t hash = 2166136261U;
+
+	while (*name) {
+		hash ^= (uint8_t)tolower((uint8_t)*(name++));
+		hash *= 16777619U;
+	}
+
+	return hash;
+}
+
+static inline const char *config_entry_name(const struct darray *entries,
+					    size_t element_size, size_t idx)
+{
+	return *(char **)darray_item(element_size, entries, idx);
+}
+
+static inline void config_index_link(struct config_index *index,
+				     const struct darray *entries,
+				     size_t element_size, size_t idx)
+{
+	const char *name = config_entry_name(entries, element_size, idx);
+	size_t *bucket =
+		index->buckets + (config_hash(name) & (index->num_buckets - 1));
+
+	index->next.array[idx] = *bucket;
+	*bucket = idx + 1;
+}
+
+static void config_index_rebuild(struct config_index *index,
+				 const struct darray *entries,
+				 size_t element_size)
+{
+	size_t num_buckets = 16;
+	while (num_buckets < entries->num)
+		num_buckets <<= 1;
+
+	if (num_buckets != index->num_buckets) {
+		bfree(index->buckets);
+		index->buckets = bmalloc(num_buckets * sizeof(size_t));
+		index->num_buckets = num_buckets;
+	}
+
+	memset(index->buckets, 0, num_buckets * sizeof(size_t));
+	da_resize(index->next, entries->num);
+
+	/* link backwards so the first of any duplicate names is found */
+	for (size_t i = entries->num; i > 0; i--)
+		config_index_link(index, entries, element_size, i - 1);
+}
+
+/* call after pushing a new entry to the back of the array */
+static inline void config_index_add(struct config_index *index,
+				    const struct darray *entries,
+				    size_t element_size)
+{
+	if (entries->num > index->num_buckets) {
+		config_index_rebuild(index, entries, element_size);
+		return;
+	}
+
+	da_resize(index->next, entries->num);
+	config_index_link(index, entries, element_size, entries->num - 1);
+}
+
+static size_t config_index_find(const struct config_index *index,
+				const struct darray *entries,
+				size_t element_size, const char *name)
+{
+	size_t idx;
+
+	if (!index->num_buckets)
+		return DARRAY_INVALID;
+
+	idx = index->buckets[config_hash(name) & (index->num_buckets - 1)];
+	while (idx) {
+		const char *cur = config_entry_name(entries, element_size,
+						    idx - 1);
+		if (astrcmpi(cur, name) == 0)
+			return idx - 1;
+
+		idx = index->next.array[idx - 1];
+	}
+
+	return DARRAY_INVALID;
+}
+
+static inline void config_index_free(struct config_index *index)
+{
+	bfree(index->buckets);
+	da_free(index->next);
+}
+
+/* ------------------------------------------------------------------------- */
 
 struct config_item {
 	char *name;
@@ -40,6 +150,7 @@ static inline void config_item_free(struct config_item *item)
 struct config_section {
 	char *name;
 	struct darray items; /* struct config_item */
+	struct config_index index;
 };
 
 static inline void config_section_free(struct config_section *section)
@@ -51,16 +162,79 @@ static inline void config_section_free(struct config_section *section)
 		config_item_free(items + i);
 
 	darray_free(&section->items);
+	config_index_free(&section->index);
 	bfree(section->name);
 }
 
+static inline struct config_section *
+config_section_item(const struct darray *sections, size_t idx)
+{
+	return darray_item(sizeof(struct config_section), sections, idx);
+}
+
+static inline struct config_section *
+config_find_section(const struct darray *sections,
+		    const struct config_index *index, const char *name)
+{
+	size_t idx = config_index_find(index, sections,
+				       sizeof(struct config_section), name);
+	return idx != DARRAY_INVALID ? config_section_item(sections, idx)
+				     : NULL;
+}
+
+/* takes ownership of name */
+static inline struct config_section *
+config_add_section(struct darray *sections, struct config_index *index,
+		   char *name)
+{
+	struct config_section *section =
+		darray_push_back_new(sizeof(struct config_section), sections);
+	section->name = name;
+	config_index_add(index, sections, sizeof(struct config_section));
+	return section;
+}
+
 struct config_data {
 	char *file;
 	struct darray sections; /* struct config_section */
 	struct darray defaults; /* struct config_section */
+	struct config_index section_index;
+	struct config_index default_index;
 	pthread_mutex_t mutex;
+
+	/* bumped for every change to a user value, so saves can be skipped
+	 * when nothing has changed since the file was last written */
+	uint64_t changes;
+	uint64_t saved_changes;
+
+	/* held while a file is written, so saves never interleave */
+	pthread_mutex_t write_mutex;
+
+	os_task_queue_t *writer;
+	char *async_temp_ext;
+	char *async_backup_ext;
+	volatile bool save_queued;
 };
 
+static inline struct config_index *
+config_sections_index(struct config_data *config, const struct darray *sections)
+{
+	return sections == &config->defaults ? &config->default_index
+					     : &config->section_index;
+}
+
+static bool config_init_mutexes(struct config_data *config)
+{
+	if (pthread_mutex_init_recursive(&config->mutex) != 0)
+		return false;
+	if (pthread_mutex_init(&config->write_mutex, NULL) != 0) {
+		pthread_mutex_destroy(&config->mutex);
+		return false;
+	}
+
+	return true;
+}
+
 config_t *config_create(const char *file)
 {
 	struct config_data *config;
@@ -73,7 +247,7 @@ config_t *config_create(const char *file)
 
 	config = bzalloc(sizeof(struct config_data));
 
-	if (pthread_mutex_init_recursive(&config->mutex) != 0) {
+	if (!config_init_mutexes(config)) {
 		bfree(config);
 		return NULL;
 	}
@@ -214,7 +388,8 @@ static void config_parse_section(struct config_section *section,
 	}
 }
 
-static void parse_config_data(struct darray *sections, struct lexer *lex)
+static void parse_config_data(struct darray *sections,
+			      struct config_index *index, struct lexer *lex)
 {
 	struct strref section_name;
 	struct base_token token;
@@ -223,6 +398,7 @@ static void parse_config_data(struct darray *sections, struct lexer *lex)
 
 	while (lexer_getbasetoken(lex, &token, PARSE_WHITESPACE)) {
 		struct config_section *section;
+		char *name;
 
 		while (token.type == BASETOKEN_WHITESPACE) {
 			if (!lexer_getbasetoken(lex, &token, PARSE_WHITESPACE))
@@ -244,14 +420,27 @@ static void parse_config_data(struct darray *sections, struct lexer *lex)
 		if (!section_name.len)
 			return;
 
-		section = darray_push_back_new(sizeof(struct config_section),
-					       sections);
-		section->name = bstrdup_n(section_name.array, section_name.len);
+		/* sections that appear more than once are merged */
+		name = bstrdup_n(section_name.array, section_name.len);
+		section = config_find_section(sections, index, name);
+		if (section)
+			bfree(name);
+		else
+			section = config_add_section(sections, index, name);
+
 		config_parse_section(section, lex);
 	}
+
+	for (size_t i = 0; i < sections->num; i++) {
+		struct config_section *section =
+			config_section_item(sections, i);
+		config_index_rebuild(&section->index, &section->items,
+				     sizeof(struct config_item));
+	}
 }
 
-static int config_parse_file(struct darray *sections, const char *file,
+static int config_parse_file(struct darray *sections,
+			     struct config_index *index, const char *file,
 			     bool always_open)
 {
 	char *file_data;
@@ -273,7 +462,7 @@ static int config_parse_file(struct darray *sections, const char *file,
 	lexer_init(&lex);
 	lexer_start_move(&lex, file_data);
 
-	parse_config_data(sections, &lex);
+	parse_config_data(sections, index, &lex);
 
 	lexer_free(&lex);
 	return CONFIG_SUCCESS;
@@ -292,14 +481,16 @@ int config_open(config_t **config, const char *file,
 	if (!*config)
 		return CONFIG_ERROR;
 
-	if (pthread_mutex_init_recursive(&(*config)->mutex) != 0) {
+	if (!config_init_mutexes(*config)) {
 		bfree(*config);
 		return CONFIG_ERROR;
 	}
 
 	(*config)->file = bstrdup(file);
 
-	errorcode = config_parse_file(&(*config)->sections, file, always_open);
+	errorcode = config_parse_file(&(*config)->sections,
+				      &(*config)->section_index, file,
+				      always_open);
 
 	if (errorcode != CONFIG_SUCCESS) {
 		config_close(*config);
@@ -320,7 +511,7 @@ int config_open_string(config_t **config, const char *str)
 	if (!*config)
 		return CONFIG_ERROR;
 
-	if (pthread_mutex_init_recursive(&(*config)->mutex) != 0) {
+	if (!config_init_mutexes(*config)) {
 		bfree(*config);
 		return CONFIG_ERROR;
 	}
@@ -329,7 +520,8 @@ int config_open_string(config_t **config, const char *str)
 
 	lexer_init(&lex);
 	lexer_start(&lex, str);
-	parse_config_data(&(*config)->sections, &lex);
+	parse_config_data(&(*config)->sections, &(*config)->section_index,
+			  &lex);
 	lexer_free(&lex);
 
 	return CONFIG_SUCCESS;
@@ -340,35 +532,29 @@ int config_open_defaults(config_t *config, const char *file)
 	if (!config)
 		return CONFIG_ERROR;
 
-	return config_parse_file(&config->defaults, file, false);
+	return config_parse_file(&config->defaults, &config->default_index, file,
+				 false);
 }
 
-int config_save(config_t *config)
+/* must be called with the write mutex locked.  changes receives the change
+ * count that was written, which is only marked as saved by the caller once
+ * the file is in its final place */
+static int config_write_file(config_t *config, const char *file,
+			     uint64_t *changes)
 {
 	FILE *f;
 	struct dstr str, tmp;
 	size_t i, j;
 	int ret = CONFIG_ERROR;
 
-	if (!config)
-		return CONFIG_ERROR;
-	if (!config->file)
-		return CONFIG_ERROR;
-
 	dstr_init(&str);
 	dstr_init(&tmp);
 
 	pthread_mutex_lock(&config->mutex);
 
-	f = os_fopen(config->file, "wb");
-	if (!f) {
-		pthread_mutex_unlock(&config->mutex);
-		return CONFIG_FILENOTFOUND;
-	}
-
 	for (i = 0; i < config->sections.num; i++) {
-		struct config_section *section = darray_item(
-			sizeof(struct config_section), &config->sections, i);
+		struct config_section *section =
+			config_section_item(&config->sections, i);
 
 		if (i)
 			dstr_cat(&str, "\n");
@@ -393,32 +579,70 @@ int config_save(config_t *config)
 		}
 	}
 
+	*changes = config->changes;
+
+	/* the file is written without holding the config mutex, so values
+	 * can still be read and set while the disk is busy */
+	pthread_mutex_unlock(&config->mutex);
+
+	f = os_fopen(file, "wb");
+	if (!f) {
+		ret = CONFIG_FILENOTFOUND;
+		goto cleanup;
+	}
+
 #ifdef _WIN32
 	if (fwrite("\xEF\xBB\xBF", 1, 3, f) != 3)
-		goto cleanup;
+		goto close;
 #endif
 	if (fwrite(str.array, 1, str.len, f) != str.len)
-		goto cleanup;
+		goto close;
 
 	ret = CONFIG_SUCCESS;
 
-cleanup:
+close:
 	fclose(f);
 
-	pthread_mutex_unlock(&config->mutex);
-
+cleanup:
 	dstr_free(&tmp);
 	dstr_free(&str);
 
 	return ret;
 }
 
+static inline void config_mark_saved(config_t *config, uint64_t changes)
+{
+	pthread_mutex_lock(&config->mutex);
+	config->saved_changes = changes;
+	pthread_mutex_unlock(&config->mutex);
+}
+
+int config_save(config_t *config)
+{
+	uint64_t changes;
+	int ret;
+
+	if (!config)
+		return CONFIG_ERROR;
+	if (!config->file)
+		return CONFIG_ERROR;
+
+	pthread_mutex_lock(&config->write_mutex);
+	ret = config_write_file(config, config->file, &changes);
+	if (ret == CONFIG_SUCCESS)
+		config_mark_saved(config, changes);
+	pthread_mutex_unlock(&config->write_mutex);
+
+	return ret;
+}
+
 int config_save_safe(config_t *config, const char *temp_ext,
 		     const char *backup_ext)
 {
 	struct dstr temp_file = {0};
 	struct dstr backup_file = {0};
 	char *file = config->file;
+	uint64_t changes;
 	int ret;
 
 	if (!temp_ext || !*temp_ext) {
@@ -426,17 +650,17 @@ int config_save_safe(config_t *config, const char *temp_ext,
 				"temporary extension specified");
 		return CONFIG_ERROR;
 	}
+	if (!file)
+		return CONFIG_ERROR;
 
-	pthread_mutex_lock(&config->mutex);
+	pthread_mutex_lock(&config->write_mutex);
 
-	dstr_copy(&temp_file, config->file);
+	dstr_copy(&temp_file, file);
 	if (*temp_ext != '.')
 		dstr_cat(&temp_file, ".");
 	dstr_cat(&temp_file, temp_ext);
 
-	config->file = temp_file.array;
-	ret = config_save(config);
-	config->file = file;
+	ret = config_write_file(config, temp_file.array, &changes);
 
 	if (ret != CONFIG_SUCCESS) {
 		blog(LOG_ERROR,
@@ -447,22 +671,102 @@ int config_save_safe(config_t *config, const char *temp_ext,
 	}
 
 	if (backup_ext && *backup_ext) {
-		dstr_copy(&backup_file, config->file);
+		dstr_copy(&backup_file, file);
 		if (*backup_ext != '.')
 			dstr_cat(&backup_file, ".");
 		dstr_cat(&backup_file, backup_ext);
 	}
 
-	if (os_safe_replace(file, temp_file.array, backup_file.array) != 0)
+	if (os_safe_replace(file, temp_file.array, backup_file.array) != 0) {
+		blog(LOG_ERROR, "config_save_safe: failed to replace %s", file);
 		ret = CONFIG_ERROR;
+		goto cleanup;
+	}
+
+	config_mark_saved(config, changes);
 
 cleanup:
-	pthread_mutex_unlock(&config->mutex);
+	pthread_mutex_unlock(&config->write_mutex);
 	dstr_free(&temp_file);
 	dstr_free(&backup_file);
 	return ret;
 }
 
+static void config_save_task(void *param)
+{
+	config_t *config = param;
+	char *temp_ext;
+	char *backup_ext;
+	bool dirty;
+
+	/* anything changed after this point queues another save */
+	os_atomic_set_bool(&config->save_queued, false);
+
+	pthread_mutex_lock(&config->mutex);
+	dirty = config->changes != config->saved_changes;
+	temp_ext = bstrdup(config->async_temp_ext);
+	backup_ext = bstrdup(config->async_backup_ext);
+	pthread_mutex_unlock(&config->mutex);
+
+	if (dirty)
+		config_save_safe(config, temp_ext, backup_ext);
+
+	bfree(temp_ext);
+	bfree(backup_ext);
+}
+
+void config_save_safe_async(config_t *config, const char *temp_ext,
+			    const char *backup_ext)
+{
+	os_task_queue_t *writer;
+
+	if (!config || !config->file)
+		return;
+	if (!temp_ext || !*temp_ext) {
+		blog(LOG_ERROR, "config_save_safe_async: invalid "
+				"temporary extension specified");
+		return;
+	}
+
+	pthread_mutex_lock(&config->mutex);
+
+	bfree(config->async_temp_ext);
+	bfree(config->async_backup_ext);
+	config->async_temp_ext = bstrdup(temp_ext);
+	config->async_backup_ext = bstrdup(backup_ext);
+
+	if (!config->writer)
+		config->writer = os_task_queue_create();
+	writer = config->writer;
+
+	pthread_mutex_unlock(&config->mutex);
+
+	if (!writer) {
+		config_save_safe(config, temp_ext, backup_ext);
+		return;
+	}
+
+	/* saves requested before the writer gets to the queued one are
+	 * coalesced into it */
+	if (!os_atomic_set_bool(&config->save_queued, true))
+		os_task_queue_queue_task(writer, config_save_task, config);
+}
+
+void config_flush(config_t *config)
+{
+	os_task_queue_t *writer;
+
+	if (!config)
+		return;
+
+	pthread_mutex_lock(&config->mutex);
+	writer = config->writer;
+	pthread_mutex_unlock(&config->mutex);
+
+	if (writer)
+		os_task_queue_wait(writer);
+}
+
 void config_close(config_t *config)
 {
 	struct config_section *defaults, *sections;
@@ -471,6 +775,9 @@ void config_close(config_t *config)
 	if (!config)
 		return;
 
+	/* finishes any pending background save */
+	os_task_queue_destroy(config->writer);
+
 	defaults = config->defaults.array;
 	sections = config->sections.array;
 
@@ -481,7 +788,12 @@ void config_close(config_t *config)
 
 	darray_free(&config->defaults);
 	darray_free(&config->sections);
+	config_index_free(&config->default_index);
+	config_index_free(&config->section_index);
+	bfree(config->async_temp_ext);
+	bfree(config->async_backup_ext);
 	bfree(config->file);
+	pthread_mutex_destroy(&config->write_mutex);
 	pthread_mutex_destroy(&config->mutex);
 	bfree(config);
 }
@@ -510,72 +822,64 @@ unlock:
 	return name;
 }
 
-static const struct config_item *config_find_item(const struct darray *sections,
+static const struct config_item *config_find_item(config_t *config,
+						  const struct darray *sections,
 						  const char *section,
 						  const char *name)
 {
-	size_t i, j;
+	const struct config_index *index =
+		config_sections_index(config, sections);
+	const struct config_section *sec;
+	size_t idx;
 
-	for (i = 0; i < sections->num; i++) {
-		const struct config_section *sec =
-			darray_item(sizeof(struct config_section), sections, i);
-
-		if (astrcmpi(sec->name, section) == 0) {
-			for (j = 0; j < sec->items.num; j++) {
-				struct config_item *item =
-					darray_item(sizeof(struct config_item),
-						    &sec->items, j);
+	sec = config_find_section(sections, index, section);
+	if (!sec)
+		return NULL;
 
-				if (astrcmpi(item->name, name) == 0)
-					return item;
-			}
-		}
-	}
+	idx = config_index_find(&sec->index, &sec->items,
+				sizeof(struct config_item), name);
+	if (idx == DARRAY_INVALID)
+		return NULL;
 
-	return NULL;
+	return darray_item(sizeof(struct config_item), &sec->items, idx);
 }
 
 static void config_set_item(config_t *config, struct darray *sections,
 			    const char *section, const char *name, char *value)
 {
-	struct config_section *sec = NULL;
-	struct config_section *array = sections->array;
+	struct config_index *index = config_sections_index(config, sections);
+	struct config_section *sec;
 	struct config_item *item;
-	size_t i, j;
+	bool changed = true;
+	size_t idx;
 
 	pthread_mutex_lock(&config->mutex);
 
-	for (i = 0; i < sections->num; i++) {
-		struct config_section *cur_sec = array + i;
-		struct config_item *items = cur_sec->items.array;
-
-		if (astrcmpi(cur_sec->name, section) == 0) {
-			for (j = 0; j < cur_sec->items.num; j++) {
-				item = items + j;
-
-				if (astrcmpi(item->name, name) == 0) {
-					bfree(item->value);
-					item->value = value;
-					goto unlock;
-				}
-			}
-
-			sec = cur_sec;
-			break;
-		}
-	}
-
-	if (!sec) {
-		sec = darray_push_back_new(sizeof(struct config_section),
-					   sections);
-		sec->name = bstrdup(section);
+	sec = config_find_section(sections, index, section);
+	if (!sec)
+		sec = config_add_section(sections, index, bstrdup(section));
+
+	idx = config_index_find(&sec->index, &sec->items,
+				sizeof(struct config_item), name);
+
+	if (idx != DARRAY_INVALID) {
+		item = darray_item(sizeof(struct config_item), &sec->items,
+				   idx);
+		changed = strcmp(item->value, value) != 0;
+		bfree(item->value);
+		item->value = value;
+	} else {
+		item = darray_push_back_new(sizeof(struct config_item),
+					    &sec->items);
+		item->name = bstrdup(name);
+		item->value = value;
+		config_index_add(&sec->index, &sec->items,
+				 sizeof(struct config_item));
 	}
 
-	item = darray_push_back_new(sizeof(struct config_item), &sec->items);
-	item->name = bstrdup(name);
-	item->value = value;
+	if (changed && sections == &config->sections)
+		config->changes++;
 
-unlock:
 	pthread_mutex_unlock(&config->mutex);
 }
 
@@ -672,9 +976,10 @@ const char *config_get_string(config_t *config, const char *section,
 
 	pthread_mutex_lock(&config->mutex);
 
-	item = config_find_item(&config->sections, section, name);
+	item = config_find_item(config, &config->sections, section, name);
 	if (!item)
-		item = config_find_item(&config->defaults, section, name);
+		item = config_find_item(config, &config->defaults, section,
+					name);
 	if (item)
 		value = item->value;
 
@@ -745,31 +1050,30 @@ double config_get_double(config_t *config, const char *section,
 bool config_remove_value(config_t *config, const char *section,
 			 const char *name)
 {
-	struct darray *sections = &config->sections;
+	struct config_section *sec;
 	bool success = false;
+	size_t idx;
 
 	pthread_mutex_lock(&config->mutex);
 
-	for (size_t i = 0; i < sections->num; i++) {
-		struct config_section *sec =
-			darray_item(sizeof(struct config_section), sections, i);
+	sec = config_find_section(&config->sections, &config->section_index,
+				  section);
+	if (!sec)
+		goto unlock;
 
-		if (astrcmpi(sec->name, section) != 0)
-			continue;
+	idx = config_index_find(&sec->index, &sec->items,
+				sizeof(struct config_item), name);
+	if (idx == DARRAY_INVALID)
+		goto unlock;
 
-		for (size_t j = 0; j < sec->items.num; j++) {
-			struct config_item *item = darray_item(
-				sizeof(struct config_item), &sec->items, j);
+	config_item_free(darray_item(sizeof(struct config_item), &sec->items,
+				     idx));
+	darray_erase(sizeof(struct config_item), &sec->items, idx);
+	config_index_rebuild(&sec->index, &sec->items,
+			     sizeof(struct config_item));
 
-			if (astrcmpi(item->name, name) == 0) {
-				config_item_free(item);
-				darray_erase(sizeof(struct config_item),
-					     &sec->items, j);
-				success = true;
-				goto unlock;
-			}
-		}
-	}
+	config->changes++;
+	success = true;
 
 unlock:
 	pthread_mutex_unlock(&config->mutex);
@@ -784,7 +1088,7 @@ const char *config_get_default_string(config_t *config, const char *section,
 
 	pthread_mutex_lock(&config->mutex);
 
-	item = config_find_item(&config->defaults, section, name);
+	item = config_find_item(config, &config->defaults, section, name);
 	if (item)
 		value = item->value;
 
@@ -837,7 +1141,8 @@ bool config_has_user_value(config_t *config, const char *section,
 {
 	bool success;
 	pthread_mutex_lock(&config->mutex);
-	success = config_find_item(&config->sections, section, name) != NULL;
+	success = config_find_item(config, &config->sections, section, name) !=
+		  NULL;
 	pthread_mutex_unlock(&config->mutex);
 	return success;
 }
@@ -847,7 +1152,8 @@ bool config_has_default_value(config_t *config, const char *section,
 {
 	bool success;
 	pthread_mutex_lock(&config->mutex);
-	success = config_find_item(&config->defaults, section, name) != NULL;
+	success = config_find_item(config, &config->defaults, section, name) !=
+		  NULL;
 	pthread_mutex_unlock(&config->mutex);
 	return success;
 }
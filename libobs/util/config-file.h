@@ -48,6 +48,15 @@ EXPORT int config_open_string(config_t **config, const char *str);
 EXPORT int config_save(config_t *config);
 EXPORT int config_save_safe(config_t *config, const char *temp_ext,
 			    const char *backup_ext);
+
+/* Queues a safe save on a background writer and returns immediately.  Saves
+ * requested while one is still queued are coalesced into it, and nothing is
+ * written if no values changed since the file was last saved.  Pending saves
+ * are finished by config_flush and config_close. */
+EXPORT void config_save_safe_async(config_t *config, const char *temp_ext,
+				   const char *backup_ext);
+EXPORT void config_flush(config_t *config);
+
 EXPORT void config_close(config_t *config);
 
 EXPORT size_t config_num_sections(config_t *config);
@@ -0,0 +1,897 @@
+/*
+ * Copyright (c) 2026 Hugh Bailey <obs.jim@gmail.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <windows.h>
+#else
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <errno.h>
+#endif
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "metrics.h"
+#include "bmem.h"
+#include "darray.h"
+#include "threading.h"
+#include "platform.h"
+#include "base.h"
+
+/* ------------------------------------------------------------------------- */
+/* 64 bit atomics, values of gauges and histogram sums are stored as the bit
+ * pattern of the double so they can be updated without a lock as well */
+
+#ifdef _WIN32
+static inline int64_t atomic_load_int64(volatile int64_t *ptr)
+{
+	return InterlockedCompareExchange64((volatile LONG64 *)ptr, 0, 0);
+}
+
+static inline void atomic_store_int64(volatile int64_t *ptr, int64_t val)
+{
+	InterlockedExchange64((volatile LONG64 *)ptr, val);
+}
+
+static inline void atomic_add_int64(volatile int64_t *ptr, int64_t val)
+{
+	InterlockedExchangeAdd64((volatile LONG64 *)ptr, val);
+}
+
+static inline bool atomic_compare_swap_int64(volatile int64_t *ptr,
+					     int64_t old_val, int64_t new_val)
+{
+	return InterlockedCompareExchange64((volatile LONG64 *)ptr, new_val,
+					    old_val) == old_val;
+}
+#else
+static inline int64_t atomic_load_int64(volatile int64_t *ptr)
+{
+	return __atomic_load_n(ptr, __ATOMIC_SEQ_CST);
+}
+
+static inline void atomic_store_int64(volatile int64_t *ptr, int64_t val)
+{
+	__atomic_store_n(ptr, val, __ATOMIC_SEQ_CST);
+}
+
+static inline void atomic_add_int64(volatile int64_t *ptr, int64_t val)
+{
+	__atomic_add_fetch(ptr, val, __ATOMIC_SEQ_CST);
+}
+
+static inline bool atomic_compare_swap_int64(volatile int64_t *ptr,
+					     int64_t old_val, int64_t new_val)
+{
+	return __atomic_compare_exchange_n(ptr, &old_val, new_val, false,
+					   __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+}
+#endif
+
+static inline int64_t double_bits(double val)
+{
+	int64_t bits;
+	memcpy(&bits, &val, sizeof(bits));
+	return bits;
+}
+
+static inline double bits_double(int64_t bits)
+{
+	double val;
+	memcpy(&val, &bits, sizeof(val));
+	return val;
+}
+
+/* ------------------------------------------------------------------------- */
+/* Registry */
+
+struct metric {
+	/* first so it is always 8 byte aligned, even on 32 bit */
+	volatile int64_t value;
+
+	enum metric_type type;
+	char *name;
+	char *help;
+	char *labels;
+
+	metric_collect_func collect;
+	void *param;
+
+	/* histograms: num_bounds + 1 (non-cumulative) bucket counts */
+	size_t num_bounds;
+	double *bounds;
+	volatile int64_t *buckets;
+};
+
+static pthread_mutex_t registry_mutex = PTHREAD_MUTEX_INITIALIZER;
+static DARRAY(metric_t *) registry = {0};
+
+static bool valid_metric_name(const char *name)
+{
+	if (!name || !*name)
+		return false;
+
+	for (const char *c = name; *c; c++) {
+		bool alpha = (*c >= 'a' && *c <= 'z') ||
+			     (*c >= 'A' && *c <= 'Z') || *c == '_' ||
+			     *c == ':';
+		bool digit = *c >= '0' && *c <= '9';
+
+		if (!alpha && !(digit && c != name))
+			return false;
+	}
+
+	return true;
+}
+
+static metric_t *metric_create(const char *name, const char *help,
+			       const char *labels, enum metric_type type)
+{
+	metric_t *metric;
+
+	if (!valid_metric_name(name)) {
+		blog(LOG_WARNING, "metrics: Invalid metric name '%s'",
+		     name ? name : "(null)");
+		return NULL;
+	}
+
+	metric = bzalloc(sizeof(struct metric));
+	metric->type = type;
+	metric->name = bstrdup(name);
+	metric->help = bstrdup(help ? help : "");
+	metric->labels = bstrdup(labels ? labels : "");
+	return metric;
+}
+
+static void metric_register(metric_t *metric)
+{
+	pthread_mutex_lock(&registry_mutex);
+	da_push_back(registry, &metric);
+	pthread_mutex_unlock(&registry_mutex);
+}
+
+metric_t *metrics_counter_create(const char *name, const char *help,
+				 const char *labels)
+{
+	metric_t *metric = metric_create(name, help, labels, METRIC_COUNTER);
+	if (metric)
+		metric_register(metric);
+	return metric;
+}
+
+metric_t *metrics_gauge_create(const char *name, const char *help,
+			       const char *labels)
+{
+	metric_t *metric = metric_create(name, help, labels, METRIC_GAUGE);
+	if (metric) {
+		metric->value = double_bits(0.0);
+		metric_register(metric);
+	}
+	return metric;
+}
+
+metric_t *metrics_histogram_create(const char *name, const char *help,
+				   const char *labels, const double *bounds,
+				   size_t num_bounds)
+{
+	metric_t *metric;
+
+	for (size_t i = 1; i < num_bounds; i++) {
+		if (!(bounds[i] > bounds[i - 1])) {
+			blog(LOG_WARNING,
+			     "metrics: Histogram '%s' has unsorted bounds",
+			     name);
+			return NULL;
+		}
+	}
+
+	metric = metric_create(name, help, labels, METRIC_HISTOGRAM);
+	if (!metric)
+		return NULL;
+
+	metric->value = double_bits(0.0);
+	metric->num_bounds = num_bounds;
+	metric->buckets = bzalloc(sizeof(int64_t) * (num_bounds + 1));
+	if (num_bounds)
+		metric->bounds = bmemdup(bounds, sizeof(double) * num_bounds);
+
+	metric_register(metric);
+	return metric;
+}
+
+metric_t *metrics_collector_create(const char *name, const char *help,
+				   const char *labels, enum metric_type type,
+				   metric_collect_func collect, void *param)
+{
+	metric_t *metric;
+
+	if (!collect || type == METRIC_HISTOGRAM)
+		return NULL;
+
+	metric = metric_create(name, help, labels, type);
+	if (metric) {
+		metric->collect = collect;
+		metric->param = param;
+		metric_register(metric);
+	}
+	return metric;
+}
+
+void metrics_destroy(metric_t *metric)
+{
+	if (!metric)
+		return;
+
+	pthread_mutex_lock(&registry_mutex);
+	da_erase_item(registry, &metric);
+	if (!registry.num)
+		da_free(registry);
+	pthread_mutex_unlock(&registry_mutex);
+
+	bfree(metric->name);
+	bfree(metric->help);
+	bfree(metric->labels);
+	bfree(metric->bounds);
+	bfree((void *)metric->buckets);
+	bfree(metric);
+}
+
+void metrics_append_label(struct dstr *labels, const char *key,
+			  const char *value)
+{
+	if (!key || !value)
+		return;
+
+	if (labels->len)
+		dstr_cat_ch(labels, ',');
+	dstr_cat(labels, key);
+	dstr_cat(labels, "=\"");
+
+	for (const char *c = value; *c; c++) {
+		if (*c == '\\')
+			dstr_cat(labels, "\\\\");
+		else if (*c == '"')
+			dstr_cat(labels, "\\\"");
+		else if (*c == '\n')
+			dstr_cat(labels, "\\n");
+		else
+			dstr_cat_ch(labels, *c);
+	}
+
+	dstr_cat_ch(labels, '"');
+}
+
+/* ------------------------------------------------------------------------- */
+/* Updates */
+
+void metrics_counter_add(metric_t *metric, uint64_t value)
+{
+	if (metric)
+		atomic_add_int64(&metric->value, (int64_t)value);
+}
+
+void metrics_gauge_set(metric_t *metric, double value)
+{
+	if (metric)
+		atomic_store_int64(&metric->value, double_bits(value));
+}
+
+static inline void add_double(volatile int64_t *ptr, double value)
+{
+	int64_t old_bits;
+
+	do {
+		old_bits = atomic_load_int64(ptr);
+	} while (!atomic_compare_swap_int64(
+		ptr, old_bits, double_bits(bits_double(old_bits) + value)));
+}
+
+void metrics_gauge_add(metric_t *metric, double value)
+{
+	if (metric)
+		add_double(&metric->value, value);
+}
+
+void metrics_histogram_observe(metric_t *metric, double value)
+{
+	size_t lo = 0, hi;
+
+	if (!metric || !metric->buckets)
+		return;
+
+	/* first bucket whose upper bound is >= value */
+	hi = metric->num_bounds;
+	while (lo < hi) {
+		size_t mid = (lo + hi) / 2;
+		if (metric->bounds[mid] < value)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	atomic_add_int64(&metric->buckets[lo], 1);
+	add_double(&metric->value, value);
+}
+
+uint64_t metrics_histogram_read(metric_t *metric, uint64_t *buckets,
+				size_t num_buckets, double *sum)
+{
+	uint64_t total = 0;
+
+	if (sum)
+		*sum = 0.0;
+	if (!metric || !metric->buckets)
+		return 0;
+
+	for (size_t i = 0; i <= metric->num_bounds; i++) {
+		total += (uint64_t)atomic_load_int64(&metric->buckets[i]);
+		if (buckets && i < num_buckets)
+			buckets[i] = total;
+	}
+
+	if (sum)
+		*sum = bits_double(atomic_load_int64(&metric->value));
+	return total;
+}
+
+/* ------------------------------------------------------------------------- */
+/* Snapshots */
+
+struct metrics_snapshot {
+	DARRAY(struct metrics_sample) samples;
+};
+
+static void snapshot_metric(struct metrics_sample *sample, metric_t *metric)
+{
+	sample->name = bstrdup(metric->name);
+	sample->help = bstrdup(metric->help);
+	sample->labels = bstrdup(metric->labels);
+	sample->type = metric->type;
+
+	if (metric->collect) {
+		sample->value = metric->collect(metric->param);
+
+	} else if (metric->type == METRIC_COUNTER) {
+		sample->value = (double)atomic_load_int64(&metric->value);
+
+	} else if (metric->type == METRIC_GAUGE) {
+		sample->value = bits_double(atomic_load_int64(&metric->value));
+
+	} else {
+		size_t num = metric->num_bounds + 1;
+		uint64_t *buckets = bmalloc(sizeof(uint64_t) * num);
+		uint64_t total = 0;
+
+		for (size_t i = 0; i < num; i++) {
+			total += (uint64_t)atomic_load_int64(
+				&metric->buckets[i]);
+			buckets[i] = total;
+		}
+
+		sample->value = bits_double(atomic_load_int64(&metric->value));
+		sample->count = total;
+		sample->num_buckets = num;
+		sample->buckets = buckets;
+		if (metric->num_bounds)
+			sample->bounds = bmemdup(metric->bounds,
+						 sizeof(double) *
+							 metric->num_bounds);
+	}
+}
+
+metrics_snapshot_t *metrics_snapshot_create(void)
+{
+	metrics_snapshot_t *snap = bzalloc(sizeof(struct metrics_snapshot));
+
+	pthread_mutex_lock(&registry_mutex);
+	for (size_t i = 0; i < registry.num; i++) {
+		struct metrics_sample *sample = da_push_back_new(snap->samples);
+		snapshot_metric(sample, registry.array[i]);
+	}
+	pthread_mutex_unlock(&registry_mutex);
+
+	return snap;
+}
+
+void metrics_snapshot_free(metrics_snapshot_t *snap)
+{
+	if (!snap)
+		return;
+
+	for (size_t i = 0; i < snap->samples.num; i++) {
+		struct metrics_sample *sample = &snap->samples.array[i];
+		bfree((char *)sample->name);
+		bfree((char *)sample->help);
+		bfree((char *)sample->labels);
+		bfree((double *)sample->bounds);
+		bfree((uint64_t *)sample->buckets);
+	}
+
+	da_free(snap->samples);
+	bfree(snap);
+}
+
+size_t metrics_snapshot_size(const metrics_snapshot_t *snap)
+{
+	return snap ? snap->samples.num : 0;
+}
+
+void metrics_snapshot_enumerate(const metrics_snapshot_t *snap,
+				metrics_enum_func func, void *param)
+{
+	if (!snap || !func)
+		return;
+
+	for (size_t i = 0; i < snap->samples.num; i++) {
+		if (!func(param, &snap->samples.array[i]))
+			break;
+	}
+}
+
+static void cat_value(struct dstr *out, double value)
+{
+	if (isnan(value))
+		dstr_cat(out, "NaN");
+	else if (isinf(value))
+		dstr_cat(out, value > 0.0 ? "+Inf" : "-Inf");
+	else
+		dstr_catf(out, "%.17g", value);
+}
+
+static void cat_sample_line(struct dstr *out, const char *name,
+			    const char *suffix, const char *labels,
+			    const char *extra_label, double value)
+{
+	bool has_labels = *labels || extra_label;
+
+	dstr_cat(out, name);
+	dstr_cat(out, suffix);
+
+	if (has_labels) {
+		dstr_cat_ch(out, '{');
+		dstr_cat(out, labels);
+		if (extra_label) {
+			if (*labels)
+				dstr_cat_ch(out, ',');
+			dstr_cat(out, extra_label);
+		}
+		dstr_cat_ch(out, '}');
+	}
+
+	dstr_cat_ch(out, ' ');
+	cat_value(out, value);
+	dstr_cat_ch(out, '\n');
+}
+
+static void cat_help(struct dstr *out, const char *help)
+{
+	for (const char *c = help; *c; c++) {
+		if (*c == '\\')
+			dstr_cat(out, "\\\\");
+		else if (*c == '\n')
+			dstr_cat(out, "\\n");
+		else
+			dstr_cat_ch(out, *c);
+	}
+}
+
+static void cat_sample(struct dstr *out, const struct metrics_sample *sample)
+{
+	struct dstr le = {0};
+
+	if (sample->type != METRIC_HISTOGRAM) {
+		cat_sample_line(out, sample->name, "", sample->labels, NULL,
+				sample->value);
+		return;
+	}
+
+	for (size_t i = 0; i < sample->num_buckets; i++) {
+		bool inf = i == sample->num_buckets - 1;
+
+		dstr_copy(&le, "le=\"");
+		if (inf)
+			dstr_cat(&le, "+Inf");
+		else
+			cat_value(&le, sample->bounds[i]);
+		dstr_cat_ch(&le, '"');
+
+		cat_sample_line(out, sample->name, "_bucket", sample->labels,
+				le.array, (double)sample->buckets[i]);
+	}
+
+	cat_sample_line(out, sample->name, "_sum", sample->labels, NULL,
+			sample->value);
+	cat_sample_line(out, sample->name, "_count", sample->labels, NULL,
+			(double)sample->count);
+	dstr_free(&le);
+}
+
+static const char *type_names[] = {"counter", "gauge", "histogram"};
+
+char *metrics_snapshot_to_prometheus(const metrics_snapshot_t *snap)
+{
+	struct dstr out = {0};
+	size_t num = snap ? snap->samples.num : 0;
+	bool *written = bzalloc(num ? num : 1);
+
+	/* every sample of a metric family has to be in the same group, with
+	 * a single HELP and TYPE line */
+	for (size_t i = 0; i < num; i++) {
+		const struct metrics_sample *first = &snap->samples.array[i];
+
+		if (written[i])
+			continue;
+
+		dstr_catf(&out, "# HELP %s ", first->name);
+		cat_help(&out, first->help);
+		dstr_catf(&out, "\n# TYPE %s %s\n", first->name,
+			  type_names[first->type]);
+
+		for (size_t j = i; j < num; j++) {
+			const struct metrics_sample *sample =
+				&snap->samples.array[j];
+
+			if (written[j] || sample->type != first->type)
+				continue;
+			if (strcmp(sample->name, first->name) != 0)
+				continue;
+
+			cat_sample(&out, sample);
+			written[j] = true;
+		}
+	}
+
+	bfree(written);
+	return out.array ? out.array : bstrdup("");
+}
+
+/* ------------------------------------------------------------------------- */
+/* Exporter */
+
+#ifdef _WIN32
+typedef SOCKET metrics_socket_t;
+#define INVALID_METRICS_SOCKET INVALID_SOCKET
+#define close_metrics_socket closesocket
+#else
+typedef int metrics_socket_t;
+#define INVALID_METRICS_SOCKET -1
+#define close_metrics_socket close
+#endif
+
+#ifdef MSG_NOSIGNAL
+#define SEND_FLAGS MSG_NOSIGNAL
+#else
+#define SEND_FLAGS 0
+#endif
+
+#define EXPORTER_POLL_MS 250
+#define EXPORTER_TIMEOUT_MS 2000
+
+struct metrics_exporter {
+	pthread_t thread;
+	bool active;
+	volatile bool stop;
+
+	metrics_socket_t socket;
+	char *unix_path;
+#ifdef _WIN32
+	bool wsa_initialized;
+#endif
+};
+
+static pthread_mutex_t exporter_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct metrics_exporter exporter = {0};
+
+static bool wait_readable(metrics_socket_t sock, long ms)
+{
+	struct timeval tv = {ms / 1000, (ms % 1000) * 1000};
+	fd_set set;
+
+	FD_ZERO(&set);
+	FD_SET(sock, &set);
+	return select((int)sock + 1, &set, NULL, NULL, &tv) > 0;
+}
+
+static bool send_all(metrics_socket_t sock, const char *data, size_t size)
+{
+	while (size) {
+		int chunk = size > 0x10000 ? 0x10000 : (int)size;
+		int ret = (int)send(sock, data, chunk, SEND_FLAGS);
+
+		if (ret <= 0)
+			return false;
+
+		data += ret;
+		size -= (size_t)ret;
+	}
+
+	return true;
+}
+
+/* reads the request header.  anything but GET /metrics or GET / is a 404 */
+static bool read_request(metrics_socket_t sock, bool *found)
+{
+	char request[2048];
+	size_t size = 0;
+
+	while (size < sizeof(request) - 1) {
+		int ret;
+
+		if (!wait_readable(sock, EXPORTER_TIMEOUT_MS))
+			return false;
+
+		ret = (int)recv(sock, request + size,
+				(int)(sizeof(request) - 1 - size), 0);
+		if (ret <= 0)
+			return false;
+
+		size += (size_t)ret;
+		request[size] = 0;
+
+		if (strstr(request, "\r\n\r\n") || strstr(request, "\n\n"))
+			break;
+	}
+
+	request[size] = 0;
+	*found = strncmp(request, "GET /metrics ", 13) == 0 ||
+		 strncmp(request, "GET / ", 6) == 0;
+	return true;
+}
+
+static void serve_connection(metrics_socket_t sock)
+{
+	struct dstr response = {0};
+	bool found;
+
+	if (!read_request(sock, &found))
+		return;
+
+	if (found) {
+		metrics_snapshot_t *snap = metrics_snapshot_create();
+		char *body = metrics_snapshot_to_prometheus(snap);
+		size_t len = body ? strlen(body) : 0;
+
+		dstr_printf(&response,
+			    "HTTP/1.0 200 OK\r\n"
+			    "Content-Type: text/plain; version=0.0.4\r\n"
+			    "Content-Length: %zu\r\n"
+			    "Connection: close\r\n\r\n",
+			    len);
+		if (body)
+			dstr_cat(&response, body);
+
+		bfree(body);
+		metrics_snapshot_free(snap);
+	} else {
+		dstr_copy(&response, "HTTP/1.0 404 Not Found\r\n"
+				     "Content-Length: 0\r\n"
+				     "Connection: close\r\n\r\n");
+	}
+
+	send_all(sock, response.array, response.len);
+	dstr_free(&response);
+}
+
+static void *exporter_thread(void *unused)
+{
+	os_set_thread_name("metrics: exporter");
+
+	while (!os_atomic_load_bool(&exporter.stop)) {
+		metrics_socket_t client;
+
+		if (!wait_readable(exporter.socket, EXPORTER_POLL_MS))
+			continue;
+
+		client = accept(exporter.socket, NULL, NULL);
+		if (client == INVALID_METRICS_SOCKET)
+			continue;
+
+		serve_connection(client);
+		close_metrics_socket(client);
+	}
+
+	UNUSED_PARAMETER(unused);
+	return NULL;
+}
+
+#ifndef _WIN32
+static metrics_socket_t listen_unix(const char *path)
+{
+	struct sockaddr_un addr = {0};
+	metrics_socket_t sock;
+
+	if (strlen(path) >= sizeof(addr.sun_path)) {
+		blog(LOG_WARNING, "metrics: Socket path '%s' is too long",
+		     path);
+		return INVALID_METRICS_SOCKET;
+	}
+
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, path);
+
+	sock = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (sock == INVALID_METRICS_SOCKET)
+		return INVALID_METRICS_SOCKET;
+
+	/* a stale socket from a previous run would make bind fail */
+	unlink(path);
+
+	if (bind(sock, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+	    listen(sock, 8) != 0) {
+		blog(LOG_WARNING, "metrics: Failed to listen on '%s': %s",
+		     path, strerror(errno));
+		close_metrics_socket(sock);
+		return INVALID_METRICS_SOCKET;
+	}
+
+	return sock;
+}
+#endif
+
+static metrics_socket_t listen_loopback(const char *address)
+{
+	const char *port_str = strrchr(address, ':');
+	struct sockaddr_in addr = {0};
+	metrics_socket_t sock;
+	long port;
+	char *end;
+	int one = 1;
+
+	if (port_str) {
+		size_t host_len = (size_t)(port_str - address);
+		bool loopback = host_len == 9 &&
+				(strncmp(address, "127.0.0.1", 9) == 0 ||
+				 strncmp(address, "localhost", 9) == 0);
+
+		if (!loopback) {
+			blog(LOG_WARNING,
+			     "metrics: Refusing to listen on non-loopback "
+			     "address '%s'",
+			     address);
+			return INVALID_METRICS_SOCKET;
+		}
+
+		port_str++;
+	} else {
+		port_str = address;
+	}
+
+	port = strtol(port_str, &end, 10);
+	if (*end || port <= 0 || port > 65535) {
+		blog(LOG_WARNING, "metrics: Invalid exporter address '%s'",
+		     address);
+		return INVALID_METRICS_SOCKET;
+	}
+
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = htons((unsigned short)port);
+
+	sock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	if (sock == INVALID_METRICS_SOCKET)
+		return INVALID_METRICS_SOCKET;
+
+	setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, (const char *)&one,
+		   sizeof(one));
+
+	if (bind(sock, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+	    listen(sock, 8) != 0) {
+		blog(LOG_WARNING, "metrics: Failed to listen on port %ld",
+		     port);
+		close_metrics_socket(sock);
+		return INVALID_METRICS_SOCKET;
+	}
+
+	return sock;
+}
+
+static void exporter_close(void)
+{
+	if (exporter.socket != INVALID_METRICS_SOCKET)
+		close_metrics_socket(exporter.socket);
+	exporter.socket = INVALID_METRICS_SOCKET;
+
+#ifndef _WIN32
+	if (exporter.unix_path)
+		unlink(exporter.unix_path);
+#endif
+	bfree(exporter.unix_path);
+	exporter.unix_path = NULL;
+
+#ifdef _WIN32
+	if (exporter.wsa_initialized)
+		WSACleanup();
+	exporter.wsa_initialized = false;
+#endif
+}
+
+bool metrics_exporter_start(const char *address)
+{
+	bool success = false;
+
+	if (!address || !*address)
+		return false;
+
+	pthread_mutex_lock(&exporter_mutex);
+
+	if (exporter.active) {
+		blog(LOG_WARNING, "metrics: Exporter is already running");
+		goto unlock;
+	}
+
+	exporter.socket = INVALID_METRICS_SOCKET;
+
+#ifdef _WIN32
+	WSADATA wsad;
+	if (WSAStartup(MAKEWORD(2, 2), &wsad) != 0)
+		goto unlock;
+	exporter.wsa_initialized = true;
+#endif
+
+	if (strncmp(address, "unix:", 5) == 0) {
+#ifdef _WIN32
+		blog(LOG_WARNING, "metrics: UNIX sockets are not supported "
+				  "on this platform");
+#else
+		exporter.socket = listen_unix(address + 5);
+		if (exporter.socket != INVALID_METRICS_SOCKET)
+			exporter.unix_path = bstrdup(address + 5);
+#endif
+	} else {
+		exporter.socket = listen_loopback(address);
+	}
+
+	if (exporter.socket == INVALID_METRICS_SOCKET)
+		goto fail;
+
+	os_atomic_set_bool(&exporter.stop, false);
+	if (pthread_create(&exporter.thread, NULL, exporter_thread, NULL) != 0)
+		goto fail;
+
+	blog(LOG_INFO, "metrics: Exporter listening on '%s'", address);
+	exporter.active = true;
+	success = true;
+	goto unlock;
+
+fail:
+	exporter_close();
+unlock:
+	pthread_mutex_unlock(&exporter_mutex);
+	return success;
+}
+
+void metrics_exporter_stop(void)
+{
+	pthread_mutex_lock(&exporter_mutex);
+
+	if (exporter.active) {
+		os_atomic_set_bool(&exporter.stop, true);
+		pthread_join(exporter.thread, NULL);
+		exporter_close();
+		exporter.active = false;
+	}
+
+	pthread_mutex_unlock(&exporter_mutex);
+}
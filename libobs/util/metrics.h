@@ -0,0 +1,137 @@
+/*
+ * Copyright (c) 2026 Hugh Bailey <obs.jim@gmail.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#pragma once
+
+#include "c99defs.h"
+#include "dstr.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Process wide registry of runtime metrics (counters, gauges and histograms).
+ *
+ *   Registering and destroying a metric locks the registry, but updating one
+ * only uses atomic operations, so the render and audio threads never block
+ * on a snapshot or on the exporter.  Collector metrics are read from a
+ * callback whenever a snapshot is taken instead, for values that are
+ * already tracked elsewhere.
+ */
+
+typedef struct metric metric_t;
+typedef struct metrics_snapshot metrics_snapshot_t;
+
+enum metric_type {
+	METRIC_COUNTER,
+	METRIC_GAUGE,
+	METRIC_HISTOGRAM,
+};
+
+typedef double (*metric_collect_func)(void *param);
+
+/* ------------------------------------------------------------------------- */
+/* Registration */
+
+/* names must match [a-zA-Z_:][a-zA-Z0-9_:]*, labels are either NULL or in
+ * the form key="value",key2="value2" (see metrics_append_label) */
+EXPORT metric_t *metrics_counter_create(const char *name, const char *help,
+					const char *labels);
+EXPORT metric_t *metrics_gauge_create(const char *name, const char *help,
+				      const char *labels);
+/* bounds are the upper bounds of each bucket in ascending order, a +Inf
+ * bucket is always added */
+EXPORT metric_t *metrics_histogram_create(const char *name, const char *help,
+					  const char *labels,
+					  const double *bounds,
+					  size_t num_bounds);
+/* type must be METRIC_COUNTER or METRIC_GAUGE */
+EXPORT metric_t *metrics_collector_create(const char *name, const char *help,
+					  const char *labels,
+					  enum metric_type type,
+					  metric_collect_func collect,
+					  void *param);
+
+/* once this returns, the collect callback of the metric is not called again */
+EXPORT void metrics_destroy(metric_t *metric);
+
+EXPORT void metrics_append_label(struct dstr *labels, const char *key,
+				 const char *value);
+
+/* ------------------------------------------------------------------------- */
+/* Updates (lock-free, NULL metrics are ignored) */
+
+EXPORT void metrics_counter_add(metric_t *metric, uint64_t value);
+EXPORT void metrics_gauge_set(metric_t *metric, double value);
+EXPORT void metrics_gauge_add(metric_t *metric, double value);
+EXPORT void metrics_histogram_observe(metric_t *metric, double value);
+
+/* reads a single histogram without taking a snapshot.  fills in up to
+ * num_buckets cumulative bucket counts and returns the observation count */
+EXPORT uint64_t metrics_histogram_read(metric_t *metric, uint64_t *buckets,
+				       size_t num_buckets, double *sum);
+
+static inline void metrics_counter_inc(metric_t *metric)
+{
+	metrics_counter_add(metric, 1);
+}
+
+/* ------------------------------------------------------------------------- */
+/* Snapshots */
+
+struct metrics_sample {
+	const char *name;
+	const char *help;
+	const char *labels; /* never NULL */
+	enum metric_type type;
+
+	/* counter or gauge value, or the sum of all histogram observations */
+	double value;
+
+	/* histograms only.  buckets are cumulative, the last one is +Inf and
+	 * is equal to count */
+	uint64_t count;
+	size_t num_buckets;
+	const double *bounds;
+	const uint64_t *buckets;
+};
+
+typedef bool (*metrics_enum_func)(void *param,
+				  const struct metrics_sample *sample);
+
+EXPORT metrics_snapshot_t *metrics_snapshot_create(void);
+EXPORT void metrics_snapshot_free(metrics_snapshot_t *snap);
+
+EXPORT size_t metrics_snapshot_size(const metrics_snapshot_t *snap);
+EXPORT void metrics_snapshot_enumerate(const metrics_snapshot_t *snap,
+				       metrics_enum_func func, void *param);
+
+/* Prometheus text exposition format, free with bfree */
+EXPORT char *metrics_snapshot_to_prometheus(const metrics_snapshot_t *snap);
+
+/* ------------------------------------------------------------------------- */
+/* Exporter */
+
+/* serves the Prometheus text format over HTTP on a local endpoint, either
+ * "unix:/path/to/socket" (not on windows), "port" or "127.0.0.1:port".
+ * only loopback addresses are accepted. */
+EXPORT bool metrics_exporter_start(const char *address);
+EXPORT void metrics_exporter_stop(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -18,6 +18,8 @@
 #include <errno.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
 #include <sys/statvfs.h>
 #include <dirent.h>
 #include <stdlib.h>
@@ -570,6 +572,39 @@ int os_safe_replace(const char *target, const char *from, const char *backup)
 	return rename(from, target);
 }
 
+const void *os_mmap_file(const char *path, size_t *size)
+{
+	struct stat st;
+	void *data = NULL;
+	int fd;
+
+	if (!path || !size)
+		return NULL;
+
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd == -1)
+		return NULL;
+
+	if (fstat(fd, &st) == 0 && st.st_size > 0 &&
+	    (uint64_t)st.st_size <= SIZE_MAX) {
+		data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE,
+			    fd, 0);
+		if (data == MAP_FAILED)
+			data = NULL;
+		else
+			*size = (size_t)st.st_size;
+	}
+
+	close(fd);
+	return data;
+}
+
+void os_munmap_file(const void *data, size_t size)
+{
+	if (data)
+		munmap((void *)data, size);
+}
+
 #if !defined(__APPLE__)
 os_performance_token_t *os_request_high_performance(const char *reason)
 {
@@ -770,6 +770,56 @@ fail:
 	return code;
 }
 
+const void *os_mmap_file(const char *path, size_t *size)
+{
+	HANDLE file = INVALID_HANDLE_VALUE;
+	HANDLE mapping = NULL;
+	wchar_t *wpath = NULL;
+	LARGE_INTEGER file_size;
+	void *data = NULL;
+
+	if (!path || !size)
+		return NULL;
+	if (!os_utf8_to_wcs_ptr(path, 0, &wpath))
+		return NULL;
+
+	/* FILE_SHARE_DELETE so the file can still be replaced while mapped */
+	file = CreateFileW(wpath, GENERIC_READ,
+			   FILE_SHARE_READ | FILE_SHARE_DELETE, NULL,
+			   OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	bfree(wpath);
+
+	if (file == INVALID_HANDLE_VALUE)
+		return NULL;
+
+	if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart <= 0 ||
+	    (uint64_t)file_size.QuadPart > SIZE_MAX)
+		goto cleanup;
+
+	mapping = CreateFileMappingW(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (!mapping)
+		goto cleanup;
+
+	data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (data)
+		*size = (size_t)file_size.QuadPart;
+
+cleanup:
+	/* the view keeps the mapping alive */
+	if (mapping)
+		CloseHandle(mapping);
+	CloseHandle(file);
+	return data;
+}
+
+void os_munmap_file(const void *data, size_t size)
+{
+	if (data)
+		UnmapViewOfFile(data);
+
+	UNUSED_PARAMETER(size);
+}
+
 BOOL WINAPI DllMain(HINSTANCE hinst_dll, DWORD reason, LPVOID reserved)
 {
 	switch (reason) {
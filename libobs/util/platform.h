@@ -61,6 +61,10 @@ EXPORT bool os_quick_write_mbs_file(const char *path, const char *str,
 EXPORT int64_t os_get_file_size(const char *path);
 EXPORT int64_t os_get_free_space(const char *path);
 
+/* maps a whole file read-only, returns NULL on failure or if it is empty */
+EXPORT const void *os_mmap_file(const char *path, size_t *size);
+EXPORT void os_munmap_file(const void *data, size_t size);
+
 EXPORT size_t os_mbs_to_wcs(const char *str, size_t str_len, wchar_t *dst,
 			    size_t dst_size);
 EXPORT size_t os_utf8_to_wcs(const char *str, size_t len, wchar_t *dst,
@@ -263,6 +263,359 @@ static DARRAY(profile_root_entry) root_entries;
 static THREAD_LOCAL profile_call *thread_context = NULL;
 static THREAD_LOCAL bool thread_enabled = true;
 
+/* ------------------------------------------------------------------------- */
+/* Trace recording */
+
+#define TRACE_DEFAULT_EVENTS 8192
+#define TRACE_MAX_THREADS 256
+#define TRACE_NAME_SIZE 64
+
+struct trace_event {
+	const char *name;
+	uint64_t time;
+	bool end;
+};
+
+/* written only by its owning thread; the head is a free running event count,
+ * published after the event itself has been written.  rings of threads that
+ * exited are kept for the next new thread rather than freed */
+struct trace_thread {
+	struct trace_thread *next;
+	char name[TRACE_NAME_SIZE];
+	long id;
+	bool in_use;
+	volatile long *writing; /* thread_trace_writing of the owner */
+	size_t capacity;
+	volatile long head;
+	struct trace_event *events;
+};
+
+static volatile bool trace_enabled = false;
+static volatile long trace_generation = 1;
+static size_t trace_capacity = TRACE_DEFAULT_EVENTS;
+static pthread_mutex_t trace_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct trace_thread *trace_threads = NULL;
+static size_t trace_thread_rings = 0;
+static long trace_thread_count = 0;
+static pthread_key_t trace_thread_key;
+static bool trace_thread_key_created = false;
+
+static THREAD_LOCAL struct trace_thread *thread_trace = NULL;
+static THREAD_LOCAL long thread_trace_generation = 0;
+static THREAD_LOCAL volatile long thread_trace_writing = 0;
+
+void profiler_trace_start(size_t events_per_thread)
+{
+	size_t capacity = 1;
+
+	if (!events_per_thread)
+		events_per_thread = TRACE_DEFAULT_EVENTS;
+	while (capacity < events_per_thread)
+		capacity <<= 1;
+
+	pthread_mutex_lock(&trace_mutex);
+	trace_capacity = capacity;
+	os_atomic_store_bool(&trace_enabled, true);
+	pthread_mutex_unlock(&trace_mutex);
+}
+
+void profiler_trace_stop(void)
+{
+	os_atomic_store_bool(&trace_enabled, false);
+}
+
+/* the key holds the id rather than the ring, so a ring that was freed or
+ * handed to another thread in the meantime is never touched */
+static void trace_thread_exit(void *param)
+{
+	long id = (long)(intptr_t)param;
+
+	pthread_mutex_lock(&trace_mutex);
+	for (struct trace_thread *thread = trace_threads; thread;
+	     thread = thread->next) {
+		if (thread->id == id) {
+			thread->in_use = false;
+			break;
+		}
+	}
+	pthread_mutex_unlock(&trace_mutex);
+}
+
+static struct trace_thread *trace_find_free_ring(void)
+{
+	for (struct trace_thread *thread = trace_threads; thread;
+	     thread = thread->next) {
+		if (!thread->in_use)
+			return thread;
+	}
+
+	return NULL;
+}
+
+/* the only allocation, made on the first event of each thread.  returns NULL
+ * if tracing was stopped or every ring is in use, in which case the thread
+ * doesn't record until the next profiler_free() */
+static struct trace_thread *trace_register_thread(void)
+{
+	struct trace_thread *thread = NULL;
+	const char *name = os_get_thread_name();
+
+	pthread_mutex_lock(&trace_mutex);
+
+	thread_trace_generation = os_atomic_load_long(&trace_generation);
+
+	if (!os_atomic_load_bool(&trace_enabled))
+		goto unlock;
+
+	if (!trace_thread_key_created) {
+		if (pthread_key_create(&trace_thread_key, trace_thread_exit) !=
+		    0)
+			goto unlock;
+		trace_thread_key_created = true;
+	}
+
+	thread = trace_find_free_ring();
+	if (thread) {
+		if (thread->capacity != trace_capacity) {
+			bfree(thread->events);
+			thread->events = bmalloc(trace_capacity *
+						 sizeof(struct trace_event));
+			thread->capacity = trace_capacity;
+		}
+
+		memset(thread->events, 0,
+		       thread->capacity * sizeof(struct trace_event));
+		thread->head = 0;
+
+	} else if (trace_thread_rings < TRACE_MAX_THREADS) {
+		thread = bzalloc(sizeof(struct trace_thread));
+		thread->capacity = trace_capacity;
+		thread->events =
+			bzalloc(trace_capacity * sizeof(struct trace_event));
+		thread->next = trace_threads;
+		trace_threads = thread;
+		trace_thread_rings++;
+
+	} else {
+		goto unlock;
+	}
+
+	thread->id = ++trace_thread_count;
+	thread->in_use = true;
+	thread->writing = &thread_trace_writing;
+	if (name)
+		snprintf(thread->name, sizeof(thread->name), "%s", name);
+	else
+		snprintf(thread->name, sizeof(thread->name), "Thread %ld",
+			 thread->id);
+
+	pthread_setspecific(trace_thread_key, (void *)(intptr_t)thread->id);
+
+unlock:
+	pthread_mutex_unlock(&trace_mutex);
+	return thread;
+}
+
+static inline void trace_record(const char *name, uint64_t time, bool end)
+{
+	struct trace_thread *thread;
+	struct trace_event *event;
+	unsigned long head;
+
+	/* the flag is raised before checking whether tracing is still
+	 * enabled, so trace_free() can wait for every thread that saw it
+	 * enabled.  registering locks the trace mutex, which trace_free()
+	 * holds while waiting, so that happens with the flag lowered */
+	for (;;) {
+		os_atomic_store_long(&thread_trace_writing, 1);
+		if (!os_atomic_load_bool(&trace_enabled))
+			goto done;
+		if (thread_trace_generation ==
+		    os_atomic_load_long(&trace_generation))
+			break;
+
+		os_atomic_store_long(&thread_trace_writing, 0);
+		thread_trace = trace_register_thread();
+	}
+
+	thread = thread_trace;
+	if (!thread)
+		goto done;
+
+	head = (unsigned long)thread->head;
+	event = &thread->events[head & (thread->capacity - 1)];
+	event->name = name;
+	event->time = time;
+	event->end = end;
+
+	os_atomic_store_long(&thread->head, (long)(head + 1));
+
+done:
+	os_atomic_store_long(&thread_trace_writing, 0);
+}
+
+/* copies the events of a thread that are known to be intact, oldest first,
+ * while the thread keeps writing */
+static size_t trace_copy_events(struct trace_thread *thread,
+				struct trace_event *copy,
+				struct trace_event *out)
+{
+	size_t mask = thread->capacity - 1;
+	long head = os_atomic_load_long(&thread->head);
+	long head_after = head;
+	unsigned long overwritten;
+	unsigned long count;
+	size_t num = 0;
+
+	memcpy(copy, thread->events,
+	       thread->capacity * sizeof(struct trace_event));
+
+	/* unlike a plain load, a compare-exchange can't be reordered before
+	 * the copy on any platform */
+	os_atomic_compare_exchange_long(&thread->head, &head_after, head);
+
+	/* events written while copying may have replaced the oldest ones */
+	overwritten = (unsigned long)head_after - (unsigned long)head;
+	if (overwritten >= mask)
+		return 0;
+
+	count = (unsigned long)mask - overwritten;
+	for (unsigned long i = 0; i < count; i++) {
+		unsigned long idx = (unsigned long)head - count + i;
+		struct trace_event *event = &copy[idx & mask];
+
+		if (event->name)
+			out[num++] = *event;
+	}
+
+	return num;
+}
+
+static void trace_write_string(FILE *f, const char *str)
+{
+	fputc('"', f);
+	for (; *str; str++) {
+		unsigned char c = (unsigned char)*str;
+
+		if (c == '"' || c == '\\')
+			fprintf(f, "\\%c", c);
+		else if (c < 0x20)
+			fprintf(f, "\\u%04x", c);
+		else
+			fputc(c, f);
+	}
+	fputc('"', f);
+}
+
+static void trace_write_thread(FILE *f, struct trace_thread *thread,
+			       const struct trace_event *events, size_t num,
+			       uint64_t start_time, bool *first)
+{
+	long depth = 0;
+
+	fprintf(f, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,"
+		   "\"tid\":%ld,\"args\":{\"name\":",
+		*first ? "" : ",", thread->id);
+	trace_write_string(f, thread->name);
+	fprintf(f, "}}");
+	*first = false;
+
+	for (size_t i = 0; i < num; i++) {
+		const struct trace_event *event = &events[i];
+
+		if (event->time < start_time)
+			continue;
+
+		/* skip the ends of calls that started before the window */
+		if (event->end) {
+			if (!depth)
+				continue;
+			depth--;
+		} else {
+			depth++;
+		}
+
+		fprintf(f, ",\n{\"name\":");
+		trace_write_string(f, event->name);
+		fprintf(f, ",\"ph\":\"%c\",\"pid\":1,\"tid\":%ld,\"ts\":%.3f}",
+			event->end ? 'E' : 'B', thread->id,
+			(double)event->time / 1000.0);
+	}
+}
+
+bool profiler_trace_dump_json(const char *filename, uint64_t window_ns)
+{
+	uint64_t now = os_gettime_ns();
+	uint64_t start_time = 0;
+	bool first = true;
+	FILE *f;
+
+	if (window_ns && window_ns < now)
+		start_time = now - window_ns;
+
+	f = os_fopen(filename, "wb+");
+	if (!f)
+		return false;
+
+	fprintf(f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+
+	pthread_mutex_lock(&trace_mutex);
+
+	for (struct trace_thread *thread = trace_threads; thread;
+	     thread = thread->next) {
+		if (!thread->in_use)
+			continue;
+
+		size_t size = thread->capacity * sizeof(struct trace_event);
+		struct trace_event *copy = bmalloc(size);
+		struct trace_event *events = bmalloc(size);
+		size_t num = trace_copy_events(thread, copy, events);
+
+		trace_write_thread(f, thread, events, num, start_time, &first);
+
+		bfree(copy);
+		bfree(events);
+	}
+
+	pthread_mutex_unlock(&trace_mutex);
+
+	fprintf(f, "\n]}\n");
+	fclose(f);
+	return true;
+}
+
+static void trace_free(void)
+{
+	struct trace_thread *thread;
+
+	pthread_mutex_lock(&trace_mutex);
+	os_atomic_store_bool(&trace_enabled, false);
+	os_atomic_inc_long(&trace_generation);
+
+	/* threads that saw tracing enabled may still be writing.  owners
+	 * that exit block on the mutex in trace_thread_exit() until this is
+	 * done, so their flags stay valid */
+	for (thread = trace_threads; thread; thread = thread->next) {
+		while (thread->in_use && os_atomic_load_long(thread->writing))
+			os_sleep_ms(0);
+	}
+
+	thread = trace_threads;
+	trace_threads = NULL;
+	trace_thread_rings = 0;
+	pthread_mutex_unlock(&trace_mutex);
+
+	while (thread) {
+		struct trace_thread *next = thread->next;
+		bfree(thread->events);
+		bfree(thread);
+		thread = next;
+	}
+}
+
+/* ------------------------------------------------------------------------- */
+/* Profiling */
+
 void profiler_start(void)
 {
 	pthread_mutex_lock(&root_mutex);
@@ -367,6 +720,9 @@ static void merge_context(profile_call *context)
 
 void profile_start(const char *name)
 {
+	if (os_atomic_load_bool(&trace_enabled))
+		trace_record(name, os_gettime_ns(), false);
+
 	if (!thread_enabled)
 		return;
 
@@ -395,6 +751,9 @@ void profile_start(const char *name)
 void profile_end(const char *name)
 {
 	uint64_t end = os_gettime_ns();
+	if (os_atomic_load_bool(&trace_enabled))
+		trace_record(name, end, true);
+
 	if (!thread_enabled)
 		return;
 
@@ -827,6 +1186,8 @@ void profiler_free(void)
 	da_free(old_root_entries);
 
 	pthread_mutex_destroy(&root_mutex);
+
+	trace_free();
 }
 
 /* ------------------------------------------------------------------------- */
@@ -0,0 +1,130 @@
+/*
+ * Copyright (c) 2026 Hugh Bailey <obs.jim@gmail.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#pragma once
+
+#include "c99defs.h"
+#include <string.h>
+
+#include "bmem.h"
+#include "threading.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Fixed size lock-free ring buffer for exactly one producer thread and one
+ * consumer thread.  The capacity is rounded up to a power of two, and the
+ * read/write positions are free running byte counters, so the buffer never
+ * reallocates and neither side ever blocks.
+ */
+
+struct spsc_ring {
+	uint8_t *data;
+	size_t capacity;
+
+	volatile long head; /* written by the producer */
+	volatile long tail; /* written by the consumer */
+};
+
+static inline bool spsc_ring_init(struct spsc_ring *ring, size_t capacity)
+{
+	size_t size = 1;
+
+	memset(ring, 0, sizeof(struct spsc_ring));
+
+	while (size < capacity)
+		size <<= 1;
+	if (size > 0x40000000)
+		return false;
+
+	ring->data = (uint8_t *)bmalloc(size);
+	ring->capacity = size;
+	return true;
+}
+
+static inline void spsc_ring_free(struct spsc_ring *ring)
+{
+	bfree(ring->data);
+	memset(ring, 0, sizeof(struct spsc_ring));
+}
+
+/* bytes that can currently be popped */
+static inline size_t spsc_ring_size(const struct spsc_ring *ring)
+{
+	unsigned long head = (unsigned long)os_atomic_load_long(&ring->head);
+	unsigned long tail = (unsigned long)os_atomic_load_long(&ring->tail);
+	return (size_t)(head - tail);
+}
+
+/* bytes that can currently be pushed */
+static inline size_t spsc_ring_avail(const struct spsc_ring *ring)
+{
+	return ring->capacity - spsc_ring_size(ring);
+}
+
+/* producer only.  either pushes all of the data or nothing at all. */
+static inline bool spsc_ring_push(struct spsc_ring *ring, const void *data,
+				  size_t size)
+{
+	unsigned long head = (unsigned long)ring->head;
+	size_t pos, first;
+
+	if (spsc_ring_avail(ring) < size)
+		return false;
+
+	pos = (size_t)head & (ring->capacity - 1);
+	first = ring->capacity - pos;
+	if (first > size)
+		first = size;
+
+	memcpy(ring->data + pos, data, first);
+	memcpy(ring->data, (const uint8_t *)data + first, size - first);
+
+	os_atomic_store_long(&ring->head, (long)(head + (unsigned long)size));
+	return true;
+}
+
+/* consumer only.  pops up to size bytes, returns the number popped.  data
+ * can be NULL to discard. */
+static inline size_t spsc_ring_pop(struct spsc_ring *ring, void *data,
+				   size_t size)
+{
+	unsigned long tail = (unsigned long)ring->tail;
+	size_t available = spsc_ring_size(ring);
+	size_t pos, first;
+
+	if (size > available)
+		size = available;
+
+	if (data) {
+		pos = (size_t)tail & (ring->capacity - 1);
+		first = ring->capacity - pos;
+		if (first > size)
+			first = size;
+
+		memcpy(data, ring->data + pos, first);
+		memcpy((uint8_t *)data + first, ring->data, size - first);
+	}
+
+	os_atomic_store_long(&ring->tail, (long)(tail + (unsigned long)size));
+	return size;
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -14,170 +14,82 @@
  * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  */
 
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <ctype.h>
+
 #include "dstr.h"
+#include "darray.h"
 #include "text-lookup.h"
 #include "lexer.h"
 #include "platform.h"
+#include "threading.h"
 
-/* ------------------------------------------------------------------------- */
-
-struct text_leaf {
-	char *lookup, *value;
-};
-
-static inline void text_leaf_destroy(struct text_leaf *leaf)
-{
-	if (leaf) {
-		bfree(leaf->lookup);
-		bfree(leaf->value);
-		bfree(leaf);
-	}
-}
-
-/* ------------------------------------------------------------------------- */
+/*
+ * Each added file is compiled into a flat table: a header, an array of
+ * entries sorted by the hash of their (case insensitive) name, and a block
+ * of null terminated strings.  Lookups binary search the hashes, so nothing
+ * has to be built per string, and when a cache directory is set, the table
+ * is written there and memory mapped on later runs instead of parsing the
+ * .ini file again.
+ */
 
-struct text_node {
-	struct dstr str;
-	struct text_node *first_subnode;
-	struct text_leaf *leaf;
+#define TEXT_TABLE_MAGIC 0x424C544F /* "OTLB" */
+#define TEXT_TABLE_VERSION 1
 
-	struct text_node *next;
+struct text_table_header {
+	uint32_t magic;
+	uint32_t version;
+	uint64_t source_size;
+	int64_t source_mtime;
+	uint32_t num_entries;
+	uint32_t strings_size;
 };
 
-static void text_node_destroy(struct text_node *node)
-{
-	struct text_node *subnode;
-
-	if (!node)
-		return;
-
-	subnode = node->first_subnode;
-	while (subnode) {
-		struct text_node *destroy_node = subnode;
-
-		subnode = subnode->next;
-		text_node_destroy(destroy_node);
-	}
-
-	dstr_free(&node->str);
-	if (node->leaf)
-		text_leaf_destroy(node->leaf);
-	bfree(node);
-}
-
-static struct text_node *text_node_bychar(struct text_node *node, char ch)
-{
-	struct text_node *subnode = node->first_subnode;
-
-	while (subnode) {
-		if (!dstr_is_empty(&subnode->str) &&
-		    subnode->str.array[0] == ch)
-			return subnode;
-
-		subnode = subnode->next;
-	}
-
-	return NULL;
-}
-
-static struct text_node *text_node_byname(struct text_node *node,
-					  const char *name)
-{
-	struct text_node *subnode = node->first_subnode;
-
-	while (subnode) {
-		if (astrcmpi_n(subnode->str.array, name, subnode->str.len) == 0)
-			return subnode;
-
-		subnode = subnode->next;
-	}
+struct text_table_entry {
+	uint32_t hash;
+	uint32_t name;  /* offset into the string block */
+	uint32_t value; /* offset into the string block */
+};
 
-	return NULL;
-}
+struct text_table {
+	const uint8_t *data;
+	size_t size;
+	bool mapped;
 
-/* ------------------------------------------------------------------------- */
+	const struct text_table_entry *entries;
+	uint32_t num_entries;
+	const char *strings;
+};
 
 struct text_lookup {
 	struct dstr language;
-	struct text_node *top;
+	DARRAY(struct text_table) tables; /* later tables take precedence */
 };
 
-static void lookup_createsubnode(const char *lookup_val, struct text_leaf *leaf,
-				 struct text_node *node)
-{
-	struct text_node *new = bzalloc(sizeof(struct text_node));
-	new->leaf = leaf;
-	new->next = node->first_subnode;
-	dstr_copy(&new->str, lookup_val);
-
-	node->first_subnode = new;
-}
+static pthread_mutex_t cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+static char *cache_dir = NULL;
+static struct text_lookup_stats stats = {0};
 
-static void lookup_splitnode(const char *lookup_val, size_t len,
-			     struct text_leaf *leaf, struct text_node *node)
+static inline uint32_t text_hash(const char *str)
 {
-	struct text_node *split = bzalloc(sizeof(struct text_node));
-
-	dstr_copy(&split->str, node->str.array + len);
-	split->leaf = node->leaf;
-	split->first_subnode = node->first_subnode;
-	node->first_subnode = split;
-
-	dstr_resize(&node->str, len);
+	uint32_t hash = 2166136261U;
 
-	if (lookup_val[len] != 0) {
-		node->leaf = NULL;
-		lookup_createsubnode(lookup_val + len, leaf, node);
-	} else {
-		node->leaf = leaf;
+	while (*str) {
+		hash ^= (uint8_t)tolower((uint8_t)*(str++));
+		hash *= 16777619U;
 	}
-}
 
-static inline void lookup_replaceleaf(struct text_node *node,
-				      struct text_leaf *leaf)
-{
-	text_leaf_destroy(node->leaf);
-	node->leaf = leaf;
+	return hash;
 }
 
-static void lookup_addstring(const char *lookup_val, struct text_leaf *leaf,
-			     struct text_node *node)
-{
-	struct text_node *child;
-
-	/* value already exists, so replace */
-	if (!lookup_val || !*lookup_val) {
-		lookup_replaceleaf(node, leaf);
-		return;
-	}
-
-	child = text_node_bychar(node, *lookup_val);
-	if (child) {
-		size_t len;
-
-		for (len = 0; len < child->str.len; len++) {
-			char val1 = child->str.array[len],
-			     val2 = lookup_val[len];
-
-			if (val1 >= 'A' && val1 <= 'Z')
-				val1 += 0x20;
-			if (val2 >= 'A' && val2 <= 'Z')
-				val2 += 0x20;
-
-			if (val1 != val2)
-				break;
-		}
+/* ------------------------------------------------------------------------- */
+/* .ini parsing */
 
-		if (len == child->str.len) {
-			lookup_addstring(lookup_val + len, leaf, child);
-			return;
-		} else {
-			lookup_splitnode(lookup_val, len, leaf, child);
-		}
-	} else {
-		lookup_createsubnode(lookup_val, leaf, node);
-	}
-}
+struct text_item {
+	char *name;
+	char *value;
+};
 
 static void lookup_getstringtoken(struct lexer *lex, struct strref *token)
 {
@@ -292,8 +204,7 @@ static char *convert_string(const char *str, size_t len)
 	return out.array;
 }
 
-static void lookup_addfiledata(struct text_lookup *lookup,
-			       const char *file_data)
+static void lookup_addfiledata(struct darray *items, const char *file_data)
 {
 	struct lexer lex;
 	struct strref name, value;
@@ -304,7 +215,7 @@ static void lookup_addfiledata(struct text_lookup *lookup,
 	strref_clear(&value);
 
 	while (lookup_gettoken(&lex, &name)) {
-		struct text_leaf *leaf;
+		struct text_item *item;
 		bool got_eq = false;
 
 		if (*name.array == '\n')
@@ -319,11 +230,9 @@ static void lookup_addfiledata(struct text_lookup *lookup,
 			goto getval;
 		}
 
-		leaf = bmalloc(sizeof(struct text_leaf));
-		leaf->lookup = bstrdup_n(name.array, name.len);
-		leaf->value = convert_string(value.array, value.len);
-
-		lookup_addstring(leaf->lookup, leaf, lookup->top);
+		item = darray_push_back_new(sizeof(struct text_item), items);
+		item->name = bstrdup_n(name.array, name.len);
+		item->value = convert_string(value.array, value.len);
 
 		if (!lookup_goto_nextline(&lex))
 			break;
@@ -332,49 +241,285 @@ static void lookup_addfiledata(struct text_lookup *lookup,
 	lexer_free(&lex);
 }
 
-static inline bool lookup_getstring(const char *lookup_val, const char **out,
-				    struct text_node *node)
+/* ------------------------------------------------------------------------- */
+/* tables */
+
+#define TEXT_ITEM_REMOVED UINT32_MAX
+
+struct text_sort_item {
+	uint32_t hash;
+	uint32_t idx;
+};
+
+static int text_sort_item_cmp(const void *val1, const void *val2)
+{
+	const struct text_sort_item *item1 = val1;
+	const struct text_sort_item *item2 = val2;
+
+	if (item1->hash != item2->hash)
+		return item1->hash < item2->hash ? -1 : 1;
+
+	/* later items come first so that they replace earlier ones */
+	return item1->idx < item2->idx ? 1 : -1;
+}
+
+static inline bool text_item_duplicate(const struct text_item *items,
+				       const struct text_sort_item *sorted,
+				       size_t first, size_t cur)
+{
+	for (size_t i = first; i < cur; i++) {
+		if (sorted[i].idx != TEXT_ITEM_REMOVED &&
+		    astrcmpi(items[sorted[i].idx].name,
+			     items[sorted[cur].idx].name) == 0)
+			return true;
+	}
+
+	return false;
+}
+
+static uint8_t *text_table_build(const struct text_item *items, size_t num,
+				 const struct stat *source, size_t *size)
+{
+	struct text_sort_item *sorted = bmalloc(sizeof(*sorted) * (num + 1));
+	struct text_table_header *header;
+	struct text_table_entry *entries;
+	size_t strings_size = 0;
+	size_t num_entries = 0;
+	size_t run = 0;
+	uint8_t *data;
+	char *strings;
+
+	for (size_t i = 0; i < num; i++) {
+		sorted[i].hash = text_hash(items[i].name);
+		sorted[i].idx = (uint32_t)i;
+	}
+
+	qsort(sorted, num, sizeof(*sorted), text_sort_item_cmp);
+
+	/* drop the names that are replaced by a later line of the file */
+	for (size_t i = 0; i < num; i++) {
+		if (i && sorted[i].hash != sorted[i - 1].hash)
+			run = i;
+
+		if (text_item_duplicate(items, sorted, run, i)) {
+			sorted[i].idx = TEXT_ITEM_REMOVED;
+			continue;
+		}
+
+		strings_size += strlen(items[sorted[i].idx].name) + 1;
+		strings_size += strlen(items[sorted[i].idx].value) + 1;
+		num_entries++;
+	}
+
+	*size = sizeof(*header) + sizeof(*entries) * num_entries +
+		strings_size;
+	data = bzalloc(*size);
+
+	header = (struct text_table_header *)data;
+	header->magic = TEXT_TABLE_MAGIC;
+	header->version = TEXT_TABLE_VERSION;
+	header->source_size = (uint64_t)source->st_size;
+	header->source_mtime = (int64_t)source->st_mtime;
+	header->num_entries = (uint32_t)num_entries;
+	header->strings_size = (uint32_t)strings_size;
+
+	entries = (struct text_table_entry *)(data + sizeof(*header));
+	strings = (char *)(entries + num_entries);
+	strings_size = 0;
+
+	for (size_t i = 0; i < num; i++) {
+		const struct text_item *item;
+		size_t len;
+
+		if (sorted[i].idx == TEXT_ITEM_REMOVED)
+			continue;
+
+		item = items + sorted[i].idx;
+		entries->hash = sorted[i].hash;
+
+		len = strlen(item->name) + 1;
+		entries->name = (uint32_t)strings_size;
+		memcpy(strings + strings_size, item->name, len);
+		strings_size += len;
+
+		len = strlen(item->value) + 1;
+		entries->value = (uint32_t)strings_size;
+		memcpy(strings + strings_size, item->value, len);
+		strings_size += len;
+
+		entries++;
+	}
+
+	bfree(sorted);
+	return data;
+}
+
+/* checks everything lookups rely on, so a truncated or stale cache file is
+ * never used */
+static bool text_table_init(struct text_table *table, const uint8_t *data,
+			    size_t size, const struct stat *source)
 {
-	struct text_node *child;
-	char ch;
+	const struct text_table_header *header = (const void *)data;
+	const struct text_table_entry *entries;
+	const char *strings;
+	uint64_t expected;
 
-	if (!node)
+	if (size < sizeof(*header))
+		return false;
+	if (header->magic != TEXT_TABLE_MAGIC ||
+	    header->version != TEXT_TABLE_VERSION)
+		return false;
+	if (header->source_size != (uint64_t)source->st_size ||
+	    header->source_mtime != (int64_t)source->st_mtime)
 		return false;
 
-	child = text_node_byname(node, lookup_val);
-	if (!child)
+	expected = sizeof(*header) +
+		   (uint64_t)sizeof(*entries) * header->num_entries +
+		   header->strings_size;
+	if (expected != size)
 		return false;
 
-	lookup_val += child->str.len;
-	ch = *lookup_val;
-	if (ch)
-		return lookup_getstring(lookup_val, out, child);
+	entries = (const void *)(data + sizeof(*header));
+	strings = (const char *)(entries + header->num_entries);
 
-	if (!child->leaf)
+	if (header->strings_size && strings[header->strings_size - 1] != 0)
 		return false;
 
-	*out = child->leaf->value;
+	for (uint32_t i = 0; i < header->num_entries; i++) {
+		if (entries[i].name >= header->strings_size ||
+		    entries[i].value >= header->strings_size)
+			return false;
+		if (i && entries[i].hash < entries[i - 1].hash)
+			return false;
+	}
+
+	table->data = data;
+	table->size = size;
+	table->entries = entries;
+	table->num_entries = header->num_entries;
+	table->strings = strings;
 	return true;
 }
 
+static inline void text_table_free(struct text_table *table)
+{
+	if (table->mapped)
+		os_munmap_file(table->data, table->size);
+	else
+		bfree((void *)table->data);
+}
+
+static bool text_table_find(const struct text_table *table, const char *name,
+			    uint32_t hash, const char **out)
+{
+	size_t low = 0;
+	size_t high = table->num_entries;
+
+	while (low < high) {
+		size_t mid = low + (high - low) / 2;
+		if (table->entries[mid].hash < hash)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+
+	for (; low < table->num_entries; low++) {
+		const struct text_table_entry *entry = table->entries + low;
+
+		if (entry->hash != hash)
+			break;
+		if (astrcmpi(table->strings + entry->name, name) == 0) {
+			*out = table->strings + entry->value;
+			return true;
+		}
+	}
+
+	return false;
+}
+
 /* ------------------------------------------------------------------------- */
+/* cache */
 
-lookup_t *text_lookup_create(const char *path)
+static char *text_cache_file(const char *path)
 {
-	struct text_lookup *lookup = bzalloc(sizeof(struct text_lookup));
+	struct dstr file = {0};
+	char *abs_path;
+	const char *name;
+	uint64_t hash = 14695981039346656037ULL;
+
+	pthread_mutex_lock(&cache_mutex);
+	if (cache_dir)
+		dstr_copy(&file, cache_dir);
+	pthread_mutex_unlock(&cache_mutex);
+
+	if (!file.array)
+		return NULL;
+
+	/* the cache is per file rather than per module, so the full path is
+	 * what identifies it */
+	abs_path = os_get_abs_path_ptr(path);
+	name = abs_path ? abs_path : path;
+
+	while (*name) {
+		hash ^= (uint8_t)*(name++);
+		hash *= 1099511628211ULL;
+	}
 
-	if (!text_lookup_add(lookup, path)) {
-		bfree(lookup);
-		lookup = NULL;
+	dstr_catf(&file, "/%016llx.bin", (unsigned long long)hash);
+
+	bfree(abs_path);
+	return file.array;
+}
+
+static bool text_cache_map(struct text_table *table, const char *cache_file,
+			   const struct stat *source)
+{
+	size_t size = 0;
+	const uint8_t *data = os_mmap_file(cache_file, &size);
+
+	if (!data)
+		return false;
+
+	if (!text_table_init(table, data, size, source)) {
+		os_munmap_file(data, size);
+		return false;
 	}
 
-	return lookup;
+	table->mapped = true;
+	return true;
 }
 
-bool text_lookup_add(lookup_t *lookup, const char *path)
+static void text_cache_write(const char *cache_file, const uint8_t *data,
+			     size_t size)
+{
+	struct dstr temp_file = {0};
+	bool success = false;
+	FILE *f;
+
+	dstr_printf(&temp_file, "%s.tmp", cache_file);
+
+	f = os_fopen(temp_file.array, "wb");
+	if (f) {
+		success = fwrite(data, 1, size, f) == size;
+		fclose(f);
+	}
+
+	if (!success || os_safe_replace(cache_file, temp_file.array, NULL) != 0)
+		os_unlink(temp_file.array);
+
+	dstr_free(&temp_file);
+}
+
+/* ------------------------------------------------------------------------- */
+
+static bool text_table_load(struct text_table *table, const char *path,
+			    const struct stat *source, char *cache_file)
 {
+	struct darray items = {0};
 	struct dstr file_str;
 	char *temp = NULL;
+	uint8_t *data;
+	size_t size;
 	FILE *file;
 
 	file = os_fopen(path, "rb");
@@ -388,22 +533,100 @@ bool text_lookup_add(lookup_t *lookup, const char *path)
 	if (!file_str.array)
 		return false;
 
-	if (!lookup->top)
-		lookup->top = bzalloc(sizeof(struct text_node));
-
 	dstr_replace(&file_str, "\r", " ");
-	lookup_addfiledata(lookup, file_str.array);
+	lookup_addfiledata(&items, file_str.array);
 	dstr_free(&file_str);
 
+	data = text_table_build(items.array, items.num, source, &size);
+
+	for (size_t i = 0; i < items.num; i++) {
+		struct text_item *item =
+			darray_item(sizeof(struct text_item), &items, i);
+		bfree(item->name);
+		bfree(item->value);
+	}
+	darray_free(&items);
+
+	/* map the cached copy right away, so the table does not take up
+	 * heap memory on the first run either */
+	if (cache_file) {
+		text_cache_write(cache_file, data, size);
+
+		if (text_cache_map(table, cache_file, source)) {
+			bfree(data);
+			return true;
+		}
+	}
+
+	if (!text_table_init(table, data, size, source)) {
+		bfree(data);
+		return false;
+	}
+
+	return true;
+}
+
+/* ------------------------------------------------------------------------- */
+
+lookup_t *text_lookup_create(const char *path)
+{
+	struct text_lookup *lookup = bzalloc(sizeof(struct text_lookup));
+
+	if (!text_lookup_add(lookup, path)) {
+		bfree(lookup);
+		lookup = NULL;
+	}
+
+	return lookup;
+}
+
+bool text_lookup_add(lookup_t *lookup, const char *path)
+{
+	struct text_table table = {0};
+	struct stat source;
+	char *cache_file = NULL;
+	uint64_t start = os_gettime_ns();
+	bool cached = false;
+	bool success;
+
+	if (!path || os_stat(path, &source) != 0)
+		return false;
+
+	if (source.st_size > 0)
+		cache_file = text_cache_file(path);
+	if (cache_file)
+		cached = text_cache_map(&table, cache_file, &source);
+
+	success = cached || text_table_load(&table, path, &source, cache_file);
+	bfree(cache_file);
+
+	if (!success)
+		return false;
+
+	da_push_back(lookup->tables, &table);
+
+	pthread_mutex_lock(&cache_mutex);
+	stats.files++;
+	if (cached)
+		stats.cached_files++;
+	if (table.mapped)
+		stats.mapped_bytes += table.size;
+	else
+		stats.heap_bytes += table.size;
+	stats.load_time_ns += os_gettime_ns() - start;
+	pthread_mutex_unlock(&cache_mutex);
+
 	return true;
 }
 
 void text_lookup_destroy(lookup_t *lookup)
 {
 	if (lookup) {
-		dstr_free(&lookup->language);
-		text_node_destroy(lookup->top);
+		for (size_t i = 0; i < lookup->tables.num; i++)
+			text_table_free(lookup->tables.array + i);
 
+		da_free(lookup->tables);
+		dstr_free(&lookup->language);
 		bfree(lookup);
 	}
 }
@@ -411,7 +634,33 @@ void text_lookup_destroy(lookup_t *lookup)
 bool text_lookup_getstr(lookup_t *lookup, const char *lookup_val,
 			const char **out)
 {
-	if (lookup)
-		return lookup_getstring(lookup_val, out, lookup->top);
+	uint32_t hash;
+
+	if (!lookup || !lookup_val)
+		return false;
+
+	hash = text_hash(lookup_val);
+
+	for (size_t i = lookup->tables.num; i > 0; i--) {
+		if (text_table_find(lookup->tables.array + (i - 1), lookup_val,
+				    hash, out))
+			return true;
+	}
+
 	return false;
 }
+
+void text_lookup_set_cache_dir(const char *dir)
+{
+	pthread_mutex_lock(&cache_mutex);
+	bfree(cache_dir);
+	cache_dir = dir && *dir ? bstrdup(dir) : NULL;
+	pthread_mutex_unlock(&cache_mutex);
+}
+
+void text_lookup_get_stats(struct text_lookup_stats *out)
+{
+	pthread_mutex_lock(&cache_mutex);
+	*out = stats;
+	pthread_mutex_unlock(&cache_mutex);
+}
@@ -19,9 +19,11 @@
 /*
  * Text Lookup interface
  *
- *   Used for storing and looking up localized strings.  Stores localization
- * strings in a radix/trie tree to efficiently look up associated strings via a
- * unique string identifier name.
+ *   Used for storing and looking up localized strings.  Each added file is
+ * stored as a table sorted by the hash of the string identifier names, and
+ * strings in later files take precedence over earlier ones.  When a cache
+ * directory is set, the tables are saved there and memory mapped on later
+ * loads rather than parsing the .ini files again.
  */
 
 #include "c99defs.h"
@@ -41,6 +43,21 @@ EXPORT void text_lookup_destroy(lookup_t *lookup);
 EXPORT bool text_lookup_getstr(lookup_t *lookup, const char *lookup_val,
 			       const char **out);
 
+/* directory to cache compiled locale tables in, NULL to disable caching (and
+ * to free the path before shutdown) */
+EXPORT void text_lookup_set_cache_dir(const char *dir);
+
+struct text_lookup_stats {
+	uint64_t files;
+	uint64_t cached_files; /* files loaded from the cache */
+	uint64_t load_time_ns;
+	uint64_t mapped_bytes;
+	uint64_t heap_bytes;
+};
+
+/* totals for every file added since the process started */
+EXPORT void text_lookup_get_stats(struct text_lookup_stats *stats);
+
 #ifdef __cplusplus
 }
 #endif
@@ -30,6 +30,8 @@
 #include <pthread_np.h>
 #endif
 
+#include <stdio.h>
+
 #include "bmem.h"
 #include "threading.h"
 
@@ -255,8 +257,12 @@ int os_sem_wait(os_sem_t *sem)
 
 #endif
 
+static THREAD_LOCAL char thread_name[64];
+
 void os_set_thread_name(const char *name)
 {
+	snprintf(thread_name, sizeof(thread_name), "%s", name);
+
 #if defined(__APPLE__)
 	pthread_setname_np(name);
 #elif defined(__FreeBSD__)
@@ -265,9 +271,14 @@ void os_set_thread_name(const char *name)
 	if (strlen(name) <= 15) {
 		pthread_setname_np(pthread_self(), name);
 	} else {
-		char *thread_name = bstrdup_n(name, 15);
-		pthread_setname_np(pthread_self(), thread_name);
-		bfree(thread_name);
+		char *short_name = bstrdup_n(name, 15);
+		pthread_setname_np(pthread_self(), short_name);
+		bfree(short_name);
 	}
 #endif
 }
+
+const char *os_get_thread_name(void)
+{
+	return *thread_name ? thread_name : NULL;
+}
@@ -20,6 +20,7 @@
 
 #define WIN32_LEAN_AND_MEAN
 #include <windows.h>
+#include <stdio.h>
 #include <KnownFolders.h>
 #include <ShlObj_core.h>
 
@@ -168,8 +169,12 @@ struct vs_threadname_info {
 #define THREADNAME_INFO_SIZE \
 	(sizeof(struct vs_threadname_info) / sizeof(ULONG_PTR))
 
+static THREAD_LOCAL char thread_name[64];
+
 void os_set_thread_name(const char *name)
 {
+	snprintf(thread_name, sizeof(thread_name), "%s", name);
+
 #ifdef __MINGW32__
 	UNUSED_PARAMETER(name);
 #else
@@ -224,3 +229,8 @@ void os_set_thread_name(const char *name)
 		FreeLibrary(hModule);
 	}
 }
+
+const char *os_get_thread_name(void)
+{
+	return *thread_name ? thread_name : NULL;
+}
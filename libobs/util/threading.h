@@ -93,6 +93,8 @@ EXPORT int os_sem_post(os_sem_t *sem);
 EXPORT int os_sem_wait(os_sem_t *sem);
 
 EXPORT void os_set_thread_name(const char *name);
+/* name last set with os_set_thread_name on the calling thread, or NULL */
+EXPORT const char *os_get_thread_name(void);
 
 #ifdef _MSC_VER
 #define THREAD_LOCAL __declspec(thread)
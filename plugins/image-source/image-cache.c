@@ -0,0 +1,226 @@
+#include <obs-module.h>
+#include <util/threading.h>
+#include <util/platform.h>
+#include <util/darray.h>
+#include <util/dstr.h>
+#include <sys/stat.h>
+
+#include "image-cache.h"
+
+#define CACHE_BUDGET (400ULL * 1024ULL * 1024ULL)
+
+enum item_state {
+	ITEM_DECODING,
+	ITEM_READY,
+};
+
+struct cache_item {
+	struct image_cache_entry entry;
+
+	char *path;
+	enum gs_image_alpha_mode alpha_mode;
+	time_t mtime;
+
+	enum item_state state;
+	os_event_t *decoded;
+	size_t size;
+	uint64_t last_used;
+	long refs;
+	bool removed;
+};
+
+static pthread_mutex_t cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+static DARRAY(struct cache_item *) items;
+static uint64_t total_size = 0;
+
+static time_t get_mtime(const char *path)
+{
+	struct stat stats;
+	if (os_stat(path, &stats) != 0)
+		return -1;
+	return stats.st_mtime;
+}
+
+static void item_free(struct cache_item *item)
+{
+	os_event_destroy(item->decoded);
+	bfree(item->entry.data);
+	bfree(item->path);
+	bfree(item);
+}
+
+static struct cache_item *find_item(const char *path,
+				    enum gs_image_alpha_mode alpha_mode)
+{
+	for (size_t i = 0; i < items.num; i++) {
+		struct cache_item *item = items.array[i];
+		if (item->alpha_mode == alpha_mode &&
+		    strcmp(item->path, path) == 0)
+			return item;
+	}
+
+	return NULL;
+}
+
+static void remove_item(struct cache_item *item)
+{
+	da_erase_item(items, &item);
+	if (item->state == ITEM_READY)
+		total_size -= item->size;
+
+	item->removed = true;
+	if (!item->refs)
+		item_free(item);
+}
+
+static void evict_items(void)
+{
+	while (total_size > CACHE_BUDGET) {
+		struct cache_item *lru = NULL;
+
+		for (size_t i = 0; i < items.num; i++) {
+			struct cache_item *item = items.array[i];
+			if (item->state != ITEM_READY || item->refs)
+				continue;
+			if (!lru || item->last_used < lru->last_used)
+				lru = item;
+		}
+
+		if (!lru)
+			break;
+
+		remove_item(lru);
+	}
+}
+
+/* returns the cached item for the file, or a new one if the file has not
+ * been seen yet or was modified since it was decoded */
+static struct cache_item *lookup_item(const char *path,
+				      enum gs_image_alpha_mode alpha_mode,
+				      time_t mtime, bool *created)
+{
+	struct cache_item *item = find_item(path, alpha_mode);
+
+	if (item && item->mtime != mtime) {
+		remove_item(item);
+		item = NULL;
+	}
+
+	*created = !item;
+
+	if (!item) {
+		item = bzalloc(sizeof(*item));
+		item->path = bstrdup(path);
+		item->alpha_mode = alpha_mode;
+		item->mtime = mtime;
+		item->state = ITEM_DECODING;
+		os_event_init(&item->decoded, OS_EVENT_TYPE_MANUAL);
+		da_push_back(items, &item);
+	}
+
+	item->last_used = os_gettime_ns();
+	return item;
+}
+
+static void decode_item(struct cache_item *item)
+{
+	struct image_cache_entry *entry = &item->entry;
+
+	entry->data = gs_create_texture_file_data2(item->path,
+						   item->alpha_mode,
+						   &entry->format, &entry->cx,
+						   &entry->cy);
+	if (entry->data)
+		item->size = (size_t)entry->cx * entry->cy *
+			     gs_get_format_bpp(entry->format) / 8;
+
+	pthread_mutex_lock(&cache_mutex);
+	item->state = ITEM_READY;
+	if (!item->removed) {
+		total_size += item->size;
+		evict_items();
+	}
+	pthread_mutex_unlock(&cache_mutex);
+
+	os_event_signal(item->decoded);
+}
+
+/* ------------------------------------------------------------------------- */
+
+bool image_cache_supported(const char *path)
+{
+	const char *ext = os_get_path_extension(path);
+	return ext && astrcmpi(ext, ".gif") != 0;
+}
+
+struct image_cache_entry *image_cache_get(const char *path,
+					  enum gs_image_alpha_mode alpha_mode)
+{
+	struct cache_item *item;
+	time_t mtime;
+	bool decode;
+
+	if (!path || !*path)
+		return NULL;
+
+	mtime = get_mtime(path);
+	if (mtime == -1)
+		return NULL;
+
+	pthread_mutex_lock(&cache_mutex);
+	item = lookup_item(path, alpha_mode, mtime, &decode);
+	item->refs++;
+	pthread_mutex_unlock(&cache_mutex);
+
+	if (decode)
+		decode_item(item);
+	else
+		os_event_wait(item->decoded);
+
+	if (!item->entry.data) {
+		image_cache_release(&item->entry);
+		return NULL;
+	}
+
+	return &item->entry;
+}
+
+void image_cache_release(struct image_cache_entry *entry)
+{
+	struct cache_item *item = (struct cache_item *)entry;
+
+	if (!item)
+		return;
+
+	pthread_mutex_lock(&cache_mutex);
+	if (--item->refs == 0 && item->removed)
+		item_free(item);
+	pthread_mutex_unlock(&cache_mutex);
+}
+
+bool image_cache_get_size(const char *path, enum gs_image_alpha_mode alpha_mode,
+			  uint32_t *cx, uint32_t *cy)
+{
+	struct cache_item *item;
+	bool success = false;
+
+	pthread_mutex_lock(&cache_mutex);
+	item = find_item(path, alpha_mode);
+	if (item && item->state == ITEM_READY && item->entry.data) {
+		*cx = item->entry.cx;
+		*cy = item->entry.cy;
+		success = true;
+	}
+	pthread_mutex_unlock(&cache_mutex);
+
+	return success;
+}
+
+void image_cache_free(void)
+{
+	pthread_mutex_lock(&cache_mutex);
+	while (items.num)
+		remove_item(items.array[items.num - 1]);
+	da_free(items);
+	pthread_mutex_unlock(&cache_mutex);
+}
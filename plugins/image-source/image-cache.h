@@ -0,0 +1,35 @@
+#pragma once
+
+#include <graphics/graphics.h>
+#include <graphics/image-file.h>
+
+/*
+ * Process-wide cache of decoded still images, shared by image sources and
+ * slideshows.  Entries are keyed by path, modification time and alpha mode,
+ * and are evicted least recently used first once the decoded data exceeds
+ * the memory budget.  Animated GIFs are not cached.
+ */
+
+struct image_cache_entry {
+	uint32_t cx;
+	uint32_t cy;
+	enum gs_color_format format;
+	uint8_t *data;
+};
+
+/* returns whether the file can go through the cache at all */
+extern bool image_cache_supported(const char *path);
+
+/* returns a referenced entry for the file, decoding it on the calling thread
+ * if it is neither cached nor being decoded by another thread already.
+ * returns NULL if the file could not be loaded */
+extern struct image_cache_entry *
+image_cache_get(const char *path, enum gs_image_alpha_mode alpha_mode);
+extern void image_cache_release(struct image_cache_entry *entry);
+
+/* gets the size of the image if it is decoded already, without blocking */
+extern bool image_cache_get_size(const char *path,
+				 enum gs_image_alpha_mode alpha_mode,
+				 uint32_t *cx, uint32_t *cy);
+
+extern void image_cache_free(void);
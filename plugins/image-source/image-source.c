@@ -1,9 +1,12 @@
 #include <obs-module.h>
 #include <graphics/image-file.h>
+#include <graphics/texture-atlas.h>
 #include <util/platform.h>
 #include <util/dstr.h>
 #include <sys/stat.h>
 
+#include "image-cache.h"
+
 #define blog(log_level, format, ...)                    \
 	blog(log_level, "[image_source: '%s'] " format, \
 	     obs_source_get_name(context->source), ##__VA_ARGS__)
@@ -25,6 +28,7 @@ struct image_source {
 	bool restart_gif;
 
 	gs_image_file3_t if3;
+	gs_atlas_region_t *region;
 };
 
 static time_t get_modified_timestamp(const char *filename)
@@ -41,15 +45,87 @@ static const char *image_source_get_name(void *unused)
 	return obs_module_text("ImageInput");
 }
 
-static void image_source_load(struct image_source *context)
+/* small static images share an atlas page instead of a texture each */
+static bool image_source_init_atlas_region(struct image_source *context)
 {
-	char *file = context->file;
+	gs_image_file_t *image = &context->if3.image2.image;
+
+	if (!image->loaded || image->is_animated_gif || !image->texture_data)
+		return false;
+
+	context->region = gs_atlas_region_create(image->cx, image->cy,
+						 image->format,
+						 image->texture_data);
+	if (!context->region)
+		return false;
+
+	bfree(image->texture_data);
+	image->texture_data = NULL;
+	return true;
+}
+
+/* still images come from the shared decoded image cache, only the texture
+ * is created here */
+static void image_source_load_cached(struct image_source *context,
+				     struct image_cache_entry *entry,
+				     enum gs_image_alpha_mode alpha_mode)
+{
+	gs_image_file_t *image = &context->if3.image2.image;
+	const uint8_t *data = entry->data;
+
+	image->cx = entry->cx;
+	image->cy = entry->cy;
+	image->format = entry->format;
+	image->loaded = true;
+	context->if3.image2.mem_usage =
+		(uint64_t)entry->cx * entry->cy *
+		gs_get_format_bpp(entry->format) / 8;
+	context->if3.alpha_mode = alpha_mode;
 
 	obs_enter_graphics();
+	context->region = gs_atlas_region_create(entry->cx, entry->cy,
+						 entry->format, data);
+	if (!context->region)
+		image->texture = gs_texture_create(entry->cx, entry->cy,
+						   entry->format, 1, &data, 0);
+	obs_leave_graphics();
+}
+
+static void image_source_free(struct image_source *context)
+{
+	obs_enter_graphics();
+	gs_atlas_region_destroy(context->region);
+	context->region = NULL;
 	gs_image_file3_free(&context->if3);
 	obs_leave_graphics();
+}
+
+static void image_source_load(struct image_source *context)
+{
+	char *file = context->file;
+
+	image_source_free(context);
+
+	if (file && *file && image_cache_supported(file)) {
+		enum gs_image_alpha_mode alpha_mode =
+			context->linear_alpha ? GS_IMAGE_ALPHA_PREMULTIPLY_SRGB
+					      : GS_IMAGE_ALPHA_PREMULTIPLY;
+		struct image_cache_entry *entry;
 
-	if (file && *file) {
+		debug("loading texture '%s'", file);
+		context->file_timestamp = get_modified_timestamp(file);
+		context->update_time_elapsed = 0;
+
+		entry = image_cache_get(file, alpha_mode);
+		if (entry) {
+			image_source_load_cached(context, entry, alpha_mode);
+			image_cache_release(entry);
+		}
+
+		if (!context->if3.image2.image.loaded)
+			warn("failed to load texture '%s'", file);
+
+	} else if (file && *file) {
 		debug("loading texture '%s'", file);
 		context->file_timestamp = get_modified_timestamp(file);
 		gs_image_file3_init(&context->if3, file,
@@ -59,19 +135,22 @@ static void image_source_load(struct image_source *context)
 		context->update_time_elapsed = 0;
 
 		obs_enter_graphics();
-		gs_image_file3_init_texture(&context->if3);
+		if (!image_source_init_atlas_region(context))
+			gs_image_file3_init_texture(&context->if3);
 		obs_leave_graphics();
 
 		if (!context->if3.image2.image.loaded)
 			warn("failed to load texture '%s'", file);
 	}
+
+	obs_source_mark_dirty(context->source);
 }
 
 static void image_source_unload(struct image_source *context)
 {
-	obs_enter_graphics();
-	gs_image_file3_free(&context->if3);
-	obs_leave_graphics();
+	image_source_free(context);
+
+	obs_source_mark_dirty(context->source);
 }
 
 static void image_source_update(void *data, obs_data_t *settings)
@@ -129,6 +208,7 @@ static void restart_gif(void *data)
 		gs_image_file3_update_texture(&context->if3);
 		obs_leave_graphics();
 
+		obs_source_mark_dirty(context->source);
 		context->restart_gif = false;
 	}
 }
@@ -174,8 +254,11 @@ static uint32_t image_source_getheight(void *data)
 static void image_source_render(void *data, gs_effect_t *effect)
 {
 	struct image_source *context = data;
+	gs_texture_t *texture =
+		context->region ? gs_atlas_region_get_texture(context->region)
+				: context->if3.image2.image.texture;
 
-	if (!context->if3.image2.image.texture)
+	if (!texture)
 		return;
 
 	const bool previous = gs_framebuffer_srgb_enabled();
@@ -185,11 +268,13 @@ static void image_source_render(void *data, gs_effect_t *effect)
 	gs_blend_function(GS_BLEND_ONE, GS_BLEND_INVSRCALPHA);
 
 	gs_eparam_t *const param = gs_effect_get_param_by_name(effect, "image");
-	gs_effect_set_texture_srgb(param, context->if3.image2.image.texture);
+	gs_effect_set_texture_srgb(param, texture);
 
-	gs_draw_sprite(context->if3.image2.image.texture, 0,
-		       context->if3.image2.image.cx,
-		       context->if3.image2.image.cy);
+	if (context->region)
+		gs_atlas_region_draw(context->region, 0);
+	else
+		gs_draw_sprite(texture, 0, context->if3.image2.image.cx,
+			       context->if3.image2.image.cy);
 
 	gs_blend_state_pop();
 
@@ -241,6 +326,8 @@ static void image_source_tick(void *data, float seconds)
 			obs_enter_graphics();
 			gs_image_file3_update_texture(&context->if3);
 			obs_leave_graphics();
+
+			obs_source_mark_dirty(context->source);
 		}
 	}
 
@@ -326,7 +413,8 @@ static obs_missing_files_t *image_source_missingfiles(void *data)
 static struct obs_source_info image_source_info = {
 	.id = "image_source",
 	.type = OBS_SOURCE_TYPE_INPUT,
-	.output_flags = OBS_SOURCE_VIDEO | OBS_SOURCE_SRGB,
+	.output_flags = OBS_SOURCE_VIDEO | OBS_SOURCE_SRGB |
+			OBS_SOURCE_CACHEABLE | OBS_SOURCE_THREADSAFE_TICK,
 	.get_name = image_source_get_name,
 	.create = image_source_create,
 	.destroy = image_source_destroy,
@@ -356,6 +444,8 @@ extern struct obs_source_info color_source_info_v1;
 extern struct obs_source_info color_source_info_v2;
 extern struct obs_source_info color_source_info_v3;
 
+extern void slideshow_free_load_queue(void);
+
 bool obs_module_load(void)
 {
 	obs_register_source(&image_source_info);
@@ -365,3 +455,9 @@ bool obs_module_load(void)
 	obs_register_source(&slideshow_info);
 	return true;
 }
+
+void obs_module_unload(void)
+{
+	slideshow_free_load_queue();
+	image_cache_free();
+}
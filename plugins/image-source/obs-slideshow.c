@@ -3,6 +3,9 @@
 #include <util/platform.h>
 #include <util/darray.h>
 #include <util/dstr.h>
+#include <util/task.h>
+
+#include "image-cache.h"
 
 #define do_log(level, format, ...)               \
 	blog(level, "[slideshow: '%s'] " format, \
@@ -66,9 +69,22 @@ extern uint64_t image_source_get_memory_usage(void *data);
 #define BYTES_TO_MBYTES (1024 * 1024)
 #define MAX_MEM_USAGE (400 * BYTES_TO_MBYTES)
 
+/* number of upcoming slides loaded ahead of time */
+#define PREFETCH_COUNT 3
+
+/* alpha mode of the image sources created for slides */
+#define SLIDE_ALPHA_MODE GS_IMAGE_ALPHA_PREMULTIPLY
+
+/* slides only have a source while they are shown or about to be shown.  the
+ * sources are created on a background task queue, so images are never
+ * decoded on the graphics thread */
 struct image_file_data {
 	char *path;
 	obs_source_t *source;
+	uint64_t mem_usage;
+	uint32_t cx;
+	uint32_t cy;
+	bool loading;
 };
 
 enum behavior {
@@ -97,10 +113,22 @@ struct slideshow {
 
 	float elapsed;
 	size_t cur_item;
+	DARRAY(size_t) upcoming;
+	uint64_t mem_usage;
+
+	/* the current slide is shown once its source has been loaded */
+	bool slide_pending;
+	bool pending_cut;
 
 	uint32_t cx;
 	uint32_t cy;
-	uint64_t mem_usage;
+	uint32_t max_cx;
+	uint32_t max_cy;
+	int custom_cx;
+	int custom_cy;
+	bool aspect_only;
+	bool use_auto;
+	bool sizes_changed;
 
 	pthread_mutex_t mutex;
 	DARRAY(struct image_file_data) files;
@@ -192,6 +220,280 @@ static inline size_t random_file(struct slideshow *ss)
 	return (size_t)rand() % ss->files.num;
 }
 
+static size_t random_next_file(struct slideshow *ss, size_t cur)
+{
+	size_t next = cur;
+	if (ss->files.num > 1) {
+		while (next == cur)
+			next = random_file(ss);
+	}
+	return next;
+}
+
+/* random slides are picked ahead of time so they can be prefetched, call with
+ * the mutex held */
+static size_t next_random_item(struct slideshow *ss)
+{
+	size_t next;
+
+	if (ss->upcoming.num) {
+		next = ss->upcoming.array[0];
+		da_erase(ss->upcoming, 0);
+	} else {
+		next = random_next_file(ss, ss->cur_item);
+	}
+
+	return next;
+}
+
+static void apply_size(struct slideshow *ss)
+{
+	uint32_t cx = ss->max_cx;
+	uint32_t cy = ss->max_cy;
+
+	if (!ss->use_auto) {
+		double cx_f = (double)cx;
+		double cy_f = (double)cy;
+
+		double old_aspect = cx_f / cy_f;
+		double new_aspect =
+			(double)ss->custom_cx / (double)ss->custom_cy;
+
+		if (ss->aspect_only) {
+			if (fabs(old_aspect - new_aspect) > EPSILON) {
+				if (new_aspect > old_aspect)
+					cx = (uint32_t)(cy_f * new_aspect);
+				else
+					cy = (uint32_t)(cx_f / new_aspect);
+			}
+		} else {
+			cx = (uint32_t)ss->custom_cx;
+			cy = (uint32_t)ss->custom_cy;
+		}
+	}
+
+	ss->cx = cx;
+	ss->cy = cy;
+	obs_transition_set_size(ss->transition, cx, cy);
+}
+
+static void set_file_size(struct slideshow *ss, struct image_file_data *file,
+			  uint32_t cx, uint32_t cy)
+{
+	file->cx = cx;
+	file->cy = cy;
+
+	if (cx > ss->max_cx || cy > ss->max_cy) {
+		if (cx > ss->max_cx)
+			ss->max_cx = cx;
+		if (cy > ss->max_cy)
+			ss->max_cy = cy;
+		ss->sizes_changed = true;
+	}
+}
+
+/* ------------------------------------------------------------------------- */
+/* slide loading                                                             */
+
+struct slide_load {
+	struct slideshow *ss;
+	obs_weak_source_t *weak;
+	char *path;
+};
+
+static pthread_mutex_t load_queue_mutex = PTHREAD_MUTEX_INITIALIZER;
+static os_task_queue_t *load_queue = NULL;
+
+static struct image_file_data *find_file(struct slideshow *ss,
+					 const char *path, bool loading)
+{
+	for (size_t i = 0; i < ss->files.num; i++) {
+		struct image_file_data *file = &ss->files.array[i];
+
+		if (!file->source && file->loading == loading &&
+		    strcmp(file->path, path) == 0)
+			return file;
+	}
+
+	return NULL;
+}
+
+static void load_slide_task(void *param)
+{
+	struct slide_load *load = param;
+	struct slideshow *ss = load->ss;
+	obs_source_t *ss_source;
+	obs_source_t *source = NULL;
+	struct image_file_data *file;
+
+	/* the slideshow data stays valid for as long as its source does */
+	ss_source = obs_weak_source_get_source(load->weak);
+	if (!ss_source)
+		goto exit;
+
+	pthread_mutex_lock(&ss->mutex);
+	file = find_file(ss, load->path, true);
+	pthread_mutex_unlock(&ss->mutex);
+
+	if (file)
+		source = create_source_from_file(load->path);
+
+	pthread_mutex_lock(&ss->mutex);
+	file = find_file(ss, load->path, true);
+	if (file) {
+		file->loading = false;
+
+		if (source) {
+			void *source_data = obs_obj_get_data(source);
+
+			file->source = source;
+			file->mem_usage =
+				image_source_get_memory_usage(source_data);
+			ss->mem_usage += file->mem_usage;
+			set_file_size(ss, file, obs_source_get_width(source),
+				      obs_source_get_height(source));
+			source = NULL;
+		}
+	}
+	pthread_mutex_unlock(&ss->mutex);
+
+	obs_source_release(source);
+	obs_source_release(ss_source);
+
+exit:
+	obs_weak_source_release(load->weak);
+	bfree(load->path);
+	bfree(load);
+}
+
+/* queues the source of the slide to be created, call with the mutex held */
+static void load_slide(struct slideshow *ss, size_t idx)
+{
+	struct image_file_data *file = &ss->files.array[idx];
+	struct slide_load *load;
+
+	if (file->source || file->loading)
+		return;
+
+	load = bzalloc(sizeof(*load));
+	load->ss = ss;
+	load->weak = obs_source_get_weak_source(ss->source);
+	load->path = bstrdup(file->path);
+	file->loading = true;
+
+	pthread_mutex_lock(&load_queue_mutex);
+	if (!load_queue)
+		load_queue = os_task_queue_create();
+	os_task_queue_queue_task(load_queue, load_slide_task, load);
+	pthread_mutex_unlock(&load_queue_mutex);
+}
+
+void slideshow_free_load_queue(void)
+{
+	pthread_mutex_lock(&load_queue_mutex);
+	os_task_queue_destroy(load_queue);
+	load_queue = NULL;
+	pthread_mutex_unlock(&load_queue_mutex);
+}
+
+/* the current slide and the upcoming ones keep their sources */
+static bool slide_wanted(struct slideshow *ss, size_t idx)
+{
+	size_t num = ss->files.num;
+
+	if (idx == ss->cur_item)
+		return true;
+
+	if (ss->randomize) {
+		for (size_t i = 0; i < ss->upcoming.num; i++) {
+			if (ss->upcoming.array[i] == idx)
+				return true;
+		}
+		return false;
+	}
+
+	for (size_t i = 1; i <= PREFETCH_COUNT && i < num; i++) {
+		size_t next = ss->cur_item + i;
+
+		if (next >= num) {
+			if (!ss->loop)
+				break;
+			next -= num;
+		}
+
+		if (next == idx)
+			return true;
+	}
+
+	return false;
+}
+
+/* takes the sources of slides that are no longer wanted, they are released
+ * by the caller once the mutex is unlocked.  the transition keeps its own
+ * reference while it fades them out */
+static void take_unwanted_sources(struct slideshow *ss,
+				  struct darray *sources)
+{
+	DARRAY(obs_source_t *) unwanted;
+
+	unwanted.da = *sources;
+
+	for (size_t i = 0; i < ss->files.num; i++) {
+		struct image_file_data *file = &ss->files.array[i];
+
+		if (file->source && !slide_wanted(ss, i)) {
+			da_push_back(unwanted, &file->source);
+			ss->mem_usage -= file->mem_usage;
+			file->mem_usage = 0;
+			file->source = NULL;
+		}
+	}
+
+	*sources = unwanted.da;
+}
+
+/* loads the upcoming slides until the sources of the slideshow reach the
+ * memory limit */
+static void prefetch_slides(struct slideshow *ss)
+{
+	size_t num = ss->files.num;
+
+	if (!num)
+		return;
+
+	if (ss->randomize) {
+		size_t last = ss->upcoming.num ? *(size_t *)da_end(ss->upcoming)
+					       : ss->cur_item;
+
+		while (ss->upcoming.num < PREFETCH_COUNT) {
+			last = random_next_file(ss, last);
+			da_push_back(ss->upcoming, &last);
+		}
+
+		for (size_t i = 0; i < ss->upcoming.num; i++) {
+			if (ss->mem_usage >= MAX_MEM_USAGE)
+				break;
+			load_slide(ss, ss->upcoming.array[i]);
+		}
+		return;
+	}
+
+	for (size_t i = 1; i <= PREFETCH_COUNT && i < num; i++) {
+		size_t idx = ss->cur_item + i;
+
+		if (ss->mem_usage >= MAX_MEM_USAGE)
+			break;
+
+		if (idx >= num) {
+			if (!ss->loop)
+				break;
+			idx -= num;
+		}
+
+		load_slide(ss, idx);
+	}
+}
+
 /* ------------------------------------------------------------------------- */
 
 static const char *ss_getname(void *unused)
@@ -200,40 +502,38 @@ static const char *ss_getname(void *unused)
 	return obs_module_text("SlideShow");
 }
 
+/* adds a slide without loading it.  sources of slides that are already
+ * shown are kept, the size is only known once the image was decoded */
 static void add_file(struct slideshow *ss, struct darray *array,
 		     const char *path, uint32_t *cx, uint32_t *cy)
 {
 	DARRAY(struct image_file_data) new_files;
-	struct image_file_data data;
-	obs_source_t *new_source;
+	struct image_file_data data = {0};
 
 	new_files.da = *array;
 
 	pthread_mutex_lock(&ss->mutex);
-	new_source = get_source(&ss->files.da, path);
+	data.source = get_source(&ss->files.da, path);
 	pthread_mutex_unlock(&ss->mutex);
 
-	if (!new_source)
-		new_source = get_source(&new_files.da, path);
-	if (!new_source)
-		new_source = create_source_from_file(path);
+	if (data.source) {
+		void *source_data = obs_obj_get_data(data.source);
 
-	if (new_source) {
-		uint32_t new_cx = obs_source_get_width(new_source);
-		uint32_t new_cy = obs_source_get_height(new_source);
-
-		data.path = bstrdup(path);
-		data.source = new_source;
-		da_push_back(new_files, &data);
+		data.cx = obs_source_get_width(data.source);
+		data.cy = obs_source_get_height(data.source);
+		data.mem_usage = image_source_get_memory_usage(source_data);
+	} else {
+		image_cache_get_size(path, SLIDE_ALPHA_MODE, &data.cx,
+				     &data.cy);
+	}
 
-		if (new_cx > *cx)
-			*cx = new_cx;
-		if (new_cy > *cy)
-			*cy = new_cy;
+	data.path = bstrdup(path);
+	da_push_back(new_files, &data);
 
-		void *source_data = obs_obj_get_data(new_source);
-		ss->mem_usage += image_source_get_memory_usage(source_data);
-	}
+	if (data.cx > *cx)
+		*cx = data.cx;
+	if (data.cy > *cy)
+		*cy = data.cy;
 
 	*array = new_files.da;
 }
@@ -252,19 +552,49 @@ static inline bool item_valid(struct slideshow *ss)
 	return ss->files.num && ss->cur_item < ss->files.num;
 }
 
-static void do_transition(void *data, bool to_null)
+static void do_transition_internal(struct slideshow *ss, bool to_null,
+				   bool use_cut)
 {
-	struct slideshow *ss = data;
-	bool valid = item_valid(ss);
+	DARRAY(obs_source_t *) unwanted;
+	obs_source_t *source = NULL;
+	bool valid;
+
+	da_init(unwanted);
+
+	pthread_mutex_lock(&ss->mutex);
+	valid = item_valid(ss);
+	ss->slide_pending = false;
+
+	if (valid && (use_cut || !to_null)) {
+		struct image_file_data *file = &ss->files.array[ss->cur_item];
+
+		/* a slide that is not loaded yet is shown once it is, see
+		 * ss_video_tick */
+		source = obs_source_get_ref(file->source);
+		if (!source) {
+			ss->slide_pending = true;
+			ss->pending_cut = use_cut;
+			load_slide(ss, ss->cur_item);
+		}
+
+		take_unwanted_sources(ss, &unwanted.da);
+		prefetch_slides(ss);
+	}
+	pthread_mutex_unlock(&ss->mutex);
+
+	for (size_t i = 0; i < unwanted.num; i++)
+		obs_source_release(unwanted.array[i]);
+	da_free(unwanted);
+
+	if (valid && (use_cut || !to_null) && !source)
+		return;
 
-	if (valid && ss->use_cut) {
-		obs_transition_set(ss->transition,
-				   ss->files.array[ss->cur_item].source);
+	if (valid && use_cut) {
+		obs_transition_set(ss->transition, source);
 
 	} else if (valid && !to_null) {
 		obs_transition_start(ss->transition, OBS_TRANSITION_MODE_AUTO,
-				     ss->tr_speed,
-				     ss->files.array[ss->cur_item].source);
+				     ss->tr_speed, source);
 
 	} else {
 		obs_transition_start(ss->transition, OBS_TRANSITION_MODE_AUTO,
@@ -272,6 +602,44 @@ static void do_transition(void *data, bool to_null)
 		set_media_state(ss, OBS_MEDIA_STATE_ENDED);
 		obs_source_media_ended(ss->source);
 	}
+
+	obs_source_release(source);
+}
+
+static void do_transition(void *data, bool to_null)
+{
+	struct slideshow *ss = data;
+	do_transition_internal(ss, to_null, ss->use_cut);
+}
+
+/* shows the current slide once its source has been loaded */
+static void show_pending_slide(struct slideshow *ss)
+{
+	bool ready = false;
+	bool use_cut;
+
+	pthread_mutex_lock(&ss->mutex);
+	if (ss->slide_pending && item_valid(ss))
+		ready = ss->files.array[ss->cur_item].source != NULL;
+	use_cut = ss->pending_cut;
+	pthread_mutex_unlock(&ss->mutex);
+
+	if (!ready)
+		return;
+
+	ss->elapsed = 0.0f;
+	do_transition_internal(ss, false, use_cut);
+}
+
+/* applies the sizes of slides loaded since the last tick */
+static void update_slide_sizes(struct slideshow *ss)
+{
+	pthread_mutex_lock(&ss->mutex);
+	if (ss->sizes_changed) {
+		ss->sizes_changed = false;
+		apply_size(ss);
+	}
+	pthread_mutex_unlock(&ss->mutex);
 }
 
 static void ss_update(void *data, obs_data_t *settings)
@@ -333,9 +701,7 @@ static void ss_update(void *data, obs_data_t *settings)
 	count = obs_data_array_count(array);
 
 	/* ------------------------------------- */
-	/* create new list of sources */
-
-	ss->mem_usage = 0;
+	/* create new list of slides */
 
 	for (size_t i = 0; i < count; i++) {
 		obs_data_t *item = obs_data_array_item(array, i);
@@ -364,9 +730,6 @@ static void ss_update(void *data, obs_data_t *settings)
 				dstr_cat(&dir_path, ent->d_name);
 				add_file(ss, &new_files.da, dir_path.array, &cx,
 					 &cy);
-
-				if (ss->mem_usage >= MAX_MEM_USAGE)
-					break;
 			}
 
 			dstr_free(&dir_path);
@@ -376,9 +739,27 @@ static void ss_update(void *data, obs_data_t *settings)
 		}
 
 		obs_data_release(item);
+	}
 
-		if (ss->mem_usage >= MAX_MEM_USAGE)
-			break;
+	/* ------------------------------------- */
+	/* get size settings */
+
+	const char *res_str = obs_data_get_string(settings, S_CUSTOM_SIZE);
+	bool aspect_only = false, use_auto = true;
+	int cx_in = 0, cy_in = 0;
+
+	if (strcmp(res_str, T_CUSTOM_SIZE_AUTO) != 0) {
+		int ret = sscanf(res_str, "%dx%d", &cx_in, &cy_in);
+		if (ret == 2) {
+			aspect_only = false;
+			use_auto = false;
+		} else {
+			ret = sscanf(res_str, "%d:%d", &cx_in, &cy_in);
+			if (ret == 2) {
+				aspect_only = true;
+				use_auto = false;
+			}
+		}
 	}
 
 	/* ------------------------------------- */
@@ -388,6 +769,11 @@ static void ss_update(void *data, obs_data_t *settings)
 
 	old_files.da = ss->files.da;
 	ss->files.da = new_files.da;
+
+	ss->mem_usage = 0;
+	for (size_t i = 0; i < ss->files.num; i++)
+		ss->mem_usage += ss->files.array[i].mem_usage;
+
 	if (new_tr) {
 		old_tr = ss->transition;
 		ss->transition = new_tr;
@@ -406,6 +792,18 @@ static void ss_update(void *data, obs_data_t *settings)
 	ss->tr_speed = new_speed;
 	ss->tr_name = tr_name;
 	ss->slide_time = (float)new_duration / 1000.0f;
+	da_resize(ss->upcoming, 0);
+	ss->slide_pending = false;
+	ss->cur_item = 0;
+
+	ss->custom_cx = cx_in;
+	ss->custom_cy = cy_in;
+	ss->aspect_only = aspect_only;
+	ss->use_auto = use_auto;
+	ss->max_cx = cx;
+	ss->max_cy = cy;
+	ss->sizes_changed = false;
+	apply_size(ss);
 
 	pthread_mutex_unlock(&ss->mutex);
 
@@ -418,57 +816,16 @@ static void ss_update(void *data, obs_data_t *settings)
 
 	/* ------------------------- */
 
-	const char *res_str = obs_data_get_string(settings, S_CUSTOM_SIZE);
-	bool aspect_only = false, use_auto = true;
-	int cx_in = 0, cy_in = 0;
-
-	if (strcmp(res_str, T_CUSTOM_SIZE_AUTO) != 0) {
-		int ret = sscanf(res_str, "%dx%d", &cx_in, &cy_in);
-		if (ret == 2) {
-			aspect_only = false;
-			use_auto = false;
-		} else {
-			ret = sscanf(res_str, "%d:%d", &cx_in, &cy_in);
-			if (ret == 2) {
-				aspect_only = true;
-				use_auto = false;
-			}
-		}
-	}
-
-	if (!use_auto) {
-		double cx_f = (double)cx;
-		double cy_f = (double)cy;
-
-		double old_aspect = cx_f / cy_f;
-		double new_aspect = (double)cx_in / (double)cy_in;
-
-		if (aspect_only) {
-			if (fabs(old_aspect - new_aspect) > EPSILON) {
-				if (new_aspect > old_aspect)
-					cx = (uint32_t)(cy_f * new_aspect);
-				else
-					cy = (uint32_t)(cx_f / new_aspect);
-			}
-		} else {
-			cx = (uint32_t)cx_in;
-			cy = (uint32_t)cy_in;
-		}
-	}
-
-	/* ------------------------- */
-
-	ss->cx = cx;
-	ss->cy = cy;
-	ss->cur_item = 0;
 	ss->elapsed = 0.0f;
-	obs_transition_set_size(ss->transition, cx, cy);
 	obs_transition_set_alignment(ss->transition, OBS_ALIGN_CENTER);
 	obs_transition_set_scale_type(ss->transition,
 				      OBS_TRANSITION_SCALE_ASPECT);
 
-	if (ss->randomize && ss->files.num)
+	if (ss->randomize && ss->files.num) {
+		pthread_mutex_lock(&ss->mutex);
 		ss->cur_item = random_file(ss);
+		pthread_mutex_unlock(&ss->mutex);
+	}
 	if (new_tr)
 		obs_source_add_active_child(ss->source, new_tr);
 	if (ss->files.num) {
@@ -509,7 +866,9 @@ static void ss_restart(void *data)
 	struct slideshow *ss = data;
 
 	ss->elapsed = 0.0f;
+	pthread_mutex_lock(&ss->mutex);
 	ss->cur_item = 0;
+	pthread_mutex_unlock(&ss->mutex);
 	ss->stop = false;
 	ss->paused = false;
 	do_transition(ss, false);
@@ -522,7 +881,9 @@ static void ss_stop(void *data)
 	struct slideshow *ss = data;
 
 	ss->elapsed = 0.0f;
+	pthread_mutex_lock(&ss->mutex);
 	ss->cur_item = 0;
+	pthread_mutex_unlock(&ss->mutex);
 
 	do_transition(ss, true);
 	ss->stop = true;
@@ -538,8 +899,10 @@ static void ss_next_slide(void *data)
 	if (!ss->files.num || obs_transition_get_time(ss->transition) < 1.0f)
 		return;
 
+	pthread_mutex_lock(&ss->mutex);
 	if (++ss->cur_item >= ss->files.num)
 		ss->cur_item = 0;
+	pthread_mutex_unlock(&ss->mutex);
 
 	do_transition(ss, false);
 }
@@ -551,10 +914,12 @@ static void ss_previous_slide(void *data)
 	if (!ss->files.num || obs_transition_get_time(ss->transition) < 1.0f)
 		return;
 
+	pthread_mutex_lock(&ss->mutex);
 	if (ss->cur_item == 0)
 		ss->cur_item = ss->files.num - 1;
 	else
 		--ss->cur_item;
+	pthread_mutex_unlock(&ss->mutex);
 
 	do_transition(ss, false);
 }
@@ -636,6 +1001,7 @@ static void ss_destroy(void *data)
 	}
 	
 	free_files(&ss->files.da);
+	da_free(ss->upcoming);
 	pthread_mutex_destroy(&ss->mutex);
 	bfree(ss);
 }
@@ -705,9 +1071,15 @@ static void ss_video_tick(void *data, float seconds)
 	if (!ss->transition || !ss->slide_time)
 		return;
 
+	update_slide_sizes(ss);
+	show_pending_slide(ss);
+
 	if (ss->restart_on_activate && ss->use_cut) {
 		ss->elapsed = 0.0f;
+		pthread_mutex_lock(&ss->mutex);
 		ss->cur_item = ss->randomize ? random_file(ss) : 0;
+		da_resize(ss->upcoming, 0);
+		pthread_mutex_unlock(&ss->mutex);
 		do_transition(ss, false);
 		ss->restart_on_activate = false;
 		ss->use_cut = false;
@@ -746,17 +1118,14 @@ static void ss_video_tick(void *data, float seconds)
 			return;
 		}
 
+		pthread_mutex_lock(&ss->mutex);
 		if (ss->randomize) {
-			size_t next = ss->cur_item;
-			if (ss->files.num > 1) {
-				while (next == ss->cur_item)
-					next = random_file(ss);
-			}
-			ss->cur_item = next;
+			ss->cur_item = next_random_item(ss);
 
 		} else if (++ss->cur_item >= ss->files.num) {
 			ss->cur_item = 0;
 		}
+		pthread_mutex_unlock(&ss->mutex);
 
 		if (ss->files.num)
 			do_transition(ss, false);
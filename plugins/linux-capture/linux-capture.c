@@ -62,6 +62,9 @@ bool obs_module_load(void)
 #endif
 		break;
 #endif
+
+	case OBS_NIX_PLATFORM_SURFACELESS_EGL:
+		break;
 	}
 
 	return true;
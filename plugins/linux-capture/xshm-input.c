@@ -18,6 +18,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <stdio.h>
 #include <stdlib.h>
 #include <inttypes.h>
+#include <xcb/damage.h>
 #include <xcb/randr.h>
 #include <xcb/shm.h>
 #include <xcb/xfixes.h>
@@ -32,6 +33,18 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #define blog(level, msg, ...) blog(level, "xshm-input: " msg, ##__VA_ARGS__)
 
+/* damage beyond these limits is captured with a full grab instead */
+#define MAX_DAMAGE_RECTS 32
+#define MAX_DAMAGE_PERCENT 50
+
+struct damage_rect {
+	int_fast32_t x;
+	int_fast32_t y;
+	int_fast32_t width;
+	int_fast32_t height;
+	uint32_t offset;
+};
+
 struct xshm_data {
 	obs_source_t *source;
 
@@ -63,6 +76,14 @@ struct xshm_data {
 	bool use_xinerama;
 	bool use_randr;
 	bool advanced;
+
+	bool use_damage;
+	bool full_update;
+	xcb_damage_damage_t damage;
+	xcb_xfixes_region_t damage_region;
+
+	uint64_t bytes_copied;
+	double capture_time;
 };
 
 /**
@@ -98,9 +119,60 @@ static bool xshm_check_extensions(xcb_connection_t *xcb)
 	if (!xcb_get_extension_data(xcb, &xcb_randr_id)->present)
 		blog(LOG_INFO, "Missing Randr extension !");
 
+	if (!xcb_get_extension_data(xcb, &xcb_damage_id)->present)
+		blog(LOG_INFO, "Missing Damage extension !");
+
 	return ok;
 }
 
+/**
+ * Track damage of the root window so only changed areas have to be copied
+ *
+ * @note requires the xfixes version to be queried first
+ */
+static bool xshm_init_damage(struct xshm_data *data)
+{
+	xcb_damage_query_version_cookie_t ver_c;
+	xcb_void_cookie_t damage_c;
+	xcb_generic_error_t *err;
+
+	if (!xcb_get_extension_data(data->xcb, &xcb_damage_id)->present)
+		return false;
+
+	ver_c = xcb_damage_query_version_unchecked(data->xcb,
+						   XCB_DAMAGE_MAJOR_VERSION,
+						   XCB_DAMAGE_MINOR_VERSION);
+	free(xcb_damage_query_version_reply(data->xcb, ver_c, NULL));
+
+	data->damage = xcb_generate_id(data->xcb);
+	damage_c = xcb_damage_create_checked(data->xcb, data->damage,
+					     data->xcb_screen->root,
+					     XCB_DAMAGE_REPORT_LEVEL_NON_EMPTY);
+	err = xcb_request_check(data->xcb, damage_c);
+	if (err) {
+		blog(LOG_WARNING, "failed to create damage, capturing "
+				  "full frames");
+		free(err);
+		return false;
+	}
+
+	data->damage_region = xcb_generate_id(data->xcb);
+	xcb_xfixes_create_region(data->xcb, data->damage_region, 0, NULL);
+
+	data->full_update = true;
+	return true;
+}
+
+static void xshm_destroy_damage(struct xshm_data *data)
+{
+	if (!data->use_damage)
+		return;
+
+	xcb_xfixes_destroy_region(data->xcb, data->damage_region);
+	xcb_damage_destroy(data->xcb, data->damage);
+	data->use_damage = false;
+}
+
 /**
  * Update the capture
  *
@@ -201,6 +273,18 @@ static void xshm_capture_stop(struct xshm_data *data)
 
 	obs_leave_graphics();
 
+	if (data->capture_time > 0.0) {
+		blog(LOG_INFO, "Copied %.1f MB/s on average (%s)",
+		     (double)data->bytes_copied / data->capture_time /
+			     (1024.0 * 1024.0),
+		     data->use_damage ? "damage tracking" : "full frames");
+		data->bytes_copied = 0;
+		data->capture_time = 0.0;
+	}
+
+	if (data->xcb)
+		xshm_destroy_damage(data);
+
 	if (data->xshm) {
 		xshm_xcb_detach(data->xshm);
 		data->xshm = NULL;
@@ -252,6 +336,8 @@ static void xshm_capture_start(struct xshm_data *data)
 	data->cursor = xcb_xcursor_init(data->xcb);
 	xcb_xcursor_offset(data->cursor, data->adj_x_org, data->adj_y_org);
 
+	data->use_damage = xshm_init_damage(data);
+
 	obs_enter_graphics();
 
 	xshm_resize_texture(data);
@@ -466,12 +552,164 @@ static void *xshm_create(obs_data_t *settings, obs_source_t *source)
 	return data;
 }
 
+/**
+ * Grab the whole capture area and upload it
+ */
+static void xshm_update_full(struct xshm_data *data)
+{
+	xcb_shm_get_image_cookie_t img_c;
+	xcb_shm_get_image_reply_t *img_r;
+
+	/* everything damaged so far is covered by this grab */
+	if (data->use_damage)
+		xcb_damage_subtract(data->xcb, data->damage, XCB_NONE,
+				    XCB_NONE);
+
+	img_c = xcb_shm_get_image_unchecked(data->xcb, data->xcb_screen->root,
+					    data->adj_x_org, data->adj_y_org,
+					    data->adj_width, data->adj_height,
+					    ~0, XCB_IMAGE_FORMAT_Z_PIXMAP,
+					    data->xshm->seg, 0);
+	img_r = xcb_shm_get_image_reply(data->xcb, img_c, NULL);
+	if (!img_r)
+		return;
+
+	obs_enter_graphics();
+	gs_texture_set_image(data->texture, (void *)data->xshm->data,
+			     data->adj_width * 4, false);
+	obs_leave_graphics();
+
+	data->bytes_copied += (uint64_t)data->adj_width * data->adj_height * 4;
+	data->full_update = false;
+	free(img_r);
+}
+
+/**
+ * Clip the damaged rectangles to the capture area and lay them out one after
+ * another in the shm segment
+ *
+ * @return number of rectangles, or -1 if a full grab is cheaper
+ */
+static int_fast32_t xshm_clip_damage(struct xshm_data *data,
+				     const xcb_rectangle_t *rects,
+				     int_fast32_t num_rects,
+				     struct damage_rect *out)
+{
+	const int_fast32_t right = data->adj_x_org + data->adj_width;
+	const int_fast32_t bottom = data->adj_y_org + data->adj_height;
+	uint64_t area = 0;
+	int_fast32_t count = 0;
+
+	if (num_rects > MAX_DAMAGE_RECTS)
+		return -1;
+
+	for (int_fast32_t i = 0; i < num_rects; i++) {
+		int_fast32_t x1 = rects[i].x;
+		int_fast32_t y1 = rects[i].y;
+		int_fast32_t x2 = x1 + rects[i].width;
+		int_fast32_t y2 = y1 + rects[i].height;
+
+		if (x1 < data->adj_x_org)
+			x1 = data->adj_x_org;
+		if (y1 < data->adj_y_org)
+			y1 = data->adj_y_org;
+		if (x2 > right)
+			x2 = right;
+		if (y2 > bottom)
+			y2 = bottom;
+		if (x1 >= x2 || y1 >= y2)
+			continue;
+
+		out[count].x = x1 - data->adj_x_org;
+		out[count].y = y1 - data->adj_y_org;
+		out[count].width = x2 - x1;
+		out[count].height = y2 - y1;
+		out[count].offset = (uint32_t)(area * 4);
+		area += (uint64_t)(x2 - x1) * (y2 - y1);
+		count++;
+	}
+
+	if (area * 100 > (uint64_t)data->adj_width * data->adj_height *
+				 MAX_DAMAGE_PERCENT)
+		return -1;
+
+	return count;
+}
+
+/**
+ * Grab and upload only the areas damaged since the last update
+ *
+ * @return false if a full grab is needed instead
+ */
+static bool xshm_update_damaged(struct xshm_data *data)
+{
+	xcb_xfixes_fetch_region_cookie_t region_c;
+	xcb_xfixes_fetch_region_reply_t *region_r;
+	xcb_shm_get_image_cookie_t img_c[MAX_DAMAGE_RECTS];
+	struct damage_rect rects[MAX_DAMAGE_RECTS];
+	int_fast32_t count;
+	bool success = true;
+
+	if (data->full_update)
+		return false;
+
+	xcb_damage_subtract(data->xcb, data->damage, XCB_NONE,
+			    data->damage_region);
+	region_c = xcb_xfixes_fetch_region_unchecked(data->xcb,
+						     data->damage_region);
+	region_r = xcb_xfixes_fetch_region_reply(data->xcb, region_c, NULL);
+	if (!region_r)
+		return false;
+
+	count = xshm_clip_damage(
+		data, xcb_xfixes_fetch_region_rectangles(region_r),
+		xcb_xfixes_fetch_region_rectangles_length(region_r), rects);
+	free(region_r);
+
+	if (count <= 0)
+		return count == 0;
+
+	for (int_fast32_t i = 0; i < count; i++) {
+		img_c[i] = xcb_shm_get_image_unchecked(
+			data->xcb, data->xcb_screen->root,
+			data->adj_x_org + rects[i].x,
+			data->adj_y_org + rects[i].y, rects[i].width,
+			rects[i].height, ~0, XCB_IMAGE_FORMAT_Z_PIXMAP,
+			data->xshm->seg, rects[i].offset);
+	}
+
+	for (int_fast32_t i = 0; i < count; i++) {
+		xcb_shm_get_image_reply_t *img_r =
+			xcb_shm_get_image_reply(data->xcb, img_c[i], NULL);
+		if (!img_r)
+			success = false;
+		free(img_r);
+	}
+
+	if (!success)
+		return false;
+
+	obs_enter_graphics();
+
+	for (int_fast32_t i = 0; success && i < count; i++) {
+		success = gs_texture_set_image_region(
+			data->texture, rects[i].x, rects[i].y, rects[i].width,
+			rects[i].height, data->xshm->data + rects[i].offset,
+			rects[i].width * 4);
+		data->bytes_copied +=
+			(uint64_t)rects[i].width * rects[i].height * 4;
+	}
+
+	obs_leave_graphics();
+
+	return success;
+}
+
 /**
  * Prepare the capture data
  */
 static void xshm_video_tick(void *vptr, float seconds)
 {
-	UNUSED_PARAMETER(seconds);
 	XSHM_DATA(vptr);
 
 	if (!data->texture)
@@ -479,34 +717,32 @@ static void xshm_video_tick(void *vptr, float seconds)
 	if (!obs_source_showing(data->source))
 		return;
 
-	xcb_shm_get_image_cookie_t img_c;
-	xcb_shm_get_image_reply_t *img_r;
 	xcb_xfixes_get_cursor_image_cookie_t cur_c;
 	xcb_xfixes_get_cursor_image_reply_t *cur_r;
 
-	img_c = xcb_shm_get_image_unchecked(data->xcb, data->xcb_screen->root,
-					    data->adj_x_org, data->adj_y_org,
-					    data->adj_width, data->adj_height,
-					    ~0, XCB_IMAGE_FORMAT_Z_PIXMAP,
-					    data->xshm->seg, 0);
 	cur_c = xcb_xfixes_get_cursor_image_unchecked(data->xcb);
 
-	img_r = xcb_shm_get_image_reply(data->xcb, img_c, NULL);
-	cur_r = xcb_xfixes_get_cursor_image_reply(data->xcb, cur_c, NULL);
+	if (data->use_damage) {
+		xcb_generic_event_t *event;
 
-	if (!img_r)
-		goto exit;
+		/* damage is fetched every tick, the notify events are only
+		 * drained so they do not pile up */
+		while ((event = xcb_poll_for_event(data->xcb)))
+			free(event);
 
-	obs_enter_graphics();
+		if (!xshm_update_damaged(data))
+			xshm_update_full(data);
+	} else {
+		xshm_update_full(data);
+	}
 
-	gs_texture_set_image(data->texture, (void *)data->xshm->data,
-			     data->adj_width * 4, false);
-	xcb_xcursor_update(data->cursor, cur_r);
+	cur_r = xcb_xfixes_get_cursor_image_reply(data->xcb, cur_c, NULL);
 
+	obs_enter_graphics();
+	xcb_xcursor_update(data->cursor, cur_r);
 	obs_leave_graphics();
 
-exit:
-	free(img_r);
+	data->capture_time += seconds;
 	free(cur_r);
 }
 
@@ -265,16 +265,16 @@ static void *v4l2_thread(void *vptr)
 		start = (uint8_t *)data->buffers.info[buf.index].start;
 
 		if (data->pixfmt == V4L2_PIX_FMT_MJPEG) {
-			if (v4l2_decode_mjpeg(&out, start, buf.bytesused,
-					      &data->mjpeg_decoder) < 0) {
-				blog(LOG_ERROR, "failed to unpack jpeg");
-				break;
-			}
+			if (v4l2_queue_mjpeg(&data->mjpeg_decoder, &out, start,
+					     buf.bytesused) < 0)
+				blog(LOG_DEBUG,
+				     "%s: decoders busy, dropped jpeg",
+				     data->device_id);
 		} else {
 			for (uint_fast32_t i = 0; i < MAX_AV_PLANES; ++i)
 				out.data[i] = start + plane_offsets[i];
+			obs_source_output_video(data->source, &out);
 		}
-		obs_source_output_video(data->source, &out);
 
 		if (v4l2_ioctl(data->dev, VIDIOC_QBUF, &buf) < 0) {
 			blog(LOG_ERROR, "%s: failed to enqueue buffer",
@@ -1021,7 +1021,8 @@ static void v4l2_init(struct v4l2_data *data)
 		goto fail;
 	}
 
-	if (v4l2_init_mjpeg(&data->mjpeg_decoder) < 0) {
+	if (data->pixfmt == V4L2_PIX_FMT_MJPEG &&
+	    v4l2_init_mjpeg(&data->mjpeg_decoder, data->source) < 0) {
 		blog(LOG_ERROR, "Failed to initialize mjpeg decoder");
 		goto fail;
 	}
@@ -15,99 +15,383 @@ You should have received a copy of the GNU General Public License
 along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <inttypes.h>
+
 #include <obs-module.h>
+#include <util/platform.h>
+#include <util/bmem.h>
 
 #include "v4l2-mjpeg.h"
 
 #define blog(level, msg, ...) \
 	blog(level, "v4l2-input: mjpeg: " msg, ##__VA_ARGS__)
 
-int v4l2_init_mjpeg(struct v4l2_mjpeg_decoder *decoder)
+#define MAX_WORKERS 4
+
+enum job_state {
+	JOB_FREE,
+	JOB_QUEUED,
+	JOB_DECODING,
+	JOB_DONE,
+};
+
+struct v4l2_mjpeg_job {
+	enum job_state state;
+	uint64_t seq;
+	uint64_t queued_ts;
+	bool failed;
+
+	uint8_t *data;
+	size_t length;
+	size_t capacity;
+
+	struct obs_source_frame out;
+	AVFrame *frame;
+};
+
+struct v4l2_mjpeg_worker {
+	struct v4l2_mjpeg_decoder *decoder;
+	pthread_t thread;
+	bool thread_valid;
+
+	AVCodecContext *context;
+	AVPacket *packet;
+};
+
+static enum video_format convert_pix_fmt(int format)
+{
+	switch (format) {
+	case AV_PIX_FMT_YUVJ422P:
+	case AV_PIX_FMT_YUV422P:
+		return VIDEO_FORMAT_I422;
+	case AV_PIX_FMT_YUVJ420P:
+	case AV_PIX_FMT_YUV420P:
+		return VIDEO_FORMAT_I420;
+	case AV_PIX_FMT_YUVJ444P:
+	case AV_PIX_FMT_YUV444P:
+		return VIDEO_FORMAT_I444;
+	default:
+		return VIDEO_FORMAT_NONE;
+	}
+}
+
+/**
+ * Decode the jpeg of the job. The obs frame points straight at the planes of
+ * the decoded frame, which stay referenced until the frame has been output.
+ */
+static void decode_job(struct v4l2_mjpeg_worker *worker,
+		       struct v4l2_mjpeg_job *job)
+{
+	worker->packet->data = job->data;
+	worker->packet->size = (int)job->length;
+
+	job->failed = true;
+
+	if (avcodec_send_packet(worker->context, worker->packet) < 0) {
+		blog(LOG_DEBUG, "failed to send jpeg to codec");
+		return;
+	}
+
+	if (avcodec_receive_frame(worker->context, job->frame) < 0) {
+		blog(LOG_DEBUG, "failed to receive frame from codec");
+		return;
+	}
+
+	for (uint_fast32_t i = 0; i < MAX_AV_PLANES; ++i) {
+		job->out.data[i] = job->frame->data[i];
+		job->out.linesize[i] = job->frame->linesize[i];
+	}
+
+	job->out.format = convert_pix_fmt(job->frame->format);
+	job->failed = job->out.format == VIDEO_FORMAT_NONE;
+}
+
+/**
+ * Output all decoded frames that are next in capture order. Whichever worker
+ * finishes the oldest frame outputs it along with the frames that were
+ * completed behind it.
+ */
+static void output_jobs(struct v4l2_mjpeg_decoder *decoder)
+{
+	pthread_mutex_lock(&decoder->output_mutex);
+
+	for (;;) {
+		struct v4l2_mjpeg_job *job;
+		bool ready;
+
+		pthread_mutex_lock(&decoder->mutex);
+		job = &decoder->jobs[decoder->next_output % decoder->num_jobs];
+		ready = job->state == JOB_DONE &&
+			job->seq == decoder->next_output;
+		pthread_mutex_unlock(&decoder->mutex);
+
+		if (!ready)
+			break;
+
+		if (job->failed) {
+			if (!decoder->failed++)
+				blog(LOG_ERROR, "failed to unpack jpeg");
+		} else {
+			uint64_t latency = os_gettime_ns() - job->queued_ts;
+
+			obs_source_output_video(decoder->source, &job->out);
+
+			decoder->decoded++;
+			decoder->latency_total += latency;
+			if (latency > decoder->latency_max)
+				decoder->latency_max = latency;
+
+			blog(LOG_DEBUG,
+			     "frame #%" PRIu64 " decode latency %.2f ms",
+			     job->seq, (double)latency / 1000000.0);
+		}
+
+		av_frame_unref(job->frame);
+
+		pthread_mutex_lock(&decoder->mutex);
+		job->state = JOB_FREE;
+		decoder->next_output++;
+		pthread_mutex_unlock(&decoder->mutex);
+	}
+
+	pthread_mutex_unlock(&decoder->output_mutex);
+}
+
+static struct v4l2_mjpeg_job *
+next_queued_job(struct v4l2_mjpeg_decoder *decoder)
+{
+	for (uint64_t seq = decoder->next_output; seq < decoder->next_seq;
+	     seq++) {
+		struct v4l2_mjpeg_job *job =
+			&decoder->jobs[seq % decoder->num_jobs];
+		if (job->state == JOB_QUEUED)
+			return job;
+	}
+
+	return NULL;
+}
+
+static void *worker_thread(void *vptr)
+{
+	struct v4l2_mjpeg_worker *worker = vptr;
+	struct v4l2_mjpeg_decoder *decoder = worker->decoder;
+
+	os_set_thread_name("v4l2: mjpeg decode");
+
+	for (;;) {
+		struct v4l2_mjpeg_job *job;
+
+		if (os_sem_wait(decoder->queued) != 0)
+			break;
+
+		pthread_mutex_lock(&decoder->mutex);
+		if (decoder->stopping) {
+			pthread_mutex_unlock(&decoder->mutex);
+			break;
+		}
+		job = next_queued_job(decoder);
+		if (job)
+			job->state = JOB_DECODING;
+		pthread_mutex_unlock(&decoder->mutex);
+
+		if (!job)
+			continue;
+
+		decode_job(worker, job);
+
+		pthread_mutex_lock(&decoder->mutex);
+		job->state = JOB_DONE;
+		pthread_mutex_unlock(&decoder->mutex);
+
+		output_jobs(decoder);
+	}
+
+	return NULL;
+}
+
+static int init_worker(struct v4l2_mjpeg_decoder *decoder,
+		       struct v4l2_mjpeg_worker *worker, const AVCodec *codec)
 {
-	decoder->codec = avcodec_find_decoder(AV_CODEC_ID_MJPEG);
-	if (!decoder->codec) {
+	worker->decoder = decoder;
+
+	worker->context = avcodec_alloc_context3(codec);
+	if (!worker->context) {
 		return -1;
 	}
 
-	decoder->context = avcodec_alloc_context3(decoder->codec);
-	if (!decoder->context) {
+	worker->packet = av_packet_alloc();
+	if (!worker->packet) {
 		return -1;
 	}
 
-	decoder->packet = av_packet_alloc();
-	if (!decoder->packet) {
+	worker->context->flags2 |= AV_CODEC_FLAG2_FAST;
+	worker->context->thread_count = 1;
+
+	if (avcodec_open2(worker->context, codec, NULL) < 0) {
+		blog(LOG_ERROR, "failed to open codec");
 		return -1;
 	}
 
-	decoder->frame = av_frame_alloc();
-	if (!decoder->frame) {
+	if (pthread_create(&worker->thread, NULL, worker_thread, worker) != 0) {
+		blog(LOG_ERROR, "failed to create decode thread");
 		return -1;
 	}
 
-	decoder->context->flags2 |= AV_CODEC_FLAG2_FAST;
+	worker->thread_valid = true;
+	return 0;
+}
 
-	if (avcodec_open2(decoder->context, decoder->codec, NULL) < 0) {
-		blog(LOG_ERROR, "failed to open codec");
+int v4l2_init_mjpeg(struct v4l2_mjpeg_decoder *decoder, obs_source_t *source)
+{
+	const AVCodec *codec = avcodec_find_decoder(AV_CODEC_ID_MJPEG);
+	int cores = os_get_logical_cores();
+
+	if (!codec) {
+		return -1;
+	}
+
+	if (pthread_mutex_init(&decoder->mutex, NULL) != 0) {
 		return -1;
 	}
+	if (pthread_mutex_init(&decoder->output_mutex, NULL) != 0) {
+		pthread_mutex_destroy(&decoder->mutex);
+		return -1;
+	}
+	if (os_sem_init(&decoder->queued, 0) != 0) {
+		pthread_mutex_destroy(&decoder->output_mutex);
+		pthread_mutex_destroy(&decoder->mutex);
+		return -1;
+	}
+
+	decoder->initialized = true;
+	decoder->source = source;
+
+	/* leave a core for the capture thread and the rest of obs */
+	decoder->num_workers = cores > 2 ? (size_t)cores - 1 : 1;
+	if (decoder->num_workers > MAX_WORKERS)
+		decoder->num_workers = MAX_WORKERS;
 
-	blog(LOG_DEBUG, "initialized avcodec");
+	decoder->workers = bzalloc(sizeof(struct v4l2_mjpeg_worker) *
+				   decoder->num_workers);
+
+	/* enough jobs to keep every worker busy while earlier frames wait to
+	 * be output in order */
+	decoder->num_jobs = decoder->num_workers * 2;
+	decoder->jobs = bzalloc(sizeof(struct v4l2_mjpeg_job) *
+				decoder->num_jobs);
+	for (size_t i = 0; i < decoder->num_jobs; i++) {
+		decoder->jobs[i].frame = av_frame_alloc();
+		if (!decoder->jobs[i].frame) {
+			return -1;
+		}
+	}
+
+	for (size_t i = 0; i < decoder->num_workers; i++) {
+		if (init_worker(decoder, &decoder->workers[i], codec) < 0) {
+			return -1;
+		}
+	}
+
+	blog(LOG_DEBUG, "initialized avcodec with %zu decode threads",
+	     decoder->num_workers);
 
 	return 0;
 }
 
 void v4l2_destroy_mjpeg(struct v4l2_mjpeg_decoder *decoder)
 {
+	if (!decoder->initialized) {
+		return;
+	}
+
 	blog(LOG_DEBUG, "destroying avcodec");
-	if (decoder->frame) {
-		av_frame_free(&decoder->frame);
+
+	pthread_mutex_lock(&decoder->mutex);
+	decoder->stopping = true;
+	pthread_mutex_unlock(&decoder->mutex);
+
+	for (size_t i = 0; i < decoder->num_workers; i++) {
+		os_sem_post(decoder->queued);
+	}
+
+	for (size_t i = 0; i < decoder->num_workers; i++) {
+		struct v4l2_mjpeg_worker *worker = &decoder->workers[i];
+
+		if (worker->thread_valid) {
+			pthread_join(worker->thread, NULL);
+		}
+		if (worker->packet) {
+			av_packet_free(&worker->packet);
+		}
+		if (worker->context) {
+			avcodec_free_context(&worker->context);
+		}
 	}
 
-	if (decoder->packet) {
-		av_packet_free(&decoder->packet);
+	if (decoder->decoded) {
+		blog(LOG_INFO,
+		     "decoded %" PRIu64 " frames on %zu threads, latency "
+		     "avg %.2f ms, max %.2f ms, dropped %" PRIu64
+		     ", failed %" PRIu64,
+		     decoder->decoded, decoder->num_workers,
+		     (double)decoder->latency_total / decoder->decoded /
+			     1000000.0,
+		     (double)decoder->latency_max / 1000000.0,
+		     decoder->dropped, decoder->failed);
 	}
 
-	if (decoder->context) {
-		avcodec_free_context(&decoder->context);
+	for (size_t i = 0; i < decoder->num_jobs; i++) {
+		struct v4l2_mjpeg_job *job = &decoder->jobs[i];
+
+		if (job->frame) {
+			av_frame_free(&job->frame);
+		}
+		bfree(job->data);
 	}
+
+	bfree(decoder->jobs);
+	bfree(decoder->workers);
+	os_sem_destroy(decoder->queued);
+	pthread_mutex_destroy(&decoder->output_mutex);
+	pthread_mutex_destroy(&decoder->mutex);
+	memset(decoder, 0, sizeof(*decoder));
 }
 
-int v4l2_decode_mjpeg(struct obs_source_frame *out, uint8_t *data,
-		      size_t length, struct v4l2_mjpeg_decoder *decoder)
+int v4l2_queue_mjpeg(struct v4l2_mjpeg_decoder *decoder,
+		     const struct obs_source_frame *frame, const uint8_t *data,
+		     size_t length)
 {
-	decoder->packet->data = data;
-	decoder->packet->size = length;
-	if (avcodec_send_packet(decoder->context, decoder->packet) < 0) {
-		blog(LOG_ERROR, "failed to send jpeg to codec");
-		return -1;
-	}
+	struct v4l2_mjpeg_job *job;
+
+	pthread_mutex_lock(&decoder->mutex);
+	job = &decoder->jobs[decoder->next_seq % decoder->num_jobs];
+	if (job->state != JOB_FREE) {
+		pthread_mutex_unlock(&decoder->mutex);
 
-	if (avcodec_receive_frame(decoder->context, decoder->frame) < 0) {
-		blog(LOG_ERROR, "failed to recieve frame from codec");
+		pthread_mutex_lock(&decoder->output_mutex);
+		decoder->dropped++;
+		pthread_mutex_unlock(&decoder->output_mutex);
 		return -1;
 	}
+	pthread_mutex_unlock(&decoder->mutex);
 
-	for (uint_fast32_t i = 0; i < MAX_AV_PLANES; ++i) {
-		out->data[i] = decoder->frame->data[i];
-		out->linesize[i] = decoder->frame->linesize[i];
+	/* the slot stays free until it is queued, only the capture thread
+	 * fills jobs */
+	if (job->capacity < length + AV_INPUT_BUFFER_PADDING_SIZE) {
+		job->capacity = length + AV_INPUT_BUFFER_PADDING_SIZE;
+		job->data = brealloc(job->data, job->capacity);
 	}
+	memcpy(job->data, data, length);
+	memset(job->data + length, 0, AV_INPUT_BUFFER_PADDING_SIZE);
+	job->length = length;
+	job->out = *frame;
+	job->queued_ts = os_gettime_ns();
 
-	switch (decoder->context->pix_fmt) {
-	case AV_PIX_FMT_YUVJ422P:
-	case AV_PIX_FMT_YUV422P:
-		out->format = VIDEO_FORMAT_I422;
-		break;
-	case AV_PIX_FMT_YUVJ420P:
-	case AV_PIX_FMT_YUV420P:
-		out->format = VIDEO_FORMAT_I420;
-		break;
-	case AV_PIX_FMT_YUVJ444P:
-	case AV_PIX_FMT_YUV444P:
-		out->format = VIDEO_FORMAT_I444;
-		break;
-	default:
-		break;
-	}
+	pthread_mutex_lock(&decoder->mutex);
+	job->seq = decoder->next_seq++;
+	job->state = JOB_QUEUED;
+	pthread_mutex_unlock(&decoder->mutex);
 
+	os_sem_post(decoder->queued);
 	return 0;
 }
@@ -25,43 +25,77 @@ extern "C" {
 #include <libavformat/avformat.h>
 #include <libavutil/pixfmt.h>
 
+#include <obs.h>
+#include <util/threading.h>
+
+struct v4l2_mjpeg_worker;
+struct v4l2_mjpeg_job;
+
 /**
  * Data structure for mjpeg decoding
+ *
+ * Frames are decoded by a pool of worker threads, each with its own codec
+ * context, and are output to the source in the order they were captured.
  */
 struct v4l2_mjpeg_decoder {
-	const AVCodec *codec;
-	AVCodecContext *context;
-	AVPacket *packet;
-	AVFrame *frame;
+	obs_source_t *source;
+	bool initialized;
+	bool stopping;
+
+	struct v4l2_mjpeg_worker *workers;
+	size_t num_workers;
+
+	struct v4l2_mjpeg_job *jobs;
+	size_t num_jobs;
+	uint64_t next_seq;
+	uint64_t next_output;
+
+	pthread_mutex_t mutex;
+	pthread_mutex_t output_mutex;
+	os_sem_t *queued;
+
+	/* statistics, protected by output_mutex */
+	uint64_t decoded;
+	uint64_t dropped;
+	uint64_t failed;
+	uint64_t latency_total;
+	uint64_t latency_max;
 };
 
 /**
- * Initialize the mjpeg decoder.
+ * Initialize the mjpeg decoder and start the decode threads.
  * The decoder must be destroyed on failure.
  *
- * @param props the decoder structure
+ * @param decoder the decoder structure
+ * @param source the source the decoded frames are output to
  * @return non-zero on failure
  */
-int v4l2_init_mjpeg(struct v4l2_mjpeg_decoder *decoder);
+int v4l2_init_mjpeg(struct v4l2_mjpeg_decoder *decoder, obs_source_t *source);
 
 /**
- * Free any data associated with the decoder.
+ * Stop the decode threads and free any data associated with the decoder.
  *
  * @param decoder the decoder structure
  */
 void v4l2_destroy_mjpeg(struct v4l2_mjpeg_decoder *decoder);
 
 /**
- * Decode a jpeg into an obs frame
+ * Queue a jpeg for decoding
+ *
+ * The jpeg data is copied, so the capture buffer can be given back to the
+ * driver right away. Once decoded, the frame is output to the source with the
+ * properties and timestamp of the frame passed in. If all decoders are busy
+ * the jpeg is dropped.
  *
- * @param out the obs frame to decode into
+ * @param decoder the decoder as initialized by v4l2_init_mjpeg
+ * @param frame the obs frame properties, the planes are filled in later
  * @param data the jpeg data
  * @param length length of the data
- * @param decoder the decoder as initialized by v4l2_init_mjpeg
- * @return non-zero on failure
+ * @return non-zero if the jpeg was dropped
  */
-int v4l2_decode_mjpeg(struct obs_source_frame *out, uint8_t *data,
-		      size_t length, struct v4l2_mjpeg_decoder *decoder);
+int v4l2_queue_mjpeg(struct v4l2_mjpeg_decoder *decoder,
+		     const struct obs_source_frame *frame, const uint8_t *data,
+		     size_t length);
 
 #ifdef __cplusplus
 }
@@ -502,6 +502,7 @@ bool write_packet(struct ffmpeg_muxer *stream, struct encoder_packet *packet)
 		return false;
 	}
 
+	obs_encoder_packet_trace_sent(packet);
 	stream->total_bytes += packet->size;
 	return true;
 }
@@ -60,6 +60,8 @@ struct ffmpeg_source {
 	bool seekable;
 	bool enable_caching;
 	int volume;
+	int preroll_frames;
+	bool seek_index;
 	
 
 	pthread_t reconnect_thread;
@@ -102,6 +104,7 @@ static bool is_local_file_modified(obs_properties_t *props,
 	obs_property_t *seekable = obs_properties_get(props, "seekable");
 	obs_property_t *speed = obs_properties_get(props, "speed_percent");
 	obs_property_t *caching = obs_properties_get(props, "caching");
+	obs_property_t *seek_index = obs_properties_get(props, "seek_index");
 	obs_property_t *reconnect_delay_sec =
 		obs_properties_get(props, "reconnect_delay_sec");
 	obs_property_set_visible(input, !enabled);
@@ -112,6 +115,7 @@ static bool is_local_file_modified(obs_properties_t *props,
 	obs_property_set_visible(speed, enabled);
 	obs_property_set_visible(seekable, !enabled);
 	obs_property_set_visible(caching, false);
+	obs_property_set_visible(seek_index, enabled);
 	obs_property_set_visible(reconnect_delay_sec, !enabled);
 
 	return true;
@@ -128,6 +132,8 @@ static void ffmpeg_source_defaults(obs_data_t *settings)
 	obs_data_set_default_int(settings, "buffering_mb", 2);
 	obs_data_set_default_int(settings, "speed_percent", 100);
 	obs_data_set_default_bool(settings, "caching", false);
+	obs_data_set_default_int(settings, "preroll_frames", 0);
+	obs_data_set_default_bool(settings, "seek_index", false);
 	obs_data_set_default_int(settings, "volume", 100);
 }
 
@@ -236,6 +242,11 @@ static obs_properties_t *ffmpeg_source_getproperties(void *data)
 
 	obs_properties_add_bool(props, "seekable", obs_module_text("Seekable"));
 
+	prop = obs_properties_add_bool(props, "seek_index",
+				       obs_module_text("SeekIndex"));
+	obs_property_set_long_description(prop,
+					  obs_module_text("SeekIndex.ToolTip"));
+
 	const char* text = obs_module_text("EnableCaching");
 	obs_properties_add_bool(props, "caching", obs_module_text("EnableCaching"));
 
@@ -256,6 +267,8 @@ static void dump_source_info(struct ffmpeg_source *s, const char *input,
 			"\trestart_on_activate:     %s\n"
 			"\tclose_when_inactive:     %s\n"
 			"\tenable_caching:          %s\n"
+			"\tpreroll_frames:          %d\n"
+			"\tseek_index:              %s\n"
 			"\tvolume:                  %d",
 			input ? input : "(null)",
 			input_format ? input_format : "(null)",
@@ -266,6 +279,8 @@ static void dump_source_info(struct ffmpeg_source *s, const char *input,
 			s->restart_on_activate ? "yes" : "no",
 			s->close_when_inactive ? "yes" : "no",
 			s->enable_caching ? "yes" : "no",
+			s->preroll_frames,
+			s->seek_index ? "yes" : "no",
 			s->volume);
 }
 
@@ -281,7 +296,11 @@ static void preload_frame(void *opaque, struct obs_source_frame *f)
 	if (s->close_when_inactive)
 		return;
 
-	if (s->is_clear_on_media_end || s->is_looping)
+	/* with preroll the first frame is uploaded right away instead of when
+	 * playback starts */
+	if (s->preroll_frames && s->is_clear_on_media_end)
+		obs_source_set_video_frame(s->source, f);
+	else if (s->is_clear_on_media_end || s->is_looping)
 		obs_source_preload_video(s->source, f);
 
 	if (!s->is_local_file && os_atomic_set_bool(&s->reconnecting, false))
@@ -330,6 +349,9 @@ static void media_ready(void *opaque)
 static void ffmpeg_source_open(struct ffmpeg_source *s)
 {
 	if (s->input && *s->input) {
+		char *index_dir = s->seek_index
+					  ? obs_module_config_path("seek-index")
+					  : NULL;
 		struct mp_media_info info = {
 			.opaque = s,
 			.v_cb = get_frame,
@@ -349,9 +371,13 @@ static void ffmpeg_source_open(struct ffmpeg_source *s)
 			.enable_caching = s->enable_caching,
 			.reconnecting = s->reconnecting,
 			.volume = s->volume,
+			.preroll_frames = s->preroll_frames,
+			.seek_index = s->seek_index,
+			.seek_index_dir = index_dir,
 		};
 
 		s->media_valid = mp_media_init(&s->media, &info);
+		bfree(index_dir);
 	}
 }
 
@@ -449,6 +475,9 @@ static void ffmpeg_source_update(void *data, obs_data_t *settings)
 		s->close_when_inactive =
 			obs_data_get_bool(settings, "close_when_inactive");
 		s->enable_caching = obs_data_get_bool(settings, "caching");
+		s->preroll_frames =
+			(int)obs_data_get_int(settings, "preroll_frames");
+		s->seek_index = obs_data_get_bool(settings, "seek_index");
 	} else {
 		input = (char *)obs_data_get_string(settings, "input");
 		input_format =
@@ -465,6 +494,8 @@ static void ffmpeg_source_update(void *data, obs_data_t *settings)
 		s->is_looping = false;
 		s->close_when_inactive = true;
 		s->enable_caching = false;
+		s->preroll_frames = 0;
+		s->seek_index = false;
 
 		if (s->reconnect_thread_valid) {
 			s->stop_reconnect = true;
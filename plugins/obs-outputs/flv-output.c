@@ -98,6 +98,9 @@ static int write_packet(struct flv_output *stream,
 	fwrite(data, 1, size, stream->file);
 	bfree(data);
 
+	if (!is_header)
+		obs_encoder_packet_trace_sent(packet);
+
 	return ret;
 }
 
@@ -407,6 +407,7 @@ static int send_packet(struct ftl_stream *stream, struct encoder_packet *packet,
 	if (is_header) {
 		bfree(packet->data);
 	} else {
+		obs_encoder_packet_trace_sent(packet);
 		obs_encoder_packet_release(packet);
 	}
 
@@ -477,10 +477,13 @@ static int send_packet(struct rtmp_stream *stream,
 	ret = RTMP_Write(&stream->rtmp, (char *)data, (int)size, 0);
 	bfree(data);
 
-	if (is_header)
+	if (is_header) {
 		bfree(packet->data);
-	else
+	} else {
+		if (ret >= 0)
+			obs_encoder_packet_trace_sent(packet);
 		obs_encoder_packet_release(packet);
+	}
 
 	stream->total_bytes_sent += size;
 	return ret;
@@ -1,10 +1,15 @@
 #include <obs-module.h>
 #include <util/dstr.h>
 #include "util/platform.h"
+#include "util/threading.h"
 
 #define TIMING_TIME 0
 #define TIMING_FRAME 1
 
+/* frames decoded ahead while the stinger is idle so it can start right away
+ * when the transition is triggered */
+#define STINGER_PREROLL_FRAMES 6
+
 enum matte_layout {
 	MATTE_LAYOUT_HORIZONTAL,
 	MATTE_LAYOUT_VERTICAL,
@@ -49,6 +54,13 @@ struct stinger_info {
 	gs_texrender_t *matte_tex;
 	gs_texrender_t *stinger_tex;
 
+	/* time from obs_transition_start to the first composited frame of the
+	 * playing media, set on the graphics thread */
+	uint64_t start_time_ns;
+	uint64_t start_latency_ns;
+	volatile bool start_pending;
+	volatile bool start_measured;
+
 	float (*mix_a)(void *data, float t);
 	float (*mix_b)(void *data, float t);
 };
@@ -76,6 +88,8 @@ static void stinger_update(void *data, obs_data_t *settings)
 	obs_data_set_bool(media_settings, "hw_decode", hw_decode);
 	obs_data_set_bool(media_settings, "looping", false);
 	obs_data_set_int(media_settings, "volume", volume);
+	obs_data_set_int(media_settings, "preroll_frames",
+			 STINGER_PREROLL_FRAMES);
 
 	obs_source_release(s->media_source);
 	struct dstr name;
@@ -123,6 +137,8 @@ static void stinger_update(void *data, obs_data_t *settings)
 		obs_data_t *tm_media_settings = obs_data_create();
 		obs_data_set_string(tm_media_settings, "local_file", tm_path);
 		obs_data_set_bool(tm_media_settings, "looping", false);
+		obs_data_set_int(tm_media_settings, "preroll_frames",
+				 STINGER_PREROLL_FRAMES);
 
 		s->matte_source = obs_source_create_private(
 			"ffmpeg_source", NULL, tm_media_settings);
@@ -169,6 +185,16 @@ static void stinger_update(void *data, obs_data_t *settings)
 	}
 }
 
+static void get_start_latency(void *data, calldata_t *cd)
+{
+	struct stinger_info *s = data;
+	bool measured = os_atomic_load_bool(&s->start_measured);
+
+	calldata_set_bool(cd, "measured", measured);
+	calldata_set_int(cd, "latency",
+			 measured ? (long long)s->start_latency_ns : 0);
+}
+
 static void *stinger_create(obs_data_t *settings, obs_source_t *source)
 {
 	struct stinger_info *s = bzalloc(sizeof(*s));
@@ -202,6 +228,12 @@ static void *stinger_create(obs_data_t *settings, obs_source_t *source)
 	s->ep_invert_matte =
 		gs_effect_get_param_by_name(s->matte_effect, "invert_matte");
 
+	proc_handler_t *ph = obs_source_get_proc_handler(source);
+	proc_handler_add(ph,
+			 "void get_start_latency(out bool measured, "
+			 "out int latency)",
+			 get_start_latency, s);
+
 	obs_transition_enable_fixed(s->source, true, 0);
 	obs_source_update(source, settings);
 	return s;
@@ -309,6 +341,24 @@ static void stinger_texrender(struct stinger_info *s, uint32_t source_cx,
 	}
 }
 
+/* called when a stinger frame is composited.  only frames of the media that
+ * is playing count, so a frame left over from the last run doesn't */
+static void mark_started(struct stinger_info *s)
+{
+	if (!os_atomic_load_bool(&s->start_pending))
+		return;
+	if (obs_source_media_get_state(s->media_source) !=
+	    OBS_MEDIA_STATE_PLAYING)
+		return;
+
+	s->start_latency_ns = os_gettime_ns() - s->start_time_ns;
+	os_atomic_set_bool(&s->start_pending, false);
+	os_atomic_set_bool(&s->start_measured, true);
+
+	blog(LOG_DEBUG, "Stinger started after %.2f ms",
+	     (double)s->start_latency_ns / 1000000.0);
+}
+
 static void stinger_video_render(void *data, gs_effect_t *effect)
 {
 	struct stinger_info *s = data;
@@ -324,6 +374,7 @@ static void stinger_video_render(void *data, gs_effect_t *effect)
 				s->matte_rendered = true;
 			obs_transition_video_render(s->source,
 						    stinger_matte_render);
+			mark_started(s);
 		} else {
 			obs_transition_video_render_direct(
 				s->source, s->matte_rendered
@@ -373,6 +424,8 @@ static void stinger_video_render(void *data, gs_effect_t *effect)
 		gs_matrix_pop();
 	}
 
+	mark_started(s);
+
 	UNUSED_PARAMETER(effect);
 }
 
@@ -447,6 +500,7 @@ static bool stinger_audio_render(void *data, uint64_t *ts_out,
 		*ts_out = ts;
 
 	struct obs_source_audio_mix child_audio;
+	size_t frames = obs_get_audio_frames_per_tick();
 	obs_source_get_audio_mix(s->media_source, &child_audio);
 
 	for (size_t mix = 0; mix < MAX_AUDIO_MIXES; mix++) {
@@ -456,7 +510,7 @@ static bool stinger_audio_render(void *data, uint64_t *ts_out,
 		for (size_t ch = 0; ch < channels; ch++) {
 			register float *out = audio->output[mix].data[ch];
 			register float *in = child_audio.output[mix].data[ch];
-			register float *end = in + AUDIO_OUTPUT_FRAMES;
+			register float *end = in + frames;
 
 			while (in < end)
 				*(out++) += *(in++);
@@ -498,6 +552,9 @@ static void stinger_transition_start(void *data)
 		}
 
 		s->matte_rendered = false;
+		s->start_time_ns = os_gettime_ns();
+		os_atomic_set_bool(&s->start_measured, false);
+		os_atomic_set_bool(&s->start_pending, true);
 
 		proc_handler_call(ph, "get_duration", &cd);
 		proc_handler_call(ph, "get_nb_frames", &cd);
@@ -555,6 +612,7 @@ static void stinger_transition_stop(void *data)
 	if (s->matte_source)
 		obs_source_remove_active_child(s->source, s->matte_source);
 
+	os_atomic_set_bool(&s->start_pending, false);
 	s->transitioning = false;
 }
 
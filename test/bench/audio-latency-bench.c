@@ -0,0 +1,294 @@
+/*
+ * audio-latency-bench: measures the input-to-output latency of the audio
+ * mixer for each supported tick size.
+ *
+ * A sine wave source in the style of test-sinewave.c outputs silence with
+ * periodic tone bursts, timestamped like a capture device would.  The mixed
+ * output is scanned for the start of each burst, and the time between the
+ * burst being captured and it reaching the output is reported as JSON.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <obs.h>
+#include <util/bmem.h>
+#include <util/platform.h>
+#include <util/threading.h>
+
+#define SAMPLE_RATE 48000
+#define CHUNK_FRAMES 480
+#define CHUNK_NS 10000000ULL
+#define BURST_CHUNKS 5
+#define BURST_INTERVAL_CHUNKS 25
+#define WARMUP_NS 1000000000ULL
+#define NUM_BURSTS 20
+#define THRESHOLD 0.1f
+
+#ifndef M_PI
+#define M_PI 3.1415926535897932384626433832795
+#endif
+
+struct burst_data {
+	pthread_t thread;
+	bool thread_valid;
+	os_event_t *event;
+	obs_source_t *source;
+};
+
+struct latency_stats {
+	pthread_mutex_t mutex;
+
+	/* capture timestamps of the burst onsets not yet seen in the output */
+	uint64_t pending[NUM_BURSTS * 2];
+	size_t num_pending;
+	uint32_t silent_frames;
+	bool in_burst;
+
+	uint64_t total;
+	uint64_t min;
+	uint64_t max;
+	size_t count;
+};
+
+static struct latency_stats stats;
+
+static void do_log(int log_level, const char *msg, va_list args, void *param)
+{
+	if (log_level <= LOG_WARNING) {
+		vfprintf(stderr, msg, args);
+		fputc('\n', stderr);
+	}
+
+	UNUSED_PARAMETER(param);
+}
+
+/* ------------------------------------------------------------------------- */
+
+static void *burst_thread(void *pdata)
+{
+	struct burst_data *bd = pdata;
+	uint64_t start_time = os_gettime_ns();
+	uint64_t last_time = start_time;
+	float samples[CHUNK_FRAMES];
+	double phase = 0.0;
+	uint64_t chunk = 0;
+
+	while (os_event_try(bd->event) == EAGAIN) {
+		uint64_t ts;
+		bool burst;
+
+		if (!os_sleepto_ns(last_time += CHUNK_NS))
+			last_time = os_gettime_ns();
+
+		/* the chunk was captured over the last CHUNK_NS */
+		ts = last_time - CHUNK_NS;
+		burst = ts - start_time >= WARMUP_NS &&
+			chunk % BURST_INTERVAL_CHUNKS < BURST_CHUNKS;
+
+		for (size_t i = 0; i < CHUNK_FRAMES; i++) {
+			phase += 1000.0 / SAMPLE_RATE * M_PI * 2.0;
+			samples[i] = burst ? (float)(sin(phase) * 0.5) : 0.0f;
+		}
+
+		if (burst && chunk % BURST_INTERVAL_CHUNKS == 0) {
+			pthread_mutex_lock(&stats.mutex);
+			if (stats.num_pending < NUM_BURSTS * 2)
+				stats.pending[stats.num_pending++] = ts;
+			pthread_mutex_unlock(&stats.mutex);
+		}
+
+		struct obs_source_audio data = {0};
+		data.data[0] = (const uint8_t *)samples;
+		data.frames = CHUNK_FRAMES;
+		data.speakers = SPEAKERS_MONO;
+		data.samples_per_sec = SAMPLE_RATE;
+		data.timestamp = ts;
+		data.format = AUDIO_FORMAT_FLOAT;
+		obs_source_output_audio(bd->source, &data);
+
+		chunk++;
+	}
+
+	return NULL;
+}
+
+static const char *burst_getname(void *unused)
+{
+	UNUSED_PARAMETER(unused);
+	return "Latency Burst Source";
+}
+
+static void burst_destroy(void *data)
+{
+	struct burst_data *bd = data;
+
+	if (bd) {
+		if (bd->thread_valid) {
+			os_event_signal(bd->event);
+			pthread_join(bd->thread, NULL);
+		}
+
+		os_event_destroy(bd->event);
+		bfree(bd);
+	}
+}
+
+static void *burst_create(obs_data_t *settings, obs_source_t *source)
+{
+	struct burst_data *bd = bzalloc(sizeof(struct burst_data));
+	bd->source = source;
+
+	if (os_event_init(&bd->event, OS_EVENT_TYPE_MANUAL) != 0)
+		goto fail;
+	if (pthread_create(&bd->thread, NULL, burst_thread, bd) != 0)
+		goto fail;
+
+	bd->thread_valid = true;
+
+	UNUSED_PARAMETER(settings);
+	return bd;
+
+fail:
+	burst_destroy(bd);
+	return NULL;
+}
+
+static struct obs_source_info burst_source_info = {
+	.id = "latency_burst_source",
+	.type = OBS_SOURCE_TYPE_INPUT,
+	.output_flags = OBS_SOURCE_AUDIO,
+	.get_name = burst_getname,
+	.create = burst_create,
+	.destroy = burst_destroy,
+};
+
+/* ------------------------------------------------------------------------- */
+
+static void audio_callback(void *param, size_t mix_idx,
+			   struct audio_data *streaming_data,
+			   struct audio_data *recording_data)
+{
+	const float *samples = (const float *)streaming_data->data[0];
+	uint64_t now = os_gettime_ns();
+
+	pthread_mutex_lock(&stats.mutex);
+
+	for (uint32_t i = 0; i < streaming_data->frames; i++) {
+		bool loud = fabsf(samples[i]) > THRESHOLD;
+
+		if (loud && !stats.in_burst && stats.num_pending) {
+			uint64_t latency = now - stats.pending[0];
+
+			memmove(stats.pending, stats.pending + 1,
+				(stats.num_pending - 1) * sizeof(uint64_t));
+			stats.num_pending--;
+
+			stats.total += latency;
+			if (!stats.count || latency < stats.min)
+				stats.min = latency;
+			if (latency > stats.max)
+				stats.max = latency;
+			stats.count++;
+		}
+
+		/* a burst ends after a full chunk of silence */
+		if (loud) {
+			stats.in_burst = true;
+			stats.silent_frames = 0;
+		} else if (++stats.silent_frames >= CHUNK_FRAMES) {
+			stats.in_burst = false;
+		}
+	}
+
+	pthread_mutex_unlock(&stats.mutex);
+
+	UNUSED_PARAMETER(param);
+	UNUSED_PARAMETER(mix_idx);
+	UNUSED_PARAMETER(recording_data);
+}
+
+static bool measure(uint32_t frames_per_tick, FILE *out, bool first)
+{
+	struct obs_audio_info2 oai = {0};
+	obs_source_t *source;
+	uint64_t duration;
+
+	oai.samples_per_sec = SAMPLE_RATE;
+	oai.speakers = SPEAKERS_STEREO;
+	oai.frames_per_tick = frames_per_tick;
+
+	if (!obs_reset_audio2(&oai)) {
+		fprintf(stderr, "Failed to initialize audio with %u frames\n",
+			frames_per_tick);
+		return false;
+	}
+
+	pthread_mutex_lock(&stats.mutex);
+	stats.num_pending = 0;
+	stats.silent_frames = 0;
+	stats.in_burst = false;
+	stats.total = stats.min = stats.max = 0;
+	stats.count = 0;
+	pthread_mutex_unlock(&stats.mutex);
+
+	audio_output_connect(obs_get_audio(), 0, NULL, audio_callback, NULL);
+
+	source = obs_source_create("latency_burst_source", "bursts", NULL,
+				   NULL);
+	obs_set_output_source(0, source);
+
+	duration = WARMUP_NS +
+		   (NUM_BURSTS + 1) * BURST_INTERVAL_CHUNKS * CHUNK_NS;
+	os_sleep_ms((uint32_t)(duration / 1000000));
+
+	obs_set_output_source(0, NULL);
+	obs_source_release(source);
+	audio_output_disconnect(obs_get_audio(), 0, audio_callback, NULL);
+
+	pthread_mutex_lock(&stats.mutex);
+	fprintf(out,
+		"%s    {\"frames_per_tick\": %u, \"bursts\": %zu, "
+		"\"avg_ms\": %.2f, \"min_ms\": %.2f, \"max_ms\": %.2f, "
+		"\"buffering_ms\": %u}",
+		first ? "" : ",\n", frames_per_tick, stats.count,
+		stats.count ? (double)stats.total / stats.count / 1e6 : 0.0,
+		(double)stats.min / 1e6, (double)stats.max / 1e6,
+		obs_get_audio_buffering_ms());
+	pthread_mutex_unlock(&stats.mutex);
+
+	return stats.count > 0;
+}
+
+int main(int argc, char *argv[])
+{
+	static const uint32_t tick_sizes[] = {1024, 512, 256};
+	bool success = true;
+
+	base_set_log_handler(do_log, NULL);
+	pthread_mutex_init(&stats.mutex, NULL);
+
+	if (!obs_startup("en-US", NULL, NULL)) {
+		fprintf(stderr, "Failed to start libobs\n");
+		return 1;
+	}
+
+	obs_register_source(&burst_source_info);
+
+	printf("{\n  \"results\": [\n");
+	for (size_t i = 0; i < sizeof(tick_sizes) / sizeof(tick_sizes[0]);
+	     i++) {
+		if (!measure(tick_sizes[i], stdout, i == 0))
+			success = false;
+	}
+	printf("\n  ]\n}\n");
+
+	obs_shutdown();
+	pthread_mutex_destroy(&stats.mutex);
+
+	UNUSED_PARAMETER(argc);
+	UNUSED_PARAMETER(argv);
+	return success ? 0 : 1;
+}
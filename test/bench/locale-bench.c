@@ -0,0 +1,137 @@
+/*
+ * locale-bench: measures loading the locale files of the UI and of every
+ * plugin in a source tree, by parsing the .ini files, with an empty locale
+ * cache and with a filled cache that is memory mapped.  Reports the load time
+ * and the change in resident memory as JSON.
+ *
+ * usage: locale-bench [source dir] [locale]
+ */
+
+#include <stdio.h>
+
+#include <util/bmem.h>
+#include <util/darray.h>
+#include <util/dstr.h>
+#include <util/platform.h>
+#include <util/text-lookup.h>
+
+#define CACHE_DIR "locale-bench-cache"
+
+static void do_log(int log_level, const char *msg, va_list args, void *param)
+{
+	if (log_level <= LOG_WARNING) {
+		vfprintf(stderr, msg, args);
+		fputc('\n', stderr);
+	}
+
+	UNUSED_PARAMETER(param);
+}
+
+static void find_files(struct darray *files, const char *pattern)
+{
+	os_glob_t *glob;
+
+	if (os_glob(pattern, 0, &glob) != 0)
+		return;
+
+	for (size_t i = 0; i < glob->gl_pathc; i++) {
+		char *path = bstrdup(glob->gl_pathv[i].path);
+		darray_push_back(sizeof(char *), files, &path);
+	}
+
+	os_globfree(glob);
+}
+
+static void clear_cache(void)
+{
+	os_glob_t *glob;
+
+	if (os_glob(CACHE_DIR "/*", 0, &glob) == 0) {
+		for (size_t i = 0; i < glob->gl_pathc; i++)
+			os_unlink(glob->gl_pathv[i].path);
+		os_globfree(glob);
+	}
+}
+
+static void measure(const char *name, char **files, size_t num, bool cache,
+		    bool first)
+{
+	struct text_lookup_stats start, end;
+	lookup_t **lookups = bzalloc(sizeof(lookup_t *) * num);
+	uint64_t rss = os_get_proc_resident_size();
+	uint64_t time_ns = os_gettime_ns();
+	size_t loaded = 0;
+
+	text_lookup_set_cache_dir(cache ? CACHE_DIR : NULL);
+	text_lookup_get_stats(&start);
+
+	/* one lookup per file, the way each module has its own */
+	for (size_t i = 0; i < num; i++) {
+		lookups[i] = text_lookup_create(files[i]);
+		if (lookups[i])
+			loaded++;
+	}
+
+	time_ns = os_gettime_ns() - time_ns;
+	rss = os_get_proc_resident_size() - rss;
+	text_lookup_get_stats(&end);
+
+	printf("%s    {\"mode\": \"%s\", \"files\": %llu, \"cached\": %llu, "
+	       "\"load_ms\": %.3f, \"rss_delta_kb\": %lld, "
+	       "\"mapped_kb\": %llu, \"heap_kb\": %llu}",
+	       first ? "" : ",\n", name, (unsigned long long)loaded,
+	       (unsigned long long)(end.cached_files - start.cached_files),
+	       (double)time_ns / 1000000.0, (long long)(int64_t)rss / 1024,
+	       (unsigned long long)(end.mapped_bytes - start.mapped_bytes) /
+		       1024,
+	       (unsigned long long)(end.heap_bytes - start.heap_bytes) / 1024);
+
+	for (size_t i = 0; i < num; i++)
+		text_lookup_destroy(lookups[i]);
+	bfree(lookups);
+}
+
+int main(int argc, char *argv[])
+{
+	const char *source_dir = argc > 1 ? argv[1] : ".";
+	const char *locale = argc > 2 ? argv[2] : "en-US";
+	struct darray files = {0};
+	struct dstr pattern = {0};
+
+	base_set_log_handler(do_log, NULL);
+
+	dstr_printf(&pattern, "%s/UI/data/locale/%s.ini", source_dir, locale);
+	find_files(&files, pattern.array);
+	dstr_printf(&pattern, "%s/plugins/*/data/locale/%s.ini", source_dir,
+		    locale);
+	find_files(&files, pattern.array);
+	dstr_free(&pattern);
+
+	if (!files.num) {
+		fprintf(stderr, "No %s locale files found in '%s'\n", locale,
+			source_dir);
+		return 1;
+	}
+
+	if (os_mkdirs(CACHE_DIR) == MKDIR_ERROR) {
+		fprintf(stderr, "Failed to create " CACHE_DIR "\n");
+		return 1;
+	}
+
+	clear_cache();
+
+	printf("{\n  \"results\": [\n");
+	measure("parse", files.array, files.num, false, true);
+	measure("cold_cache", files.array, files.num, true, false);
+	measure("mapped", files.array, files.num, true, false);
+	printf("\n  ]\n}\n");
+
+	clear_cache();
+	os_rmdir(CACHE_DIR);
+
+	for (size_t i = 0; i < files.num; i++)
+		bfree(*(char **)darray_item(sizeof(char *), &files, i));
+	darray_free(&files);
+
+	return 0;
+}
@@ -0,0 +1,649 @@
+/*
+ * obs-bench: headless render/encode benchmark.
+ *
+ * Renders a scene collection (or a synthetic scene) for a fixed number of
+ * frames without any windowing system and prints timing statistics as JSON,
+ * so results can be compared between commits and machines.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <obs.h>
+#include <obs-nix-platform.h>
+#include <graphics/texture-atlas.h>
+#include <graphics/vec2.h>
+#include <util/bmem.h>
+#include <util/darray.h>
+#include <util/dstr.h>
+#include <util/platform.h>
+#include <util/threading.h>
+#include <util/profiler.h>
+
+enum bench_output {
+	BENCH_OUTPUT_NONE,
+	BENCH_OUTPUT_RAW,
+	BENCH_OUTPUT_X264,
+};
+
+struct bench_config {
+	uint32_t frames;
+	uint32_t cx;
+	uint32_t cy;
+	uint32_t fps;
+	uint32_t num_sources;
+	const char *scene_file;
+	const char *image_file;
+	const char *stinger_file;
+	const char *json_file;
+	const char *plugin_bin;
+	const char *plugin_data;
+	enum bench_output output;
+	bool verbose;
+};
+
+static volatile long raw_frames = 0;
+static bool verbose_log = false;
+
+static void do_log(int log_level, const char *msg, va_list args, void *param)
+{
+	if (verbose_log || log_level <= LOG_WARNING) {
+		vfprintf(stderr, msg, args);
+		fputc('\n', stderr);
+	}
+
+	UNUSED_PARAMETER(param);
+}
+
+static void usage(const char *exe)
+{
+	fprintf(stderr,
+		"Usage: %s [options]\n"
+		"  --frames <n>          Number of frames to render (default 600)\n"
+		"  --resolution <WxH>    Canvas resolution (default 1920x1080)\n"
+		"  --fps <n>             Frame rate (default 60)\n"
+		"  --scene <file>        Scene collection JSON to load\n"
+		"  --sources <n>         Synthetic color sources if no scene "
+		"collection is given (default 8)\n"
+		"  --image <file>        Use image sources showing <file> for "
+		"the synthetic scene\n"
+		"  --stinger <file>      Trigger a stinger transition using "
+		"<file> halfway through and report its start latency\n"
+		"  --output <mode>       none, raw or x264 (default none)\n"
+		"  --plugins <bin> <data> Additional module search path\n"
+		"  --json <file>         Write results to file instead of stdout\n"
+		"  --verbose             Print the full libobs log\n",
+		exe);
+}
+
+static bool parse_args(struct bench_config *cfg, int argc, char *argv[])
+{
+	for (int i = 1; i < argc; i++) {
+		const char *arg = argv[i];
+		bool has_val = i + 1 < argc;
+
+		if (strcmp(arg, "--frames") == 0 && has_val) {
+			cfg->frames = (uint32_t)strtoul(argv[++i], NULL, 10);
+		} else if (strcmp(arg, "--resolution") == 0 && has_val) {
+			if (sscanf(argv[++i], "%ux%u", &cfg->cx, &cfg->cy) != 2)
+				return false;
+		} else if (strcmp(arg, "--fps") == 0 && has_val) {
+			cfg->fps = (uint32_t)strtoul(argv[++i], NULL, 10);
+		} else if (strcmp(arg, "--scene") == 0 && has_val) {
+			cfg->scene_file = argv[++i];
+		} else if (strcmp(arg, "--sources") == 0 && has_val) {
+			cfg->num_sources =
+				(uint32_t)strtoul(argv[++i], NULL, 10);
+		} else if (strcmp(arg, "--image") == 0 && has_val) {
+			cfg->image_file = argv[++i];
+		} else if (strcmp(arg, "--stinger") == 0 && has_val) {
+			cfg->stinger_file = argv[++i];
+		} else if (strcmp(arg, "--output") == 0 && has_val) {
+			const char *mode = argv[++i];
+			if (strcmp(mode, "none") == 0)
+				cfg->output = BENCH_OUTPUT_NONE;
+			else if (strcmp(mode, "raw") == 0)
+				cfg->output = BENCH_OUTPUT_RAW;
+			else if (strcmp(mode, "x264") == 0)
+				cfg->output = BENCH_OUTPUT_X264;
+			else
+				return false;
+		} else if (strcmp(arg, "--plugins") == 0 && i + 2 < argc) {
+			cfg->plugin_bin = argv[++i];
+			cfg->plugin_data = argv[++i];
+		} else if (strcmp(arg, "--json") == 0 && has_val) {
+			cfg->json_file = argv[++i];
+		} else if (strcmp(arg, "--verbose") == 0) {
+			cfg->verbose = true;
+		} else {
+			return false;
+		}
+	}
+
+	return cfg->frames && cfg->cx && cfg->cy && cfg->fps;
+}
+
+static bool init_obs(const struct bench_config *cfg,
+		     profiler_name_store_t *names)
+{
+	obs_set_nix_platform(OBS_NIX_PLATFORM_SURFACELESS_EGL);
+	obs_set_nix_platform_display(NULL);
+
+	if (!obs_startup("en-US", NULL, names))
+		return false;
+
+	struct obs_video_info ovi = {0};
+	ovi.graphics_module = "libobs-opengl";
+	ovi.fps_num = cfg->fps;
+	ovi.fps_den = 1;
+	ovi.base_width = cfg->cx;
+	ovi.base_height = cfg->cy;
+	ovi.output_width = cfg->cx;
+	ovi.output_height = cfg->cy;
+	ovi.output_format = VIDEO_FORMAT_NV12;
+	ovi.gpu_conversion = true;
+	ovi.colorspace = VIDEO_CS_709;
+	ovi.range = VIDEO_RANGE_PARTIAL;
+	ovi.scale_type = OBS_SCALE_BICUBIC;
+
+	if (obs_reset_video(&ovi) != OBS_VIDEO_SUCCESS) {
+		fprintf(stderr, "Failed to initialize headless video\n");
+		return false;
+	}
+
+	struct obs_audio_info oai = {0};
+	oai.samples_per_sec = 48000;
+	oai.speakers = SPEAKERS_STEREO;
+
+	if (!obs_reset_audio(&oai)) {
+		fprintf(stderr, "Failed to initialize audio\n");
+		return false;
+	}
+
+	if (cfg->plugin_bin)
+		obs_add_module_path(cfg->plugin_bin, cfg->plugin_data);
+
+	obs_load_all_modules();
+	obs_post_load_modules();
+	return true;
+}
+
+/* ------------------------------------------------------------------------- */
+
+static obs_source_t *load_scene_collection(const char *file)
+{
+	obs_data_t *data = obs_data_create_from_json_file(file);
+	if (!data) {
+		fprintf(stderr, "Failed to load scene collection '%s'\n", file);
+		return NULL;
+	}
+
+	obs_data_array_t *sources = obs_data_get_array(data, "sources");
+	const char *scene_name = obs_data_get_string(data, "current_scene");
+
+	obs_load_sources(sources, NULL, NULL);
+
+	obs_source_t *scene = obs_get_source_by_name(scene_name);
+	if (!scene)
+		fprintf(stderr, "Scene '%s' not found in '%s'\n", scene_name,
+			file);
+
+	obs_data_array_release(sources);
+	obs_data_release(data);
+	return scene;
+}
+
+static obs_source_t *create_synthetic_scene(const struct bench_config *cfg)
+{
+	obs_scene_t *scene = obs_scene_create("obs-bench");
+	uint32_t cols = 1;
+
+	while (cols * cols < cfg->num_sources)
+		cols++;
+
+	uint32_t item_cx = cfg->cx / cols;
+	uint32_t item_cy = cfg->cy / cols;
+
+	for (uint32_t i = 0; i < cfg->num_sources; i++) {
+		const char *id = cfg->image_file ? "image_source"
+						 : "color_source";
+		struct dstr name = {0};
+		dstr_printf(&name, "%s %u", id, i);
+
+		obs_data_t *settings = obs_data_create();
+		if (cfg->image_file) {
+			obs_data_set_string(settings, "file", cfg->image_file);
+		} else {
+			obs_data_set_int(settings, "color",
+					 0xFF000000 |
+						 ((i * 0x3F1D27) & 0xFFFFFF));
+			obs_data_set_int(settings, "width", item_cx);
+			obs_data_set_int(settings, "height", item_cy);
+		}
+
+		obs_source_t *source =
+			obs_source_create(id, name.array, settings, NULL);
+		if (source) {
+			obs_sceneitem_t *item = obs_scene_add(scene, source);
+			struct vec2 pos;
+			vec2_set(&pos, (float)((i % cols) * item_cx),
+				 (float)((i / cols) * item_cy));
+			obs_sceneitem_set_pos(item, &pos);
+			obs_source_release(source);
+		}
+
+		obs_data_release(settings);
+		dstr_free(&name);
+	}
+
+	obs_source_t *source = obs_source_get_ref(obs_scene_get_source(scene));
+	obs_scene_release(scene);
+	return source;
+}
+
+/* ------------------------------------------------------------------------- */
+
+static void raw_video_callback(void *param, struct video_data *streaming_frame,
+			       struct video_data *recording_frame)
+{
+	os_atomic_inc_long(&raw_frames);
+
+	UNUSED_PARAMETER(param);
+	UNUSED_PARAMETER(streaming_frame);
+	UNUSED_PARAMETER(recording_frame);
+}
+
+struct bench_encode {
+	obs_encoder_t *venc;
+	obs_encoder_t *aenc;
+	obs_output_t *output;
+};
+
+static bool start_encode(struct bench_encode *enc)
+{
+	obs_data_t *settings = obs_data_create();
+	obs_data_set_string(settings, "preset", "veryfast");
+	obs_data_set_int(settings, "bitrate", 6000);
+
+	enc->venc = obs_video_encoder_create("obs_x264", "bench video",
+					     settings, NULL);
+	enc->aenc = obs_audio_encoder_create("ffmpeg_aac", "bench audio", NULL,
+					     0, NULL);
+	enc->output = obs_output_create("null_output", "bench output", NULL,
+					NULL);
+	obs_data_release(settings);
+
+	if (!enc->venc || !enc->aenc || !enc->output) {
+		fprintf(stderr, "Failed to create x264 encoding pipeline\n");
+		return false;
+	}
+
+	obs_encoder_set_video(enc->venc, obs_get_video());
+	obs_encoder_set_audio(enc->aenc, obs_get_audio());
+	obs_output_set_video_encoder(enc->output, enc->venc);
+	obs_output_set_audio_encoder(enc->output, enc->aenc, 0);
+
+	if (!obs_output_start(enc->output)) {
+		fprintf(stderr, "Failed to start x264 encoding pipeline\n");
+		return false;
+	}
+
+	return true;
+}
+
+static void stop_encode(struct bench_encode *enc)
+{
+	if (enc->output) {
+		obs_output_force_stop(enc->output);
+		obs_output_release(enc->output);
+	}
+	obs_encoder_release(enc->venc);
+	obs_encoder_release(enc->aenc);
+}
+
+/* ------------------------------------------------------------------------- */
+
+static bool find_graphics_root(void *context, profiler_snapshot_entry_t *entry)
+{
+	profiler_snapshot_entry_t **found = context;
+	const char *name = profiler_snapshot_entry_name(entry);
+
+	if (strncmp(name, "obs_graphics_thread", 19) == 0) {
+		*found = entry;
+		return false;
+	}
+	return true;
+}
+
+/* snapshot time entries are sorted from slowest to fastest */
+static double entry_percentile(profiler_snapshot_entry_t *entry, double pct)
+{
+	profiler_time_entries_t *times = profiler_snapshot_entry_times(entry);
+	uint64_t calls = profiler_snapshot_entry_overall_count(entry);
+	double slower_calls = (double)calls * (1.0 - pct / 100.0);
+	uint64_t accu = 0;
+
+	for (size_t i = 0; i < times->num; i++) {
+		accu += times->array[i].count;
+		if ((double)accu >= slower_calls)
+			return (double)times->array[i].time_delta / 1000.0;
+	}
+
+	return 0.0;
+}
+
+static double entry_average(profiler_snapshot_entry_t *entry)
+{
+	profiler_time_entries_t *times = profiler_snapshot_entry_times(entry);
+	uint64_t calls = profiler_snapshot_entry_overall_count(entry);
+	double total = 0.0;
+
+	if (!calls)
+		return 0.0;
+
+	for (size_t i = 0; i < times->num; i++)
+		total += (double)times->array[i].time_delta *
+			 (double)times->array[i].count;
+
+	return total / (double)calls / 1000.0;
+}
+
+static bool add_profiler_entry(void *context, profiler_snapshot_entry_t *entry)
+{
+	obs_data_array_t *array = context;
+	obs_data_t *item = obs_data_create();
+	obs_data_array_t *children = obs_data_array_create();
+
+	obs_data_set_string(item, "name", profiler_snapshot_entry_name(entry));
+	obs_data_set_int(
+		item, "calls",
+		(long long)profiler_snapshot_entry_overall_count(entry));
+	obs_data_set_double(item, "avg_ms", entry_average(entry));
+	obs_data_set_double(item, "median_ms", entry_percentile(entry, 50.0));
+	obs_data_set_double(item, "max_ms",
+			    profiler_snapshot_entry_max_time(entry) / 1000.0);
+
+	profiler_snapshot_enumerate_children(entry, add_profiler_entry,
+					     children);
+	if (obs_data_array_count(children))
+		obs_data_set_array(item, "children", children);
+
+	obs_data_array_push_back(array, item);
+	obs_data_array_release(children);
+	obs_data_release(item);
+	return true;
+}
+
+static void add_profiler_results(obs_data_t *results,
+				 profiler_snapshot_t *snap)
+{
+	profiler_snapshot_entry_t *root = NULL;
+	obs_data_array_t *tree = obs_data_array_create();
+
+	profiler_snapshot_enumerate_roots(snap, find_graphics_root, &root);
+	if (root) {
+		obs_data_t *frame = obs_data_create();
+		obs_data_set_double(frame, "avg_ms", entry_average(root));
+		obs_data_set_double(frame, "p50_ms",
+				    entry_percentile(root, 50.0));
+		obs_data_set_double(frame, "p90_ms",
+				    entry_percentile(root, 90.0));
+		obs_data_set_double(frame, "p99_ms",
+				    entry_percentile(root, 99.0));
+		obs_data_set_double(
+			frame, "max_ms",
+			profiler_snapshot_entry_max_time(root) / 1000.0);
+		obs_data_set_obj(results, "frame_time", frame);
+		obs_data_release(frame);
+	}
+
+	profiler_snapshot_enumerate_roots(snap, add_profiler_entry, tree);
+	obs_data_set_array(results, "profiler", tree);
+	obs_data_array_release(tree);
+}
+
+/* ------------------------------------------------------------------------- */
+
+struct bench_stinger {
+	obs_source_t *transition;
+	obs_scene_t *target;
+	bool triggered;
+};
+
+static bool create_stinger(struct bench_stinger *st, const char *file,
+			   obs_source_t *scene)
+{
+	obs_data_t *settings = obs_data_create();
+	obs_data_set_string(settings, "path", file);
+	st->transition = obs_source_create_private("obs_stinger_transition",
+						   "bench stinger", settings);
+	obs_data_release(settings);
+
+	if (!st->transition) {
+		fprintf(stderr, "Failed to create stinger transition\n");
+		return false;
+	}
+
+	/* transitioning to the current scene is a no-op, so use an empty
+	 * scene as the destination */
+	st->target = obs_scene_create_private("bench stinger target");
+	obs_transition_set(st->transition, scene);
+	return true;
+}
+
+static void trigger_stinger(struct bench_stinger *st)
+{
+	st->triggered = obs_transition_start(st->transition,
+					     OBS_TRANSITION_MODE_AUTO, 0,
+					     obs_scene_get_source(st->target));
+	if (!st->triggered)
+		fprintf(stderr, "Failed to start stinger transition\n");
+}
+
+/* the stinger records the time from obs_transition_start to the first
+ * composited frame of its media */
+static void add_stinger_results(obs_data_t *results, struct bench_stinger *st)
+{
+	proc_handler_t *ph = obs_source_get_proc_handler(st->transition);
+	uint64_t timeout = os_gettime_ns() + 1000000000ULL;
+	calldata_t cd = {0};
+	bool measured;
+
+	obs_data_set_bool(results, "stinger_triggered", st->triggered);
+	if (!st->triggered)
+		return;
+
+	/* the transition may have been started close to the end of the run */
+	for (;;) {
+		proc_handler_call(ph, "get_start_latency", &cd);
+		measured = calldata_bool(&cd, "measured");
+		if (measured || os_gettime_ns() > timeout)
+			break;
+		os_sleep_ms(10);
+	}
+
+	if (measured)
+		obs_data_set_double(
+			results, "stinger_start_latency_ms",
+			(double)calldata_int(&cd, "latency") / 1000000.0);
+	else
+		fprintf(stderr, "Stinger media was never composited\n");
+
+	calldata_free(&cd);
+}
+
+static void destroy_stinger(struct bench_stinger *st)
+{
+	obs_source_release(st->transition);
+	obs_scene_release(st->target);
+}
+
+static void add_atlas_results(obs_data_t *results)
+{
+	struct gs_atlas_stats stats;
+	obs_data_t *atlas = obs_data_create();
+
+	obs_enter_graphics();
+	gs_atlas_get_stats(&stats);
+	obs_leave_graphics();
+
+	obs_data_set_int(atlas, "pages", stats.pages);
+	obs_data_set_int(atlas, "regions", stats.regions);
+	obs_data_set_int(atlas, "page_bytes", (long long)stats.page_bytes);
+	obs_data_set_int(atlas, "region_bytes", (long long)stats.region_bytes);
+	obs_data_set_int(atlas, "textures_saved",
+			 stats.regions > stats.pages
+				 ? stats.regions - stats.pages
+				 : 0);
+	obs_data_set_obj(results, "atlas", atlas);
+	obs_data_release(atlas);
+}
+
+static bool write_results(const struct bench_config *cfg, obs_data_t *results)
+{
+	if (cfg->json_file)
+		return obs_data_save_json(results, cfg->json_file);
+
+	puts(obs_data_get_json(results));
+	return true;
+}
+
+/* ------------------------------------------------------------------------- */
+
+static const char *output_names[] = {"none", "raw", "x264"};
+
+int main(int argc, char *argv[])
+{
+	struct bench_config cfg = {
+		.frames = 600,
+		.cx = 1920,
+		.cy = 1080,
+		.fps = 60,
+		.num_sources = 8,
+		.output = BENCH_OUTPUT_NONE,
+	};
+	struct bench_encode enc = {0};
+	struct bench_stinger stinger = {0};
+	obs_source_t *scene = NULL;
+	int ret = EXIT_FAILURE;
+
+	if (!parse_args(&cfg, argc, argv)) {
+		usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	verbose_log = cfg.verbose;
+	base_set_log_handler(do_log, NULL);
+
+	profiler_start();
+	profiler_name_store_t *names = profiler_name_store_create();
+
+	if (!init_obs(&cfg, names))
+		goto shutdown;
+
+	scene = cfg.scene_file ? load_scene_collection(cfg.scene_file)
+			       : create_synthetic_scene(&cfg);
+	if (!scene)
+		goto shutdown;
+
+	if (cfg.stinger_file) {
+		if (!create_stinger(&stinger, cfg.stinger_file, scene))
+			goto shutdown;
+		obs_set_output_source(0, stinger.transition);
+	} else {
+		obs_set_output_source(0, scene);
+	}
+
+	if (cfg.output == BENCH_OUTPUT_RAW)
+		obs_add_raw_video_callback(NULL, raw_video_callback, NULL);
+	else if (cfg.output == BENCH_OUTPUT_X264 && !start_encode(&enc))
+		goto shutdown;
+
+	/* allow twice the nominal duration before giving up */
+	uint64_t start_time = os_gettime_ns();
+	uint64_t timeout = (uint64_t)cfg.frames * 2000000000ULL / cfg.fps;
+	uint32_t start_frames = obs_get_total_frames();
+	uint32_t start_lagged = obs_get_lagged_frames();
+	uint32_t start_skipped =
+		video_output_get_skipped_frames(obs_get_video());
+	uint32_t rendered = 0;
+
+	while (rendered < cfg.frames) {
+		if (os_gettime_ns() - start_time > timeout) {
+			fprintf(stderr, "Timed out after %u of %u frames\n",
+				rendered, cfg.frames);
+			break;
+		}
+		os_sleep_ms(10);
+		rendered = obs_get_total_frames() - start_frames;
+
+		if (stinger.transition && !stinger.triggered &&
+		    rendered >= cfg.frames / 2)
+			trigger_stinger(&stinger);
+	}
+
+	double elapsed = (double)(os_gettime_ns() - start_time) / 1000000000.0;
+
+	obs_data_t *results = obs_data_create();
+	obs_data_set_int(results, "width", cfg.cx);
+	obs_data_set_int(results, "height", cfg.cy);
+	obs_data_set_int(results, "fps", cfg.fps);
+	obs_data_set_string(results, "output", output_names[cfg.output]);
+	obs_data_set_int(results, "frames", rendered);
+	obs_data_set_double(results, "elapsed_s", elapsed);
+	obs_data_set_int(results, "lagged_frames",
+			 obs_get_lagged_frames() - start_lagged);
+	obs_data_set_int(results, "skipped_frames",
+			 video_output_get_skipped_frames(obs_get_video()) -
+				 start_skipped);
+	obs_data_set_int(results, "audio_buffering_ms",
+			 obs_get_audio_buffering_ms());
+	if (cfg.output == BENCH_OUTPUT_RAW)
+		obs_data_set_int(results, "raw_frames",
+				 os_atomic_load_long(&raw_frames));
+	if (cfg.output == BENCH_OUTPUT_X264)
+		obs_data_set_int(results, "dropped_frames",
+				 obs_output_get_frames_dropped(enc.output));
+
+	add_atlas_results(results);
+	if (stinger.transition)
+		add_stinger_results(results, &stinger);
+
+	/* snapshot while the scene is still live, so the numbers reflect the
+	 * measured run rather than teardown */
+	profiler_snapshot_t *snap = profile_snapshot_create();
+	add_profiler_results(results, snap);
+	profile_snapshot_free(snap);
+
+	if (cfg.output == BENCH_OUTPUT_RAW)
+		obs_remove_raw_video_callback(raw_video_callback, NULL);
+	stop_encode(&enc);
+
+	obs_set_output_source(0, NULL);
+	destroy_stinger(&stinger);
+	obs_source_release(scene);
+	scene = NULL;
+
+	obs_shutdown();
+	profiler_stop();
+
+	/* the poll loop can overshoot the requested frame count */
+	if (write_results(&cfg, results) && rendered >= cfg.frames)
+		ret = EXIT_SUCCESS;
+	obs_data_release(results);
+
+	profiler_free();
+	profiler_name_store_free(names);
+	return ret;
+
+shutdown:
+	stop_encode(&enc);
+	destroy_stinger(&stinger);
+	obs_source_release(scene);
+	obs_shutdown();
+	profiler_stop();
+	profiler_free();
+	profiler_name_store_free(names);
+	return ret;
+}
@@ -0,0 +1,94 @@
+/*
+ * profiler-trace-bench: measures the cost of profile_start/profile_end with
+ * trace recording off and on, from one and from several threads at once.
+ * Results are reported as JSON.
+ */
+
+#include <stdio.h>
+
+#include <util/platform.h>
+#include <util/profiler.h>
+#include <util/threading.h>
+
+#define TRACE_EVENTS 4096
+#define NUM_CALLS 1000000
+#define MAX_THREADS 4
+
+static const char *outer_name = "trace_bench_outer";
+static const char *inner_name = "trace_bench_inner";
+
+struct call_thread_data {
+	uint64_t time_ns;
+};
+
+/* four events per call */
+static void record_calls(size_t count)
+{
+	for (size_t i = 0; i < count; i++) {
+		profile_start(outer_name);
+		profile_start(inner_name);
+		profile_end(inner_name);
+		profile_end(outer_name);
+	}
+}
+
+static void *call_thread(void *param)
+{
+	struct call_thread_data *td = param;
+	uint64_t start;
+
+	/* the first events register the ring of the thread */
+	record_calls(1000);
+
+	start = os_gettime_ns();
+	record_calls(NUM_CALLS);
+	td->time_ns = os_gettime_ns() - start;
+	return NULL;
+}
+
+static double measure_ns(int threads)
+{
+	struct call_thread_data td[MAX_THREADS];
+	pthread_t callers[MAX_THREADS];
+	uint64_t time_ns = 0;
+
+	for (int i = 0; i < threads; i++)
+		pthread_create(&callers[i], NULL, call_thread, &td[i]);
+
+	for (int i = 0; i < threads; i++) {
+		pthread_join(callers[i], NULL);
+		time_ns += td[i].time_ns;
+	}
+
+	return (double)time_ns / ((double)NUM_CALLS * 4.0 * threads);
+}
+
+static void measure(int threads, bool first)
+{
+	double off, on;
+
+	profiler_trace_stop();
+	off = measure_ns(threads);
+
+	profiler_trace_start(TRACE_EVENTS);
+	on = measure_ns(threads);
+	profiler_trace_stop();
+
+	printf("%s    {\"threads\": %d, \"ns_per_event_off\": %.1f, "
+	       "\"ns_per_event_on\": %.1f, \"trace_overhead_ns\": %.1f}",
+	       first ? "" : ",\n", threads, off, on, on - off);
+}
+
+int main(int argc, char *argv[])
+{
+	printf("{\n  \"results\": [\n");
+	measure(1, true);
+	measure(MAX_THREADS, false);
+	printf("\n  ]\n}\n");
+
+	profiler_free();
+
+	UNUSED_PARAMETER(argc);
+	UNUSED_PARAMETER(argv);
+	return 0;
+}
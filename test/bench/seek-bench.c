@@ -0,0 +1,504 @@
+/*
+ * seek-bench: media-playback seek latency benchmark.
+ *
+ * Generates test clips with different keyframe intervals (or uses the files
+ * given on the command line), then seeks a paused media to fixed pseudo-random
+ * positions with and without the seek index and prints the time until the
+ * seeked frame is delivered as JSON.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <obs.h>
+#include <util/bmem.h>
+#include <util/darray.h>
+#include <util/dstr.h>
+#include <util/platform.h>
+#include <util/threading.h>
+#include <media-playback/media.h>
+
+#include <libavformat/avformat.h>
+#include <libavcodec/avcodec.h>
+
+#define CLIP_CX 640
+#define CLIP_CY 360
+#define CLIP_FPS 30
+#define SEEK_TIMEOUT_MS 10000
+#define INDEX_TIMEOUT_MS 60000
+
+struct bench_config {
+	DARRAY(int) gops;
+	DARRAY(const char *) files;
+	const char *container;
+	const char *cache_dir;
+	const char *json_file;
+	int duration;
+	int seeks;
+	bool verbose;
+};
+
+struct bench_media {
+	mp_media_t media;
+	os_event_t *ready;
+	os_event_t *seeked;
+};
+
+struct seek_stats {
+	double mean_ms;
+	double p50_ms;
+	double p95_ms;
+	double max_ms;
+	int timeouts;
+};
+
+static bool verbose_log = false;
+
+static void do_log(int log_level, const char *msg, va_list args, void *param)
+{
+	if (verbose_log || log_level <= LOG_WARNING) {
+		vfprintf(stderr, msg, args);
+		fputc('\n', stderr);
+	}
+
+	UNUSED_PARAMETER(param);
+}
+
+static void usage(const char *exe)
+{
+	fprintf(stderr,
+		"Usage: %s [options] [file...]\n"
+		"  --gops <n,n,...>      Keyframe intervals of the generated "
+		"clips (default 1,30,120,300)\n"
+		"  --duration <sec>      Length of the generated clips "
+		"(default 60)\n"
+		"  --container <ext>     Container of the generated clips, ts "
+		"or mp4 (default ts)\n"
+		"  --seeks <n>           Seeks per clip and mode (default 50)\n"
+		"  --cache <dir>         Directory for clips and seek indexes "
+		"(default seek-bench-cache)\n"
+		"  --json <file>         Write results to file instead of stdout\n"
+		"  --verbose             Print the full log\n",
+		exe);
+}
+
+static void parse_gops(struct bench_config *cfg, const char *list)
+{
+	char **gops = strlist_split(list, ',', false);
+
+	da_free(cfg->gops);
+	for (char **gop = gops; *gop; gop++) {
+		int val = atoi(*gop);
+		if (val > 0)
+			da_push_back(cfg->gops, &val);
+	}
+
+	strlist_free(gops);
+}
+
+static bool parse_args(struct bench_config *cfg, int argc, char *argv[])
+{
+	static const int default_gops[] = {1, 30, 120, 300};
+
+	for (size_t i = 0; i < sizeof(default_gops) / sizeof(int); i++)
+		da_push_back(cfg->gops, &default_gops[i]);
+
+	cfg->container = "ts";
+	cfg->cache_dir = "seek-bench-cache";
+	cfg->duration = 60;
+	cfg->seeks = 50;
+
+	for (int i = 1; i < argc; i++) {
+		const char *arg = argv[i];
+		bool has_val = i + 1 < argc;
+
+		if (strcmp(arg, "--gops") == 0 && has_val) {
+			parse_gops(cfg, argv[++i]);
+		} else if (strcmp(arg, "--duration") == 0 && has_val) {
+			cfg->duration = atoi(argv[++i]);
+		} else if (strcmp(arg, "--container") == 0 && has_val) {
+			cfg->container = argv[++i];
+		} else if (strcmp(arg, "--seeks") == 0 && has_val) {
+			cfg->seeks = atoi(argv[++i]);
+		} else if (strcmp(arg, "--cache") == 0 && has_val) {
+			cfg->cache_dir = argv[++i];
+		} else if (strcmp(arg, "--json") == 0 && has_val) {
+			cfg->json_file = argv[++i];
+		} else if (strcmp(arg, "--verbose") == 0) {
+			cfg->verbose = true;
+		} else if (arg[0] != '-') {
+			da_push_back(cfg->files, &arg);
+		} else {
+			return false;
+		}
+	}
+
+	return cfg->duration > 0 && cfg->seeks > 0 &&
+	       (cfg->gops.num || cfg->files.num);
+}
+
+/* ------------------------------------------------------------------------- */
+/* clip generation                                                           */
+
+static void fill_frame(AVFrame *frame, int index)
+{
+	for (int y = 0; y < CLIP_CY; y++) {
+		uint8_t *row = frame->data[0] + y * frame->linesize[0];
+		for (int x = 0; x < CLIP_CX; x++)
+			row[x] = (uint8_t)(x + y + index * 3);
+	}
+
+	for (int y = 0; y < CLIP_CY / 2; y++) {
+		uint8_t *u = frame->data[1] + y * frame->linesize[1];
+		uint8_t *v = frame->data[2] + y * frame->linesize[2];
+		for (int x = 0; x < CLIP_CX / 2; x++) {
+			u[x] = (uint8_t)(128 + y + index * 2);
+			v[x] = (uint8_t)(64 + x + index * 5);
+		}
+	}
+}
+
+static bool write_packets(AVFormatContext *fmt, AVCodecContext *enc,
+			  AVStream *stream, AVPacket *pkt)
+{
+	int ret;
+
+	while ((ret = avcodec_receive_packet(enc, pkt)) == 0) {
+		av_packet_rescale_ts(pkt, enc->time_base, stream->time_base);
+		pkt->stream_index = stream->index;
+		if (av_interleaved_write_frame(fmt, pkt) < 0)
+			return false;
+	}
+
+	return ret == AVERROR(EAGAIN) || ret == AVERROR_EOF;
+}
+
+static bool generate_clip(const char *path, int gop, int duration)
+{
+	const AVCodec *codec = avcodec_find_encoder(AV_CODEC_ID_MPEG4);
+	AVFormatContext *fmt = NULL;
+	AVCodecContext *enc = NULL;
+	AVFrame *frame = NULL;
+	AVPacket *pkt = NULL;
+	AVStream *stream;
+	bool success = false;
+
+	if (!codec) {
+		fprintf(stderr, "MPEG-4 encoder not available\n");
+		return false;
+	}
+
+	if (avformat_alloc_output_context2(&fmt, NULL, NULL, path) < 0)
+		return false;
+
+	stream = avformat_new_stream(fmt, NULL);
+	enc = avcodec_alloc_context3(codec);
+	frame = av_frame_alloc();
+	pkt = av_packet_alloc();
+	if (!stream || !enc || !frame || !pkt)
+		goto fail;
+
+	enc->width = CLIP_CX;
+	enc->height = CLIP_CY;
+	enc->pix_fmt = AV_PIX_FMT_YUV420P;
+	enc->time_base = (AVRational){1, CLIP_FPS};
+	enc->framerate = (AVRational){CLIP_FPS, 1};
+	enc->gop_size = gop;
+	enc->max_b_frames = 0;
+	enc->bit_rate = 2000000;
+	if (fmt->oformat->flags & AVFMT_GLOBALHEADER)
+		enc->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+
+	if (avcodec_open2(enc, codec, NULL) < 0)
+		goto fail;
+	if (avcodec_parameters_from_context(stream->codecpar, enc) < 0)
+		goto fail;
+	stream->time_base = enc->time_base;
+
+	if (avio_open(&fmt->pb, path, AVIO_FLAG_WRITE) < 0)
+		goto fail;
+	if (avformat_write_header(fmt, NULL) < 0)
+		goto fail;
+
+	frame->format = enc->pix_fmt;
+	frame->width = CLIP_CX;
+	frame->height = CLIP_CY;
+	if (av_frame_get_buffer(frame, 0) < 0)
+		goto fail;
+
+	for (int i = 0; i < duration * CLIP_FPS; i++) {
+		if (av_frame_make_writable(frame) < 0)
+			goto fail;
+
+		fill_frame(frame, i);
+		frame->pts = i;
+
+		if (avcodec_send_frame(enc, frame) < 0 ||
+		    !write_packets(fmt, enc, stream, pkt))
+			goto fail;
+	}
+
+	if (avcodec_send_frame(enc, NULL) < 0 ||
+	    !write_packets(fmt, enc, stream, pkt))
+		goto fail;
+
+	success = av_write_trailer(fmt) == 0;
+
+fail:
+	if (fmt->pb)
+		avio_closep(&fmt->pb);
+	av_packet_free(&pkt);
+	av_frame_free(&frame);
+	avcodec_free_context(&enc);
+	avformat_free_context(fmt);
+
+	if (!success)
+		fprintf(stderr, "Failed to generate '%s'\n", path);
+	return success;
+}
+
+/* ------------------------------------------------------------------------- */
+/* seeking                                                                   */
+
+static void media_ready(void *opaque)
+{
+	struct bench_media *bm = opaque;
+	os_event_signal(bm->ready);
+}
+
+static void media_seeked(void *opaque, struct obs_source_frame *frame)
+{
+	struct bench_media *bm = opaque;
+	os_event_signal(bm->seeked);
+
+	UNUSED_PARAMETER(frame);
+}
+
+static void media_frame(void *opaque, struct obs_source_frame *frame)
+{
+	UNUSED_PARAMETER(opaque);
+	UNUSED_PARAMETER(frame);
+}
+
+static void media_audio(void *opaque, struct obs_source_audio *audio)
+{
+	UNUSED_PARAMETER(opaque);
+	UNUSED_PARAMETER(audio);
+}
+
+static int compare_times(const void *a, const void *b)
+{
+	double val_a = *(const double *)a;
+	double val_b = *(const double *)b;
+	return val_a < val_b ? -1 : (val_a > val_b ? 1 : 0);
+}
+
+static bool wait_index(struct bench_media *bm)
+{
+	for (int i = 0; i < INDEX_TIMEOUT_MS / 10; i++) {
+		if (mp_media_seek_index_ready(&bm->media))
+			return true;
+		os_sleep_ms(10);
+	}
+
+	return false;
+}
+
+static int64_t get_duration_ms(const char *path)
+{
+	AVFormatContext *fmt = NULL;
+	int64_t duration = 0;
+
+	if (avformat_open_input(&fmt, path, NULL, NULL) < 0)
+		return 0;
+	if (avformat_find_stream_info(fmt, NULL) >= 0 &&
+	    fmt->duration != AV_NOPTS_VALUE)
+		duration = fmt->duration / 1000;
+
+	avformat_close_input(&fmt);
+	return duration;
+}
+
+static bool bench_seeks(const struct bench_config *cfg, const char *path,
+			bool use_index, struct seek_stats *stats)
+{
+	struct bench_media bm = {0};
+	DARRAY(double) times = {0};
+	int64_t duration = get_duration_ms(path);
+	uint32_t seed = 0x5EEC;
+	bool success = false;
+
+	struct mp_media_info info = {
+		.opaque = &bm,
+		.v_cb = media_frame,
+		.v_preload_cb = media_frame,
+		.v_seek_cb = media_seeked,
+		.a_cb = media_audio,
+		.ready_cb = media_ready,
+		.path = path,
+		.speed = 100,
+		.is_local_file = true,
+		.volume = 100,
+		.seek_index = use_index,
+		.seek_index_dir = cfg->cache_dir,
+	};
+
+	if (duration <= 0) {
+		fprintf(stderr, "Could not get the duration of '%s'\n", path);
+		return false;
+	}
+
+	os_event_init(&bm.ready, OS_EVENT_TYPE_MANUAL);
+	os_event_init(&bm.seeked, OS_EVENT_TYPE_AUTO);
+
+	if (!mp_media_init(&bm.media, &info))
+		goto exit;
+	if (os_event_timedwait(bm.ready, SEEK_TIMEOUT_MS) != 0)
+		goto exit;
+	if (use_index && !wait_index(&bm)) {
+		fprintf(stderr, "Timed out indexing '%s'\n", path);
+		goto exit;
+	}
+
+	mp_media_play(&bm.media, false, false);
+	mp_media_play_pause(&bm.media, true);
+
+	memset(stats, 0, sizeof(*stats));
+
+	for (int i = 0; i < cfg->seeks; i++) {
+		seed = seed * 1664525 + 1013904223;
+		int64_t pos = (int64_t)(seed >> 8) % duration;
+		uint64_t start = os_gettime_ns();
+
+		os_event_reset(bm.seeked);
+		mp_media_seek_to(&bm.media, pos);
+
+		if (os_event_timedwait(bm.seeked, SEEK_TIMEOUT_MS) != 0) {
+			stats->timeouts++;
+			continue;
+		}
+
+		double ms = (double)(os_gettime_ns() - start) / 1000000.0;
+		da_push_back(times, &ms);
+	}
+
+	if (times.num) {
+		double total = 0.0;
+
+		qsort(times.array, times.num, sizeof(double), compare_times);
+		for (size_t i = 0; i < times.num; i++)
+			total += times.array[i];
+
+		stats->mean_ms = total / (double)times.num;
+		stats->p50_ms = times.array[times.num / 2];
+		stats->p95_ms = times.array[times.num * 95 / 100];
+		stats->max_ms = times.array[times.num - 1];
+	}
+
+	success = true;
+
+exit:
+	mp_media_free(&bm.media);
+	os_event_destroy(bm.ready);
+	os_event_destroy(bm.seeked);
+	da_free(times);
+	return success;
+}
+
+static void add_result(obs_data_array_t *results, const char *path, int gop,
+		       bool use_index, const struct seek_stats *stats)
+{
+	obs_data_t *result = obs_data_create();
+
+	obs_data_set_string(result, "file", path);
+	if (gop)
+		obs_data_set_int(result, "gop", gop);
+	obs_data_set_bool(result, "seek_index", use_index);
+	obs_data_set_double(result, "mean_ms", stats->mean_ms);
+	obs_data_set_double(result, "p50_ms", stats->p50_ms);
+	obs_data_set_double(result, "p95_ms", stats->p95_ms);
+	obs_data_set_double(result, "max_ms", stats->max_ms);
+	obs_data_set_int(result, "timeouts", stats->timeouts);
+	obs_data_array_push_back(results, result);
+	obs_data_release(result);
+}
+
+static bool bench_file(const struct bench_config *cfg,
+		       obs_data_array_t *results, const char *path, int gop)
+{
+	for (int i = 0; i < 2; i++) {
+		bool use_index = i == 1;
+		struct seek_stats stats;
+
+		if (!bench_seeks(cfg, path, use_index, &stats))
+			return false;
+
+		add_result(results, path, gop, use_index, &stats);
+	}
+
+	return true;
+}
+
+static bool run(const struct bench_config *cfg, obs_data_array_t *results)
+{
+	struct dstr path = {0};
+	bool success = true;
+
+	os_mkdirs(cfg->cache_dir);
+
+	for (size_t i = 0; success && i < cfg->gops.num; i++) {
+		int gop = cfg->gops.array[i];
+
+		dstr_printf(&path, "%s/gop%d-%ds.%s", cfg->cache_dir, gop,
+			    cfg->duration, cfg->container);
+		if (!os_file_exists(path.array))
+			success = generate_clip(path.array, gop, cfg->duration);
+		if (success)
+			success = bench_file(cfg, results, path.array, gop);
+	}
+
+	for (size_t i = 0; success && i < cfg->files.num; i++)
+		success = bench_file(cfg, results, cfg->files.array[i], 0);
+
+	dstr_free(&path);
+	return success;
+}
+
+int main(int argc, char *argv[])
+{
+	struct bench_config cfg = {0};
+	obs_data_array_t *results;
+	obs_data_t *data;
+	int ret = EXIT_FAILURE;
+
+	if (!parse_args(&cfg, argc, argv)) {
+		usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	verbose_log = cfg.verbose;
+	base_set_log_handler(do_log, NULL);
+
+	results = obs_data_array_create();
+	if (run(&cfg, results)) {
+		data = obs_data_create();
+		obs_data_set_array(data, "seeks", results);
+
+		if (cfg.json_file) {
+			ret = obs_data_save_json(data, cfg.json_file)
+				      ? EXIT_SUCCESS
+				      : EXIT_FAILURE;
+		} else {
+			puts(obs_data_get_json(data));
+			ret = EXIT_SUCCESS;
+		}
+
+		obs_data_release(data);
+	}
+
+	obs_data_array_release(results);
+	da_free(cfg.gops);
+	da_free(cfg.files);
+	return ret;
+}
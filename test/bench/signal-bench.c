@@ -0,0 +1,138 @@
+/*
+ * signal-bench: measures how many signals per second can be emitted to a
+ * signal with 100 subscribers, from one and from several threads at once,
+ * and while another thread keeps connecting and disconnecting a callback.
+ * Results are reported as JSON.
+ */
+
+#include <stdio.h>
+
+#include <util/platform.h>
+#include <util/threading.h>
+#include <callback/signal.h>
+
+#define SUBSCRIBERS 100
+#define MAX_THREADS 4
+#define DURATION_NS 1000000000ULL
+
+struct bench_data {
+	signal_handler_t *handler;
+	volatile bool stop;
+	uint64_t emits[MAX_THREADS];
+};
+
+struct emit_thread_data {
+	struct bench_data *bd;
+	int idx;
+};
+
+static THREAD_LOCAL long long sum = 0;
+
+static void subscriber_cb(void *data, calldata_t *cd)
+{
+	sum += calldata_int(cd, "val");
+	UNUSED_PARAMETER(data);
+}
+
+static void churn_cb(void *data, calldata_t *cd)
+{
+	UNUSED_PARAMETER(data);
+	UNUSED_PARAMETER(cd);
+}
+
+static void *emit_thread(void *param)
+{
+	struct emit_thread_data *td = param;
+	struct bench_data *bd = td->bd;
+	uint64_t emits = 0;
+	calldata_t cd;
+
+	calldata_init(&cd);
+	calldata_set_int(&cd, "val", 1);
+
+	while (!os_atomic_load_bool(&bd->stop)) {
+		for (int i = 0; i < 100; i++)
+			signal_handler_signal(bd->handler, "test", &cd);
+		emits += 100;
+	}
+
+	calldata_free(&cd);
+
+	bd->emits[td->idx] = emits;
+	return NULL;
+}
+
+static void *churn_thread(void *param)
+{
+	struct bench_data *bd = param;
+
+	while (!os_atomic_load_bool(&bd->stop)) {
+		signal_handler_connect(bd->handler, "test", churn_cb, NULL);
+		signal_handler_disconnect(bd->handler, "test", churn_cb, NULL);
+	}
+
+	return NULL;
+}
+
+static void measure(signal_handler_t *handler, int threads, bool churn,
+		    bool first)
+{
+	struct bench_data bd = {handler, false, {0}};
+	struct emit_thread_data td[MAX_THREADS];
+	pthread_t emitters[MAX_THREADS];
+	pthread_t churner;
+	uint64_t start, end;
+	uint64_t emits = 0;
+
+	start = os_gettime_ns();
+
+	for (int i = 0; i < threads; i++) {
+		td[i].bd = &bd;
+		td[i].idx = i;
+		pthread_create(&emitters[i], NULL, emit_thread, &td[i]);
+	}
+	if (churn)
+		pthread_create(&churner, NULL, churn_thread, &bd);
+
+	os_sleepto_ns(start + DURATION_NS);
+	os_atomic_store_bool(&bd.stop, true);
+
+	for (int i = 0; i < threads; i++) {
+		pthread_join(emitters[i], NULL);
+		emits += bd.emits[i];
+	}
+	if (churn)
+		pthread_join(churner, NULL);
+
+	end = os_gettime_ns();
+
+	printf("%s    {\"subscribers\": %d, \"threads\": %d, \"churn\": %s, "
+	       "\"emits_per_sec\": %.0f, \"ns_per_emit\": %.1f}",
+	       first ? "" : ",\n", SUBSCRIBERS, threads,
+	       churn ? "true" : "false",
+	       (double)emits * 1e9 / (double)(end - start),
+	       (double)(end - start) * threads / (double)emits);
+}
+
+int main(int argc, char *argv[])
+{
+	signal_handler_t *handler = signal_handler_create();
+
+	signal_handler_add(handler, "void test(int val)");
+	for (size_t i = 0; i < SUBSCRIBERS; i++)
+		signal_handler_connect(handler, "test", subscriber_cb,
+				       (void *)(uintptr_t)(i + 1));
+
+	printf("{\n  \"results\": [\n");
+	measure(handler, 1, false, true);
+	measure(handler, MAX_THREADS, false, false);
+	measure(handler, 1, true, false);
+	measure(handler, MAX_THREADS, true, false);
+	printf("\n  ]\n}\n");
+
+	signal_handler_destroy(handler);
+
+	UNUSED_PARAMETER(argc);
+	UNUSED_PARAMETER(argv);
+	return 0;
+}
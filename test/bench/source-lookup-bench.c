@@ -0,0 +1,192 @@
+/*
+ * source-lookup-bench: measures obs_get_source_by_name() with 10000 sources,
+ * for names that exist and names that don't, from one thread and from several
+ * threads while another thread keeps renaming sources.  Results are reported
+ * as JSON.
+ */
+
+#include <stdio.h>
+
+#include <obs.h>
+#include <util/dstr.h>
+#include <util/platform.h>
+#include <util/threading.h>
+
+#define NUM_SOURCES 10000
+#define NUM_LOOKUPS 1000000
+#define MAX_THREADS 4
+
+static obs_source_t *sources[NUM_SOURCES];
+static volatile bool stop_renaming = false;
+
+static void do_log(int log_level, const char *msg, va_list args, void *param)
+{
+	if (log_level <= LOG_WARNING) {
+		vfprintf(stderr, msg, args);
+		fputc('\n', stderr);
+	}
+
+	UNUSED_PARAMETER(param);
+}
+
+/* ------------------------------------------------------------------------- */
+
+static const char *dummy_getname(void *unused)
+{
+	UNUSED_PARAMETER(unused);
+	return "Lookup Dummy Source";
+}
+
+static void *dummy_create(obs_data_t *settings, obs_source_t *source)
+{
+	UNUSED_PARAMETER(settings);
+	UNUSED_PARAMETER(source);
+	return bzalloc(1);
+}
+
+static void dummy_destroy(void *data)
+{
+	bfree(data);
+}
+
+static struct obs_source_info dummy_source_info = {
+	.id = "lookup_dummy_source",
+	.type = OBS_SOURCE_TYPE_INPUT,
+	.get_name = dummy_getname,
+	.create = dummy_create,
+	.destroy = dummy_destroy,
+};
+
+/* ------------------------------------------------------------------------- */
+
+static inline int next_index(uint32_t *seed)
+{
+	*seed = *seed * 1664525 + 1013904223;
+	return (int)((*seed >> 8) % NUM_SOURCES);
+}
+
+struct lookup_thread {
+	pthread_t thread;
+	uint32_t seed;
+	bool miss;
+	uint64_t found;
+	uint64_t time_ns;
+};
+
+static void *lookup_thread(void *param)
+{
+	struct lookup_thread *lt = param;
+	char name[64];
+	uint64_t start = os_gettime_ns();
+
+	for (int i = 0; i < NUM_LOOKUPS; i++) {
+		int idx = next_index(&lt->seed);
+		obs_source_t *source;
+
+		snprintf(name, sizeof(name),
+			 lt->miss ? "missing %d" : "source %d", idx);
+
+		source = obs_get_source_by_name(name);
+		if (source) {
+			lt->found++;
+			obs_source_release(source);
+		}
+	}
+
+	lt->time_ns = os_gettime_ns() - start;
+	return NULL;
+}
+
+static void *rename_thread(void *param)
+{
+	uint32_t seed = 1234;
+	char name[64];
+
+	while (!os_atomic_load_bool(&stop_renaming)) {
+		int idx = next_index(&seed);
+
+		/* rename back and forth so lookups keep finding most names */
+		snprintf(name, sizeof(name), "renamed %d", idx);
+		obs_source_set_name(sources[idx], name);
+		snprintf(name, sizeof(name), "source %d", idx);
+		obs_source_set_name(sources[idx], name);
+	}
+
+	UNUSED_PARAMETER(param);
+	return NULL;
+}
+
+static void measure(int threads, bool miss, bool rename, bool first)
+{
+	struct lookup_thread lt[MAX_THREADS] = {0};
+	pthread_t renamer;
+	uint64_t found = 0;
+	uint64_t time_ns = 0;
+
+	if (rename) {
+		os_atomic_store_bool(&stop_renaming, false);
+		pthread_create(&renamer, NULL, rename_thread, NULL);
+	}
+
+	for (int i = 0; i < threads; i++) {
+		lt[i].seed = (uint32_t)i + 1;
+		lt[i].miss = miss;
+		pthread_create(&lt[i].thread, NULL, lookup_thread, &lt[i]);
+	}
+
+	for (int i = 0; i < threads; i++) {
+		pthread_join(lt[i].thread, NULL);
+		found += lt[i].found;
+		time_ns += lt[i].time_ns;
+	}
+
+	if (rename) {
+		os_atomic_store_bool(&stop_renaming, true);
+		pthread_join(renamer, NULL);
+	}
+
+	printf("%s    {\"sources\": %d, \"threads\": %d, \"miss\": %s, "
+	       "\"renaming\": %s, \"lookups\": %d, \"found\": %llu, "
+	       "\"ns_per_lookup\": %.1f}",
+	       first ? "" : ",\n", NUM_SOURCES, threads,
+	       miss ? "true" : "false", rename ? "true" : "false",
+	       NUM_LOOKUPS * threads, (unsigned long long)found,
+	       (double)time_ns / ((double)NUM_LOOKUPS * threads));
+}
+
+int main(int argc, char *argv[])
+{
+	struct dstr name = {0};
+
+	base_set_log_handler(do_log, NULL);
+
+	if (!obs_startup("en-US", NULL, NULL)) {
+		fprintf(stderr, "Failed to start libobs\n");
+		return 1;
+	}
+
+	obs_register_source(&dummy_source_info);
+
+	for (int i = 0; i < NUM_SOURCES; i++) {
+		dstr_printf(&name, "source %d", i);
+		sources[i] = obs_source_create("lookup_dummy_source",
+					       name.array, NULL, NULL);
+	}
+
+	printf("{\n  \"results\": [\n");
+	measure(1, false, false, true);
+	measure(1, true, false, false);
+	measure(MAX_THREADS, false, false, false);
+	measure(MAX_THREADS, false, true, false);
+	printf("\n  ]\n}\n");
+
+	for (int i = 0; i < NUM_SOURCES; i++)
+		obs_source_release(sources[i]);
+
+	dstr_free(&name);
+	obs_shutdown();
+
+	UNUSED_PARAMETER(argc);
+	UNUSED_PARAMETER(argv);
+	return 0;
+}
@@ -0,0 +1,228 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <stdio.h>
+#include <math.h>
+#include <cmocka.h>
+
+#include <util/platform.h>
+#include <media-io/audio-io.h>
+#include <media-io/audio-resampler.h>
+#include <libavutil/channel_layout.h>
+#include <libswresample/swresample.h>
+
+#define BLOCK_FRAMES 1024
+#define NUM_BLOCKS 400
+#define TONE_HZ 1000.0
+#define AMPLITUDE 0.5
+
+struct tone_result {
+	double snr;
+	uint64_t out_frames;
+	uint64_t time_ns;
+};
+
+static inline double tone(double seconds)
+{
+	return AMPLITUDE * sin(2.0 * M_PI * TONE_HZ * seconds);
+}
+
+static void fill_block(float *data, uint32_t rate, int block)
+{
+	for (int i = 0; i < BLOCK_FRAMES; i++) {
+		int64_t n = (int64_t)block * BLOCK_FRAMES + i;
+		data[i] = (float)tone((double)n / rate);
+	}
+}
+
+/* compares the output against the ideal tone at the timestamps the
+ * resampler reports, skipping the first blocks while the filter fills up */
+static void measure_block(struct tone_result *res, double *signal,
+			  double *noise, int block, uint32_t in_rate,
+			  uint32_t out_rate, const float *out, uint32_t frames,
+			  uint64_t ts_offset)
+{
+	uint64_t ts = (uint64_t)block * BLOCK_FRAMES * 1000000000ULL / in_rate;
+	double start = (double)(int64_t)(ts - ts_offset) / 1000000000.0;
+
+	if (block >= 4) {
+		for (uint32_t i = 0; i < frames; i++) {
+			double ideal = tone(start + (double)i / out_rate);
+			double diff = out[i] - ideal;
+			*signal += ideal * ideal;
+			*noise += diff * diff;
+		}
+	}
+
+	res->out_frames += frames;
+}
+
+static void resample_native(struct tone_result *res, uint32_t in_rate,
+			    uint32_t out_rate)
+{
+	struct resample_info src = {in_rate, AUDIO_FORMAT_FLOAT_PLANAR,
+				    SPEAKERS_MONO};
+	struct resample_info dst = {out_rate, AUDIO_FORMAT_FLOAT_PLANAR,
+				    SPEAKERS_MONO};
+	audio_resampler_t *rs = audio_resampler_create(&dst, &src);
+	float in[BLOCK_FRAMES];
+	double signal = 0.0, noise = 0.0;
+
+	assert_non_null(rs);
+
+	for (int block = 0; block < NUM_BLOCKS; block++) {
+		const uint8_t *input[MAX_AV_PLANES] = {(uint8_t *)in};
+		uint8_t *output[MAX_AV_PLANES] = {0};
+		uint32_t frames = 0;
+		uint64_t ts_offset = 0;
+		uint64_t start;
+
+		fill_block(in, in_rate, block);
+
+		start = os_gettime_ns();
+		assert_true(audio_resampler_resample(rs, output, &frames,
+						     &ts_offset, input,
+						     BLOCK_FRAMES));
+		res->time_ns += os_gettime_ns() - start;
+
+		measure_block(res, &signal, &noise, block, in_rate, out_rate,
+			      (const float *)output[0], frames, ts_offset);
+	}
+
+	audio_resampler_destroy(rs);
+	res->snr = 10.0 * log10(signal / noise);
+}
+
+static void resample_swr(struct tone_result *res, uint32_t in_rate,
+			 uint32_t out_rate)
+{
+	struct SwrContext *swr = swr_alloc_set_opts(
+		NULL, AV_CH_LAYOUT_MONO, AV_SAMPLE_FMT_FLTP, out_rate,
+		AV_CH_LAYOUT_MONO, AV_SAMPLE_FMT_FLTP, in_rate, 0, NULL);
+	float in[BLOCK_FRAMES];
+	float out[BLOCK_FRAMES * 2];
+	double signal = 0.0, noise = 0.0;
+
+	assert_non_null(swr);
+	assert_int_equal(swr_init(swr), 0);
+
+	for (int block = 0; block < NUM_BLOCKS; block++) {
+		const uint8_t *input[1] = {(uint8_t *)in};
+		uint8_t *output[1] = {(uint8_t *)out};
+		uint64_t ts_offset;
+		uint64_t start;
+		int frames;
+
+		fill_block(in, in_rate, block);
+
+		start = os_gettime_ns();
+		ts_offset = (uint64_t)swr_get_delay(swr, 1000000000);
+		frames = swr_convert(swr, output, BLOCK_FRAMES * 2, input,
+				     BLOCK_FRAMES);
+		res->time_ns += os_gettime_ns() - start;
+
+		assert_true(frames >= 0);
+		measure_block(res, &signal, &noise, block, in_rate, out_rate,
+			      out, (uint32_t)frames, ts_offset);
+	}
+
+	swr_free(&swr);
+	res->snr = 10.0 * log10(signal / noise);
+}
+
+static void compare_rates(uint32_t in_rate, uint32_t out_rate)
+{
+	struct tone_result native = {0};
+	struct tone_result swr = {0};
+	uint64_t expected = (uint64_t)NUM_BLOCKS * BLOCK_FRAMES * out_rate /
+			    in_rate;
+
+	resample_native(&native, in_rate, out_rate);
+	resample_swr(&swr, in_rate, out_rate);
+
+	printf("%u -> %u: native %.1f dB %.2f ms, swresample %.1f dB %.2f ms\n",
+	       in_rate, out_rate, native.snr, (double)native.time_ns / 1e6,
+	       swr.snr, (double)swr.time_ns / 1e6);
+
+	/* the output has to line up with the reported delay, or the error
+	 * against the ideal tone would be close to the signal itself */
+	assert_true(native.snr > 80.0);
+	assert_true(native.snr > swr.snr - 6.0);
+
+	/* everything but the filter delay is output */
+	assert_true(native.out_frames <= expected);
+	assert_true(native.out_frames + 64 >= expected);
+}
+
+static void upsample_test(void **state)
+{
+	compare_rates(44100, 48000);
+	compare_rates(32000, 48000);
+	compare_rates(22050, 48000);
+	UNUSED_PARAMETER(state);
+}
+
+static void downsample_test(void **state)
+{
+	compare_rates(48000, 44100);
+	compare_rates(96000, 48000);
+	UNUSED_PARAMETER(state);
+}
+
+static void interleaved_test(void **state)
+{
+	struct resample_info src = {44100, AUDIO_FORMAT_16BIT,
+				    SPEAKERS_STEREO};
+	struct resample_info dst = {48000, AUDIO_FORMAT_FLOAT_PLANAR,
+				    SPEAKERS_STEREO};
+	audio_resampler_t *rs = audio_resampler_create(&dst, &src);
+	int16_t in[BLOCK_FRAMES * 2];
+	uint64_t total = 0;
+
+	assert_non_null(rs);
+
+	/* left at half scale, right silent */
+	for (int i = 0; i < BLOCK_FRAMES; i++) {
+		in[i * 2] = 16384;
+		in[i * 2 + 1] = 0;
+	}
+
+	for (int block = 0; block < 8; block++) {
+		const uint8_t *input[MAX_AV_PLANES] = {(uint8_t *)in};
+		uint8_t *output[MAX_AV_PLANES] = {0};
+		uint32_t frames = 0;
+		uint64_t ts_offset = 0;
+
+		assert_true(audio_resampler_resample(rs, output, &frames,
+						     &ts_offset, input,
+						     BLOCK_FRAMES));
+		assert_non_null(output[0]);
+		assert_non_null(output[1]);
+
+		if (block >= 2) {
+			const float *left = (const float *)output[0];
+			const float *right = (const float *)output[1];
+			for (uint32_t i = 0; i < frames; i++) {
+				assert_true(fabsf(left[i] - 0.5f) < 0.001f);
+				assert_true(fabsf(right[i]) < 0.001f);
+			}
+		}
+
+		total += frames;
+	}
+
+	assert_true(total > 0);
+	audio_resampler_destroy(rs);
+	UNUSED_PARAMETER(state);
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(upsample_test),
+		cmocka_unit_test(downsample_test),
+		cmocka_unit_test(interleaved_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
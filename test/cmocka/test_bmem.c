@@ -0,0 +1,63 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <util/bmem.h>
+
+static int64_t tag_bytes(enum bmem_tag tag)
+{
+	struct bmem_tag_stats stats;
+	bmem_get_tag_stats(tag, &stats);
+	return stats.bytes;
+}
+
+static void tagged_alloc_test(void **state)
+{
+	int64_t before = tag_bytes(BMEM_TAG_IMAGES);
+	uint8_t *ptr = bmalloc_tagged(1000, BMEM_TAG_IMAGES);
+
+	assert_non_null(ptr);
+	assert_int_equal((uintptr_t)ptr % base_get_alignment(), 0);
+	assert_int_equal(tag_bytes(BMEM_TAG_IMAGES), before + 1000);
+
+	/* reallocation keeps the tag and the data */
+	ptr[999] = 42;
+	ptr = brealloc(ptr, 5000);
+	assert_int_equal(ptr[999], 42);
+	assert_int_equal(tag_bytes(BMEM_TAG_IMAGES), before + 5000);
+
+	bfree(ptr);
+	assert_int_equal(tag_bytes(BMEM_TAG_IMAGES), before);
+	UNUSED_PARAMETER(state);
+}
+
+static void thread_tag_test(void **state)
+{
+	int64_t before = tag_bytes(BMEM_TAG_AUDIO);
+	enum bmem_tag prev = bmem_set_thread_tag(BMEM_TAG_AUDIO);
+	void *ptr = bmalloc(300);
+	struct bmem_tag_stats stats;
+
+	assert_int_equal(prev, BMEM_TAG_UNTAGGED);
+	bmem_set_thread_tag(prev);
+
+	bmem_get_tag_stats(BMEM_TAG_AUDIO, &stats);
+	assert_int_equal(stats.bytes, before + 300);
+	assert_true(stats.peak_bytes >= stats.bytes);
+
+	bfree(ptr);
+	assert_int_equal(tag_bytes(BMEM_TAG_AUDIO), before);
+	assert_string_equal(bmem_tag_name(BMEM_TAG_AUDIO), "audio buffers");
+	UNUSED_PARAMETER(state);
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(tagged_alloc_test),
+		cmocka_unit_test(thread_tag_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
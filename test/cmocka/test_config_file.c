@@ -0,0 +1,183 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <string.h>
+#include <cmocka.h>
+
+#include <util/bmem.h>
+#include <util/config-file.h>
+#include <util/dstr.h>
+#include <util/platform.h>
+
+#define NUM_ITEMS 1000
+
+static const char *test_ini = "[General]\n"
+			      "Name=first\n"
+			      "Multi=a\\nb\n"
+			      "\n"
+			      "[Video]\n"
+			      "BaseCX=1920\n"
+			      "\n"
+			      "[general]\n"
+			      "Name=second\n"
+			      "Extra=1\n";
+
+static char *read_file(const char *path)
+{
+	char *data = os_quick_read_utf8_file(path);
+	assert_non_null(data);
+	return data;
+}
+
+static void config_lookup_test(void **state)
+{
+	config_t *config;
+
+	assert_int_equal(config_open_string(&config, test_ini), CONFIG_SUCCESS);
+
+	/* sections that appear twice are merged, the first value wins */
+	assert_int_equal(config_num_sections(config), 2);
+	assert_string_equal(config_get_string(config, "General", "Name"),
+			    "first");
+	assert_string_equal(config_get_string(config, "GENERAL", "extra"),
+			    "1");
+	assert_string_equal(config_get_string(config, "General", "Multi"),
+			    "a\nb");
+	assert_int_equal(config_get_uint(config, "video", "basecx"), 1920);
+	assert_null(config_get_string(config, "Video", "BaseCY"));
+	assert_null(config_get_string(config, "Audio", "BaseCX"));
+
+	config_set_default_uint(config, "Video", "BaseCY", 1080);
+	assert_int_equal(config_get_uint(config, "Video", "BaseCY"), 1080);
+	assert_false(config_has_user_value(config, "Video", "BaseCY"));
+
+	for (int i = 0; i < NUM_ITEMS; i++) {
+		struct dstr name = {0};
+		dstr_printf(&name, "Item%d", i);
+		config_set_int(config, "Items", name.array, i);
+		dstr_free(&name);
+	}
+
+	for (int i = NUM_ITEMS; i > 0; i--) {
+		struct dstr name = {0};
+		dstr_printf(&name, "item%d", i - 1);
+		assert_int_equal(config_get_int(config, "Items", name.array),
+				 i - 1);
+		dstr_free(&name);
+	}
+
+	assert_true(config_remove_value(config, "Items", "Item0"));
+	assert_false(config_remove_value(config, "Items", "Item0"));
+	assert_false(config_has_user_value(config, "Items", "Item0"));
+	assert_int_equal(config_get_int(config, "Items", "Item999"), 999);
+
+	config_close(config);
+
+	UNUSED_PARAMETER(state);
+}
+
+static void config_save_test(void **state)
+{
+	const char *path = "test_config_file.ini";
+	config_t *config;
+	char *data;
+
+	config = config_create(path);
+	assert_non_null(config);
+
+	config_set_string(config, "General", "Name", "value");
+	config_set_bool(config, "General", "Enabled", true);
+	config_set_string(config, "Other", "Text", "line\r\nbreak\\");
+	assert_int_equal(config_save_safe(config, "tmp", NULL), CONFIG_SUCCESS);
+
+	data = read_file(path);
+	assert_string_equal(data, "[General]\n"
+				  "Name=value\n"
+				  "Enabled=true\n"
+				  "\n"
+				  "[Other]\n"
+				  "Text=line\\r\\nbreak\\\\\n");
+	bfree(data);
+
+	/* queued saves are coalesced and written in the background */
+	for (int i = 0; i < 100; i++) {
+		config_set_int(config, "General", "Count", i);
+		config_save_safe_async(config, "tmp", NULL);
+	}
+	config_flush(config);
+
+	data = read_file(path);
+	assert_non_null(strstr(data, "Count=99\n"));
+	bfree(data);
+
+	/* nothing is written when no values changed */
+	os_unlink(path);
+	config_set_int(config, "General", "Count", 99);
+	config_save_safe_async(config, "tmp", NULL);
+	config_flush(config);
+	assert_false(os_file_exists(path));
+
+	/* pending saves are finished on close */
+	config_set_string(config, "General", "Name", "closed");
+	config_save_safe_async(config, "tmp", NULL);
+	config_close(config);
+
+	assert_int_equal(config_open(&config, path, CONFIG_OPEN_EXISTING),
+			 CONFIG_SUCCESS);
+	assert_string_equal(config_get_string(config, "General", "Name"),
+			    "closed");
+	assert_string_equal(config_get_string(config, "Other", "Text"),
+			    "line\r\nbreak\\");
+	config_close(config);
+
+	os_unlink(path);
+
+	UNUSED_PARAMETER(state);
+}
+
+static void config_failed_save_test(void **state)
+{
+	const char *path = "test_config_failed.ini";
+	config_t *config;
+	char *data;
+
+	config = config_create(path);
+	assert_non_null(config);
+
+	/* a directory in place of the file makes the final replace fail */
+	os_unlink(path);
+	assert_int_equal(os_mkdir(path), MKDIR_SUCCESS);
+	assert_true(os_quick_write_utf8_file("test_config_failed.ini/keep",
+					     "", 0, false));
+
+	config_set_string(config, "General", "Name", "value");
+	assert_int_equal(config_save_safe(config, "tmp", NULL), CONFIG_ERROR);
+
+	os_unlink("test_config_failed.ini/keep");
+	os_rmdir(path);
+	os_unlink("test_config_failed.ini.tmp");
+
+	/* the failed save must not mark the config as saved */
+	config_save_safe_async(config, "tmp", NULL);
+	config_flush(config);
+
+	data = read_file(path);
+	assert_non_null(strstr(data, "Name=value\n"));
+	bfree(data);
+
+	config_close(config);
+	os_unlink(path);
+
+	UNUSED_PARAMETER(state);
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(config_lookup_test),
+		cmocka_unit_test(config_save_test),
+		cmocka_unit_test(config_failed_save_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,143 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <math.h>
+#include <cmocka.h>
+
+#include <obs.h>
+#include <util/platform.h>
+
+#if !defined(_WIN32) && !defined(__APPLE__)
+#include <obs-nix-platform.h>
+#endif
+
+#define MS_NS 1000000ULL
+
+/* room for the time between computing a timestamp and marking it, on a
+ * loaded machine */
+#define AGE_SLACK_MS 50.0
+
+static void assert_ms_equal(double value, double expected)
+{
+	assert_true(fabs(value - expected) < 0.000001);
+}
+
+/* marks frames that are at least age_ms old when they reach the stage.  ages
+ * are just above the lower bound of their bucket, so a delay before marking
+ * can't move them to the next one */
+static void mark_frames(enum obs_frame_stage stage, int count, uint64_t age_ms)
+{
+	for (int i = 0; i < count; i++)
+		obs_frame_trace_mark(stage, os_gettime_ns() - age_ms * MS_NS);
+}
+
+static void frame_latency_empty_test(void **state)
+{
+	struct obs_frame_latency latency;
+
+	assert_true(obs_get_frame_latency(OBS_FRAME_STAGE_ENCODE, &latency));
+	assert_int_equal(latency.frames, 0);
+	assert_ms_equal(latency.avg_ms, 0.0);
+	assert_ms_equal(latency.p50_ms, 0.0);
+	assert_ms_equal(latency.p99_ms, 0.0);
+
+	assert_false(obs_get_frame_latency(OBS_FRAME_STAGE_COUNT, &latency));
+	assert_false(obs_get_frame_latency(OBS_FRAME_STAGE_ENCODE, NULL));
+
+	/* frames without a timestamp and invalid stages are ignored */
+	obs_frame_trace_mark(OBS_FRAME_STAGE_ENCODE, 0);
+	obs_frame_trace_mark(OBS_FRAME_STAGE_COUNT, os_gettime_ns());
+	assert_true(obs_get_frame_latency(OBS_FRAME_STAGE_ENCODE, &latency));
+	assert_int_equal(latency.frames, 0);
+
+	UNUSED_PARAMETER(state);
+}
+
+static void frame_latency_percentile_test(void **state)
+{
+	struct obs_frame_latency latency;
+
+	/* 50 frames in (25, 50] ms, 40 in (100, 150] ms, 10 in (300, 500] ms,
+	 * and nothing in the buckets between them */
+	mark_frames(OBS_FRAME_STAGE_SEND, 50, 26);
+	mark_frames(OBS_FRAME_STAGE_SEND, 40, 101);
+	mark_frames(OBS_FRAME_STAGE_SEND, 10, 301);
+
+	assert_true(obs_get_frame_latency(OBS_FRAME_STAGE_SEND, &latency));
+	assert_int_equal(latency.frames, 100);
+	assert_true(latency.avg_ms >= 83.5);
+	assert_true(latency.avg_ms < 83.5 + AGE_SLACK_MS);
+
+	/* the 50th frame is the last of its bucket, so the upper bound */
+	assert_ms_equal(latency.p50_ms, 50.0);
+
+	/* the 95th and 99th are half and 9/10 into the (300, 500] bucket */
+	assert_ms_equal(latency.p95_ms, 400.0);
+	assert_ms_equal(latency.p99_ms, 480.0);
+
+	/* other stages are kept apart */
+	assert_true(obs_get_frame_latency(OBS_FRAME_STAGE_ENCODE, &latency));
+	assert_int_equal(latency.frames, 0);
+
+	UNUSED_PARAMETER(state);
+}
+
+static void frame_latency_edges_test(void **state)
+{
+	struct obs_frame_latency latency;
+
+	/* the first bucket starts at 0.  frames stamped in the future, which
+	 * rendering can do, count as 0 ms old */
+	for (int i = 0; i < 4; i++)
+		obs_frame_trace_mark(OBS_FRAME_STAGE_RENDER,
+				     os_gettime_ns() + 1000 * MS_NS);
+
+	assert_true(obs_get_frame_latency(OBS_FRAME_STAGE_RENDER, &latency));
+	assert_int_equal(latency.frames, 4);
+	assert_ms_equal(latency.avg_ms, 0.0);
+	assert_ms_equal(latency.p50_ms, 0.5);
+	assert_ms_equal(latency.p95_ms, 0.95);
+	assert_ms_equal(latency.p99_ms, 0.99);
+
+	/* frames older than the last bound are reported as the last bound */
+	mark_frames(OBS_FRAME_STAGE_OUTPUT, 10, 6000);
+
+	assert_true(obs_get_frame_latency(OBS_FRAME_STAGE_OUTPUT, &latency));
+	assert_int_equal(latency.frames, 10);
+	assert_true(latency.avg_ms >= 6000.0);
+	assert_true(latency.avg_ms < 6000.0 + AGE_SLACK_MS);
+	assert_ms_equal(latency.p50_ms, 5000.0);
+	assert_ms_equal(latency.p99_ms, 5000.0);
+
+	UNUSED_PARAMETER(state);
+}
+
+static int setup(void **state)
+{
+#if !defined(_WIN32) && !defined(__APPLE__)
+	obs_set_nix_platform(OBS_NIX_PLATFORM_SURFACELESS_EGL);
+	obs_set_nix_platform_display(NULL);
+#endif
+
+	UNUSED_PARAMETER(state);
+	return obs_startup("en-US", NULL, NULL) ? 0 : -1;
+}
+
+static int teardown(void **state)
+{
+	obs_shutdown();
+
+	UNUSED_PARAMETER(state);
+	return 0;
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(frame_latency_empty_test),
+		cmocka_unit_test(frame_latency_percentile_test),
+		cmocka_unit_test(frame_latency_edges_test),
+	};
+
+	return cmocka_run_group_tests(tests, setup, teardown);
+}
@@ -0,0 +1,279 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <string.h>
+#include <cmocka.h>
+
+#include <util/bmem.h>
+#include <util/metrics.h>
+#include <util/threading.h>
+
+#define NUM_THREADS 4
+#define THREAD_UPDATES 100000
+
+struct find_data {
+	const char *name;
+	const char *labels;
+	struct metrics_sample sample;
+	bool found;
+};
+
+static bool find_sample(void *param, const struct metrics_sample *sample)
+{
+	struct find_data *data = param;
+
+	if (strcmp(sample->name, data->name) != 0)
+		return true;
+	if (data->labels && strcmp(sample->labels, data->labels) != 0)
+		return true;
+
+	data->sample = *sample;
+	data->found = true;
+	return false;
+}
+
+static bool snapshot_find(metrics_snapshot_t *snap, const char *name,
+			  const char *labels, struct metrics_sample *sample)
+{
+	struct find_data data = {name, labels};
+	metrics_snapshot_enumerate(snap, find_sample, &data);
+	*sample = data.sample;
+	return data.found;
+}
+
+static void metrics_basic_test(void **state)
+{
+	metric_t *counter = metrics_counter_create("test_events_total",
+						   "Events", NULL);
+	metric_t *gauge = metrics_gauge_create("test_level", "Level", NULL);
+	struct metrics_sample sample;
+	metrics_snapshot_t *snap;
+
+	assert_non_null(counter);
+	assert_non_null(gauge);
+	assert_null(metrics_counter_create("0invalid", NULL, NULL));
+	assert_null(metrics_counter_create("in-valid", NULL, NULL));
+
+	metrics_counter_inc(counter);
+	metrics_counter_add(counter, 41);
+	metrics_gauge_set(gauge, 2.5);
+	metrics_gauge_add(gauge, -1.0);
+
+	/* NULL metrics are ignored */
+	metrics_counter_inc(NULL);
+	metrics_gauge_set(NULL, 1.0);
+	metrics_histogram_observe(NULL, 1.0);
+
+	snap = metrics_snapshot_create();
+	assert_int_equal(metrics_snapshot_size(snap), 2);
+
+	metrics_destroy(counter);
+	metrics_destroy(gauge);
+
+	/* the snapshot keeps its own copy */
+	assert_true(snapshot_find(snap, "test_events_total", NULL, &sample));
+	assert_int_equal(sample.type, METRIC_COUNTER);
+	assert_true(sample.value == 42.0);
+	assert_string_equal(sample.labels, "");
+
+	assert_true(snapshot_find(snap, "test_level", NULL, &sample));
+	assert_int_equal(sample.type, METRIC_GAUGE);
+	assert_true(sample.value == 1.5);
+	metrics_snapshot_free(snap);
+
+	snap = metrics_snapshot_create();
+	assert_int_equal(metrics_snapshot_size(snap), 0);
+	metrics_snapshot_free(snap);
+
+	UNUSED_PARAMETER(state);
+}
+
+static void metrics_histogram_test(void **state)
+{
+	static const double bounds[] = {0.01, 0.1, 1.0};
+	metric_t *hist = metrics_histogram_create(
+		"test_duration_seconds", "Duration", NULL, bounds, 3);
+	struct metrics_sample sample;
+	metrics_snapshot_t *snap;
+	uint64_t buckets[4];
+	double sum;
+
+	assert_non_null(hist);
+	assert_null(metrics_histogram_create("test_unsorted", NULL, NULL,
+					     (const double[]){1.0, 0.5}, 2));
+
+	metrics_histogram_observe(hist, 0.005);
+	metrics_histogram_observe(hist, 0.01);
+	metrics_histogram_observe(hist, 0.5);
+	metrics_histogram_observe(hist, 5.0);
+
+	snap = metrics_snapshot_create();
+	assert_true(snapshot_find(snap, "test_duration_seconds", NULL,
+				  &sample));
+	assert_int_equal(sample.type, METRIC_HISTOGRAM);
+	assert_int_equal(sample.count, 4);
+	assert_int_equal(sample.num_buckets, 4);
+
+	/* buckets are cumulative and bounds are inclusive */
+	assert_int_equal(sample.buckets[0], 2);
+	assert_int_equal(sample.buckets[1], 2);
+	assert_int_equal(sample.buckets[2], 3);
+	assert_int_equal(sample.buckets[3], 4);
+	assert_true(sample.value > 5.514 && sample.value < 5.516);
+	metrics_snapshot_free(snap);
+
+	/* reading a single histogram gives the same result */
+	assert_int_equal(metrics_histogram_read(hist, buckets, 4, &sum), 4);
+	assert_int_equal(buckets[0], 2);
+	assert_int_equal(buckets[2], 3);
+	assert_int_equal(buckets[3], 4);
+	assert_true(sum > 5.514 && sum < 5.516);
+
+	metrics_destroy(hist);
+
+	UNUSED_PARAMETER(state);
+}
+
+static double collect_value(void *param)
+{
+	return *(double *)param;
+}
+
+static void metrics_prometheus_test(void **state)
+{
+	static const double bounds[] = {1.0};
+	struct dstr labels_a = {0};
+	struct dstr labels_b = {0};
+	double value_a = 3.0;
+	double value_b = 4.0;
+	metric_t *a, *b, *other, *hist;
+	metrics_snapshot_t *snap;
+	char *text;
+
+	metrics_append_label(&labels_a, "output", "stream");
+	metrics_append_label(&labels_a, "kind", "say \"hi\"\\");
+	metrics_append_label(&labels_b, "output", "record");
+	assert_string_equal(labels_a.array,
+			    "output=\"stream\",kind=\"say \\\"hi\\\"\\\\\"");
+
+	a = metrics_collector_create("test_dropped_total", "Dropped frames",
+				     labels_a.array, METRIC_COUNTER,
+				     collect_value, &value_a);
+	other = metrics_gauge_create("test_other", "Other\nline", NULL);
+	b = metrics_collector_create("test_dropped_total", "Dropped frames",
+				     labels_b.array, METRIC_COUNTER,
+				     collect_value, &value_b);
+	hist = metrics_histogram_create("test_hist", "Hist", labels_b.array,
+					bounds, 1);
+	assert_null(metrics_collector_create("test_bad", NULL, NULL,
+					     METRIC_HISTOGRAM, collect_value,
+					     &value_a));
+
+	metrics_histogram_observe(hist, 0.5);
+
+	snap = metrics_snapshot_create();
+	text = metrics_snapshot_to_prometheus(snap);
+
+	/* samples of the same family are grouped under one HELP/TYPE */
+	assert_string_equal(
+		text,
+		"# HELP test_dropped_total Dropped frames\n"
+		"# TYPE test_dropped_total counter\n"
+		"test_dropped_total{output=\"stream\","
+		"kind=\"say \\\"hi\\\"\\\\\"} 3\n"
+		"test_dropped_total{output=\"record\"} 4\n"
+		"# HELP test_other Other\\nline\n"
+		"# TYPE test_other gauge\n"
+		"test_other 0\n"
+		"# HELP test_hist Hist\n"
+		"# TYPE test_hist histogram\n"
+		"test_hist_bucket{output=\"record\",le=\"1\"} 1\n"
+		"test_hist_bucket{output=\"record\",le=\"+Inf\"} 1\n"
+		"test_hist_sum{output=\"record\"} 0.5\n"
+		"test_hist_count{output=\"record\"} 1\n");
+
+	bfree(text);
+	metrics_snapshot_free(snap);
+
+	metrics_destroy(a);
+	metrics_destroy(b);
+	metrics_destroy(other);
+	metrics_destroy(hist);
+	dstr_free(&labels_a);
+	dstr_free(&labels_b);
+
+	UNUSED_PARAMETER(state);
+}
+
+static metric_t *thread_counter;
+static metric_t *thread_gauge;
+static metric_t *thread_hist;
+
+static void *update_thread(void *unused)
+{
+	for (int i = 0; i < THREAD_UPDATES; i++) {
+		metrics_counter_inc(thread_counter);
+		metrics_gauge_add(thread_gauge, 1.0);
+		metrics_histogram_observe(thread_hist, (double)(i & 1));
+	}
+
+	UNUSED_PARAMETER(unused);
+	return NULL;
+}
+
+static void metrics_thread_test(void **state)
+{
+	static const double bounds[] = {0.5};
+	pthread_t threads[NUM_THREADS];
+	struct metrics_sample sample;
+	metrics_snapshot_t *snap;
+	const double total = (double)NUM_THREADS * THREAD_UPDATES;
+
+	thread_counter = metrics_counter_create("test_thread_total", NULL,
+						NULL);
+	thread_gauge = metrics_gauge_create("test_thread_gauge", NULL, NULL);
+	thread_hist = metrics_histogram_create("test_thread_hist", NULL, NULL,
+					       bounds, 1);
+
+	for (int i = 0; i < NUM_THREADS; i++)
+		assert_int_equal(pthread_create(&threads[i], NULL,
+						update_thread, NULL),
+				 0);
+
+	/* snapshots can be taken while other threads update */
+	for (int i = 0; i < 10; i++)
+		metrics_snapshot_free(metrics_snapshot_create());
+
+	for (int i = 0; i < NUM_THREADS; i++)
+		pthread_join(threads[i], NULL);
+
+	snap = metrics_snapshot_create();
+
+	assert_true(snapshot_find(snap, "test_thread_total", NULL, &sample));
+	assert_true(sample.value == total);
+	assert_true(snapshot_find(snap, "test_thread_gauge", NULL, &sample));
+	assert_true(sample.value == total);
+	assert_true(snapshot_find(snap, "test_thread_hist", NULL, &sample));
+	assert_int_equal(sample.count, NUM_THREADS * THREAD_UPDATES);
+	assert_int_equal(sample.buckets[0], NUM_THREADS * THREAD_UPDATES / 2);
+	assert_true(sample.value == total / 2.0);
+
+	metrics_snapshot_free(snap);
+	metrics_destroy(thread_counter);
+	metrics_destroy(thread_gauge);
+	metrics_destroy(thread_hist);
+
+	UNUSED_PARAMETER(state);
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(metrics_basic_test),
+		cmocka_unit_test(metrics_histogram_test),
+		cmocka_unit_test(metrics_prometheus_test),
+		cmocka_unit_test(metrics_thread_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
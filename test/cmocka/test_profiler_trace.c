@@ -0,0 +1,196 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <string.h>
+#include <cmocka.h>
+
+#include <util/bmem.h>
+#include <util/platform.h>
+#include <util/profiler.h>
+#include <util/threading.h>
+
+#define TRACE_EVENTS 1024
+#define NUM_CALLS 100000
+#define NUM_THREADS 64
+#define NUM_WRITERS 4
+
+static const char *outer_name = "trace_test_outer";
+static const char *inner_name = "trace_test_inner";
+
+static void record_calls(size_t count)
+{
+	for (size_t i = 0; i < count; i++) {
+		profile_start(outer_name);
+		profile_start(inner_name);
+		profile_end(inner_name);
+		profile_end(outer_name);
+	}
+}
+
+static void trace_no_alloc_test(void **state)
+{
+	long allocs;
+
+	profiler_trace_start(TRACE_EVENTS);
+
+	/* the first event allocates the ring of the thread */
+	record_calls(1);
+
+	allocs = bnum_allocs();
+	record_calls(NUM_CALLS);
+	assert_int_equal(bnum_allocs(), allocs);
+
+	profiler_trace_stop();
+	UNUSED_PARAMETER(state);
+}
+
+static void trace_dump_test(void **state)
+{
+	const char *file = "test_profiler_trace.json";
+	char *json;
+	size_t begins = 0;
+	const char *pos;
+
+	profiler_trace_start(TRACE_EVENTS);
+	record_calls(NUM_CALLS);
+	profiler_trace_stop();
+
+	assert_true(profiler_trace_dump_json(file, 0));
+
+	json = os_quick_read_utf8_file(file);
+	assert_non_null(json);
+	assert_non_null(strstr(json, "\"traceEvents\""));
+	assert_non_null(strstr(json, inner_name));
+
+	/* only the most recent events are kept */
+	for (pos = json; (pos = strstr(pos, "\"ph\":\"B\"")) != NULL; pos++)
+		begins++;
+	assert_true(begins > 0);
+	assert_true(begins <= TRACE_EVENTS / 2);
+
+	bfree(json);
+	os_unlink(file);
+	UNUSED_PARAMETER(state);
+}
+
+struct named_thread {
+	const char *name;
+	const char *dump_file;
+};
+
+static void *named_thread(void *param)
+{
+	struct named_thread *info = param;
+
+	os_set_thread_name(info->name);
+	record_calls(10);
+
+	if (info->dump_file)
+		assert_true(profiler_trace_dump_json(info->dump_file, 0));
+	return NULL;
+}
+
+static void run_thread(const char *name, const char *dump_file)
+{
+	struct named_thread info = {name, dump_file};
+	pthread_t thread;
+
+	assert_int_equal(pthread_create(&thread, NULL, named_thread, &info),
+			 0);
+	pthread_join(thread, NULL);
+}
+
+static void trace_threads_test(void **state)
+{
+	const char *file = "test_profiler_trace_threads.json";
+	char *json;
+	long allocs;
+
+	profiler_trace_start(TRACE_EVENTS);
+	record_calls(1);
+
+	/* rings of threads that exited are reused by new ones */
+	run_thread("trace worker", NULL);
+	allocs = bnum_allocs();
+	for (int i = 0; i < NUM_THREADS; i++)
+		run_thread("trace worker", NULL);
+	assert_int_equal(bnum_allocs(), allocs);
+
+	/* running threads are labeled with their own name, threads that
+	 * exited are left out */
+	run_thread("trace dumper", file);
+	profiler_trace_stop();
+
+	json = os_quick_read_utf8_file(file);
+	assert_non_null(json);
+	assert_non_null(strstr(json, "\"trace dumper\""));
+	assert_null(strstr(json, "trace worker"));
+	assert_null(strstr(json, "\"name\":\"trace_test_outer\"}}"));
+	bfree(json);
+
+	os_unlink(file);
+	UNUSED_PARAMETER(state);
+}
+
+struct trace_writer {
+	pthread_t thread;
+	volatile bool *stop;
+};
+
+static void *trace_writer_thread(void *param)
+{
+	struct trace_writer *writer = param;
+
+	os_set_thread_name("trace writer");
+	while (!os_atomic_load_bool(writer->stop))
+		record_calls(10);
+	return NULL;
+}
+
+/* runs last, as it frees the profiler */
+static void trace_free_while_writing_test(void **state)
+{
+	struct trace_writer writers[NUM_WRITERS];
+	volatile bool stop = false;
+	long allocs;
+
+	profiler_trace_start(TRACE_EVENTS);
+
+	for (int i = 0; i < NUM_WRITERS; i++) {
+		writers[i].stop = &stop;
+		assert_int_equal(pthread_create(&writers[i].thread, NULL,
+						trace_writer_thread,
+						&writers[i]),
+				 0);
+	}
+
+	/* the rings are freed while the writers keep recording.  freeing
+	 * waits for the writes in progress, and the writers stop recording
+	 * instead of getting new rings */
+	os_sleep_ms(20);
+	allocs = bnum_allocs();
+	profiler_free();
+	assert_true(bnum_allocs() < allocs);
+
+	allocs = bnum_allocs();
+	os_sleep_ms(20);
+	assert_int_equal(bnum_allocs(), allocs);
+
+	os_atomic_set_bool(&stop, true);
+	for (int i = 0; i < NUM_WRITERS; i++)
+		pthread_join(writers[i].thread, NULL);
+
+	UNUSED_PARAMETER(state);
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(trace_no_alloc_test),
+		cmocka_unit_test(trace_dump_test),
+		cmocka_unit_test(trace_threads_test),
+		cmocka_unit_test(trace_free_while_writing_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,251 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <string.h>
+#include <cmocka.h>
+
+#include <obs.h>
+#include <util/platform.h>
+#include <util/threading.h>
+#include <media-playback/media.h>
+
+#include <libavformat/avformat.h>
+#include <libavcodec/avcodec.h>
+
+#define CACHE_DIR "test_seek_index_cache"
+#define CLIP_FILE CACHE_DIR "/clip.ts"
+#define CLIP_CX 64
+#define CLIP_CY 64
+#define CLIP_FPS 30
+#define CLIP_FRAMES 72
+#define CLIP_GOP 30
+#define TIMEOUT_MS 10000
+
+/* the timestamps of the clip start here rather than at 0 */
+#define START_OFFSET_SEC 10
+
+struct seek_media {
+	mp_media_t media;
+	os_event_t *ready;
+	os_event_t *seeked;
+	int frame;
+};
+
+/* each frame is flat, its luma is the frame number.  spaced out so the
+ * number survives the encoder being off by one */
+static inline uint8_t frame_luma(int index)
+{
+	return (uint8_t)(16 + index * 3);
+}
+
+static void write_packets(AVFormatContext *fmt, AVCodecContext *enc,
+			  AVStream *stream, AVPacket *pkt)
+{
+	while (avcodec_receive_packet(enc, pkt) == 0) {
+		av_packet_rescale_ts(pkt, enc->time_base, stream->time_base);
+		pkt->stream_index = stream->index;
+		assert_true(av_interleaved_write_frame(fmt, pkt) >= 0);
+	}
+}
+
+static void generate_clip(void)
+{
+	const AVCodec *codec = avcodec_find_encoder(AV_CODEC_ID_MPEG4);
+	AVFormatContext *fmt = NULL;
+	AVCodecContext *enc;
+	AVFrame *frame;
+	AVPacket *pkt;
+	AVStream *stream;
+
+	assert_non_null(codec);
+	assert_true(avformat_alloc_output_context2(&fmt, NULL, NULL,
+						   CLIP_FILE) >= 0);
+
+	stream = avformat_new_stream(fmt, NULL);
+	enc = avcodec_alloc_context3(codec);
+	frame = av_frame_alloc();
+	pkt = av_packet_alloc();
+
+	enc->width = CLIP_CX;
+	enc->height = CLIP_CY;
+	enc->pix_fmt = AV_PIX_FMT_YUV420P;
+	enc->time_base = (AVRational){1, CLIP_FPS};
+	enc->framerate = (AVRational){CLIP_FPS, 1};
+	enc->gop_size = CLIP_GOP;
+	enc->max_b_frames = 0;
+	enc->bit_rate = 4000000;
+
+	assert_true(avcodec_open2(enc, codec, NULL) >= 0);
+	assert_true(avcodec_parameters_from_context(stream->codecpar, enc) >=
+		    0);
+	stream->time_base = enc->time_base;
+
+	assert_true(avio_open(&fmt->pb, CLIP_FILE, AVIO_FLAG_WRITE) >= 0);
+	assert_true(avformat_write_header(fmt, NULL) >= 0);
+
+	frame->format = enc->pix_fmt;
+	frame->width = CLIP_CX;
+	frame->height = CLIP_CY;
+	assert_true(av_frame_get_buffer(frame, 0) >= 0);
+
+	for (int i = 0; i < CLIP_FRAMES; i++) {
+		assert_true(av_frame_make_writable(frame) >= 0);
+
+		for (int y = 0; y < CLIP_CY; y++)
+			memset(frame->data[0] + y * frame->linesize[0],
+			       frame_luma(i), CLIP_CX);
+		for (int y = 0; y < CLIP_CY / 2; y++) {
+			memset(frame->data[1] + y * frame->linesize[1], 128,
+			       CLIP_CX / 2);
+			memset(frame->data[2] + y * frame->linesize[2], 128,
+			       CLIP_CX / 2);
+		}
+
+		frame->pts = i + START_OFFSET_SEC * CLIP_FPS;
+		assert_true(avcodec_send_frame(enc, frame) >= 0);
+		write_packets(fmt, enc, stream, pkt);
+	}
+
+	assert_true(avcodec_send_frame(enc, NULL) >= 0);
+	write_packets(fmt, enc, stream, pkt);
+	assert_true(av_write_trailer(fmt) == 0);
+
+	avio_closep(&fmt->pb);
+	av_packet_free(&pkt);
+	av_frame_free(&frame);
+	avcodec_free_context(&enc);
+	avformat_free_context(fmt);
+}
+
+static void media_ready(void *opaque)
+{
+	struct seek_media *sm = opaque;
+	os_event_signal(sm->ready);
+}
+
+/* recovers the frame number from the luma of the seeked frame */
+static void media_seeked(void *opaque, struct obs_source_frame *frame)
+{
+	struct seek_media *sm = opaque;
+	int luma = frame->data[0][frame->linesize[0] * (CLIP_CY / 2) +
+				 CLIP_CX / 2];
+
+	sm->frame = (luma - 16 + 1) / 3;
+	os_event_signal(sm->seeked);
+}
+
+static void media_frame(void *opaque, struct obs_source_frame *frame)
+{
+	UNUSED_PARAMETER(opaque);
+	UNUSED_PARAMETER(frame);
+}
+
+static void media_audio(void *opaque, struct obs_source_audio *audio)
+{
+	UNUSED_PARAMETER(opaque);
+	UNUSED_PARAMETER(audio);
+}
+
+static int seek_frame(struct seek_media *sm, int64_t pos_ms)
+{
+	sm->frame = -1;
+	os_event_reset(sm->seeked);
+	mp_media_seek_to(&sm->media, pos_ms);
+	assert_int_equal(os_event_timedwait(sm->seeked, TIMEOUT_MS), 0);
+	return sm->frame;
+}
+
+static void check_seeks(bool use_index)
+{
+	struct seek_media sm = {0};
+	struct mp_media_info info = {
+		.opaque = &sm,
+		.v_cb = media_frame,
+		.v_preload_cb = media_frame,
+		.v_seek_cb = media_seeked,
+		.a_cb = media_audio,
+		.ready_cb = media_ready,
+		.path = CLIP_FILE,
+		.speed = 100,
+		.is_local_file = true,
+		.volume = 100,
+		.seek_index = use_index,
+		.seek_index_dir = CACHE_DIR,
+	};
+
+	assert_int_equal(os_event_init(&sm.ready, OS_EVENT_TYPE_MANUAL), 0);
+	assert_int_equal(os_event_init(&sm.seeked, OS_EVENT_TYPE_AUTO), 0);
+
+	assert_true(mp_media_init(&sm.media, &info));
+	assert_int_equal(os_event_timedwait(sm.ready, TIMEOUT_MS), 0);
+
+	if (use_index) {
+		for (int i = 0; i < TIMEOUT_MS / 10; i++) {
+			if (mp_media_seek_index_ready(&sm.media))
+				break;
+			os_sleep_ms(10);
+		}
+		assert_true(mp_media_seek_index_ready(&sm.media));
+	}
+
+	mp_media_play(&sm.media, false, false);
+	mp_media_play_pause(&sm.media, true);
+
+	/* positions are relative to the start of the clip, between and on
+	 * keyframes, forwards and backwards */
+	assert_int_equal(seek_frame(&sm, 1510), 45);
+	assert_int_equal(seek_frame(&sm, 2010), 60);
+	assert_int_equal(seek_frame(&sm, 700), 21);
+	assert_int_equal(seek_frame(&sm, 10), 0);
+	assert_int_equal(seek_frame(&sm, 2310), 69);
+
+	mp_media_free(&sm.media);
+	os_event_destroy(sm.ready);
+	os_event_destroy(sm.seeked);
+}
+
+static void seek_start_offset_test(void **state)
+{
+	check_seeks(false);
+	UNUSED_PARAMETER(state);
+}
+
+static void seek_index_start_offset_test(void **state)
+{
+	check_seeks(true);
+	UNUSED_PARAMETER(state);
+}
+
+static int setup(void **state)
+{
+	os_mkdirs(CACHE_DIR);
+	generate_clip();
+
+	UNUSED_PARAMETER(state);
+	return 0;
+}
+
+static int teardown(void **state)
+{
+	os_glob_t *glob;
+
+	if (os_glob(CACHE_DIR "/*", 0, &glob) == 0) {
+		for (size_t i = 0; i < glob->gl_pathc; i++)
+			os_unlink(glob->gl_pathv[i].path);
+		os_globfree(glob);
+	}
+	os_rmdir(CACHE_DIR);
+
+	UNUSED_PARAMETER(state);
+	return 0;
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(seek_start_offset_test),
+		cmocka_unit_test(seek_index_start_offset_test),
+	};
+
+	return cmocka_run_group_tests(tests, setup, teardown);
+}
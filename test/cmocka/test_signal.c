@@ -0,0 +1,187 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <util/platform.h>
+#include <util/threading.h>
+#include <callback/signal.h>
+
+#define THREAD_EMITS 20000
+
+static void count_cb(void *data, calldata_t *cd)
+{
+	long *count = data;
+	os_atomic_inc_long(count);
+	UNUSED_PARAMETER(cd);
+}
+
+static void signal_basic_test(void **state)
+{
+	signal_handler_t *handler = signal_handler_create();
+	long count = 0;
+
+	assert_true(signal_handler_add(handler, "void test(int val)"));
+	assert_true(signal_handler_add(handler, "void other()"));
+	assert_false(signal_handler_add(handler, "void test()"));
+
+	/* connecting the same callback twice is ignored */
+	signal_handler_connect(handler, "test", count_cb, &count);
+	signal_handler_connect(handler, "test", count_cb, &count);
+	signal_handler_signal(handler, "test", NULL);
+	signal_handler_signal(handler, "other", NULL);
+	assert_int_equal(count, 1);
+
+	signal_handler_disconnect(handler, "test", count_cb, &count);
+	signal_handler_signal(handler, "test", NULL);
+	assert_int_equal(count, 1);
+
+	signal_handler_destroy(handler);
+	UNUSED_PARAMETER(state);
+}
+
+struct remove_data {
+	signal_handler_t *handler;
+	long count;
+	bool remove_current;
+};
+
+static void remove_cb(void *data, calldata_t *cd)
+{
+	struct remove_data *rd = data;
+
+	rd->count++;
+	if (rd->remove_current)
+		signal_handler_remove_current();
+	else
+		signal_handler_disconnect(rd->handler, "test", remove_cb, rd);
+
+	/* emitting again from inside the callback must not call it again */
+	signal_handler_signal(rd->handler, "test", cd);
+}
+
+static void signal_remove_test(void **state)
+{
+	signal_handler_t *handler = signal_handler_create();
+	struct remove_data rd1 = {handler, 0, false};
+	struct remove_data rd2 = {handler, 0, true};
+	long count = 0;
+
+	signal_handler_add(handler, "void test()");
+	signal_handler_connect(handler, "test", remove_cb, &rd1);
+	signal_handler_connect(handler, "test", remove_cb, &rd2);
+	signal_handler_connect(handler, "test", count_cb, &count);
+
+	signal_handler_signal(handler, "test", NULL);
+	signal_handler_signal(handler, "test", NULL);
+
+	assert_int_equal(rd1.count, 1);
+	assert_int_equal(rd2.count, 1);
+	/* once per emit, plus the two nested emits */
+	assert_int_equal(count, 4);
+
+	signal_handler_destroy(handler);
+	UNUSED_PARAMETER(state);
+}
+
+static void signal_ref_test(void **state)
+{
+	signal_handler_t *handler = signal_handler_create();
+	long count = 0;
+
+	signal_handler_add(handler, "void test()");
+	signal_handler_connect_ref(handler, "test", count_cb, &count);
+
+	/* still referenced by the connection */
+	signal_handler_destroy(handler);
+	signal_handler_signal(handler, "test", NULL);
+	assert_int_equal(count, 1);
+
+	signal_handler_disconnect(handler, "test", count_cb, &count);
+	UNUSED_PARAMETER(state);
+}
+
+struct emit_data {
+	signal_handler_t *handler;
+	volatile bool stop;
+	long emits;
+};
+
+static void *emit_thread(void *data)
+{
+	struct emit_data *ed = data;
+
+	while (!os_atomic_load_bool(&ed->stop)) {
+		signal_handler_signal(ed->handler, "test", NULL);
+		os_atomic_inc_long(&ed->emits);
+	}
+
+	return NULL;
+}
+
+struct checked_data {
+	volatile bool disconnected;
+	volatile bool called_late;
+};
+
+static void checked_cb(void *data, calldata_t *cd)
+{
+	struct checked_data *cd_data = data;
+
+	if (os_atomic_load_bool(&cd_data->disconnected))
+		os_atomic_store_bool(&cd_data->called_late, true);
+	UNUSED_PARAMETER(cd);
+}
+
+static void signal_thread_test(void **state)
+{
+	struct emit_data ed = {signal_handler_create(), false, 0};
+	pthread_t threads[2];
+	long count = 0;
+
+	signal_handler_add(ed.handler, "void test()");
+	signal_handler_connect(ed.handler, "test", count_cb, &count);
+
+	for (size_t i = 0; i < 2; i++)
+		assert_int_equal(
+			pthread_create(&threads[i], NULL, emit_thread, &ed), 0);
+
+	/* once disconnect returns, the callback must not be running or be
+	 * called anymore */
+	for (int i = 0; i < 1000; i++) {
+		struct checked_data data = {false, false};
+
+		signal_handler_connect(ed.handler, "test", checked_cb, &data);
+		os_sleep_ms(0);
+		signal_handler_disconnect(ed.handler, "test", checked_cb,
+					  &data);
+		os_atomic_store_bool(&data.disconnected, true);
+
+		for (int j = 0; j < 10; j++)
+			signal_handler_signal(ed.handler, "test", NULL);
+
+		assert_false(os_atomic_load_bool(&data.called_late));
+	}
+
+	os_atomic_store_bool(&ed.stop, true);
+	for (size_t i = 0; i < 2; i++)
+		pthread_join(threads[i], NULL);
+
+	/* the subscriber that stayed connected saw every emit */
+	assert_int_equal(count, ed.emits + 1000 * 10);
+
+	signal_handler_destroy(ed.handler);
+	UNUSED_PARAMETER(state);
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(signal_basic_test),
+		cmocka_unit_test(signal_remove_test),
+		cmocka_unit_test(signal_ref_test),
+		cmocka_unit_test(signal_thread_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,91 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <util/spsc-ring.h>
+
+#define THREAD_VALUES 100000
+
+static void ring_basic_test(void **state)
+{
+	struct spsc_ring ring;
+	uint8_t in[100];
+	uint8_t out[100];
+
+	for (size_t i = 0; i < sizeof(in); i++)
+		in[i] = (uint8_t)i;
+
+	assert_true(spsc_ring_init(&ring, 100));
+	assert_int_equal(ring.capacity, 128);
+	assert_int_equal(spsc_ring_size(&ring), 0);
+
+	/* pushing is all or nothing */
+	assert_true(spsc_ring_push(&ring, in, 100));
+	assert_false(spsc_ring_push(&ring, in, 100));
+	assert_int_equal(spsc_ring_size(&ring), 100);
+	assert_int_equal(spsc_ring_avail(&ring), 28);
+
+	assert_int_equal(spsc_ring_pop(&ring, out, 60), 60);
+	assert_memory_equal(out, in, 60);
+
+	/* wraps around the end of the buffer */
+	assert_true(spsc_ring_push(&ring, in, 80));
+	assert_int_equal(spsc_ring_pop(&ring, out, 40), 40);
+	assert_memory_equal(out, in + 60, 40);
+	assert_int_equal(spsc_ring_pop(&ring, out, 100), 80);
+	assert_memory_equal(out, in, 80);
+
+	assert_int_equal(spsc_ring_pop(&ring, NULL, 10), 0);
+
+	spsc_ring_free(&ring);
+	UNUSED_PARAMETER(state);
+}
+
+static void *producer_thread(void *data)
+{
+	struct spsc_ring *ring = data;
+	uint32_t val = 0;
+
+	while (val < THREAD_VALUES) {
+		if (spsc_ring_push(ring, &val, sizeof(val)))
+			val++;
+	}
+
+	return NULL;
+}
+
+static void ring_thread_test(void **state)
+{
+	struct spsc_ring ring;
+	pthread_t thread;
+	uint32_t expected = 0;
+
+	assert_true(spsc_ring_init(&ring, 4096));
+	assert_int_equal(pthread_create(&thread, NULL, producer_thread, &ring),
+			 0);
+
+	/* values have to come out complete and in order */
+	while (expected < THREAD_VALUES) {
+		uint32_t vals[64];
+		size_t size = spsc_ring_pop(&ring, vals, sizeof(vals));
+
+		assert_int_equal(size % sizeof(uint32_t), 0);
+		for (size_t i = 0; i < size / sizeof(uint32_t); i++)
+			assert_int_equal(vals[i], expected++);
+	}
+
+	pthread_join(thread, NULL);
+	spsc_ring_free(&ring);
+	UNUSED_PARAMETER(state);
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(ring_basic_test),
+		cmocka_unit_test(ring_thread_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,199 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <string.h>
+#include <cmocka.h>
+
+#include <util/bmem.h>
+#include <util/dstr.h>
+#include <util/platform.h>
+#include <util/text-lookup.h>
+
+#define CACHE_DIR "test_text_lookup_cache"
+#define NUM_ITEMS 1000
+
+static const char *base_ini = "Name=\"Base\"\n"
+			      "Escapes=\"a\\nb\\t\\\"c\\\"\"\n"
+			      "# comment\n"
+			      "\n"
+			      "Only.Base=\"only in base\"\n"
+			      "Twice=\"first\"\n"
+			      "Twice=\"second\"\n";
+
+static const char *override_ini = "name=\"Override\"\n"
+				  "Extra=\"extra\"\n";
+
+static void write_file(const char *path, const char *str)
+{
+	assert_true(os_quick_write_utf8_file(path, str, strlen(str), false));
+}
+
+static void check_base(lookup_t *lookup)
+{
+	const char *str;
+
+	assert_true(text_lookup_getstr(lookup, "Escapes", &str));
+	assert_string_equal(str, "a\nb\t\"c\"");
+	assert_true(text_lookup_getstr(lookup, "ONLY.BASE", &str));
+	assert_string_equal(str, "only in base");
+	assert_true(text_lookup_getstr(lookup, "Twice", &str));
+	assert_string_equal(str, "second");
+	assert_false(text_lookup_getstr(lookup, "Missing", &str));
+	assert_false(text_lookup_getstr(lookup, "Only", &str));
+}
+
+static void text_lookup_basic_test(void **state)
+{
+	lookup_t *lookup;
+	const char *str;
+
+	write_file("test_base.ini", base_ini);
+	write_file("test_override.ini", override_ini);
+
+	assert_null(text_lookup_create("test_missing.ini"));
+
+	lookup = text_lookup_create("test_base.ini");
+	assert_non_null(lookup);
+	check_base(lookup);
+	assert_true(text_lookup_getstr(lookup, "NAME", &str));
+	assert_string_equal(str, "Base");
+
+	/* later files replace values of earlier ones */
+	assert_true(text_lookup_add(lookup, "test_override.ini"));
+	assert_false(text_lookup_add(lookup, "test_missing.ini"));
+	check_base(lookup);
+	assert_true(text_lookup_getstr(lookup, "Name", &str));
+	assert_string_equal(str, "Override");
+	assert_true(text_lookup_getstr(lookup, "extra", &str));
+	assert_string_equal(str, "extra");
+
+	text_lookup_destroy(lookup);
+
+	os_unlink("test_base.ini");
+	os_unlink("test_override.ini");
+
+	UNUSED_PARAMETER(state);
+}
+
+static void text_lookup_large_test(void **state)
+{
+	struct dstr ini = {0};
+	struct dstr name = {0};
+	lookup_t *lookup;
+	const char *str;
+
+	for (int i = 0; i < NUM_ITEMS; i++)
+		dstr_catf(&ini, "Item%d=\"value %d\"\n", i, i);
+	write_file("test_large.ini", ini.array);
+
+	lookup = text_lookup_create("test_large.ini");
+	assert_non_null(lookup);
+
+	for (int i = 0; i < NUM_ITEMS; i++) {
+		dstr_printf(&name, "item%d", i);
+		assert_true(text_lookup_getstr(lookup, name.array, &str));
+		dstr_printf(&name, "value %d", i);
+		assert_string_equal(str, name.array);
+	}
+
+	text_lookup_destroy(lookup);
+	os_unlink("test_large.ini");
+	dstr_free(&ini);
+	dstr_free(&name);
+
+	UNUSED_PARAMETER(state);
+}
+
+static void clear_cache(void)
+{
+	os_glob_t *glob;
+
+	if (os_glob(CACHE_DIR "/*", 0, &glob) == 0) {
+		for (size_t i = 0; i < glob->gl_pathc; i++)
+			os_unlink(glob->gl_pathv[i].path);
+		os_globfree(glob);
+	}
+}
+
+static void corrupt_cache(void)
+{
+	os_glob_t *glob;
+
+	assert_int_equal(os_glob(CACHE_DIR "/*", 0, &glob), 0);
+	assert_int_equal(glob->gl_pathc, 1);
+	write_file(glob->gl_pathv[0].path, "not a table");
+	os_globfree(glob);
+}
+
+static uint64_t load_base(bool *cached)
+{
+	struct text_lookup_stats before, after;
+	lookup_t *lookup;
+
+	text_lookup_get_stats(&before);
+	lookup = text_lookup_create("test_base.ini");
+	assert_non_null(lookup);
+	check_base(lookup);
+	text_lookup_destroy(lookup);
+	text_lookup_get_stats(&after);
+
+	assert_int_equal(after.files - before.files, 1);
+	*cached = after.cached_files != before.cached_files;
+	return after.mapped_bytes - before.mapped_bytes;
+}
+
+static void text_lookup_cache_test(void **state)
+{
+	struct dstr ini = {0};
+	bool cached;
+
+	assert_int_not_equal(os_mkdirs(CACHE_DIR), MKDIR_ERROR);
+	clear_cache();
+	text_lookup_set_cache_dir(CACHE_DIR);
+
+	/* the first load fills the cache and already maps it */
+	write_file("test_base.ini", base_ini);
+	assert_true(load_base(&cached) > 0);
+	assert_false(cached);
+
+	assert_true(load_base(&cached) > 0);
+	assert_true(cached);
+
+	/* changed files are parsed again */
+	dstr_printf(&ini, "%sNew=\"new\"\n", base_ini);
+	write_file("test_base.ini", ini.array);
+	dstr_free(&ini);
+	load_base(&cached);
+	assert_false(cached);
+	load_base(&cached);
+	assert_true(cached);
+
+	/* broken cache files are ignored and replaced */
+	corrupt_cache();
+	load_base(&cached);
+	assert_false(cached);
+	load_base(&cached);
+	assert_true(cached);
+
+	/* without a cache directory nothing is mapped */
+	text_lookup_set_cache_dir(NULL);
+	assert_int_equal(load_base(&cached), 0);
+	assert_false(cached);
+
+	clear_cache();
+	os_rmdir(CACHE_DIR);
+	os_unlink("test_base.ini");
+
+	UNUSED_PARAMETER(state);
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(text_lookup_basic_test),
+		cmocka_unit_test(text_lookup_large_test),
+		cmocka_unit_test(text_lookup_cache_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}